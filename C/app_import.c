@@ -0,0 +1,404 @@
+#define _GNU_SOURCE
+#include "app_import.h"
+#include "desktop_entry.h"
+#include "exec_metadata.h"
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define IMPORT_DENTS_SIZE 32768      // getdents64 buffer per worker
+#define IMPORT_SHARE_LIMIT 64        // Queued directories before workers keep subtrees to themselves
+
+// Record layout of getdents64(2)
+struct import_dirent64 {
+    guint64 d_ino;
+    gint64 d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+typedef struct {
+    int fd;                   // Open directory, owned by the job
+    gchar *path;              // For the generated entries and the globs only
+} ImportDir;
+
+typedef struct {
+    const AppImportOptions *options;
+    GPatternSpec **include;
+    GPatternSpec **exclude;
+    GThreadPool *pool;
+    gint queued;              // Directories waiting in the pool (atomic)
+    GMutex mutex;
+    GCond done;
+    guint outstanding;        // Directories queued or being walked
+    GPtrArray *items;
+    GHashTable *workers;      // GThread* -> AppImportWorkerStats*
+    guint executables;
+    guint unreadable;
+} ImportContext;
+
+// What one worker collects while walking a job's subtree
+typedef struct {
+    ImportContext *context;
+    AppImportWorkerStats *stats;
+    GPtrArray *items;
+    gchar *dents;
+    guint executables;
+    guint unreadable;
+} ImportWalk;
+
+void app_import_options_init(AppImportOptions *options) {
+    memset(options, 0, sizeof(*options));
+    desktop_categories_clear(&options->categories);
+}
+
+void app_import_item_free(AppImportItem *item) {
+    if (item) {
+        g_free(item->path);
+        g_free(item->name);
+        g_free(item->content);
+        g_free(item);
+    }
+}
+
+static GPatternSpec** compile_globs(gchar **globs) {
+    if (!globs || !globs[0]) {
+        return NULL;
+    }
+    guint n = g_strv_length(globs);
+    GPatternSpec **specs = g_new0(GPatternSpec*, n + 1);
+    for (guint i = 0; i < n; i++) {
+        specs[i] = g_pattern_spec_new(globs[i]);
+    }
+    return specs;
+}
+
+static void free_globs(GPatternSpec **specs) {
+    for (guint i = 0; specs && specs[i]; i++) {
+        g_pattern_spec_free(specs[i]);
+    }
+    g_free(specs);
+}
+
+static gboolean match_globs(GPatternSpec **specs, const gchar *name, const gchar *path) {
+    for (guint i = 0; specs[i]; i++) {
+        if (g_pattern_spec_match_string(specs[i], name) || g_pattern_spec_match_string(specs[i], path)) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+// The file name without an extension that only tells the type, such as
+// .py or .AppImage; version numbers like the one in tool-1.16 stay
+static gchar* import_entry_name(const gchar *file_name) {
+    const gchar *dot = strrchr(file_name, '.');
+    if (dot && dot != file_name && file_classify_by_extension(file_name) != FILE_TYPE_UNKNOWN) {
+        return g_strndup(file_name, dot - file_name);
+    }
+    return g_strdup(file_name);
+}
+
+static gssize read_header(int fd, guchar *header) {
+    gsize length = 0;
+    while (length < FILE_CLASSIFY_HEADER_SIZE) {
+        gssize n = read(fd, header + length, FILE_CLASSIFY_HEADER_SIZE - length);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            return -1;
+        }
+        if (n == 0) {
+            break;
+        }
+        length += n;
+    }
+    return length;
+}
+
+static void import_file(ImportWalk *walk, int dir_fd, const gchar *dir_path, const gchar *name) {
+    const AppImportOptions *options = walk->context->options;
+    struct stat st;
+    
+    // Follows links to files; links to directories are not regular
+    if (fstatat(dir_fd, name, &st, 0) != 0 || !S_ISREG(st.st_mode)) {
+        return;
+    }
+    walk->stats->files++;
+    if ((st.st_mode & (S_IXUSR | S_IXGRP | S_IXOTH)) == 0) {
+        return;
+    }
+    
+    gchar *path = g_build_filename(dir_path, name, NULL);
+    if ((walk->context->include && !match_globs(walk->context->include, name, path)) ||
+        (walk->context->exclude && match_globs(walk->context->exclude, name, path))) {
+        g_free(path);
+        return;
+    }
+    walk->executables++;
+    
+    guchar header[FILE_CLASSIFY_HEADER_SIZE];
+    int fd = openat(dir_fd, name, O_RDONLY | O_CLOEXEC | O_NOCTTY | O_NONBLOCK);
+    gssize length = fd >= 0 ? read_header(fd, header) : -1;
+    if (fd >= 0) {
+        close(fd);
+    }
+    if (length < 0) {
+        g_free(path);
+        return;
+    }
+    
+    FileClassification classification;
+    file_classify_buffer(header, length, name, st.st_mode, &classification);
+    if (classification.type == FILE_TYPE_UNKNOWN) {
+        g_free(path);
+        return;
+    }
+    
+    ExecMetadata *meta = NULL;
+    if (classification.type == FILE_TYPE_APPIMAGE) {
+        // Without usable metadata the AppImage is imported like any binary
+        gchar *error_msg = NULL;
+        meta = exec_metadata_read(path, options->install_icons ? EXEC_METADATA_INSTALL_ICON : 0, &error_msg);
+        g_free(error_msg);
+    }
+    
+    AppImportItem *item = g_new0(AppImportItem, 1);
+    item->path = path;
+    item->name = meta && meta->name ? g_strdup(meta->name) : import_entry_name(name);
+    item->type = classification.type;
+    
+    // The type is known, so generation does not look at the file again
+    DesktopEntry entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.type = DESKTOP_TYPE_APPLICATION;
+    entry.name = item->name;
+    entry.exec_path = item->path;
+    entry.exec_type = item->type;
+    entry.icon_path = (gchar*)options->icon;
+    entry.terminal = options->terminal;
+    entry.categories = options->categories;
+    if (meta) {
+        entry.comment = meta->comment;
+        if (!entry.icon_path) {
+            entry.icon_path = meta->icon_path ? meta->icon_path : meta->icon;
+        }
+        if (desktop_categories_is_empty(&entry.categories) && meta->categories) {
+            desktop_categories_parse(&entry.categories, meta->categories, -1);
+        }
+    }
+    item->content = desktop_entry_generate_content(&entry);
+    exec_metadata_free(meta);
+    
+    g_ptr_array_add(walk->items, item);
+    walk->stats->entries++;
+}
+
+static void import_queue_dir(ImportContext *context, int fd, gchar *path) {
+    ImportDir *dir = g_new(ImportDir, 1);
+    dir->fd = fd;
+    dir->path = path;
+    
+    g_mutex_lock(&context->mutex);
+    context->outstanding++;
+    g_mutex_unlock(&context->mutex);
+    g_atomic_int_inc(&context->queued);
+    g_thread_pool_push(context->pool, dir, NULL);
+}
+
+// Walks the directory open on fd (and closes it). Subdirectories go to the
+// pool while it is short of work and are walked here otherwise, so idle
+// workers pick up subtrees early on and busy ones keep their locality.
+static void import_walk_dir(ImportWalk *walk, int fd, const gchar *path) {
+    ImportContext *context = walk->context;
+    GPtrArray *subdirs = g_ptr_array_new_with_free_func(g_free);
+    walk->stats->dirs++;
+    
+    for (;;) {
+        long n = syscall(SYS_getdents64, fd, walk->dents, IMPORT_DENTS_SIZE);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        for (long offset = 0; offset < n;) {
+            struct import_dirent64 *ent = (struct import_dirent64*)(walk->dents + offset);
+            offset += ent->d_reclen;
+            
+            // Also . and ..
+            if (ent->d_name[0] == '.') {
+                continue;
+            }
+            
+            unsigned char type = ent->d_type;
+            if (type == DT_UNKNOWN) {
+                struct stat st;
+                if (fstatat(fd, ent->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+                    continue;
+                }
+                type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISREG(st.st_mode) ? DT_REG :
+                       S_ISLNK(st.st_mode) ? DT_LNK : DT_UNKNOWN;
+            }
+            
+            if (type == DT_DIR) {
+                g_ptr_array_add(subdirs, g_strdup(ent->d_name));
+            } else if (type == DT_REG || type == DT_LNK) {
+                import_file(walk, fd, path, ent->d_name);
+            }
+        }
+    }
+    
+    // The listing is finished, so the getdents buffer is free for subtrees
+    for (guint i = 0; i < subdirs->len; i++) {
+        const gchar *name = g_ptr_array_index(subdirs, i);
+        gchar *subdir_path = g_build_filename(path, name, NULL);
+        if (context->exclude && match_globs(context->exclude, name, subdir_path)) {
+            g_free(subdir_path);
+            continue;
+        }
+        
+        int subdir_fd = openat(fd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        if (subdir_fd < 0) {
+            walk->unreadable++;
+            g_free(subdir_path);
+        } else if (g_atomic_int_get(&context->queued) < IMPORT_SHARE_LIMIT) {
+            import_queue_dir(context, subdir_fd, subdir_path);
+        } else {
+            import_walk_dir(walk, subdir_fd, subdir_path);
+            g_free(subdir_path);
+        }
+    }
+    
+    g_ptr_array_unref(subdirs);
+    close(fd);
+}
+
+static void import_dir_thread(gpointer data, gpointer user_data) {
+    ImportContext *context = user_data;
+    ImportDir *dir = data;
+    gint64 start_us = g_get_monotonic_time();
+    g_atomic_int_add(&context->queued, -1);
+    
+    // Pool threads outlive the import, so they are told apart by identity
+    // rather than thread-local state
+    g_mutex_lock(&context->mutex);
+    AppImportWorkerStats *stats = g_hash_table_lookup(context->workers, g_thread_self());
+    if (!stats) {
+        stats = g_new0(AppImportWorkerStats, 1);
+        g_hash_table_insert(context->workers, g_thread_self(), stats);
+    }
+    g_mutex_unlock(&context->mutex);
+    
+    ImportWalk walk;
+    memset(&walk, 0, sizeof(walk));
+    walk.context = context;
+    walk.stats = stats;
+    walk.items = g_ptr_array_new();
+    walk.dents = g_malloc(IMPORT_DENTS_SIZE);
+    
+    import_walk_dir(&walk, dir->fd, dir->path);
+    
+    g_mutex_lock(&context->mutex);
+    for (guint i = 0; i < walk.items->len; i++) {
+        g_ptr_array_add(context->items, g_ptr_array_index(walk.items, i));
+    }
+    context->executables += walk.executables;
+    context->unreadable += walk.unreadable;
+    stats->busy_us += g_get_monotonic_time() - start_us;
+    if (--context->outstanding == 0) {
+        g_cond_signal(&context->done);
+    }
+    g_mutex_unlock(&context->mutex);
+    
+    g_ptr_array_unref(walk.items);
+    g_free(walk.dents);
+    g_free(dir->path);
+    g_free(dir);
+}
+
+static gint compare_items(gconstpointer a, gconstpointer b) {
+    const AppImportItem *item_a = *(const AppImportItem * const *)a;
+    const AppImportItem *item_b = *(const AppImportItem * const *)b;
+    return strcmp(item_a->path, item_b->path);
+}
+
+GPtrArray* app_import_scan(const gchar * const *roots, const AppImportOptions *options,
+                           AppImportStats *stats) {
+    ImportContext context;
+    memset(&context, 0, sizeof(context));
+    context.options = options;
+    context.include = compile_globs(options->include);
+    context.exclude = compile_globs(options->exclude);
+    context.items = g_ptr_array_new_with_free_func((GDestroyNotify)app_import_item_free);
+    context.workers = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+    g_mutex_init(&context.mutex);
+    g_cond_init(&context.done);
+    
+    gint64 start_us = g_get_monotonic_time();
+    gint max_threads = options->n_threads > 0 ? (gint)options->n_threads : MAX((gint)g_get_num_processors(), 1);
+    context.pool = g_thread_pool_new(import_dir_thread, &context, max_threads, FALSE, NULL);
+    
+    for (guint i = 0; roots[i] != NULL; i++) {
+        int fd = open(roots[i], O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd < 0) {
+            context.unreadable++;
+            continue;
+        }
+        // Exec= needs absolute paths whatever the working directory
+        import_queue_dir(&context, fd, g_canonicalize_filename(roots[i], NULL));
+    }
+    
+    // Jobs queue more jobs, so the pool cannot be told to finish until the
+    // last directory is done
+    g_mutex_lock(&context.mutex);
+    while (context.outstanding > 0) {
+        g_cond_wait(&context.done, &context.mutex);
+    }
+    g_mutex_unlock(&context.mutex);
+    g_thread_pool_free(context.pool, FALSE, TRUE);
+    
+    // Overlapping roots find the same files twice
+    g_ptr_array_sort(context.items, compare_items);
+    for (guint i = 1; i < context.items->len;) {
+        const AppImportItem *previous = g_ptr_array_index(context.items, i - 1);
+        const AppImportItem *item = g_ptr_array_index(context.items, i);
+        if (strcmp(previous->path, item->path) == 0) {
+            g_ptr_array_remove_index(context.items, i);
+        } else {
+            i++;
+        }
+    }
+    
+    if (stats) {
+        memset(stats, 0, sizeof(*stats));
+        stats->executables = context.executables;
+        stats->unreadable = context.unreadable;
+        stats->workers = g_array_new(FALSE, TRUE, sizeof(AppImportWorkerStats));
+        GHashTableIter iter;
+        gpointer value;
+        g_hash_table_iter_init(&iter, context.workers);
+        while (g_hash_table_iter_next(&iter, NULL, &value)) {
+            AppImportWorkerStats *worker = value;
+            stats->dirs += worker->dirs;
+            stats->files += worker->files;
+            g_array_append_val(stats->workers, *worker);
+        }
+        stats->entries = context.items->len;
+        stats->elapsed_us = g_get_monotonic_time() - start_us;
+    }
+    
+    g_hash_table_destroy(context.workers);
+    g_mutex_clear(&context.mutex);
+    g_cond_clear(&context.done);
+    free_globs(context.include);
+    free_globs(context.exclude);
+    return context.items;
+}
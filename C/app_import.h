@@ -0,0 +1,67 @@
+#ifndef APP_IMPORT_H
+#define APP_IMPORT_H
+
+#include <glib.h>
+#include "desktop_categories.h"
+#include "file_classify.h"
+
+// Bulk import: a desktop entry for every executable under directory trees.
+// The trees are walked by a pool of worker threads that share out
+// subdirectories as they find them. Each worker reads directories through
+// their file descriptors (openat/fstatat/getdents64, no path lookups),
+// classifies executables from their first bytes like
+// file_utils_detect_file_type() does, and generates the entries itself.
+// Hidden files and directories are skipped, and symbolic links are
+// followed to files but never into directories, so the walk cannot loop.
+
+typedef struct {
+    gchar **include;          // Globs; when set only matching files are imported
+    gchar **exclude;          // Globs for files and directories to leave out
+    guint n_threads;          // 0 = one per CPU
+    gboolean terminal;        // Terminal= of the generated entries
+    const gchar *icon;        // Icon= of the generated entries, may be NULL
+    DesktopCategories categories;
+    gboolean install_icons;   // Install the icons of AppImages (see exec_metadata.h)
+} AppImportOptions;
+
+// AppImages are named after their embedded entry, which also provides the
+// Comment, and the Icon and Categories where the options set none.
+
+// Globs match either the file name or the whole path, so "*.so" and
+// "/opt/*/libexec/*" both work.
+
+typedef struct {
+    gchar *path;
+    gchar *name;              // Derived from the file name
+    FileType type;
+    gchar *content;           // The generated entry
+} AppImportItem;
+
+// Work done by one worker thread
+typedef struct {
+    guint dirs;
+    guint files;              // Regular files looked at
+    guint entries;
+    gint64 busy_us;
+} AppImportWorkerStats;
+
+typedef struct {
+    guint dirs;
+    guint files;
+    guint executables;        // Executable files that passed the globs
+    guint entries;            // Distinct ones, when roots overlap
+    guint unreadable;         // Roots and directories that could not be opened
+    gint64 elapsed_us;
+    GArray *workers;          // AppImportWorkerStats; release with g_array_unref()
+} AppImportStats;
+
+void app_import_options_init(AppImportOptions *options);
+
+// Imports everything under roots. Returns AppImportItem* sorted by path;
+// stats may be NULL.
+GPtrArray* app_import_scan(const gchar * const *roots, const AppImportOptions *options,
+                           AppImportStats *stats);
+
+void app_import_item_free(AppImportItem *item);
+
+#endif // APP_IMPORT_H
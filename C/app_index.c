@@ -0,0 +1,736 @@
+#define _GNU_SOURCE
+#include "app_index.h"
+#include "desktop_parser.h"
+#include "file_utils.h"
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <dirent.h>
+#include <string.h>
+
+#define APP_INDEX_MAGIC 0x49413843u  // "C8AI"
+#define APP_INDEX_VERSION 2
+#define APP_INDEX_CHUNK 32           // Files parsed per thread pool job
+
+#define APP_INDEX_RECORD_APPLICATION (1u << 0)
+#define APP_INDEX_DIR_RECURSIVE (1u << 0)
+
+// On-disk layout: header, records, name/exec/path buckets, directories,
+// string pool. Buckets hold a record index + 1 (0 = empty), probed linearly.
+typedef struct {
+    guint32 magic;
+    guint32 version;
+    guint32 n_entries;
+    guint32 n_buckets;       // Power of two, per table
+    guint32 n_dirs;
+    guint32 strings_size;
+    guint64 roots_hash;      // Hash of the scanned root directories
+} AppIndexHeader;
+
+typedef struct {
+    guint32 path;            // Offsets into the string pool
+    guint32 name;
+    guint32 name_key;        // Case-folded name
+    guint32 exec;
+    guint32 icon;
+    guint32 categories;
+    guint32 name_hash;
+    guint32 exec_hash;
+    guint32 path_hash;
+    guint32 flags;
+    gint64 mtime;
+} AppIndexRecord;
+
+typedef struct {
+    guint32 path;
+    guint32 flags;
+    gint64 mtime_sec;
+    gint64 mtime_nsec;
+} AppIndexDir;
+
+G_STATIC_ASSERT(sizeof(AppIndexHeader) == 32);
+G_STATIC_ASSERT(sizeof(AppIndexRecord) == 48);
+G_STATIC_ASSERT(sizeof(AppIndexDir) == 24);
+
+struct _AppIndex {
+    GMappedFile *mapped;     // Index loaded from disk
+    gchar *owned;            // Or built in memory
+    const AppIndexHeader *header;
+    const AppIndexRecord *records;
+    const guint32 *name_buckets;
+    const guint32 *exec_buckets;
+    const guint32 *path_buckets;
+    const AppIndexDir *dirs;
+    const gchar *strings;
+};
+
+// Files and directories found under one root
+typedef struct {
+    const gchar *root;
+    GPtrArray *files;        // gchar*
+    GPtrArray *dirs;         // AppIndexDirStamp*
+} ScanRoot;
+
+typedef struct {
+    gchar **paths;
+    AppIndexItem **items;
+    guint n_files;
+} ScanContext;
+
+static guint32 hash_string(const gchar *str) {
+    guint32 hash = 2166136261u;
+    for (const guchar *p = (const guchar*)str; *p; p++) {
+        hash = (hash ^ *p) * 16777619u;
+    }
+    return hash;
+}
+
+static guint64 hash_roots(const gchar * const *dirs) {
+    guint64 hash = 14695981039346656037ULL;
+    for (guint i = 0; dirs[i] != NULL; i++) {
+        for (const guchar *p = (const guchar*)dirs[i]; ; p++) {
+            hash = (hash ^ *p) * 1099511628211ULL;
+            if (*p == '\0') {
+                break;
+            }
+        }
+    }
+    return hash;
+}
+
+gchar** app_index_get_default_dirs(void) {
+    GPtrArray *dirs = g_ptr_array_new();
+    g_ptr_array_add(dirs, g_build_filename(g_get_user_data_dir(), "applications", NULL));
+    
+    const gchar * const *system_dirs = g_get_system_data_dirs();
+    for (guint i = 0; system_dirs[i] != NULL; i++) {
+        g_ptr_array_add(dirs, g_build_filename(system_dirs[i], "applications", NULL));
+    }
+    
+    g_ptr_array_add(dirs, file_utils_get_desktop_directory());
+    g_ptr_array_add(dirs, NULL);
+    return (gchar**)g_ptr_array_free(dirs, FALSE);
+}
+
+gchar* app_index_get_default_path(void) {
+    return g_build_filename(g_get_user_cache_dir(), "cre8or", "apps.index", NULL);
+}
+
+
+void app_index_dir_stamp_update(AppIndexDirStamp *dir) {
+    struct stat st;
+    if (stat(dir->path, &st) == 0 && S_ISDIR(st.st_mode)) {
+        dir->mtime_sec = st.st_mtim.tv_sec;
+        dir->mtime_nsec = st.st_mtim.tv_nsec;
+    } else {
+        dir->mtime_sec = -1;
+        dir->mtime_nsec = 0;
+    }
+}
+
+void app_index_dir_stamp_free(AppIndexDirStamp *dir) {
+    if (dir) {
+        g_free(dir->path);
+        g_free(dir);
+    }
+}
+
+void app_index_item_free(AppIndexItem *item) {
+    if (item) {
+        g_free(item->path);
+        g_free(item->name);
+        g_free(item->exec);
+        g_free(item->icon);
+        g_free(item->categories);
+        g_free(item);
+    }
+}
+
+AppIndexItem* app_index_item_load(const gchar *path) {
+    struct stat st;
+    if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+        return NULL;
+    }
+    
+    AppIndexItem *item = g_new0(AppIndexItem, 1);
+    item->path = g_strdup(path);
+    item->mtime = st.st_mtim.tv_sec;
+    
+    // Unreadable and non-application files are still recorded, so the index
+    // can answer whether a path is taken
+    DesktopDocument *doc = desktop_document_new_from_file(path, NULL);
+    if (!doc) {
+        return item;
+    }
+    
+    guint group = desktop_document_find_group(doc, "Desktop Entry");
+    const DesktopLine *type = desktop_document_lookup(doc, group, "Type", NULL);
+    const DesktopLine *hidden = desktop_document_lookup(doc, group, "Hidden", NULL);
+    item->application = group != DESKTOP_NO_GROUP &&
+                        (!type || desktop_span_equal(type->value, "Application")) &&
+                        !(hidden && desktop_span_equal(hidden->value, "true"));
+    
+    const DesktopLine *line;
+    if ((line = desktop_document_lookup(doc, group, "Name", NULL))) {
+        item->name = desktop_span_unescape(line->value, FALSE);
+    }
+    if ((line = desktop_document_lookup(doc, group, "Exec", NULL))) {
+        gchar *exec = desktop_span_unescape(line->value, FALSE);
+        item->exec = desktop_exec_get_path(exec, NULL);
+        g_free(exec);
+    }
+    if ((line = desktop_document_lookup(doc, group, "Icon", NULL))) {
+        item->icon = desktop_span_unescape(line->value, FALSE);
+    }
+    if ((line = desktop_document_lookup(doc, group, "Categories", NULL))) {
+        item->categories = desktop_span_unescape(line->value, FALSE);
+    }
+    desktop_document_free(doc);
+    return item;
+}
+
+// Collects the .desktop files of one directory. Subdirectories are only
+// followed below "applications" directories, where the spec allows them.
+static void scan_walk(ScanRoot *root, const gchar *dir_path, gboolean recurse) {
+    // Stat before reading so a change during the scan leaves the index stale
+    AppIndexDirStamp *dir = g_new0(AppIndexDirStamp, 1);
+    dir->path = g_strdup(dir_path);
+    dir->recursive = recurse;
+    app_index_dir_stamp_update(dir);
+    g_ptr_array_add(root->dirs, dir);
+    
+    DIR *handle = opendir(dir_path);
+    if (!handle) {
+        return;
+    }
+    
+    struct dirent *ent;
+    while ((ent = readdir(handle)) != NULL) {
+        if (ent->d_name[0] == '.') {
+            continue;
+        }
+        
+        gboolean is_dir = ent->d_type == DT_DIR;
+        if (ent->d_type == DT_UNKNOWN) {
+            struct stat st;
+            gchar *child = g_build_filename(dir_path, ent->d_name, NULL);
+            is_dir = lstat(child, &st) == 0 && S_ISDIR(st.st_mode);
+            g_free(child);
+        }
+        
+        if (is_dir) {
+            if (recurse) {
+                gchar *child = g_build_filename(dir_path, ent->d_name, NULL);
+                scan_walk(root, child, TRUE);
+                g_free(child);
+            }
+        } else if (g_str_has_suffix(ent->d_name, ".desktop")) {
+            g_ptr_array_add(root->files, g_build_filename(dir_path, ent->d_name, NULL));
+        }
+    }
+    closedir(handle);
+}
+
+static void scan_root_thread(gpointer data, gpointer user_data) {
+    (void)user_data;  // Suppress unused parameter warning
+    ScanRoot *root = data;
+    gchar *base = g_path_get_basename(root->root);
+    scan_walk(root, root->root, g_strcmp0(base, "applications") == 0);
+    g_free(base);
+}
+
+static void scan_parse_thread(gpointer data, gpointer user_data) {
+    ScanContext *context = user_data;
+    guint start = (GPOINTER_TO_UINT(data) - 1) * APP_INDEX_CHUNK;
+    guint end = MIN(start + APP_INDEX_CHUNK, context->n_files);
+    for (guint i = start; i < end; i++) {
+        context->items[i] = app_index_item_load(context->paths[i]);
+    }
+}
+
+void app_index_scan(const gchar * const *dirs, GPtrArray *items, GPtrArray *scanned) {
+    guint n_roots = g_strv_length((gchar**)dirs);
+    gint n_threads = MAX(g_get_num_processors(), 1);
+    
+    // Walk the roots in parallel, one job per root
+    ScanRoot *roots = g_new0(ScanRoot, MAX(n_roots, 1));
+    GThreadPool *pool = g_thread_pool_new(scan_root_thread, NULL, MIN(n_threads, (gint)MAX(n_roots, 1)), FALSE, NULL);
+    for (guint i = 0; i < n_roots; i++) {
+        roots[i].root = dirs[i];
+        roots[i].files = g_ptr_array_new();
+        roots[i].dirs = g_ptr_array_new();
+        g_thread_pool_push(pool, &roots[i], NULL);
+    }
+    g_thread_pool_free(pool, FALSE, TRUE);
+    
+    // Flatten in root order so earlier (more important) directories come first
+    guint n_files = 0;
+    for (guint i = 0; i < n_roots; i++) {
+        n_files += roots[i].files->len;
+    }
+    ScanContext context;
+    context.paths = g_new0(gchar*, MAX(n_files, 1));
+    context.items = g_new0(AppIndexItem*, MAX(n_files, 1));
+    context.n_files = n_files;
+    guint n = 0;
+    for (guint i = 0; i < n_roots; i++) {
+        for (guint j = 0; j < roots[i].files->len; j++) {
+            context.paths[n++] = g_ptr_array_index(roots[i].files, j);
+        }
+        for (guint j = 0; j < roots[i].dirs->len; j++) {
+            g_ptr_array_add(scanned, g_ptr_array_index(roots[i].dirs, j));
+        }
+        g_ptr_array_free(roots[i].files, TRUE);
+        g_ptr_array_free(roots[i].dirs, TRUE);
+    }
+    g_free(roots);
+    
+    // Parse in parallel; every job owns a disjoint slice of the arrays
+    pool = g_thread_pool_new(scan_parse_thread, &context, n_threads, FALSE, NULL);
+    for (guint chunk = 0; chunk * APP_INDEX_CHUNK < n_files; chunk++) {
+        g_thread_pool_push(pool, GUINT_TO_POINTER(chunk + 1), NULL);
+    }
+    g_thread_pool_free(pool, FALSE, TRUE);
+    
+    for (guint i = 0; i < n_files; i++) {
+        if (context.items[i]) {
+            g_ptr_array_add(items, context.items[i]);
+        }
+        g_free(context.paths[i]);
+    }
+    g_free(context.paths);
+    g_free(context.items);
+}
+
+static guint32 add_string(GString *strings, const gchar *str) {
+    if (!str || !*str) {
+        return 0;  // Offset 0 is the empty string
+    }
+    guint32 offset = strings->len;
+    g_string_append_len(strings, str, strlen(str) + 1);
+    return offset;
+}
+
+static void bucket_insert(guint32 *buckets, guint32 n_buckets, guint32 hash, guint32 value) {
+    for (guint32 slot = hash & (n_buckets - 1); ; slot = (slot + 1) & (n_buckets - 1)) {
+        if (buckets[slot] == 0) {
+            buckets[slot] = value;
+            return;
+        }
+    }
+}
+
+static gsize index_size(guint32 n_entries, guint32 n_buckets, guint32 n_dirs, guint32 strings_size) {
+    return sizeof(AppIndexHeader) + (gsize)n_entries * sizeof(AppIndexRecord) +
+           (gsize)n_buckets * 3 * sizeof(guint32) + (gsize)n_dirs * sizeof(AppIndexDir) + strings_size;
+}
+
+// Points the index at its sections after checking that they fit
+static gboolean app_index_bind(AppIndex *index, const gchar *data, gsize length) {
+    if (!data || length < sizeof(AppIndexHeader)) {
+        return FALSE;
+    }
+    
+    const AppIndexHeader *header = (const AppIndexHeader*)data;
+    if (header->magic != APP_INDEX_MAGIC || header->version != APP_INDEX_VERSION ||
+        header->n_buckets == 0 || (header->n_buckets & (header->n_buckets - 1)) != 0 ||
+        header->n_entries >= header->n_buckets || header->strings_size == 0 ||
+        index_size(header->n_entries, header->n_buckets, header->n_dirs, header->strings_size) != length ||
+        data[length - 1] != '\0') {
+        return FALSE;
+    }
+    
+    const gchar *p = data + sizeof(AppIndexHeader);
+    index->header = header;
+    index->records = (const AppIndexRecord*)p;
+    p += (gsize)header->n_entries * sizeof(AppIndexRecord);
+    index->name_buckets = (const guint32*)p;
+    p += (gsize)header->n_buckets * sizeof(guint32);
+    index->exec_buckets = (const guint32*)p;
+    p += (gsize)header->n_buckets * sizeof(guint32);
+    index->path_buckets = (const guint32*)p;
+    p += (gsize)header->n_buckets * sizeof(guint32);
+    index->dirs = (const AppIndexDir*)p;
+    p += (gsize)header->n_dirs * sizeof(AppIndexDir);
+    index->strings = p;
+    return TRUE;
+}
+
+static const gchar* index_string(const AppIndex *index, guint32 offset) {
+    return offset < index->header->strings_size ? index->strings + offset : "";
+}
+
+// Serializes items and directories into the on-disk layout
+static gchar* serialize_index(guint64 roots_hash, GPtrArray *items, GPtrArray *scanned, gsize *length) {
+    guint32 n_entries = items->len;
+    guint32 n_buckets = 16;
+    while (n_buckets < n_entries * 2) {
+        n_buckets <<= 1;
+    }
+    
+    GString *strings = g_string_new(NULL);
+    g_string_append_c(strings, '\0');
+    AppIndexRecord *records = g_new0(AppIndexRecord, MAX(n_entries, 1));
+    guint32 *buckets = g_new0(guint32, n_buckets * 3);
+    
+    for (guint32 i = 0; i < n_entries; i++) {
+        AppIndexItem *item = g_ptr_array_index(items, i);
+        gchar *name_key = item->name ? g_utf8_casefold(item->name, -1) : NULL;
+        AppIndexRecord *record = &records[i];
+        record->path = add_string(strings, item->path);
+        record->name = add_string(strings, item->name);
+        record->name_key = add_string(strings, name_key);
+        record->exec = add_string(strings, item->exec);
+        record->icon = add_string(strings, item->icon);
+        record->categories = add_string(strings, item->categories);
+        record->name_hash = hash_string(name_key ? name_key : "");
+        record->exec_hash = hash_string(item->exec ? item->exec : "");
+        record->path_hash = hash_string(item->path);
+        record->flags = item->application ? APP_INDEX_RECORD_APPLICATION : 0;
+        record->mtime = item->mtime;
+        g_free(name_key);
+        
+        if (record->name) {
+            bucket_insert(buckets, n_buckets, record->name_hash, i + 1);
+        }
+        if (record->exec) {
+            bucket_insert(buckets + n_buckets, n_buckets, record->exec_hash, i + 1);
+        }
+        bucket_insert(buckets + n_buckets * 2, n_buckets, record->path_hash, i + 1);
+    }
+    
+    AppIndexDir *index_dirs = g_new0(AppIndexDir, MAX(scanned->len, 1));
+    for (guint i = 0; i < scanned->len; i++) {
+        AppIndexDirStamp *dir = g_ptr_array_index(scanned, i);
+        index_dirs[i].path = add_string(strings, dir->path);
+        index_dirs[i].flags = dir->recursive ? APP_INDEX_DIR_RECURSIVE : 0;
+        index_dirs[i].mtime_sec = dir->mtime_sec;
+        index_dirs[i].mtime_nsec = dir->mtime_nsec;
+    }
+    
+    AppIndexHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = APP_INDEX_MAGIC;
+    header.version = APP_INDEX_VERSION;
+    header.n_entries = n_entries;
+    header.n_buckets = n_buckets;
+    header.n_dirs = scanned->len;
+    header.strings_size = strings->len;
+    header.roots_hash = roots_hash;
+    
+    *length = index_size(header.n_entries, header.n_buckets, header.n_dirs, header.strings_size);
+    gchar *data = g_malloc(*length);
+    gchar *p = data;
+    memcpy(p, &header, sizeof(header));
+    p += sizeof(header);
+    memcpy(p, records, (gsize)n_entries * sizeof(AppIndexRecord));
+    p += (gsize)n_entries * sizeof(AppIndexRecord);
+    memcpy(p, buckets, (gsize)n_buckets * 3 * sizeof(guint32));
+    p += (gsize)n_buckets * 3 * sizeof(guint32);
+    memcpy(p, index_dirs, (gsize)scanned->len * sizeof(AppIndexDir));
+    p += (gsize)scanned->len * sizeof(AppIndexDir);
+    memcpy(p, strings->str, strings->len);
+    
+    g_free(index_dirs);
+    g_free(buckets);
+    g_free(records);
+    g_string_free(strings, TRUE);
+    return data;
+}
+
+static AppIndex* write_index(const gchar *index_path, guint64 roots_hash,
+                             GPtrArray *items, GPtrArray *scanned, gchar **error_msg) {
+    gsize length = 0;
+    gchar *data = serialize_index(roots_hash, items, scanned, &length);
+    
+    if (index_path) {
+        gchar *dir = g_path_get_dirname(index_path);
+        g_mkdir_with_parents(dir, 0700);
+        g_free(dir);
+        
+        GError *write_error = NULL;
+        if (!g_file_set_contents(index_path, data, length, &write_error)) {
+            *error_msg = g_strdup_printf("Failed to write application index %s: %s", index_path,
+                                        write_error ? write_error->message : "Unknown error");
+            if (write_error) g_error_free(write_error);
+            g_free(data);
+            return NULL;
+        }
+    }
+    
+    AppIndex *index = g_new0(AppIndex, 1);
+    index->owned = data;
+    app_index_bind(index, data, length);
+    return index;
+}
+
+AppIndex* app_index_write(const gchar *index_path, const gchar * const *dirs,
+                          GPtrArray *items, GPtrArray *scanned, gchar **error_msg) {
+    return write_index(index_path, hash_roots(dirs), items, scanned, error_msg);
+}
+
+// Never the mtime of a directory, so a stamp set to it never matches again
+#define APP_INDEX_MTIME_STALE (-2)
+
+AppIndex* app_index_update(const AppIndex *index, const gchar *index_path, const gchar * const *paths,
+                           guint n_paths, GPtrArray *before, gchar **error_msg) {
+    GPtrArray *items = g_ptr_array_new_with_free_func((GDestroyNotify)app_index_item_free);
+    GPtrArray *scanned = g_ptr_array_new_with_free_func((GDestroyNotify)app_index_dir_stamp_free);
+    app_index_export(index, items, scanned);
+    
+    GHashTable *positions = g_hash_table_new(g_str_hash, g_str_equal);
+    for (guint i = 0; i < items->len; i++) {
+        AppIndexItem *item = g_ptr_array_index(items, i);
+        g_hash_table_insert(positions, item->path, GUINT_TO_POINTER(i + 1));
+    }
+    
+    GHashTable *stamped = g_hash_table_new(g_direct_hash, g_direct_equal);
+    for (guint i = 0; i < n_paths; i++) {
+        // Only files directly in a scanned directory belong in the index
+        gchar *dir_path = g_path_get_dirname(paths[i]);
+        AppIndexDirStamp *dir = NULL;
+        for (guint j = 0; j < scanned->len && !dir; j++) {
+            AppIndexDirStamp *candidate = g_ptr_array_index(scanned, j);
+            dir = strcmp(candidate->path, dir_path) == 0 ? candidate : NULL;
+        }
+        g_free(dir_path);
+        if (!dir || !g_str_has_suffix(paths[i], ".desktop")) {
+            continue;
+        }
+        
+        // Decided once per directory, against the stamp it was loaded with
+        if (g_hash_table_add(stamped, dir)) {
+            const AppIndexDirStamp *prior = NULL;
+            for (guint j = 0; before && j < before->len && !prior; j++) {
+                const AppIndexDirStamp *candidate = g_ptr_array_index(before, j);
+                prior = strcmp(candidate->path, dir->path) == 0 ? candidate : NULL;
+            }
+            if (prior && prior->mtime_sec == dir->mtime_sec && prior->mtime_nsec == dir->mtime_nsec) {
+                app_index_dir_stamp_update(dir);
+            } else {
+                dir->mtime_sec = APP_INDEX_MTIME_STALE;
+                dir->mtime_nsec = 0;
+            }
+        }
+        
+        // Replaced in place, so the file keeps its rank among the roots;
+        // a removed file leaves a NULL that is dropped below
+        AppIndexItem *item = app_index_item_load(paths[i]);
+        guint position = GPOINTER_TO_UINT(g_hash_table_lookup(positions, paths[i]));
+        if (position > 0) {
+            g_hash_table_remove(positions, paths[i]);
+            app_index_item_free(g_ptr_array_index(items, position - 1));
+            g_ptr_array_index(items, position - 1) = item;
+            if (item) {
+                g_hash_table_insert(positions, item->path, GUINT_TO_POINTER(position));
+            }
+        } else if (item) {
+            g_ptr_array_add(items, item);
+            g_hash_table_insert(positions, item->path, GUINT_TO_POINTER(items->len));
+        }
+    }
+    g_hash_table_destroy(stamped);
+    g_hash_table_destroy(positions);
+    for (guint i = items->len; i > 0; i--) {
+        if (!g_ptr_array_index(items, i - 1)) {
+            g_ptr_array_remove_index(items, i - 1);
+        }
+    }
+    
+    AppIndex *updated = write_index(index_path, index->header ? index->header->roots_hash : 0,
+                                    items, scanned, error_msg);
+    g_ptr_array_free(items, TRUE);
+    g_ptr_array_free(scanned, TRUE);
+    return updated;
+}
+
+AppIndex* app_index_build(const gchar *index_path, const gchar * const *dirs, gchar **error_msg) {
+    GPtrArray *items = g_ptr_array_new_with_free_func((GDestroyNotify)app_index_item_free);
+    GPtrArray *scanned = g_ptr_array_new_with_free_func((GDestroyNotify)app_index_dir_stamp_free);
+    
+    app_index_scan(dirs, items, scanned);
+    AppIndex *index = app_index_write(index_path, dirs, items, scanned, error_msg);
+    
+    g_ptr_array_free(items, TRUE);
+    g_ptr_array_free(scanned, TRUE);
+    return index;
+}
+
+AppIndex* app_index_load(const gchar *index_path, const gchar * const *dirs) {
+    GMappedFile *mapped = g_mapped_file_new(index_path, FALSE, NULL);
+    if (!mapped) {
+        return NULL;
+    }
+    
+    AppIndex *index = g_new0(AppIndex, 1);
+    index->mapped = mapped;
+    if (!app_index_bind(index, g_mapped_file_get_contents(mapped), g_mapped_file_get_length(mapped)) ||
+        index->header->roots_hash != hash_roots(dirs)) {
+        app_index_free(index);
+        return NULL;
+    }
+    
+    for (guint32 i = 0; i < index->header->n_dirs; i++) {
+        const AppIndexDir *dir = &index->dirs[i];
+        AppIndexDirStamp stamp = { (gchar*)index_string(index, dir->path), 0, 0, FALSE };
+        app_index_dir_stamp_update(&stamp);
+        if (stamp.mtime_sec != dir->mtime_sec || stamp.mtime_nsec != dir->mtime_nsec) {
+            app_index_free(index);
+            return NULL;
+        }
+    }
+    return index;
+}
+
+AppIndex* app_index_open(gchar **error_msg) {
+    gchar **dirs = app_index_get_default_dirs();
+    gchar *index_path = app_index_get_default_path();
+    
+    AppIndex *index = app_index_load(index_path, (const gchar * const *)dirs);
+    if (!index) {
+        index = app_index_build(index_path, (const gchar * const *)dirs, error_msg);
+    }
+    if (!index) {
+        // Cache not writable: still usable for this process
+        index = app_index_build(NULL, (const gchar * const *)dirs, NULL);
+    }
+    
+    g_free(index_path);
+    g_strfreev(dirs);
+    return index;
+}
+
+void app_index_free(AppIndex *index) {
+    if (index) {
+        if (index->mapped) {
+            g_mapped_file_unref(index->mapped);
+        }
+        g_free(index->owned);
+        g_free(index);
+    }
+}
+
+guint app_index_get_n_entries(const AppIndex *index) {
+    return index->header ? index->header->n_entries : 0;
+}
+
+void app_index_get_entry(const AppIndex *index, guint i, AppIndexEntry *entry) {
+    const AppIndexRecord *record = &index->records[i];
+    entry->path = index_string(index, record->path);
+    entry->name = index_string(index, record->name);
+    entry->exec = index_string(index, record->exec);
+    entry->icon = index_string(index, record->icon);
+    entry->categories = index_string(index, record->categories);
+    entry->mtime = record->mtime;
+    entry->application = (record->flags & APP_INDEX_RECORD_APPLICATION) != 0;
+}
+
+void app_index_export(const AppIndex *index, GPtrArray *items, GPtrArray *scanned) {
+    for (guint i = 0; i < app_index_get_n_entries(index); i++) {
+        AppIndexEntry entry;
+        app_index_get_entry(index, i, &entry);
+        AppIndexItem *item = g_new0(AppIndexItem, 1);
+        item->path = g_strdup(entry.path);
+        item->name = *entry.name ? g_strdup(entry.name) : NULL;
+        item->exec = *entry.exec ? g_strdup(entry.exec) : NULL;
+        item->icon = *entry.icon ? g_strdup(entry.icon) : NULL;
+        item->categories = *entry.categories ? g_strdup(entry.categories) : NULL;
+        item->mtime = entry.mtime;
+        item->application = entry.application;
+        g_ptr_array_add(items, item);
+    }
+    
+    for (guint32 i = 0; index->header && i < index->header->n_dirs; i++) {
+        const AppIndexDir *dir = &index->dirs[i];
+        AppIndexDirStamp *stamp = g_new0(AppIndexDirStamp, 1);
+        stamp->path = g_strdup(index_string(index, dir->path));
+        stamp->mtime_sec = dir->mtime_sec;
+        stamp->mtime_nsec = dir->mtime_nsec;
+        stamp->recursive = (dir->flags & APP_INDEX_DIR_RECURSIVE) != 0;
+        g_ptr_array_add(scanned, stamp);
+    }
+}
+
+typedef enum {
+    MATCH_NAME,
+    MATCH_EXEC,
+    MATCH_PATH
+} MatchKey;
+
+// Appends every record whose key equals key to matches
+static void collect_matches(const AppIndex *index, MatchKey by, const gchar *key, GArray *matches) {
+    const guint32 *buckets = by == MATCH_NAME ? index->name_buckets :
+                             by == MATCH_EXEC ? index->exec_buckets : index->path_buckets;
+    guint32 n_buckets = index->header->n_buckets;
+    guint32 hash = hash_string(key);
+    
+    for (guint32 slot = hash & (n_buckets - 1), probes = 0; probes < n_buckets;
+         slot = (slot + 1) & (n_buckets - 1), probes++) {
+        guint32 value = buckets[slot];
+        if (value == 0) {
+            break;
+        }
+        if (value > index->header->n_entries) {
+            continue;
+        }
+        
+        const AppIndexRecord *record = &index->records[value - 1];
+        guint32 record_hash = by == MATCH_NAME ? record->name_hash :
+                              by == MATCH_EXEC ? record->exec_hash : record->path_hash;
+        guint32 record_key = by == MATCH_NAME ? record->name_key :
+                             by == MATCH_EXEC ? record->exec : record->path;
+        if (record_hash != hash || strcmp(index_string(index, record_key), key) != 0) {
+            continue;
+        }
+        if (by != MATCH_PATH && !(record->flags & APP_INDEX_RECORD_APPLICATION)) {
+            continue;
+        }
+        
+        guint match = value - 1;
+        gboolean seen = FALSE;
+        for (guint i = 0; i < matches->len && !seen; i++) {
+            seen = g_array_index(matches, guint, i) == match;
+        }
+        if (!seen) {
+            g_array_append_val(matches, match);
+        }
+    }
+}
+
+GArray* app_index_find_duplicates(const AppIndex *index, const gchar *name, const gchar *exec_path) {
+    GArray *matches = g_array_new(FALSE, FALSE, sizeof(guint));
+    if (!index->header || index->header->n_entries == 0) {
+        return matches;
+    }
+    
+    if (name && *name) {
+        gchar *name_key = g_utf8_casefold(name, -1);
+        collect_matches(index, MATCH_NAME, name_key, matches);
+        g_free(name_key);
+    }
+    if (exec_path && *exec_path) {
+        collect_matches(index, MATCH_EXEC, exec_path, matches);
+    }
+    return matches;
+}
+
+gboolean app_index_lookup_path(const AppIndex *index, const gchar *path, gboolean *exists) {
+    if (!index->header || !path) {
+        return FALSE;
+    }
+    
+    gchar *dir_path = g_path_get_dirname(path);
+    gboolean covered = FALSE;
+    for (guint32 i = 0; i < index->header->n_dirs && !covered; i++) {
+        covered = strcmp(index_string(index, index->dirs[i].path), dir_path) == 0;
+    }
+    g_free(dir_path);
+    if (!covered || !g_str_has_suffix(path, ".desktop")) {
+        return FALSE;
+    }
+    
+    GArray *matches = g_array_new(FALSE, FALSE, sizeof(guint));
+    collect_matches(index, MATCH_PATH, path, matches);
+    *exists = matches->len > 0;
+    g_array_free(matches, TRUE);
+    return TRUE;
+}
@@ -0,0 +1,103 @@
+#ifndef APP_INDEX_H
+#define APP_INDEX_H
+
+#include <glib.h>
+
+// Index of the installed applications.
+// Every applications directory in $XDG_DATA_HOME and $XDG_DATA_DIRS plus the
+// user's Desktop is scanned in parallel and the entries are written to a
+// compact file ($XDG_CACHE_HOME/cre8or/apps.index) that is memory-mapped on
+// later runs. Lookups by Name, by executable and by path go through hash
+// tables in the file, so checking a new entry for duplicates is O(1).
+
+typedef struct _AppIndex AppIndex;
+
+// Strings point into the mapped index and stay valid until app_index_free()
+typedef struct {
+    const gchar *path;
+    const gchar *name;
+    const gchar *exec;        // Executable path as recovered from Exec
+    const gchar *icon;
+    const gchar *categories;
+    gint64 mtime;
+    gboolean application;     // FALSE for hidden and non-application entries
+} AppIndexEntry;
+
+// A parsed .desktop file, as kept by the scanner and by app_watch
+typedef struct {
+    gchar *path;
+    gchar *name;
+    gchar *exec;
+    gchar *icon;
+    gchar *categories;
+    gint64 mtime;
+    gboolean application;
+} AppIndexItem;
+
+// A scanned directory; the index is stale once its mtime changes
+typedef struct {
+    gchar *path;
+    gint64 mtime_sec;         // -1 when the directory does not exist
+    gint64 mtime_nsec;
+    gboolean recursive;       // Subdirectories are scanned too
+} AppIndexDirStamp;
+
+// Directories scanned by default, most important first
+gchar** app_index_get_default_dirs(void);
+gchar* app_index_get_default_path(void);
+
+// Scans dirs, writes the index to index_path (NULL = memory only) and maps it
+AppIndex* app_index_build(const gchar *index_path, const gchar * const *dirs, gchar **error_msg);
+
+// Maps an existing index. Returns NULL when it is missing, corrupt or was
+// built from other directories, or when one of them changed since.
+AppIndex* app_index_load(const gchar *index_path, const gchar * const *dirs);
+
+// Loads the default index, rebuilding it when needed
+AppIndex* app_index_open(gchar **error_msg);
+
+void app_index_free(AppIndex *index);
+
+guint app_index_get_n_entries(const AppIndex *index);
+void app_index_get_entry(const AppIndex *index, guint i, AppIndexEntry *entry);
+
+// Returns the indices (guint) of applications with the same Name
+// (case-insensitive) or the same executable; either argument may be NULL
+GArray* app_index_find_duplicates(const AppIndex *index, const gchar *name, const gchar *exec_path);
+
+// Answers whether a .desktop file exists at path without touching the file
+// system. Returns FALSE when path is outside the scanned directories.
+gboolean app_index_lookup_path(const AppIndex *index, const gchar *path, gboolean *exists);
+
+// Building blocks for incremental maintenance (see app_watch.h)
+
+// Parses one .desktop file; NULL when it cannot be read
+AppIndexItem* app_index_item_load(const gchar *path);
+void app_index_item_free(AppIndexItem *item);
+void app_index_dir_stamp_free(AppIndexDirStamp *dir);
+
+// Stats dir into stamp
+void app_index_dir_stamp_update(AppIndexDirStamp *dir);
+
+// Scans dirs in parallel, appending AppIndexItem* to items and
+// AppIndexDirStamp* to scanned (both should own their elements)
+void app_index_scan(const gchar * const *dirs, GPtrArray *items, GPtrArray *scanned);
+
+// Brings index up to date after the files at paths were written or
+// removed: their records are read again without rescanning anything else.
+// before holds AppIndexDirStamp* of their directories taken just before
+// the write. A directory whose stamp there still matches index is stamped
+// again; one that someone else changed since index was loaded is left
+// stale, so the next load rescans instead of hiding their files. The
+// result is written to index_path (NULL = memory only).
+AppIndex* app_index_update(const AppIndex *index, const gchar *index_path, const gchar * const *paths,
+                           guint n_paths, GPtrArray *before, gchar **error_msg);
+
+// Copies the contents of a loaded index out, in the same form
+void app_index_export(const AppIndex *index, GPtrArray *items, GPtrArray *scanned);
+
+// Writes items and scanned directories as an index built from dirs
+AppIndex* app_index_write(const gchar *index_path, const gchar * const *dirs,
+                          GPtrArray *items, GPtrArray *scanned, gchar **error_msg);
+
+#endif // APP_INDEX_H
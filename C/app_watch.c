@@ -0,0 +1,784 @@
+#define _GNU_SOURCE
+#include "app_watch.h"
+#include <glib-unix.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <errno.h>
+#include <unistd.h>
+#include <string.h>
+
+#define APP_WATCH_MASK (IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | \
+                        IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR)
+#define APP_WATCH_PARENT_MASK (IN_CREATE | IN_MOVED_TO | IN_ONLYDIR | IN_MASK_ADD)
+#define APP_WATCH_FLUSH_ROUNDS 4
+
+struct _AppWatch {
+    gchar *index_path;
+    gchar **roots;
+    int fd;
+    GHashTable *items;        // path -> AppIndexItem*
+    GHashTable *by_name;      // Casefolded name -> GPtrArray of application items
+    GHashTable *by_exec;      // Executable path -> GPtrArray of application items
+    GHashTable *dirs;         // path -> AppIndexDirStamp*, including missing roots
+    GHashTable *dir_wds;      // path -> wd of directories whose entries are tracked
+    GHashTable *wd_paths;     // wd -> watched path (tracked directory or parent of a missing root)
+    GHashTable *dirty;        // Paths to parse again, coalesced across events
+    gboolean rescan;          // The event queue overflowed
+    AppIndex *index;          // Snapshot of items, rebuilt on demand
+    gboolean index_stale;
+    gboolean file_stale;
+    guint source_id;
+    guint flush_id;
+    guint flush_delay_ms;
+    AppWatchErrorFunc error_func;
+    gpointer error_data;
+    AppWatchStats stats;
+    gint ref_count;
+};
+
+// Read from save workers, so swapped under the lock with a reference held
+G_LOCK_DEFINE_STATIC(default_watch);
+static AppWatch *default_watch = NULL;
+
+void app_watch_set_default(AppWatch *watch) {
+    if (watch) {
+        app_watch_ref(watch);
+    }
+    G_LOCK(default_watch);
+    AppWatch *previous = g_atomic_pointer_get(&default_watch);
+    g_atomic_pointer_set(&default_watch, watch);
+    G_UNLOCK(default_watch);
+    app_watch_unref(previous);
+}
+
+AppWatch* app_watch_dup_default(void) {
+    // No lock taken while there is no watch, the usual case outside the
+    // wizard and the daemon
+    if (!g_atomic_pointer_get(&default_watch)) {
+        return NULL;
+    }
+    G_LOCK(default_watch);
+    AppWatch *watch = g_atomic_pointer_get(&default_watch);
+    if (watch) {
+        app_watch_ref(watch);
+    }
+    G_UNLOCK(default_watch);
+    return watch;
+}
+
+static gboolean is_root(AppWatch *watch, const gchar *path) {
+    for (guint i = 0; watch->roots[i] != NULL; i++) {
+        if (strcmp(watch->roots[i], path) == 0) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+static gboolean path_is_below(const gchar *path, const gchar *dir) {
+    gsize len = strlen(dir);
+    return strncmp(path, dir, len) == 0 && path[len] == '/';
+}
+
+static void watch_add_wd(AppWatch *watch, int wd, const gchar *path) {
+    if (!g_hash_table_contains(watch->wd_paths, GINT_TO_POINTER(wd))) {
+        g_hash_table_insert(watch->wd_paths, GINT_TO_POINTER(wd), g_strdup(path));
+    }
+}
+
+static void item_table_add(GHashTable *table, const gchar *key, AppIndexItem *item) {
+    GPtrArray *bucket = g_hash_table_lookup(table, key);
+    if (!bucket) {
+        bucket = g_ptr_array_new();
+        g_hash_table_insert(table, g_strdup(key), bucket);
+    }
+    g_ptr_array_add(bucket, item);
+}
+
+static void item_table_remove(GHashTable *table, const gchar *key, AppIndexItem *item) {
+    GPtrArray *bucket = g_hash_table_lookup(table, key);
+    if (bucket && g_ptr_array_remove_fast(bucket, item) && bucket->len == 0) {
+        g_hash_table_remove(table, key);
+    }
+}
+
+// Drops the entry at path; returns FALSE when there was none
+static gboolean watch_remove_item(AppWatch *watch, const gchar *path) {
+    AppIndexItem *item = g_hash_table_lookup(watch->items, path);
+    if (!item) {
+        return FALSE;
+    }
+    if (item->application && item->name && *item->name) {
+        gchar *name_key = g_utf8_casefold(item->name, -1);
+        item_table_remove(watch->by_name, name_key, item);
+        g_free(name_key);
+    }
+    if (item->application && item->exec && *item->exec) {
+        item_table_remove(watch->by_exec, item->exec, item);
+    }
+    g_hash_table_remove(watch->items, item->path);
+    return TRUE;
+}
+
+// Takes item, replacing any entry at its path. Applications are entered in
+// the name and exec tables the same way the index file keys them.
+static void watch_put_item(AppWatch *watch, AppIndexItem *item) {
+    watch_remove_item(watch, item->path);
+    g_hash_table_insert(watch->items, item->path, item);
+    if (item->application && item->name && *item->name) {
+        gchar *name_key = g_utf8_casefold(item->name, -1);
+        item_table_add(watch->by_name, name_key, item);
+        g_free(name_key);
+    }
+    if (item->application && item->exec && *item->exec) {
+        item_table_add(watch->by_exec, item->exec, item);
+    }
+}
+
+static void watch_add_subdir(AppWatch *watch, const gchar *path);
+
+// Marks every entry currently in dir and every .desktop file on disk there
+// dirty, so the next apply brings dir in sync. Subdirectories are watched
+// and synced as well when dir is recursive.
+static void watch_sync_dir(AppWatch *watch, AppIndexDirStamp *dir) {
+    GHashTableIter iter;
+    gpointer key;
+    g_hash_table_iter_init(&iter, watch->items);
+    while (g_hash_table_iter_next(&iter, &key, NULL)) {
+        gchar *parent = g_path_get_dirname(key);
+        if (strcmp(parent, dir->path) == 0) {
+            g_hash_table_add(watch->dirty, g_strdup(key));
+        }
+        g_free(parent);
+    }
+    
+    DIR *handle = opendir(dir->path);
+    if (!handle) {
+        return;
+    }
+    
+    struct dirent *ent;
+    while ((ent = readdir(handle)) != NULL) {
+        if (ent->d_name[0] == '.') {
+            continue;
+        }
+        gchar *child = g_build_filename(dir->path, ent->d_name, NULL);
+        struct stat st;
+        if (g_str_has_suffix(ent->d_name, ".desktop")) {
+            g_hash_table_add(watch->dirty, child);
+            continue;
+        }
+        if (dir->recursive && lstat(child, &st) == 0 && S_ISDIR(st.st_mode) &&
+            !g_hash_table_contains(watch->dir_wds, child)) {
+            watch_add_subdir(watch, child);
+        }
+        g_free(child);
+    }
+    closedir(handle);
+}
+
+// Starts tracking a known directory. Watching before comparing the mtime
+// closes the window between the scan and the watch: a directory that changed
+// meanwhile is synced again.
+static void watch_track_dir(AppWatch *watch, AppIndexDirStamp *dir) {
+    gint64 scanned_sec = dir->mtime_sec;
+    gint64 scanned_nsec = dir->mtime_nsec;
+    
+    int wd = inotify_add_watch(watch->fd, dir->path, APP_WATCH_MASK);
+    if (wd < 0) {
+        // Missing root: watch its nearest existing ancestor for the
+        // directories leading to it to appear
+        if (is_root(watch, dir->path)) {
+            gchar *parent = g_path_get_dirname(dir->path);
+            for (;;) {
+                int parent_wd = inotify_add_watch(watch->fd, parent, APP_WATCH_PARENT_MASK);
+                if (parent_wd >= 0) {
+                    watch_add_wd(watch, parent_wd, parent);
+                    break;
+                }
+                gchar *up = g_path_get_dirname(parent);
+                gboolean top = strcmp(up, parent) == 0;
+                g_free(parent);
+                parent = up;
+                if (top) {
+                    break;
+                }
+            }
+            g_free(parent);
+        }
+        dir->mtime_sec = -1;
+        dir->mtime_nsec = 0;
+        if (scanned_sec != -1) {
+            watch_sync_dir(watch, dir);
+        }
+        return;
+    }
+    
+    g_hash_table_insert(watch->dir_wds, g_strdup(dir->path), GINT_TO_POINTER(wd));
+    watch_add_wd(watch, wd, dir->path);
+    app_index_dir_stamp_update(dir);
+    if (dir->mtime_sec != scanned_sec || dir->mtime_nsec != scanned_nsec) {
+        watch_sync_dir(watch, dir);
+    }
+}
+
+// Starts tracking a directory that appeared below a recursive one
+static void watch_add_subdir(AppWatch *watch, const gchar *path) {
+    AppIndexDirStamp *subdir = g_new0(AppIndexDirStamp, 1);
+    subdir->path = g_strdup(path);
+    subdir->recursive = TRUE;
+    subdir->mtime_sec = -1;
+    g_hash_table_replace(watch->dirs, subdir->path, subdir);
+    watch_track_dir(watch, subdir);
+}
+
+// Stops tracking dir and everything below it; roots stay known as missing
+static void watch_drop_dir(AppWatch *watch, const gchar *path) {
+    GPtrArray *dropped = g_ptr_array_new_with_free_func(g_free);
+    GHashTableIter iter;
+    gpointer key, value;
+    
+    g_hash_table_iter_init(&iter, watch->dir_wds);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        if (strcmp(key, path) == 0 || path_is_below(key, path)) {
+            inotify_rm_watch(watch->fd, GPOINTER_TO_INT(value));
+            g_hash_table_remove(watch->wd_paths, value);
+            g_ptr_array_add(dropped, g_strdup(key));
+            g_hash_table_iter_remove(&iter);
+        }
+    }
+    
+    for (guint i = 0; i < dropped->len; i++) {
+        const gchar *dir_path = g_ptr_array_index(dropped, i);
+        if (!is_root(watch, dir_path)) {
+            g_hash_table_remove(watch->dirs, dir_path);
+        }
+    }
+    g_ptr_array_free(dropped, TRUE);
+    
+    // The entries below go on the next apply, which counts them as changes
+    g_hash_table_iter_init(&iter, watch->items);
+    while (g_hash_table_iter_next(&iter, &key, NULL)) {
+        if (path_is_below(key, path)) {
+            g_hash_table_add(watch->dirty, g_strdup(key));
+        }
+    }
+    
+    AppIndexDirStamp *root = g_hash_table_lookup(watch->dirs, path);
+    if (root) {
+        watch_track_dir(watch, root);
+    }
+}
+
+static void watch_clear(AppWatch *watch) {
+    GHashTableIter iter;
+    gpointer wd;
+    g_hash_table_iter_init(&iter, watch->wd_paths);
+    while (g_hash_table_iter_next(&iter, &wd, NULL)) {
+        inotify_rm_watch(watch->fd, GPOINTER_TO_INT(wd));
+    }
+    g_hash_table_remove_all(watch->wd_paths);
+    g_hash_table_remove_all(watch->dir_wds);
+    g_hash_table_remove_all(watch->dirs);
+    g_hash_table_remove_all(watch->by_name);
+    g_hash_table_remove_all(watch->by_exec);
+    g_hash_table_remove_all(watch->items);
+    g_hash_table_remove_all(watch->dirty);
+}
+
+// (Re)loads all state, from the index file when it is current
+static void watch_reset(AppWatch *watch, gboolean use_index_file) {
+    watch_clear(watch);
+    
+    GPtrArray *items = g_ptr_array_new();
+    GPtrArray *scanned = g_ptr_array_new();
+    AppIndex *index = use_index_file && watch->index_path ?
+                      app_index_load(watch->index_path, (const gchar * const *)watch->roots) : NULL;
+    if (index) {
+        app_index_export(index, items, scanned);
+        app_index_free(index);
+    } else {
+        app_index_scan((const gchar * const *)watch->roots, items, scanned);
+        watch->file_stale = TRUE;
+    }
+    
+    for (guint i = 0; i < items->len; i++) {
+        watch_put_item(watch, g_ptr_array_index(items, i));
+    }
+    for (guint i = 0; i < scanned->len; i++) {
+        AppIndexDirStamp *dir = g_ptr_array_index(scanned, i);
+        g_hash_table_replace(watch->dirs, dir->path, dir);
+    }
+    g_ptr_array_free(items, TRUE);
+    
+    for (guint i = 0; i < scanned->len; i++) {
+        watch_track_dir(watch, g_ptr_array_index(scanned, i));
+    }
+    g_ptr_array_free(scanned, TRUE);
+    watch->index_stale = TRUE;
+}
+
+AppWatch* app_watch_new(const gchar *index_path, const gchar * const *dirs, gchar **error_msg) {
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        *error_msg = g_strdup_printf("Failed to start watching applications: %s", g_strerror(errno));
+        return NULL;
+    }
+    
+    AppWatch *watch = g_new0(AppWatch, 1);
+    watch->fd = fd;
+    watch->index_path = g_strdup(index_path);
+    watch->roots = g_strdupv((gchar**)dirs);
+    watch->items = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, (GDestroyNotify)app_index_item_free);
+    watch->by_name = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_ptr_array_unref);
+    watch->by_exec = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_ptr_array_unref);
+    watch->dirs = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, (GDestroyNotify)app_index_dir_stamp_free);
+    watch->dir_wds = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    watch->wd_paths = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+    watch->dirty = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    watch->ref_count = 1;
+    
+    watch_reset(watch, TRUE);
+    app_watch_process(watch);
+    return watch;
+}
+
+AppWatch* app_watch_new_default(gchar **error_msg) {
+    gchar **dirs = app_index_get_default_dirs();
+    gchar *index_path = app_index_get_default_path();
+    AppWatch *watch = app_watch_new(index_path, (const gchar * const *)dirs, error_msg);
+    g_free(index_path);
+    g_strfreev(dirs);
+    return watch;
+}
+
+typedef struct {
+    gchar *index_path;
+    gchar **dirs;
+} WatchNewTask;
+
+static void watch_new_task_free(WatchNewTask *data) {
+    g_free(data->index_path);
+    g_strfreev(data->dirs);
+    g_free(data);
+}
+
+static void watch_new_thread(GTask *task, gpointer source_object, gpointer task_data,
+                             GCancellable *cancellable) {
+    (void)source_object;  // Suppress unused parameter warning
+    (void)cancellable;
+    WatchNewTask *data = task_data;
+    gchar *error_msg = NULL;
+    
+    AppWatch *watch = app_watch_new(data->index_path, (const gchar * const *)data->dirs, &error_msg);
+    if (watch) {
+        g_task_return_pointer(task, watch, (GDestroyNotify)app_watch_free);
+    } else {
+        g_task_return_new_error(task, G_IO_ERROR, G_IO_ERROR_FAILED, "%s", error_msg);
+        g_free(error_msg);
+    }
+}
+
+void app_watch_new_async(const gchar *index_path, const gchar * const *dirs, GCancellable *cancellable,
+                         GAsyncReadyCallback callback, gpointer user_data) {
+    WatchNewTask *data = g_new0(WatchNewTask, 1);
+    data->index_path = g_strdup(index_path);
+    data->dirs = g_strdupv((gchar**)dirs);
+    
+    GTask *task = g_task_new(NULL, cancellable, callback, user_data);
+    g_task_set_task_data(task, data, (GDestroyNotify)watch_new_task_free);
+    g_task_run_in_thread(task, watch_new_thread);
+    g_object_unref(task);
+}
+
+void app_watch_new_default_async(GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data) {
+    gchar **dirs = app_index_get_default_dirs();
+    gchar *index_path = app_index_get_default_path();
+    app_watch_new_async(index_path, (const gchar * const *)dirs, cancellable, callback, user_data);
+    g_free(index_path);
+    g_strfreev(dirs);
+}
+
+AppWatch* app_watch_new_finish(GAsyncResult *result, GError **error) {
+    return g_task_propagate_pointer(G_TASK(result), error);
+}
+
+AppWatch* app_watch_ref(AppWatch *watch) {
+    g_atomic_int_inc(&watch->ref_count);
+    return watch;
+}
+
+void app_watch_unref(AppWatch *watch) {
+    if (watch && g_atomic_int_dec_and_test(&watch->ref_count)) {
+        close(watch->fd);
+        g_hash_table_destroy(watch->dirty);
+        g_hash_table_destroy(watch->wd_paths);
+        g_hash_table_destroy(watch->dir_wds);
+        g_hash_table_destroy(watch->by_name);
+        g_hash_table_destroy(watch->by_exec);
+        g_hash_table_destroy(watch->items);
+        g_hash_table_destroy(watch->dirs);
+        app_index_free(watch->index);
+        g_strfreev(watch->roots);
+        g_free(watch->index_path);
+        g_free(watch);
+    }
+}
+
+void app_watch_free(AppWatch *watch) {
+    if (watch) {
+        G_LOCK(default_watch);
+        gboolean was_default = g_atomic_pointer_get(&default_watch) == watch;
+        if (was_default) {
+            g_atomic_pointer_set(&default_watch, NULL);
+        }
+        G_UNLOCK(default_watch);
+        if (was_default) {
+            app_watch_unref(watch);
+        }
+        
+        if (watch->source_id) {
+            g_source_remove(watch->source_id);
+            watch->source_id = 0;
+        }
+        if (watch->flush_id) {
+            g_source_remove(watch->flush_id);
+            watch->flush_id = 0;
+        }
+        app_watch_unref(watch);
+    }
+}
+
+gint app_watch_get_fd(const AppWatch *watch) {
+    return watch->fd;
+}
+
+// Retries the missing roots at or below a directory that just appeared
+static void watch_track_missing_roots(AppWatch *watch, const gchar *path) {
+    for (guint i = 0; watch->roots[i] != NULL; i++) {
+        const gchar *root = watch->roots[i];
+        if (g_hash_table_contains(watch->dir_wds, root) || !path_is_below(root, path)) {
+            continue;
+        }
+        AppIndexDirStamp *dir = g_hash_table_lookup(watch->dirs, root);
+        if (dir) {
+            watch_track_dir(watch, dir);
+        }
+    }
+}
+
+static void watch_handle_event(AppWatch *watch, const struct inotify_event *event) {
+    watch->stats.events++;
+    
+    if (event->mask & IN_Q_OVERFLOW) {
+        watch->rescan = TRUE;
+        return;
+    }
+    if (event->mask & IN_IGNORED) {
+        // The kernel dropped the watch (directory gone or unmounted)
+        const gchar *watched = g_hash_table_lookup(watch->wd_paths, GINT_TO_POINTER(event->wd));
+        gpointer wd;
+        if (watched && g_hash_table_lookup_extended(watch->dir_wds, watched, NULL, &wd) &&
+            GPOINTER_TO_INT(wd) == event->wd) {
+            gchar *path = g_strdup(watched);
+            watch_drop_dir(watch, path);
+            g_free(path);
+        }
+        g_hash_table_remove(watch->wd_paths, GINT_TO_POINTER(event->wd));
+        return;
+    }
+    
+    const gchar *watched = g_hash_table_lookup(watch->wd_paths, GINT_TO_POINTER(event->wd));
+    if (!watched) {
+        return;
+    }
+    gchar *watched_path = g_strdup(watched);
+    
+    if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+        if (g_hash_table_contains(watch->dir_wds, watched_path)) {
+            watch_drop_dir(watch, watched_path);
+        }
+        g_free(watched_path);
+        return;
+    }
+    if (event->len == 0) {
+        g_free(watched_path);
+        return;
+    }
+    
+    gchar *path = g_build_filename(watched_path, event->name, NULL);
+    gboolean tracked = g_hash_table_contains(watch->dir_wds, watched_path);
+    
+    if (event->mask & IN_ISDIR) {
+        AppIndexDirStamp *known = g_hash_table_lookup(watch->dirs, path);
+        AppIndexDirStamp *parent = g_hash_table_lookup(watch->dirs, watched_path);
+        if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+            if (!known && !tracked) {
+                // A directory on the way to a missing root appeared
+                watch_track_missing_roots(watch, path);
+            } else if (known && !g_hash_table_contains(watch->dir_wds, path)) {
+                // A missing root appeared; tracking it syncs its contents
+                watch_track_dir(watch, known);
+            } else if (!known && tracked && parent && parent->recursive) {
+                watch_add_subdir(watch, path);
+            }
+        } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+            if (g_hash_table_contains(watch->dir_wds, path)) {
+                watch_drop_dir(watch, path);
+            }
+        }
+    } else if (tracked && g_str_has_suffix(event->name, ".desktop")) {
+        g_hash_table_add(watch->dirty, path);
+        path = NULL;
+    }
+    
+    g_free(path);
+    g_free(watched_path);
+}
+
+// Reads every pending event; returns FALSE when there were none
+static gboolean watch_read_events(AppWatch *watch) {
+    gboolean any = FALSE;
+    gchar buffer[16384] __attribute__((aligned(__alignof__(struct inotify_event))));
+    
+    for (;;) {
+        ssize_t length = read(watch->fd, buffer, sizeof(buffer));
+        if (length < 0 && errno == EINTR) {
+            continue;
+        }
+        if (length <= 0) {
+            break;
+        }
+        any = TRUE;
+        for (gchar *p = buffer; p < buffer + length; ) {
+            const struct inotify_event *event = (const struct inotify_event*)p;
+            watch_handle_event(watch, event);
+            p += sizeof(struct inotify_event) + event->len;
+        }
+    }
+    return any;
+}
+
+// Parses every dirty path once, however many events touched it
+static guint watch_apply(AppWatch *watch) {
+    guint changed = g_hash_table_size(watch->dirty);
+    if (changed == 0) {
+        return 0;
+    }
+    
+    GHashTableIter iter;
+    gpointer key;
+    g_hash_table_iter_init(&iter, watch->dirty);
+    while (g_hash_table_iter_next(&iter, &key, NULL)) {
+        // Only files in tracked directories belong in the index
+        gchar *dir_path = g_path_get_dirname(key);
+        gboolean tracked = g_hash_table_contains(watch->dir_wds, dir_path);
+        g_free(dir_path);
+        
+        AppIndexItem *item = tracked ? app_index_item_load(key) : NULL;
+        if (item) {
+            watch_put_item(watch, item);
+            watch->stats.updated++;
+        } else if (watch_remove_item(watch, key)) {
+            watch->stats.removed++;
+        }
+    }
+    g_hash_table_remove_all(watch->dirty);
+    
+    watch->stats.batches++;
+    watch->index_stale = TRUE;
+    watch->file_stale = TRUE;
+    return changed;
+}
+
+guint app_watch_process(AppWatch *watch) {
+    guint changed = 0;
+    watch_read_events(watch);
+    
+    // Events were lost: nothing short of a full rescan is reliable
+    while (watch->rescan) {
+        watch->rescan = FALSE;
+        watch->stats.rescans++;
+        watch_reset(watch, FALSE);
+        changed += g_hash_table_size(watch->items);
+        watch_read_events(watch);
+    }
+    
+    return changed + watch_apply(watch);
+}
+
+static gint compare_items(gconstpointer a, gconstpointer b) {
+    const AppIndexItem *item_a = *(AppIndexItem * const *)a;
+    const AppIndexItem *item_b = *(AppIndexItem * const *)b;
+    return strcmp(item_a->path, item_b->path);
+}
+
+// Builds the index from the current state; the file is written when path is set
+static AppIndex* watch_snapshot(AppWatch *watch, const gchar *path, gchar **error_msg) {
+    GPtrArray *items = g_ptr_array_sized_new(g_hash_table_size(watch->items));
+    GPtrArray *scanned = g_ptr_array_sized_new(g_hash_table_size(watch->dirs));
+    GHashTableIter iter;
+    gpointer value;
+    
+    g_hash_table_iter_init(&iter, watch->items);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        g_ptr_array_add(items, value);
+    }
+    g_ptr_array_sort(items, compare_items);
+    
+    g_hash_table_iter_init(&iter, watch->dirs);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        g_ptr_array_add(scanned, value);
+    }
+    
+    AppIndex *index = app_index_write(path, (const gchar * const *)watch->roots, items, scanned, error_msg);
+    g_ptr_array_free(items, TRUE);
+    g_ptr_array_free(scanned, TRUE);
+    return index;
+}
+
+AppIndex* app_watch_get_index(AppWatch *watch) {
+    if (watch->index_stale || !watch->index) {
+        app_index_free(watch->index);
+        watch->index = watch_snapshot(watch, NULL, NULL);
+        watch->index_stale = FALSE;
+    }
+    return watch->index;
+}
+
+gboolean app_watch_flush(AppWatch *watch, gchar **error_msg) {
+    if (!watch->index_path) {
+        return TRUE;
+    }
+    
+    // The file is trusted by other processes as long as the directory mtimes
+    // match, so they are taken only once no more events are pending
+    for (guint round = 0; round < APP_WATCH_FLUSH_ROUNDS; round++) {
+        app_watch_process(watch);
+        GHashTableIter iter;
+        gpointer value;
+        g_hash_table_iter_init(&iter, watch->dirs);
+        while (g_hash_table_iter_next(&iter, NULL, &value)) {
+            AppIndexDirStamp *dir = value;
+            gint64 sec = dir->mtime_sec;
+            gint64 nsec = dir->mtime_nsec;
+            app_index_dir_stamp_update(dir);
+            if (dir->mtime_sec != sec || dir->mtime_nsec != nsec) {
+                watch->file_stale = TRUE;
+            }
+        }
+        if (!watch_read_events(watch)) {
+            break;
+        }
+        watch_apply(watch);
+    }
+    
+    if (!watch->file_stale) {
+        return TRUE;
+    }
+    
+    AppIndex *index = watch_snapshot(watch, watch->index_path, error_msg);
+    if (!index) {
+        return FALSE;
+    }
+    app_index_free(watch->index);
+    watch->index = index;
+    watch->index_stale = FALSE;
+    watch->file_stale = FALSE;
+    watch->stats.writes++;
+    return TRUE;
+}
+
+gboolean app_watch_lookup_path(AppWatch *watch, const gchar *path, gboolean *exists) {
+    if (!path || !g_str_has_suffix(path, ".desktop")) {
+        return FALSE;
+    }
+    
+    gchar *dir_path = g_path_get_dirname(path);
+    gboolean tracked = g_hash_table_contains(watch->dir_wds, dir_path);
+    g_free(dir_path);
+    if (!tracked) {
+        return FALSE;
+    }
+    
+    *exists = g_hash_table_contains(watch->items, path);
+    return TRUE;
+}
+
+// Appends the paths of bucket not already in paths, in path order
+static void add_bucket_paths(GPtrArray *paths, GPtrArray *bucket) {
+    if (!bucket) {
+        return;
+    }
+    g_ptr_array_sort(bucket, compare_items);
+    for (guint i = 0; i < bucket->len; i++) {
+        const AppIndexItem *item = g_ptr_array_index(bucket, i);
+        if (!g_ptr_array_find_with_equal_func(paths, item->path, g_str_equal, NULL)) {
+            g_ptr_array_add(paths, g_strdup(item->path));
+        }
+    }
+}
+
+gchar** app_watch_find_duplicates(AppWatch *watch, const gchar *name, const gchar *exec_path) {
+    GPtrArray *paths = g_ptr_array_new();
+    if (name && *name) {
+        gchar *name_key = g_utf8_casefold(name, -1);
+        add_bucket_paths(paths, g_hash_table_lookup(watch->by_name, name_key));
+        g_free(name_key);
+    }
+    if (exec_path && *exec_path) {
+        add_bucket_paths(paths, g_hash_table_lookup(watch->by_exec, exec_path));
+    }
+    g_ptr_array_add(paths, NULL);
+    return (gchar**)g_ptr_array_free(paths, FALSE);
+}
+
+static gboolean watch_flush_timeout(gpointer user_data) {
+    AppWatch *watch = user_data;
+    watch->flush_id = 0;
+    
+    gchar *error_msg = NULL;
+    if (!app_watch_flush(watch, &error_msg)) {
+        watch->stats.write_errors++;
+        if (watch->error_func) {
+            watch->error_func(error_msg, watch->error_data);
+        }
+        g_free(error_msg);
+    }
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean watch_fd_ready(gint fd, GIOCondition condition, gpointer user_data) {
+    (void)fd;         // Suppress unused parameter warning
+    (void)condition;
+    AppWatch *watch = user_data;
+    
+    if (app_watch_process(watch) > 0) {
+        // Debounce: write once things have been quiet for a while
+        if (watch->flush_id) {
+            g_source_remove(watch->flush_id);
+        }
+        watch->flush_id = g_timeout_add(watch->flush_delay_ms, watch_flush_timeout, watch);
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+void app_watch_attach(AppWatch *watch, guint flush_delay_ms) {
+    watch->flush_delay_ms = flush_delay_ms;
+    if (!watch->source_id) {
+        watch->source_id = g_unix_fd_add(watch->fd, G_IO_IN, watch_fd_ready, watch);
+    }
+    if (watch->file_stale && !watch->flush_id) {
+        watch->flush_id = g_timeout_add(flush_delay_ms, watch_flush_timeout, watch);
+    }
+}
+
+void app_watch_set_error_func(AppWatch *watch, AppWatchErrorFunc func, gpointer user_data) {
+    watch->error_func = func;
+    watch->error_data = user_data;
+}
+
+void app_watch_get_stats(const AppWatch *watch, AppWatchStats *stats) {
+    *stats = watch->stats;
+}
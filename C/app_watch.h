@@ -0,0 +1,97 @@
+#ifndef APP_WATCH_H
+#define APP_WATCH_H
+
+#include <glib.h>
+#include <gio/gio.h>
+#include "app_index.h"
+
+// Keeps the applications index current with inotify.
+// Create, modify, delete and move events are coalesced per path and applied
+// incrementally; only the changed .desktop files are parsed again. A queue
+// overflow falls back to a full rescan. Not thread-safe: use it from one
+// thread (normally the main loop's). Only references and the default watch
+// may be taken from other threads.
+
+typedef struct _AppWatch AppWatch;
+
+typedef struct {
+    guint64 events;       // inotify events read
+    guint64 batches;      // Batches of events applied
+    guint64 updated;      // Files parsed again
+    guint64 removed;      // Entries dropped
+    guint64 rescans;      // Full rescans after a queue overflow
+    guint64 writes;       // Index files written
+    guint64 write_errors; // Index files that could not be written after changes
+} AppWatchStats;
+
+// Told why the index file could not be written after changes
+typedef void (*AppWatchErrorFunc)(const gchar *error_msg, gpointer user_data);
+
+// Starts watching dirs, seeding from the index at index_path when it is
+// still current. index_path may be NULL to keep the index in memory only.
+AppWatch* app_watch_new(const gchar *index_path, const gchar * const *dirs, gchar **error_msg);
+
+// Watches the default directories and maintains the default index file
+AppWatch* app_watch_new_default(gchar **error_msg);
+
+// app_watch_new() on a worker thread, so loading or rescanning the index
+// and adding the inotify watches don't block the caller's main loop. The
+// watch is used by nobody else until it is handed to the callback; attach
+// it from there.
+void app_watch_new_async(const gchar *index_path, const gchar * const *dirs, GCancellable *cancellable,
+                         GAsyncReadyCallback callback, gpointer user_data);
+void app_watch_new_default_async(GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data);
+AppWatch* app_watch_new_finish(GAsyncResult *result, GError **error);
+
+// Stops the watch: it is no longer the default and its main loop sources
+// are removed. Frees it once nobody else holds a reference.
+void app_watch_free(AppWatch *watch);
+
+// app_watch_new() returns the first reference; app_watch_free() drops it
+AppWatch* app_watch_ref(AppWatch *watch);
+void app_watch_unref(AppWatch *watch);
+
+// inotify descriptor, readable when events are pending
+gint app_watch_get_fd(const AppWatch *watch);
+
+// Reads and applies all pending events without blocking.
+// Returns the number of paths that changed.
+guint app_watch_process(AppWatch *watch);
+
+// Current index, owned by the watch and valid until the next call that
+// processes events
+AppIndex* app_watch_get_index(AppWatch *watch);
+
+// Paths of the applications named name (compared case-insensitively) or
+// running exec_path, straight from the watched state without building an
+// index. Either may be NULL. Returns a NULL-terminated array to free with
+// g_strfreev().
+gchar** app_watch_find_duplicates(AppWatch *watch, const gchar *name, const gchar *exec_path);
+
+// Writes the index file if it changed since the last write
+gboolean app_watch_flush(AppWatch *watch, gchar **error_msg);
+
+// Answers whether a .desktop file exists at path from the watched state.
+// Returns FALSE when path is not in a watched directory.
+gboolean app_watch_lookup_path(AppWatch *watch, const gchar *path, gboolean *exists);
+
+// Processes events from the default main context and writes the index file
+// flush_delay_ms after the last change
+void app_watch_attach(AppWatch *watch, guint flush_delay_ms);
+
+// Called when one of those writes fails; without it failures are only
+// counted in the stats
+void app_watch_set_error_func(AppWatch *watch, AppWatchErrorFunc func, gpointer user_data);
+
+void app_watch_get_stats(const AppWatch *watch, AppWatchStats *stats);
+
+// Process-wide watch used by file_utils_save_desktop_file(); NULL by default.
+// The default holds a reference of its own; clear it with NULL before
+// stopping the main loop the watch runs in. Any thread may take it with
+// app_watch_dup_default(), which returns a reference (or NULL) to drop
+// with app_watch_unref(); the watch itself is still only used from its
+// own thread.
+void app_watch_set_default(AppWatch *watch);
+AppWatch* app_watch_dup_default(void);
+
+#endif // APP_WATCH_H
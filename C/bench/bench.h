@@ -0,0 +1,81 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+// Small helpers shared by the microbenchmarks in this directory
+
+#include <glib.h>
+#include <time.h>
+
+static inline gint64 bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (gint64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Keeps the compiler from optimizing away a benchmarked result
+static inline void bench_consume(const void *p) {
+    __asm__ __volatile__("" : : "r"(p) : "memory");
+}
+
+// Defining BENCH_COUNT_ALLOCS before including this header replaces malloc
+// and friends with counting wrappers around glibc's allocator. GLib allocates
+// through malloc, so g_new, g_strdup and GString growth are all counted.
+// Only one translation unit per program may do this.
+#ifdef BENCH_COUNT_ALLOCS
+#include <stddef.h>
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+extern void __libc_free(void *ptr);
+
+static guint64 bench_alloc_count;
+static guint64 bench_alloc_bytes;
+
+static inline void bench_count_alloc(size_t size) {
+    __atomic_fetch_add(&bench_alloc_count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&bench_alloc_bytes, size, __ATOMIC_RELAXED);
+}
+
+void *malloc(size_t size) {
+    bench_count_alloc(size);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size) {
+    bench_count_alloc(n * size);
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    bench_count_alloc(size);
+    return __libc_realloc(ptr, size);
+}
+
+int posix_memalign(void **ptr, size_t alignment, size_t size) {
+    bench_count_alloc(size);
+    *ptr = __libc_memalign(alignment, size);
+    return *ptr ? 0 : 12;  // ENOMEM
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+    bench_count_alloc(size);
+    return __libc_memalign(alignment, size);
+}
+
+void free(void *ptr) {
+    __libc_free(ptr);
+}
+
+// Allocations (and bytes requested) since the program started
+static inline guint64 bench_allocs(void) {
+    return __atomic_load_n(&bench_alloc_count, __ATOMIC_RELAXED);
+}
+
+static inline guint64 bench_allocated_bytes(void) {
+    return __atomic_load_n(&bench_alloc_bytes, __ATOMIC_RELAXED);
+}
+#endif
+
+#endif // BENCH_H
@@ -0,0 +1,133 @@
+#define _GNU_SOURCE
+#include "bench.h"
+#include "../file_classify.h"
+#include "../type_cache.h"
+#include <glib/gstdio.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Per-file cost of file_classify_path() on a warm and a cold page cache,
+// and of a type_cache_classify() hit.
+// Usage: bench_classify [warm-iterations] [cold-iterations]
+
+typedef struct {
+    const gchar *name;
+    const gchar *content;
+    gsize length;
+} BenchFile;
+
+#define TEXT(s) s, sizeof(s) - 1
+
+static gchar elf_header[64];
+static gchar appimage_header[64];
+static const gchar jar_header[] = "PK\003\004\024\000\010\010\010\000\000\000\000\000\000\000"
+                                  "\000\000\000\000\000\000\000\000\000\000\011\000\004\000META-INF/";
+
+static void make_elf_headers(void) {
+    // A minimal x86-64 ELF header; the AppImage variant carries "AI\2" in EI_PAD
+    memset(elf_header, 0, sizeof(elf_header));
+    memcpy(elf_header, "\177ELF\002\001\001", 7);
+    elf_header[16] = 2;   // ET_EXEC
+    elf_header[18] = 62;  // EM_X86_64
+    memcpy(appimage_header, elf_header, sizeof(elf_header));
+    memcpy(appimage_header + 8, "AI\002", 3);
+}
+
+static void write_file(const gchar *dir, const BenchFile *file) {
+    gchar *path = g_build_filename(dir, file->name, NULL);
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0755);
+    if (fd < 0 || write(fd, file->content, file->length) != (ssize_t)file->length) {
+        fprintf(stderr, "bench_classify: cannot write %s\n", path);
+        exit(1);
+    }
+    fsync(fd);
+    close(fd);
+    g_free(path);
+}
+
+static void drop_page_cache(const gchar *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd >= 0) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int warm_iterations = argc > 1 ? atoi(argv[1]) : 20000;
+    int cold_iterations = argc > 2 ? atoi(argv[2]) : 200;
+    
+    make_elf_headers();
+    const BenchFile files[] = {
+        { "elf", elf_header, sizeof(elf_header) },
+        { "appimage", appimage_header, sizeof(appimage_header) },
+        { "jar", TEXT(jar_header) },
+        { "python", TEXT("#!/usr/bin/env python3\nprint('hi')\n") },
+        { "shell", TEXT("#!/bin/bash\necho hi\n") },
+        { "perl-env-S", TEXT("#!/usr/bin/env -S perl -w\nprint 1;\n") },
+        { "ruby-crlf", TEXT("#!/usr/bin/ruby\r\nputs 1\r\n") },
+        { "node", TEXT("#!/usr/bin/env node\nconsole.log(1)\n") },
+        { "script.py", TEXT("print('hi')\n") },
+        { "text", TEXT("plain text, not a script\n") },
+    };
+    
+    gchar *dir = g_dir_make_tmp("cre8or-bench-XXXXXX", NULL);
+    if (!dir) {
+        fprintf(stderr, "bench_classify: cannot create temporary directory\n");
+        return 1;
+    }
+    
+    gchar *cache_path = g_build_filename(dir, "filetypes.cache", NULL);
+    type_cache_open(cache_path);
+    
+    printf("# file_classify_path: ns/op, warm x%d, cold x%d\n", warm_iterations, cold_iterations);
+    printf("%-12s %-10s %10s %10s %10s\n", "file", "type", "warm", "cold", "cached");
+    
+    for (gsize i = 0; i < G_N_ELEMENTS(files); i++) {
+        write_file(dir, &files[i]);
+        gchar *path = g_build_filename(dir, files[i].name, NULL);
+        FileClassification result;
+        
+        gint64 start = bench_now_ns();
+        for (int n = 0; n < warm_iterations; n++) {
+            file_classify_path(path, &result);
+            bench_consume(&result);
+        }
+        gint64 warm_ns = (bench_now_ns() - start) / MAX(warm_iterations, 1);
+        
+        gint64 cold_total = 0;
+        for (int n = 0; n < cold_iterations; n++) {
+            drop_page_cache(path);
+            start = bench_now_ns();
+            file_classify_path(path, &result);
+            cold_total += bench_now_ns() - start;
+            bench_consume(&result);
+        }
+        gint64 cold_ns = cold_total / MAX(cold_iterations, 1);
+        
+        type_cache_classify(path, &result);
+        start = bench_now_ns();
+        for (int n = 0; n < warm_iterations; n++) {
+            type_cache_classify(path, &result);
+            bench_consume(&result);
+        }
+        gint64 cached_ns = (bench_now_ns() - start) / MAX(warm_iterations, 1);
+        
+        printf("%-12s %-10s %10" G_GINT64_FORMAT " %10" G_GINT64_FORMAT " %10" G_GINT64_FORMAT "\n",
+               files[i].name, file_classify_type_name(result.type), warm_ns, cold_ns, cached_ns);
+        
+        g_unlink(path);
+        g_free(path);
+    }
+    
+    type_cache_close();
+    g_unlink(cache_path);
+    g_free(cache_path);
+    g_rmdir(dir);
+    g_free(dir);
+    return 0;
+}
@@ -0,0 +1,522 @@
+#define _GNU_SOURCE
+#define BENCH_COUNT_ALLOCS
+#include "bench.h"
+#include "../desktop_entry.h"
+#include "../file_utils.h"
+#include "../type_cache.h"
+#include <glib/gstdio.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// Microbenchmark suite for the entry generator (heap, arena and buffer),
+// category parsing, filtering and formatting, file type detection, filename
+// sanitizing and the save path. Every case reports ns/op (mean and
+// p50/p90/p99 over timed batches) and allocations/op.
+// The save path runs in a sandbox on tmpfs (/dev/shm when available) with
+// HOME and the XDG directories pointed into it.
+// Usage: bench_core [--json FILE] [--filter SUBSTRING] [samples]
+
+typedef void (*BenchFunc)(gpointer data);
+
+typedef struct {
+    const gchar *name;
+    BenchFunc func;
+    gpointer data;
+} BenchCase;
+
+typedef struct {
+    const gchar *name;
+    guint64 ops;
+    gdouble ns_per_op;
+    gdouble p50;
+    gdouble p90;
+    gdouble p99;
+    gdouble max;
+    gdouble allocs_per_op;
+    gdouble bytes_per_op;
+} BenchResult;
+
+// Batches are sized so a timed sample is at least this long, which keeps
+// the clock's own cost out of the fast cases
+#define BENCH_MIN_SAMPLE_NS 20000
+
+static int compare_doubles(const void *a, const void *b) {
+    gdouble x = *(const gdouble*)a;
+    gdouble y = *(const gdouble*)b;
+    return (x > y) - (x < y);
+}
+
+static gdouble percentile(const gdouble *sorted, guint n, gdouble p) {
+    guint i = (guint)(p * (n - 1) + 0.5);
+    return sorted[MIN(i, n - 1)];
+}
+
+static void bench_run(const BenchCase *bench, guint n_samples, BenchResult *result) {
+    // Warm up and size the batches
+    guint batch = 1;
+    for (;;) {
+        gint64 start = bench_now_ns();
+        for (guint i = 0; i < batch; i++) {
+            bench->func(bench->data);
+        }
+        if (bench_now_ns() - start >= BENCH_MIN_SAMPLE_NS || batch >= (1u << 20)) {
+            break;
+        }
+        batch *= 2;
+    }
+    
+    gdouble *samples = g_new(gdouble, n_samples);
+    guint64 allocs = bench_allocs();
+    guint64 bytes = bench_allocated_bytes();
+    gint64 total_ns = 0;
+    
+    for (guint s = 0; s < n_samples; s++) {
+        gint64 start = bench_now_ns();
+        for (guint i = 0; i < batch; i++) {
+            bench->func(bench->data);
+        }
+        gint64 elapsed = bench_now_ns() - start;
+        total_ns += elapsed;
+        samples[s] = (gdouble)elapsed / batch;
+    }
+    
+    // The samples array is allocated before the counters are read, so only
+    // the benchmarked calls are counted
+    guint64 ops = (guint64)n_samples * batch;
+    result->name = bench->name;
+    result->ops = ops;
+    result->allocs_per_op = (gdouble)(bench_allocs() - allocs) / ops;
+    result->bytes_per_op = (gdouble)(bench_allocated_bytes() - bytes) / ops;
+    result->ns_per_op = (gdouble)total_ns / ops;
+    
+    qsort(samples, n_samples, sizeof(gdouble), compare_doubles);
+    result->p50 = percentile(samples, n_samples, 0.50);
+    result->p90 = percentile(samples, n_samples, 0.90);
+    result->p99 = percentile(samples, n_samples, 0.99);
+    result->max = samples[n_samples - 1];
+    g_free(samples);
+}
+
+static void print_result(const BenchResult *result) {
+    printf("%-36s %10.1f %10.1f %10.1f %10.1f %9.2f %10.1f\n",
+           result->name, result->ns_per_op, result->p50, result->p90, result->p99,
+           result->allocs_per_op, result->bytes_per_op);
+    fflush(stdout);
+}
+
+static gboolean write_json(const gchar *path, const BenchResult *results, guint n_results,
+                           guint n_samples) {
+    GString *json = g_string_new("{\n");
+    g_string_append_printf(json, "  \"suite\": \"core\",\n  \"samples\": %u,\n  \"threads\": %u,\n",
+                           n_samples, g_get_num_processors());
+    g_string_append(json, "  \"results\": [\n");
+    for (guint i = 0; i < n_results; i++) {
+        const BenchResult *r = &results[i];
+        // Case names are plain ASCII without quotes, so no escaping is needed
+        g_string_append_printf(json,
+                               "    {\"name\": \"%s\", \"ops\": %" G_GUINT64_FORMAT ", "
+                               "\"ns_per_op\": %.1f, \"p50_ns\": %.1f, \"p90_ns\": %.1f, "
+                               "\"p99_ns\": %.1f, \"max_ns\": %.1f, "
+                               "\"allocs_per_op\": %.2f, \"bytes_per_op\": %.1f}%s\n",
+                               r->name, r->ops, r->ns_per_op, r->p50, r->p90, r->p99, r->max,
+                               r->allocs_per_op, r->bytes_per_op, i + 1 < n_results ? "," : "");
+    }
+    g_string_append(json, "  ]\n}\n");
+    
+    GError *error = NULL;
+    gboolean ok = g_file_set_contents(path, json->str, json->len, &error);
+    if (!ok) {
+        fprintf(stderr, "bench_core: %s\n", error->message);
+        g_error_free(error);
+    }
+    g_string_free(json, TRUE);
+    return ok;
+}
+
+// Benchmarked operations
+
+static void run_generate(gpointer data) {
+    gchar *content = desktop_entry_generate_content(data);
+    bench_consume(content);
+    g_free(content);
+}
+
+typedef struct {
+    DesktopEntry *entry;
+    DesktopArena *arena;
+    guint in_batch;
+} ArenaCase;
+
+// Entries in a batch sharing one arena before it is reset
+#define ARENA_BATCH 64
+
+static void run_generate_arena(gpointer data) {
+    ArenaCase *bulk = data;
+    gchar *content = desktop_entry_generate_content_in(bulk->entry, bulk->arena, NULL);
+    bench_consume(content);
+    if (++bulk->in_batch == ARENA_BATCH) {
+        desktop_arena_reset(bulk->arena);
+        bulk->in_batch = 0;
+    }
+}
+
+static void run_generate_buffer(gpointer data) {
+    gchar buffer[1024];
+    gsize length = desktop_entry_write_content(data, buffer, sizeof(buffer));
+    bench_consume(buffer);
+    bench_consume(&length);
+}
+
+static void run_exec_escape(gpointer data) {
+    gchar buffer[1024];
+    gsize length = strlen(data);
+    gsize escaped = desktop_exec_escaped_length(data, length);
+    if (escaped != length) {
+        desktop_exec_escape(data, length, buffer);
+    }
+    bench_consume(buffer);
+    bench_consume(&escaped);
+}
+
+static void run_categories(gpointer data) {
+    gchar *categories = desktop_entry_get_categories_string(data);
+    bench_consume(categories);
+    g_free(categories);
+}
+
+static void run_parse_categories(gpointer data) {
+    DesktopCategories categories;
+    desktop_categories_clear(&categories);
+    guint unknown = desktop_categories_parse(&categories, data, -1);
+    bench_consume(&categories);
+    bench_consume(&unknown);
+}
+
+// Entries' category sets, filtered for games that need a terminal-free
+// graphical session (Game but not ConsoleOnly)
+#define FILTER_ENTRIES 10000
+
+typedef struct {
+    DesktopCategories *sets;
+    guint n_sets;
+} FilterCase;
+
+static void make_category_corpus(FilterCase *filter) {
+    static const gchar *lists[] = {
+        "Game;ActionGame;", "Utility;TextEditor;", "Development;IDE;GTK;",
+        "AudioVideo;Audio;Player;", "Game;LogicGame;ConsoleOnly;", "Network;WebBrowser;",
+        "Office;Spreadsheet;Qt;KDE;", "System;TerminalEmulator;", "Graphics;2DGraphics;RasterGraphics;",
+    };
+    filter->n_sets = FILTER_ENTRIES;
+    filter->sets = g_new0(DesktopCategories, FILTER_ENTRIES);
+    for (guint i = 0; i < FILTER_ENTRIES; i++) {
+        desktop_categories_parse(&filter->sets[i], lists[i % G_N_ELEMENTS(lists)], -1);
+    }
+}
+
+static void run_filter_categories(gpointer data) {
+    FilterCase *filter = data;
+    DesktopCategories wanted;
+    DesktopCategories excluded;
+    desktop_categories_clear(&wanted);
+    desktop_categories_clear(&excluded);
+    desktop_categories_add(&wanted, DESKTOP_CATEGORY_GAME);
+    desktop_categories_add(&excluded, DESKTOP_CATEGORY_CONSOLE_ONLY);
+    
+    guint matches = 0;
+    for (guint i = 0; i < filter->n_sets; i++) {
+        matches += desktop_categories_intersects(&filter->sets[i], &wanted) &&
+                   !desktop_categories_intersects(&filter->sets[i], &excluded);
+    }
+    bench_consume(&matches);
+}
+
+static void run_detect(gpointer data) {
+    FileType type = file_utils_detect_file_type(data);
+    bench_consume(&type);
+}
+
+static void run_sanitize(gpointer data) {
+    gchar *filename = file_utils_sanitize_filename(data);
+    bench_consume(filename);
+    g_free(filename);
+}
+
+typedef struct {
+    const gchar *content;
+    const gchar *filename;
+    FileSaveOptions *options;
+} SaveCase;
+
+static void run_save(gpointer data) {
+    SaveCase *save = data;
+    gchar *error_msg = NULL;
+    if (!file_utils_save_desktop_file(save->content, save->filename, save->options, &error_msg)) {
+        fprintf(stderr, "bench_core: save failed: %s\n", error_msg ? error_msg : "unknown error");
+        exit(1);
+    }
+    g_strfreev(save->options->duplicates);
+    save->options->duplicates = NULL;
+}
+
+// Corpus
+
+static DesktopEntry* make_entry(gboolean full) {
+    DesktopEntry *entry = desktop_entry_new();
+    if (!full) {
+        entry->name = g_strdup("Tool");
+        entry->exec_path = g_strdup("/usr/bin/tool");
+        return entry;
+    }
+    entry->name = g_strdup("Synthetic Editor Professional Edition 2000");
+    entry->comment = g_strdup("A long comment for a synthetic entry, with punctuation; "
+                              "quotes \"like these\" and a backslash \\ to escape");
+    entry->exec_path = g_strdup("/opt/synthetic editor/bin/synthetic-editor --profile=\"default\" %F");
+    entry->icon_path = g_strdup("/opt/synthetic editor/share/icons/hicolor/256x256/apps/synthetic.png");
+    entry->terminal = TRUE;
+    desktop_categories_parse(&entry->categories, "Utility;Graphics;Network;Office;Development;"
+                             "AudioVideo;System;Settings;Game;", -1);
+    return entry;
+}
+
+static gchar* write_sample(const gchar *dir, const gchar *name, const gchar *content, gssize length) {
+    gchar *path = g_build_filename(dir, name, NULL);
+    if (!g_file_set_contents(path, content, length, NULL)) {
+        fprintf(stderr, "bench_core: cannot write %s\n", path);
+        exit(1);
+    }
+    g_chmod(path, 0755);
+    return path;
+}
+
+static gchar* make_sandbox(void) {
+    // tmpfs keeps the save path from measuring the disk
+    if (g_file_test("/dev/shm", G_FILE_TEST_IS_DIR) && g_access("/dev/shm", W_OK) == 0) {
+        gchar *templ = g_strdup("/dev/shm/cre8or-bench-XXXXXX");
+        if (g_mkdtemp(templ)) {
+            return templ;
+        }
+        g_free(templ);
+    }
+    return g_dir_make_tmp("cre8or-bench-XXXXXX", NULL);
+}
+
+static void remove_tree(const gchar *path) {
+    GDir *dir = g_dir_open(path, 0, NULL);
+    if (dir) {
+        const gchar *name;
+        while ((name = g_dir_read_name(dir)) != NULL) {
+            gchar *child = g_build_filename(path, name, NULL);
+            if (g_file_test(child, G_FILE_TEST_IS_DIR) && !g_file_test(child, G_FILE_TEST_IS_SYMLINK)) {
+                remove_tree(child);
+            } else {
+                g_unlink(child);
+            }
+            g_free(child);
+        }
+        g_dir_close(dir);
+    }
+    g_rmdir(path);
+}
+
+int main(int argc, char *argv[]) {
+    const gchar *json_path = NULL;
+    const gchar *filter = NULL;
+    guint n_samples = 200;
+    
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            json_path = argv[++i];
+        } else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            filter = argv[++i];
+        } else {
+            n_samples = MAX(atoi(argv[i]), 1);
+        }
+    }
+    
+    gchar *sandbox = make_sandbox();
+    if (!sandbox) {
+        fprintf(stderr, "bench_core: cannot create sandbox directory\n");
+        return 1;
+    }
+    
+    // Everything the save path touches lives in the sandbox. This has to
+    // happen before GLib caches the home directory.
+    gchar *home = g_build_filename(sandbox, "home", NULL);
+    gchar *data_home = g_build_filename(home, ".local", "share", NULL);
+    gchar *cache_home = g_build_filename(home, ".cache", NULL);
+    gchar *config_home = g_build_filename(home, ".config", NULL);
+    g_mkdir_with_parents(data_home, 0755);
+    g_mkdir_with_parents(cache_home, 0755);
+    g_mkdir_with_parents(config_home, 0755);
+    g_setenv("HOME", home, TRUE);
+    g_setenv("XDG_DATA_HOME", data_home, TRUE);
+    g_setenv("XDG_CACHE_HOME", cache_home, TRUE);
+    g_setenv("XDG_CONFIG_HOME", config_home, TRUE);
+    
+    gchar *cache_path = g_build_filename(cache_home, "filetypes.cache", NULL);
+    type_cache_open(cache_path);
+    
+    // Corpus
+    DesktopEntry *minimal = make_entry(FALSE);
+    DesktopEntry *full = make_entry(TRUE);
+    DesktopCategories no_categories;
+    DesktopCategories one_category;
+    desktop_categories_clear(&no_categories);
+    desktop_categories_clear(&one_category);
+    desktop_categories_add(&one_category, DESKTOP_CATEGORY_DEVELOPMENT);
+    FilterCase filter_games = { NULL, 0 };
+    make_category_corpus(&filter_games);
+    
+    DesktopArena *arena = desktop_arena_new(0);
+    ArenaCase arena_full = { full, arena, 0 };
+    
+    gchar *samples_dir = g_build_filename(sandbox, "samples", NULL);
+    g_mkdir(samples_dir, 0755);
+    static const gchar elf[] = "\177ELF\002\001\001\000\000\000\000\000\000\000\000\000"
+                               "\002\000\076\000\001\000\000\000";
+    gchar *elf_path = write_sample(samples_dir, "tool", elf, sizeof(elf) - 1);
+    gchar *python_path = write_sample(samples_dir, "tool-py", "#!/usr/bin/env python3\nprint(1)\n", -1);
+    gchar *shell_path = write_sample(samples_dir, "tool.sh", "#!/bin/sh\necho 1\n", -1);
+    gchar *text_path = write_sample(samples_dir, "notes", "plain text, not a script\n", -1);
+    
+    gchar *long_name = g_strnfill(200, 'a');
+    for (guint i = 7; i < 200; i += 8) {
+        long_name[i] = "/ :*?\"<>"[i % 8];
+    }
+    
+    gchar *content = desktop_entry_generate_content(full);
+    gchar *custom_dir = g_build_filename(sandbox, "custom", NULL);
+    g_mkdir(custom_dir, 0755);
+    
+    // Custom save paths must be relative, so the save cases run from the
+    // sandbox and name the directory relative to it
+    gchar *original_cwd = g_get_current_dir();
+    if (g_chdir(sandbox) != 0) {
+        fprintf(stderr, "bench_core: cannot enter sandbox directory %s\n", sandbox);
+        return 1;
+    }
+    
+    FileSaveOptions *custom_options = file_save_options_new();
+    custom_options->save_to_custom = TRUE;
+    custom_options->custom_path = g_strdup("custom");
+    custom_options->overwrite_policy = FILE_OVERWRITE_FORCE;
+    custom_options->check_duplicates = FALSE;
+    SaveCase save_custom = { content, "Synthetic Editor", custom_options };
+    
+    FileSaveOptions *nosync_options = file_save_options_new();
+    nosync_options->save_to_custom = TRUE;
+    nosync_options->custom_path = g_strdup("custom");
+    nosync_options->overwrite_policy = FILE_OVERWRITE_FORCE;
+    nosync_options->check_duplicates = FALSE;
+    nosync_options->durability = FILE_DURABILITY_NONE;
+    SaveCase save_nosync = { content, "Synthetic Editor", nosync_options };
+    
+    FileSaveOptions *all_options = file_save_options_new();
+    all_options->save_to_desktop = TRUE;
+    all_options->save_to_local_apps = TRUE;
+    all_options->save_to_custom = TRUE;
+    all_options->custom_path = g_strdup("custom");
+    all_options->overwrite_policy = FILE_OVERWRITE_FORCE;
+    all_options->check_duplicates = FALSE;
+    SaveCase save_all = { content, "Synthetic Editor", all_options };
+    
+    // Without syncs the cost is mostly directory and file lookups
+    FileSaveOptions *all_nosync_options = file_save_options_new();
+    all_nosync_options->save_to_desktop = TRUE;
+    all_nosync_options->save_to_local_apps = TRUE;
+    all_nosync_options->overwrite_policy = FILE_OVERWRITE_FORCE;
+    all_nosync_options->check_duplicates = FALSE;
+    all_nosync_options->durability = FILE_DURABILITY_NONE;
+    SaveCase save_all_nosync = { content, "Synthetic Editor", all_nosync_options };
+    
+    FileSaveOptions *duplicate_options = file_save_options_new();
+    duplicate_options->save_to_custom = TRUE;
+    duplicate_options->custom_path = g_strdup("custom");
+    duplicate_options->overwrite_policy = FILE_OVERWRITE_FORCE;
+    duplicate_options->check_duplicates = TRUE;
+    SaveCase save_duplicates = { content, "Synthetic Editor", duplicate_options };
+    
+    const BenchCase cases[] = {
+        { "generate_content/minimal", run_generate, minimal },
+        { "generate_content/full", run_generate, full },
+        { "generate_content/full-arena", run_generate_arena, &arena_full },
+        { "generate_content/full-buffer", run_generate_buffer, full },
+        { "exec_escape/plain", run_exec_escape, "/opt/synthetic-editor/bin/synthetic-editor-launcher" },
+        { "exec_escape/reserved", run_exec_escape, "/home/user/My \"Tools\"/run $HOME 100% \\ `x`.sh" },
+        { "categories_string/none", run_categories, &no_categories },
+        { "categories_string/one", run_categories, &one_category },
+        { "categories_string/all", run_categories, &full->categories },
+        { "categories_parse/typical", run_parse_categories, "AudioVideo;Audio;Player;Recorder;GTK;" },
+        { "categories_parse/unknown", run_parse_categories, "X-GNOME-Utilities;Utility;X-Vendor-Tools;" },
+        { "categories_filter/10000-entries", run_filter_categories, &filter_games },
+        { "detect_file_type/elf", run_detect, elf_path },
+        { "detect_file_type/python", run_detect, python_path },
+        { "detect_file_type/shell", run_detect, shell_path },
+        { "detect_file_type/text", run_detect, text_path },
+        { "sanitize_filename/short", run_sanitize, "My Tool" },
+        { "sanitize_filename/utf8", run_sanitize, "\303\234n\303\257c\303\270d\303\251 Editor \342\200\224 Pro" },
+        { "sanitize_filename/long", run_sanitize, long_name },
+        { "save_desktop_file/custom", run_save, &save_custom },
+        { "save_desktop_file/custom-nosync", run_save, &save_nosync },
+        { "save_desktop_file/all", run_save, &save_all },
+        { "save_desktop_file/user-dirs-nosync", run_save, &save_all_nosync },
+        { "save_desktop_file/duplicates", run_save, &save_duplicates },
+    };
+    
+    BenchResult results[G_N_ELEMENTS(cases)];
+    guint n_results = 0;
+    printf("# ns/op (mean, p50, p90, p99 over %u samples), allocations and bytes per op\n", n_samples);
+    printf("# sandbox: %s\n", sandbox);
+    printf("%-36s %10s %10s %10s %10s %9s %10s\n", "case", "ns/op", "p50", "p90", "p99", "allocs", "bytes");
+    for (gsize i = 0; i < G_N_ELEMENTS(cases); i++) {
+        if (filter && !strstr(cases[i].name, filter)) {
+            continue;
+        }
+        // Fewer samples for the save path, which costs microseconds per call
+        gboolean slow = g_str_has_prefix(cases[i].name, "save_");
+        bench_run(&cases[i], slow ? MAX(n_samples / 4, 1) : n_samples, &results[n_results]);
+        print_result(&results[n_results]);
+        n_results++;
+    }
+    
+    // Back where a relative --json path was meant
+    int status = 0;
+    if (g_chdir(original_cwd) != 0) {
+        fprintf(stderr, "bench_core: cannot return to %s\n", original_cwd);
+        status = 1;
+    }
+    if (json_path && !write_json(json_path, results, n_results, n_samples)) {
+        status = 1;
+    }
+    
+    file_save_options_free(custom_options);
+    file_save_options_free(nosync_options);
+    file_save_options_free(all_options);
+    file_save_options_free(all_nosync_options);
+    file_save_options_free(duplicate_options);
+    g_free(content);
+    g_free(long_name);
+    g_free(elf_path);
+    g_free(python_path);
+    g_free(shell_path);
+    g_free(text_path);
+    desktop_entry_free(minimal);
+    desktop_entry_free(full);
+    desktop_arena_free(arena);
+    g_free(filter_games.sets);
+    type_cache_close();
+    remove_tree(sandbox);
+    g_free(custom_dir);
+    g_free(original_cwd);
+    g_free(samples_dir);
+    g_free(cache_path);
+    g_free(config_home);
+    g_free(cache_home);
+    g_free(data_home);
+    g_free(home);
+    g_free(sandbox);
+    return status;
+}
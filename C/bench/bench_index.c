@@ -0,0 +1,111 @@
+#define _GNU_SOURCE
+#include "bench.h"
+#include "../app_index.h"
+#include <glib/gstdio.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Cost of building the applications index over a synthetic applications
+// directory, of mapping it again, and of a duplicate lookup.
+// Usage: bench_index [entries] [lookups]
+
+static void write_entries(const gchar *dir, int n_entries) {
+    for (int i = 0; i < n_entries; i++) {
+        gchar *name = g_strdup_printf("app-%05d.desktop", i);
+        gchar *path = g_build_filename(dir, name, NULL);
+        gchar *content = g_strdup_printf("[Desktop Entry]\n"
+                                         "Type=Application\n"
+                                         "Name=Application %d\n"
+                                         "Name[de]=Anwendung %d\n"
+                                         "Comment=Synthetic entry for the index benchmark\n"
+                                         "Exec=/opt/app-%d/bin/app %%U\n"
+                                         "Icon=app-%d\n"
+                                         "Terminal=false\n"
+                                         "Categories=Utility;Development;\n",
+                                         i, i, i, i);
+        if (!g_file_set_contents(path, content, -1, NULL)) {
+            fprintf(stderr, "bench_index: cannot write %s\n", path);
+            exit(1);
+        }
+        g_free(content);
+        g_free(path);
+        g_free(name);
+    }
+}
+
+static void remove_entries(const gchar *dir, int n_entries) {
+    for (int i = 0; i < n_entries; i++) {
+        gchar *name = g_strdup_printf("app-%05d.desktop", i);
+        gchar *path = g_build_filename(dir, name, NULL);
+        g_unlink(path);
+        g_free(path);
+        g_free(name);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int n_entries = argc > 1 ? atoi(argv[1]) : 10000;
+    int lookups = argc > 2 ? atoi(argv[2]) : 100000;
+    
+    gchar *root = g_dir_make_tmp("cre8or-bench-XXXXXX", NULL);
+    if (!root) {
+        fprintf(stderr, "bench_index: cannot create temporary directory\n");
+        return 1;
+    }
+    gchar *apps_dir = g_build_filename(root, "applications", NULL);
+    gchar *index_path = g_build_filename(root, "apps.index", NULL);
+    g_mkdir(apps_dir, 0755);
+    write_entries(apps_dir, n_entries);
+    
+    const gchar *dirs[] = { apps_dir, NULL };
+    gchar *error_msg = NULL;
+    
+    gint64 start = bench_now_ns();
+    AppIndex *index = app_index_build(index_path, dirs, &error_msg);
+    gint64 build_ns = bench_now_ns() - start;
+    if (!index) {
+        fprintf(stderr, "bench_index: %s\n", error_msg);
+        return 1;
+    }
+    guint n_indexed = app_index_get_n_entries(index);
+    app_index_free(index);
+    
+    start = bench_now_ns();
+    index = app_index_load(index_path, dirs);
+    gint64 load_ns = bench_now_ns() - start;
+    if (!index) {
+        fprintf(stderr, "bench_index: cannot load the index just built\n");
+        return 1;
+    }
+    
+    guint found = 0;
+    start = bench_now_ns();
+    for (int n = 0; n < lookups; n++) {
+        gchar name[32];
+        gchar exec[48];
+        int i = n % MAX(n_entries, 1);
+        g_snprintf(name, sizeof(name), "application %d", i);
+        g_snprintf(exec, sizeof(exec), "/opt/app-%d/bin/app", i);
+        GArray *matches = app_index_find_duplicates(index, name, exec);
+        found += matches->len;
+        bench_consume(matches);
+        g_array_free(matches, TRUE);
+    }
+    gint64 lookup_ns = (bench_now_ns() - start) / MAX(lookups, 1);
+    
+    printf("# %d entries, %d thread(s)\n", n_entries, g_get_num_processors());
+    printf("build:  %8.2f ms (%u indexed)\n", build_ns / 1e6, n_indexed);
+    printf("load:   %8.2f ms\n", load_ns / 1e6);
+    printf("lookup: %8" G_GINT64_FORMAT " ns/op (%u match(es))\n", lookup_ns, found);
+    
+    app_index_free(index);
+    remove_entries(apps_dir, n_entries);
+    g_unlink(index_path);
+    g_rmdir(apps_dir);
+    g_rmdir(root);
+    g_free(index_path);
+    g_free(apps_dir);
+    g_free(root);
+    return 0;
+}
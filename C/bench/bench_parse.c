@@ -0,0 +1,145 @@
+#define _GNU_SOURCE
+#include "bench.h"
+#include "../desktop_parser.h"
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Parse cost of desktop_document_new_from_data() against GKeyFile over a
+// set of .desktop files loaded into memory beforehand, so only parsing is
+// measured. Also checks that every file is re-emitted byte for byte.
+// Usage: bench_parse [iterations] [dir...]   (default: /usr/share/applications)
+
+typedef struct {
+    gchar *path;
+    gchar *data;
+    gsize length;
+} BenchInput;
+
+static const gchar sample_entry[] =
+    "[Desktop Entry]\n"
+    "# Sample used when no applications directory is available\n"
+    "Type=Application\n"
+    "Name=Sample Editor\n"
+    "Name[de]=Beispieleditor\n"
+    "Name[fr]=Éditeur d'exemple\n"
+    "Comment=Edit text files\n"
+    "Comment[de]=Textdateien bearbeiten\n"
+    "Exec=sample-editor %U\n"
+    "Icon=accessories-text-editor\n"
+    "Terminal=false\n"
+    "Categories=Utility;TextEditor;\n"
+    "MimeType=text/plain;\n"
+    "Keywords=Text;Editor;Plaintext;\n"
+    "\n"
+    "[Desktop Action new-window]\n"
+    "Name=New Window\n"
+    "Exec=sample-editor --new-window\n";
+
+static void load_dir(const gchar *dir_path, GPtrArray *inputs) {
+    GDir *dir = g_dir_open(dir_path, 0, NULL);
+    if (!dir) {
+        return;
+    }
+    
+    const gchar *name;
+    while ((name = g_dir_read_name(dir)) != NULL) {
+        if (!g_str_has_suffix(name, ".desktop")) {
+            continue;
+        }
+        BenchInput *input = g_new0(BenchInput, 1);
+        input->path = g_build_filename(dir_path, name, NULL);
+        if (!g_file_get_contents(input->path, &input->data, &input->length, NULL)) {
+            g_free(input->path);
+            g_free(input);
+            continue;
+        }
+        g_ptr_array_add(inputs, input);
+    }
+    g_dir_close(dir);
+}
+
+static void free_input(gpointer data) {
+    BenchInput *input = data;
+    g_free(input->path);
+    g_free(input->data);
+    g_free(input);
+}
+
+int main(int argc, char *argv[]) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 50;
+    GPtrArray *inputs = g_ptr_array_new_with_free_func(free_input);
+    
+    if (argc > 2) {
+        for (int i = 2; i < argc; i++) {
+            load_dir(argv[i], inputs);
+        }
+    } else {
+        load_dir("/usr/share/applications", inputs);
+    }
+    if (inputs->len == 0) {
+        BenchInput *input = g_new0(BenchInput, 1);
+        input->path = g_strdup("(sample)");
+        input->data = g_strdup(sample_entry);
+        input->length = sizeof(sample_entry) - 1;
+        g_ptr_array_add(inputs, input);
+    }
+    
+    gsize total_bytes = 0;
+    guint mismatches = 0;
+    GString *out = g_string_new(NULL);
+    for (guint i = 0; i < inputs->len; i++) {
+        BenchInput *input = g_ptr_array_index(inputs, i);
+        total_bytes += input->length;
+        
+        DesktopDocument *doc = desktop_document_new_from_data(input->data, input->length);
+        g_string_truncate(out, 0);
+        desktop_document_write(doc, out);
+        if (out->len != input->length || memcmp(out->str, input->data, input->length) != 0) {
+            fprintf(stderr, "bench_parse: round trip differs for %s\n", input->path);
+            mismatches++;
+        }
+        desktop_document_free(doc);
+    }
+    g_string_free(out, TRUE);
+    
+    // Parse plus one Name lookup, the minimum a caller does with a file
+    gint64 start = bench_now_ns();
+    for (int n = 0; n < iterations; n++) {
+        for (guint i = 0; i < inputs->len; i++) {
+            BenchInput *input = g_ptr_array_index(inputs, i);
+            DesktopDocument *doc = desktop_document_new_from_data(input->data, input->length);
+            guint group = desktop_document_find_group(doc, "Desktop Entry");
+            bench_consume(desktop_document_lookup(doc, group, "Name", NULL));
+            desktop_document_free(doc);
+        }
+    }
+    gint64 parser_ns = bench_now_ns() - start;
+    
+    start = bench_now_ns();
+    for (int n = 0; n < iterations; n++) {
+        for (guint i = 0; i < inputs->len; i++) {
+            BenchInput *input = g_ptr_array_index(inputs, i);
+            GKeyFile *key_file = g_key_file_new();
+            if (g_key_file_load_from_data(key_file, input->data, input->length,
+                                          G_KEY_FILE_KEEP_COMMENTS | G_KEY_FILE_KEEP_TRANSLATIONS, NULL)) {
+                gchar *value = g_key_file_get_string(key_file, "Desktop Entry", "Name", NULL);
+                bench_consume(value);
+                g_free(value);
+            }
+            g_key_file_free(key_file);
+        }
+    }
+    gint64 keyfile_ns = bench_now_ns() - start;
+    
+    gdouble files = (gdouble)inputs->len * MAX(iterations, 1);
+    gdouble megabytes = (gdouble)total_bytes * MAX(iterations, 1) / (1024.0 * 1024.0);
+    printf("# %u file(s), %" G_GSIZE_FORMAT " bytes, x%d\n", inputs->len, total_bytes, iterations);
+    printf("%-14s %12s %10s\n", "parser", "ns/file", "MB/s");
+    printf("%-14s %12.0f %10.1f\n", "desktop_parser", parser_ns / files, megabytes / (parser_ns / 1e9));
+    printf("%-14s %12.0f %10.1f\n", "GKeyFile", keyfile_ns / files, megabytes / (keyfile_ns / 1e9));
+    printf("# speedup: %.1fx, round trip mismatches: %u\n", (gdouble)keyfile_ns / MAX(parser_ns, 1), mismatches);
+    
+    g_ptr_array_free(inputs, TRUE);
+    return mismatches == 0 ? 0 : 1;
+}
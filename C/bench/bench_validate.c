@@ -0,0 +1,114 @@
+#define _GNU_SOURCE
+#include "bench.h"
+#include "../desktop_validate.h"
+#include <glib/gstdio.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Validation throughput over a synthetic corpus: the checker alone on
+// documents in memory, then desktop_validate_paths() reading the files on
+// one thread and on every CPU.
+// Usage: bench_validate [files]
+
+// Every fourth entry has something to report
+static gchar* make_entry(int i) {
+    return g_strdup_printf("[Desktop Entry]\n"
+                           "Type=Application\n"
+                           "Version=1.5\n"
+                           "Name=Application %d\n"
+                           "Name[de]=Anwendung %d\n"
+                           "Name[pt_BR]=Aplicativo %d\n"
+                           "GenericName=Synthetic Tool\n"
+                           "Comment=Synthetic entry for the validation benchmark\n"
+                           "Comment[fr]=Entrée synthétique\n"
+                           "Exec=/opt/app-%d/bin/app %s\n"
+                           "Icon=%s\n"
+                           "Terminal=false\n"
+                           "Categories=%s\n"
+                           "MimeType=text/plain;application/x-app-%d;\n"
+                           "Keywords=synthetic;bench;\n"
+                           "Actions=new-window;\n"
+                           "\n"
+                           "[Desktop Action new-window]\n"
+                           "Name=New Window\n"
+                           "Exec=/opt/app-%d/bin/app --new-window\n",
+                           i, i, i, i,
+                           i % 4 == 1 ? "%U %f" : "%U",
+                           i % 4 == 2 ? "app.png" : "app",
+                           i % 4 == 3 ? "Qt;Utility;" : "Utility;Development;",
+                           i, i);
+}
+
+static gchar* entry_path(const gchar *dir, int i) {
+    gchar name[32];
+    g_snprintf(name, sizeof(name), "app-%05d.desktop", i);
+    return g_build_filename(dir, name, NULL);
+}
+
+static void report_run(const gchar *label, const DesktopValidateStats *stats) {
+    gdouble seconds = MAX(stats->elapsed_us, 1) / 1e6;
+    printf("%-10s %8.2f ms %10.0f files/s %8.1f MB/s (%u with errors)\n", label,
+           stats->elapsed_us / 1000.0, stats->files / seconds, stats->bytes / 1e6 / seconds,
+           stats->files_with_errors);
+}
+
+int main(int argc, char *argv[]) {
+    int n_files = argc > 1 ? atoi(argv[1]) : 10000;
+    
+    gchar *root = g_dir_make_tmp("cre8or-bench-XXXXXX", NULL);
+    if (!root) {
+        fprintf(stderr, "bench_validate: cannot create temporary directory\n");
+        return 1;
+    }
+    
+    GPtrArray *documents = g_ptr_array_new_with_free_func(g_free);
+    gsize total_bytes = 0;
+    for (int i = 0; i < n_files; i++) {
+        gchar *content = make_entry(i);
+        gchar *path = entry_path(root, i);
+        if (!g_file_set_contents(path, content, -1, NULL)) {
+            fprintf(stderr, "bench_validate: cannot write %s\n", path);
+            return 1;
+        }
+        total_bytes += strlen(content);
+        g_ptr_array_add(documents, content);
+        g_free(path);
+    }
+    
+    // Checker only, issues counted but not collected
+    DesktopValidator *validator = desktop_validator_new();
+    guint errors = 0;
+    gint64 start = bench_now_ns();
+    for (guint i = 0; i < documents->len; i++) {
+        const gchar *content = g_ptr_array_index(documents, i);
+        errors += desktop_validator_check(validator, content, strlen(content), NULL);
+    }
+    gint64 check_ns = bench_now_ns() - start;
+    bench_consume(&errors);
+    desktop_validator_free(validator);
+    
+    printf("# %d files, %.2f MB, %d CPU(s)\n", n_files, total_bytes / 1e6, g_get_num_processors());
+    printf("memory:    %8" G_GINT64_FORMAT " ns/file %8.1f MB/s (%u errors)\n",
+           check_ns / MAX(n_files, 1), total_bytes / 1e3 / MAX(check_ns / 1e6, 1e-6), errors);
+    
+    const gchar *paths[] = { root, NULL };
+    DesktopValidateStats stats;
+    GPtrArray *results = desktop_validate_paths(paths, 1, &stats);
+    report_run("1 thread:", &stats);
+    g_ptr_array_unref(results);
+    
+    results = desktop_validate_paths(paths, 0, &stats);
+    report_run("parallel:", &stats);
+    g_ptr_array_unref(results);
+    
+    for (int i = 0; i < n_files; i++) {
+        gchar *path = entry_path(root, i);
+        g_unlink(path);
+        g_free(path);
+    }
+    g_rmdir(root);
+    g_ptr_array_unref(documents);
+    g_free(root);
+    return 0;
+}
@@ -0,0 +1,900 @@
+#include "cli.h"
+#include "desktop_entry.h"
+#include "file_utils.h"
+#include "desktop_parser.h"
+#include "type_cache.h"
+#include "app_watch.h"
+#include "icon_index.h"
+#include "desktop_validate.h"
+#include "app_import.h"
+#include "exec_metadata.h"
+#include "file_writer.h"
+#include "mime_cache.h"
+#include "daemon_server.h"
+#include "daemon_client.h"
+#include "home_provision.h"
+#include <glib-unix.h>
+#include <signal.h>
+#include <string.h>
+#include <stdio.h>
+
+// Options that switch the program into headless mode
+static const gchar *headless_options[] = {
+    "--name", "--comment", "--exec", "--icon", "--categories", "--terminal",
+    "--desktop", "--local-apps", "--output", "--force", "--skip", "--fail",
+    "--stats", "--from", "--watch", "--durability", "--daemon", "--socket", "--home", "--all-users",
+    "--root", "--help", "-h"
+};
+
+gboolean cli_is_headless(int argc, char *argv[]) {
+    if (argc > 1 && (strcmp(argv[1], "validate") == 0 || strcmp(argv[1], "import") == 0 ||
+                     strcmp(argv[1], "client") == 0)) {
+        return TRUE;
+    }
+    for (int i = 1; i < argc; i++) {
+        for (gsize j = 0; j < G_N_ELEMENTS(headless_options); j++) {
+            gsize len = strlen(headless_options[j]);
+            if (strncmp(argv[i], headless_options[j], len) == 0 &&
+                (argv[i][len] == '\0' || argv[i][len] == '=')) {
+                return TRUE;
+            }
+        }
+    }
+    return FALSE;
+}
+
+static gboolean cli_parse_categories(DesktopCategories *categories, const gchar *list, gchar **error_msg) {
+    gchar **names = g_strsplit_set(list, ";,", -1);
+    gboolean ok = TRUE;
+    
+    for (gchar **name = names; *name != NULL; name++) {
+        g_strstrip(*name);
+        if (strlen(*name) == 0) {
+            continue;
+        }
+        if (!desktop_entry_set_category(categories, *name, TRUE)) {
+            *error_msg = g_strdup_printf("Unknown category: %s", *name);
+            ok = FALSE;
+            break;
+        }
+    }
+    
+    g_strfreev(names);
+    return ok;
+}
+
+static gboolean cli_on_signal(gpointer user_data) {
+    g_main_loop_quit(user_data);
+    return G_SOURCE_REMOVE;
+}
+
+static void cli_on_watch_error(const gchar *error_msg, gpointer user_data) {
+    (void)user_data;  // Suppress unused parameter warning
+    fprintf(stderr, "cre8or: %s\n", error_msg);
+}
+
+// Keeps the applications index current until interrupted
+static int cli_run_watch(gboolean stats) {
+    gchar *error_msg = NULL;
+    AppWatch *watch = app_watch_new_default(&error_msg);
+    if (!watch) {
+        fprintf(stderr, "cre8or: %s\n", error_msg);
+        g_free(error_msg);
+        return 1;
+    }
+    
+    fprintf(stderr, "cre8or: watching %u application entries\n",
+            app_index_get_n_entries(app_watch_get_index(watch)));
+    
+    GMainLoop *loop = g_main_loop_new(NULL, FALSE);
+    g_unix_signal_add(SIGINT, cli_on_signal, loop);
+    g_unix_signal_add(SIGTERM, cli_on_signal, loop);
+    app_watch_set_error_func(watch, cli_on_watch_error, NULL);
+    app_watch_attach(watch, 500);
+    g_main_loop_run(loop);
+    
+    int status = 0;
+    if (!app_watch_flush(watch, &error_msg)) {
+        fprintf(stderr, "cre8or: %s\n", error_msg);
+        g_free(error_msg);
+        status = 1;
+    }
+    
+    if (stats) {
+        AppWatchStats watch_stats;
+        app_watch_get_stats(watch, &watch_stats);
+        fprintf(stderr, "watch: %" G_GUINT64_FORMAT " event(s) in %" G_GUINT64_FORMAT " batch(es), %"
+                G_GUINT64_FORMAT " parsed, %" G_GUINT64_FORMAT " removed, %" G_GUINT64_FORMAT " rescan(s), %"
+                G_GUINT64_FORMAT " index write(s), %" G_GUINT64_FORMAT " failed\n",
+                watch_stats.events, watch_stats.batches, watch_stats.updated, watch_stats.removed,
+                watch_stats.rescans, watch_stats.writes, watch_stats.write_errors);
+    }
+    
+    g_main_loop_unref(loop);
+    app_watch_free(watch);
+    return status;
+}
+
+// Serves requests on a Unix socket until interrupted
+static int cli_run_daemon(const gchar *socket_path, gboolean stats) {
+    gchar *error_msg = NULL;
+    DaemonServer *server = daemon_server_new(socket_path, &error_msg);
+    if (!server) {
+        fprintf(stderr, "cre8or: %s\n", error_msg);
+        g_free(error_msg);
+        return 1;
+    }
+    fprintf(stderr, "cre8or: listening on %s\n", daemon_server_get_socket_path(server));
+    
+    GMainLoop *loop = g_main_loop_new(NULL, FALSE);
+    g_unix_signal_add(SIGINT, cli_on_signal, loop);
+    g_unix_signal_add(SIGTERM, cli_on_signal, loop);
+    g_main_loop_run(loop);
+    
+    if (stats) {
+        gchar *text = daemon_server_format_stats(server);
+        fputs(text, stderr);
+        g_free(text);
+    }
+    
+    g_main_loop_unref(loop);
+    daemon_server_free(server);
+    return 0;
+}
+
+// cre8or client [OPTION...] [COMMAND [KEY=VALUE...]]
+static int cli_run_client(int argc, char *argv[]) {
+    gchar *socket_path = NULL;
+    gboolean stats = FALSE;
+    
+    GOptionEntry entries[] = {
+        { "socket", 0, 0, G_OPTION_ARG_FILENAME, &socket_path, "Socket of the daemon (default: $XDG_RUNTIME_DIR/cre8or.sock)", "PATH" },
+        { "stats", 0, 0, G_OPTION_ARG_NONE, &stats, "Print the latency of each request to stderr", NULL },
+        { NULL, 0, 0, 0, NULL, NULL, NULL }
+    };
+    
+    GOptionContext *context = g_option_context_new("[COMMAND [KEY=VALUE...]] - send requests to cre8or --daemon");
+    g_option_context_add_main_entries(context, entries, NULL);
+    g_option_context_set_description(context,
+        "Commands are generate, validate, save and stats. Without a command, requests are\n"
+        "read from stdin, one per line as COMMAND<TAB>KEY=VALUE..., and sent pipelined.\n"
+        "Exits with status 1 if any request failed.");
+    
+    GError *parse_error = NULL;
+    gboolean parsed = g_option_context_parse(context, &argc, &argv, &parse_error);
+    g_option_context_free(context);
+    if (!parsed) {
+        fprintf(stderr, "cre8or: %s\n", parse_error->message);
+        g_error_free(parse_error);
+        g_free(socket_path);
+        return 2;
+    }
+    
+    gchar *error_msg = NULL;
+    DaemonClient *client = daemon_client_connect(socket_path, &error_msg);
+    g_free(socket_path);
+    if (!client) {
+        fprintf(stderr, "cre8or: %s\n", error_msg);
+        g_free(error_msg);
+        return 2;
+    }
+    
+    if (argc > 1) {
+        daemon_client_queue(client, argv[1], (const gchar * const *)argv + 2);
+    } else {
+        gchar line[65536];
+        while (fgets(line, sizeof(line), stdin)) {
+            if (line[0] != '\n') {
+                daemon_client_queue_line(client, line);
+            }
+        }
+    }
+    
+    int status = 0;
+    for (guint i = 1; daemon_client_get_pending(client) > 0; i++) {
+        DaemonReply reply;
+        if (!daemon_client_read_reply(client, &reply, &error_msg)) {
+            fprintf(stderr, "cre8or: %s\n", error_msg);
+            g_free(error_msg);
+            status = 2;
+            break;
+        }
+        if (reply.ok) {
+            fwrite(reply.body, 1, reply.length, stdout);
+        } else {
+            fprintf(stderr, "cre8or: request %u: %s%s", i, reply.body,
+                    g_str_has_suffix(reply.body, "\n") ? "" : "\n");
+            status = 1;
+        }
+        if (stats) {
+            fprintf(stderr, "request %u: %s in %.3f ms\n", i, reply.ok ? "ok" : "error",
+                    reply.latency_us / 1000.0);
+        }
+        daemon_reply_clear(&reply);
+    }
+    
+    daemon_client_free(client);
+    return status;
+}
+
+// Saves the entry into many homes (see home_provision.h). Without --home
+// or --all-users that is the user's own home inside --root.
+static int cli_provision_homes(const gchar *content, const gchar *name, gchar **homes, gboolean all_users,
+                               const HomeProvisionOptions *options, gboolean stats) {
+    GPtrArray *targets = g_ptr_array_new_with_free_func(g_free);
+    GHashTable *seen = g_hash_table_new(g_str_hash, g_str_equal);
+    gchar **user_homes = NULL;
+    
+    if (all_users) {
+        gchar *error_msg = NULL;
+        user_homes = home_provision_list_user_homes(options->root, &error_msg);
+        if (!user_homes) {
+            fprintf(stderr, "cre8or: %s\n", error_msg);
+            g_free(error_msg);
+            g_hash_table_destroy(seen);
+            g_ptr_array_unref(targets);
+            return 2;
+        }
+    }
+    for (guint pass = 0; pass < 2; pass++) {
+        gchar **list = pass == 0 ? homes : user_homes;
+        for (guint i = 0; list && list[i]; i++) {
+            if (!g_hash_table_contains(seen, list[i])) {
+                g_hash_table_add(seen, list[i]);
+                g_ptr_array_add(targets, g_strdup(list[i]));
+            }
+        }
+    }
+    if (!homes && !all_users) {
+        g_ptr_array_add(targets, g_strdup(g_get_home_dir()));
+    }
+    g_hash_table_destroy(seen);
+    g_strfreev(user_homes);
+    g_ptr_array_add(targets, NULL);
+    
+    gchar *base = file_utils_sanitize_filename(name);
+    HomeProvisionItem item = { g_strconcat(base, ".desktop", NULL), (gchar*)content };
+    g_free(base);
+    
+    HomeProvisionStats provision_stats;
+    GPtrArray *results = home_provision_run((const gchar * const *)targets->pdata, &item, 1, options,
+                                            &provision_stats);
+    for (guint i = 0; i < results->len; i++) {
+        HomeProvisionResult *result = g_ptr_array_index(results, i);
+        if (result->error) {
+            fprintf(stderr, "cre8or: %s: %s\n", result->home, result->error);
+        }
+        if (stats) {
+            fprintf(stderr, "  %s: %u written, %u kept in %.3f ms (%u file sync(s), %u directory sync(s))\n",
+                    result->home, result->written, result->skipped, result->elapsed_us / 1000.0,
+                    result->write_stats.file_syncs, result->write_stats.dir_syncs);
+        }
+    }
+    fprintf(stderr, "provision: %u home(s), %u failed, %u file(s) written, %u existing kept in %.1f ms "
+            "on %u thread(s)\n",
+            provision_stats.homes, provision_stats.failed, provision_stats.written, provision_stats.skipped,
+            provision_stats.elapsed_us / 1000.0, provision_stats.n_threads);
+    
+    g_ptr_array_unref(results);
+    g_ptr_array_unref(targets);
+    g_free(item.filename);
+    return provision_stats.failed > 0 ? 1 : 0;
+}
+
+// Fills the fields that were not given from an AppImage's embedded entry.
+// Its icon is installed into the user's icon theme only when saving.
+static void cli_apply_exec_metadata(DesktopEntry *entry, gboolean saving, gboolean stats) {
+    gboolean need_icon = !entry->icon_path || entry->icon_path[0] == '\0';
+    if (entry->name && entry->name[0] != '\0' && entry->comment && entry->comment[0] != '\0' &&
+        !need_icon && !desktop_categories_is_empty(&entry->categories)) {
+        return;
+    }
+    
+    gint64 start_us = g_get_monotonic_time();
+    gchar *error_msg = NULL;
+    ExecMetadata *meta = exec_metadata_read(entry->exec_path, saving && need_icon ? EXEC_METADATA_INSTALL_ICON : 0,
+                                            &error_msg);
+    if (!meta) {
+        fprintf(stderr, "cre8or: warning: %s\n", error_msg);
+        g_free(error_msg);
+        return;
+    }
+    
+    exec_metadata_apply(meta, entry);
+    if (meta->icon_error) {
+        fprintf(stderr, "cre8or: warning: %s\n", meta->icon_error);
+    }
+    if (stats) {
+        fprintf(stderr, "appimage: %s read from a squashfs image at offset %" G_GUINT64_FORMAT ", "
+                "%" G_GUINT64_FORMAT " bytes decoded in %.3f ms\n",
+                meta->desktop_file ? meta->desktop_file : "icon", meta->squashfs_offset, meta->bytes_read,
+                (g_get_monotonic_time() - start_us) / 1000.0);
+    }
+    exec_metadata_free(meta);
+}
+
+// cre8or validate [OPTION...] PATH...
+static int cli_run_validate(int argc, char *argv[]) {
+    gint jobs = 0;
+    gboolean no_hints = FALSE;
+    gboolean stats = FALSE;
+    
+    GOptionEntry entries[] = {
+        { "jobs", 'j', 0, G_OPTION_ARG_INT, &jobs, "Worker threads (default: one per CPU)", "N" },
+        { "no-hints", 0, 0, G_OPTION_ARG_NONE, &no_hints, "Do not report hints", NULL },
+        { "stats", 0, 0, G_OPTION_ARG_NONE, &stats, "Print throughput to stderr", NULL },
+        { NULL, 0, 0, 0, NULL, NULL, NULL }
+    };
+    
+    GOptionContext *context = g_option_context_new("PATH... - check .desktop files against the specification");
+    g_option_context_add_main_entries(context, entries, NULL);
+    g_option_context_set_description(context,
+        "Directories are searched recursively for .desktop and .directory files.\n"
+        "Exits with status 1 if any file has errors.");
+    
+    GError *parse_error = NULL;
+    gboolean parsed = g_option_context_parse(context, &argc, &argv, &parse_error);
+    g_option_context_free(context);
+    if (!parsed) {
+        fprintf(stderr, "cre8or: %s\n", parse_error->message);
+        g_error_free(parse_error);
+        return 2;
+    }
+    if (argc < 2) {
+        fprintf(stderr, "cre8or: validate needs at least one file or directory\n");
+        return 2;
+    }
+    if (jobs < 0) {
+        fprintf(stderr, "cre8or: --jobs must not be negative\n");
+        return 2;
+    }
+    
+    DesktopValidateStats validate_stats;
+    GPtrArray *results = desktop_validate_paths((const gchar * const *)argv + 1, jobs, &validate_stats);
+    
+    guint n_issues = 0;
+    for (guint i = 0; i < results->len; i++) {
+        DesktopValidateResult *result = g_ptr_array_index(results, i);
+        if (result->read_error) {
+            printf("%s: error: %s\n", result->path, result->read_error);
+            continue;
+        }
+        for (guint j = 0; result->issues && j < result->issues->len; j++) {
+            DesktopIssue *issue = &g_array_index(result->issues, DesktopIssue, j);
+            if (no_hints && issue->level == DESKTOP_ISSUE_HINT) {
+                continue;
+            }
+            printf("%s:%u: %s: %s\n", result->path, issue->line,
+                   desktop_issue_level_to_string(issue->level), issue->message);
+            n_issues++;
+        }
+    }
+    
+    if (stats) {
+        gdouble seconds = MAX(validate_stats.elapsed_us, 1) / 1e6;
+        fprintf(stderr, "validate: %u file(s), %u with errors, %u issue(s); %.2f MB in %.1f ms "
+                "(%.0f files/s, %.1f MB/s)\n",
+                validate_stats.files, validate_stats.files_with_errors, n_issues,
+                validate_stats.bytes / 1e6, validate_stats.elapsed_us / 1000.0,
+                validate_stats.files / seconds, validate_stats.bytes / 1e6 / seconds);
+    }
+    
+    int status = validate_stats.files_with_errors > 0 ? 1 : 0;
+    g_ptr_array_unref(results);
+    return status;
+}
+
+static void cli_print_mime_stats(void) {
+    MimeCacheStats mime;
+    mime_cache_get_stats(&mime);
+    if (mime.updated + mime.removed + mime.scans > 0) {
+        fprintf(stderr, "mime cache: %" G_GUINT64_FORMAT " entr%s read, %" G_GUINT64_FORMAT " removed, "
+                "%" G_GUINT64_FORMAT " full scan(s), %" G_GUINT64_FORMAT " rewrite(s) in %.3f ms\n",
+                mime.updated, mime.updated == 1 ? "y" : "ies", mime.removed, mime.scans, mime.writes,
+                mime.elapsed_us / 1000.0);
+    }
+}
+
+// Writes the imported entries to dir, one file per entry named after it;
+// entries whose names collide get a numeric suffix
+static gboolean cli_save_imported(GPtrArray *items, const gchar *dir, gboolean force,
+                                  FileDurability durability, gboolean stats, gchar **error_msg) {
+    FileWriter *writer = file_writer_new(durability);
+    if (!file_utils_prepare_directory(writer, dir, error_msg)) {
+        file_writer_free(writer);
+        return FALSE;
+    }
+    
+    GHashTable *taken = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    GPtrArray *written = g_ptr_array_new_with_free_func(g_free);
+    guint skipped = 0;
+    gboolean success = TRUE;
+    
+    for (guint i = 0; i < items->len && success; i++) {
+        AppImportItem *item = g_ptr_array_index(items, i);
+        gchar *base = file_utils_sanitize_filename(item->name);
+        gchar *filename = g_strconcat(base, ".desktop", NULL);
+        for (guint n = 2; g_hash_table_contains(taken, filename); n++) {
+            g_free(filename);
+            filename = g_strdup_printf("%s-%u.desktop", base, n);
+        }
+        g_free(base);
+        
+        gchar *path = g_build_filename(dir, filename, NULL);
+        g_hash_table_add(taken, filename);
+        if (!force && file_utils_file_exists(path)) {
+            skipped++;
+        } else {
+            success = file_writer_write(writer, path, item->content, -1, FILE_UTILS_DESKTOP_MODE, error_msg);
+            g_ptr_array_add(written, g_strdup(path));
+        }
+        g_free(path);
+    }
+    if (success) {
+        success = file_writer_commit(writer, error_msg);
+    }
+    
+    // One cache rewrite for the whole import
+    gchar *mime_error = NULL;
+    if (success && !mime_cache_update_paths((const gchar * const *)written->pdata, written->len, &mime_error)) {
+        fprintf(stderr, "cre8or: warning: could not update mimeinfo.cache: %s\n", mime_error);
+        g_free(mime_error);
+    }
+    
+    FileWriterStats write;
+    file_writer_get_stats(writer, &write);
+    fprintf(stderr, "import: %u entr%s written to %s, %u existing kept\n",
+            write.files, write.files == 1 ? "y" : "ies", dir, skipped);
+    if (stats) {
+        fprintf(stderr, "write: %u file(s), %" G_GUINT64_FORMAT " bytes in %.3f ms (%s: %u file sync(s), "
+                "%u directory sync(s))\n",
+                write.files, write.bytes, write.elapsed_us / 1000.0,
+                file_durability_to_string(durability), write.file_syncs, write.dir_syncs);
+        cli_print_mime_stats();
+    }
+    
+    g_ptr_array_unref(written);
+    g_hash_table_destroy(taken);
+    file_writer_free(writer);
+    return success;
+}
+
+static void cli_print_import_stats(const AppImportStats *import_stats) {
+    gdouble seconds = MAX(import_stats->elapsed_us, 1) / 1e6;
+    fprintf(stderr, "import: %u dir(s), %u file(s), %u executable(s), %u entr%s in %.1f ms "
+            "(%.0f files/s, %.0f entries/s on %u thread(s))\n",
+            import_stats->dirs, import_stats->files, import_stats->executables, import_stats->entries,
+            import_stats->entries == 1 ? "y" : "ies", import_stats->elapsed_us / 1000.0,
+            import_stats->files / seconds, import_stats->entries / seconds, import_stats->workers->len);
+    if (import_stats->unreadable > 0) {
+        fprintf(stderr, "import: %u director%s could not be opened\n", import_stats->unreadable,
+                import_stats->unreadable == 1 ? "y" : "ies");
+    }
+    for (guint i = 0; i < import_stats->workers->len; i++) {
+        AppImportWorkerStats *worker = &g_array_index(import_stats->workers, AppImportWorkerStats, i);
+        gdouble busy = MAX(worker->busy_us, 1) / 1e6;
+        fprintf(stderr, "  worker %u: %u dir(s), %u file(s), %u entr%s, busy %.1f ms (%.0f files/s)\n",
+                i + 1, worker->dirs, worker->files, worker->entries, worker->entries == 1 ? "y" : "ies",
+                worker->busy_us / 1000.0, worker->files / busy);
+    }
+}
+
+// cre8or import [OPTION...] DIR...
+static int cli_run_import(int argc, char *argv[]) {
+    gchar **include = NULL;
+    gchar **exclude = NULL;
+    gchar *icon = NULL;
+    gchar *categories = NULL;
+    gchar *output_dir = NULL;
+    gchar *durability = NULL;
+    gint jobs = 0;
+    gboolean terminal = FALSE;
+    gboolean to_local_apps = FALSE;
+    gboolean force = FALSE;
+    gboolean stats = FALSE;
+    
+    GOptionEntry entries[] = {
+        { "include", 0, 0, G_OPTION_ARG_STRING_ARRAY, &include, "Only import files matching GLOB (repeatable)", "GLOB" },
+        { "exclude", 0, 0, G_OPTION_ARG_STRING_ARRAY, &exclude, "Leave out files and directories matching GLOB (repeatable)", "GLOB" },
+        { "icon", 0, 0, G_OPTION_ARG_FILENAME, &icon, "Icon of every entry", "PATH|NAME" },
+        { "categories", 0, 0, G_OPTION_ARG_STRING, &categories, "Categories of every entry", "LIST" },
+        { "terminal", 0, 0, G_OPTION_ARG_NONE, &terminal, "Run the entries in a terminal", NULL },
+        { "local-apps", 0, 0, G_OPTION_ARG_NONE, &to_local_apps, "Save to the user's local applications", NULL },
+        { "output", 0, 0, G_OPTION_ARG_FILENAME, &output_dir, "Save to a custom (relative) directory", "DIR" },
+        { "force", 0, 0, G_OPTION_ARG_NONE, &force, "Overwrite existing files (default: keep them)", NULL },
+        { "durability", 0, 0, G_OPTION_ARG_STRING, &durability, "none, data or full (default): how much to sync to disk", "LEVEL" },
+        { "jobs", 'j', 0, G_OPTION_ARG_INT, &jobs, "Worker threads (default: one per CPU)", "N" },
+        { "stats", 0, 0, G_OPTION_ARG_NONE, &stats, "Print throughput per worker to stderr", NULL },
+        { NULL, 0, 0, 0, NULL, NULL, NULL }
+    };
+    
+    GOptionContext *context = g_option_context_new("DIR... - create an entry for every executable under directories");
+    g_option_context_add_main_entries(context, entries, NULL);
+    g_option_context_set_description(context,
+        "Globs match the file name or the whole path, e.g. --exclude '*.so' --exclude '*/test/*'.\n"
+        "Without --local-apps or --output the executables found are listed on stdout.");
+    
+    int status = 0;
+    GError *parse_error = NULL;
+    gchar *error_msg = NULL;
+    gchar *target_dir = NULL;
+    GPtrArray *items = NULL;
+    AppImportOptions options;
+    app_import_options_init(&options);
+    FileDurability durability_level = FILE_DURABILITY_FULL;
+    
+    if (!g_option_context_parse(context, &argc, &argv, &parse_error)) {
+        fprintf(stderr, "cre8or: %s\n", parse_error->message);
+        g_error_free(parse_error);
+        status = 2;
+        goto out;
+    }
+    if (argc < 2) {
+        fprintf(stderr, "cre8or: import needs at least one directory\n");
+        status = 2;
+        goto out;
+    }
+    if (jobs < 0) {
+        fprintf(stderr, "cre8or: --jobs must not be negative\n");
+        status = 2;
+        goto out;
+    }
+    if (to_local_apps && output_dir) {
+        fprintf(stderr, "cre8or: --local-apps and --output are mutually exclusive\n");
+        status = 2;
+        goto out;
+    }
+    if (durability && !file_durability_from_string(durability, &durability_level)) {
+        fprintf(stderr, "cre8or: unknown --durability \"%s\" (none, data or full)\n", durability);
+        status = 2;
+        goto out;
+    }
+    if (output_dir && !file_utils_validate_custom_path(output_dir, &error_msg)) {
+        fprintf(stderr, "cre8or: --output: %s\n", error_msg);
+        status = 2;
+        goto out;
+    }
+    if (categories && !cli_parse_categories(&options.categories, categories, &error_msg)) {
+        fprintf(stderr, "cre8or: %s\n", error_msg);
+        status = 2;
+        goto out;
+    }
+    if (categories) {
+        desktop_categories_add_related(&options.categories);
+    }
+    
+    options.include = include;
+    options.exclude = exclude;
+    options.n_threads = jobs;
+    options.terminal = terminal;
+    options.icon = icon;
+    options.install_icons = to_local_apps || output_dir;
+    
+    AppImportStats import_stats;
+    items = app_import_scan((const gchar * const *)argv + 1, &options, &import_stats);
+    
+    target_dir = to_local_apps ? file_utils_get_local_applications_directory() : g_strdup(output_dir);
+    if (!target_dir) {
+        for (guint i = 0; i < items->len; i++) {
+            AppImportItem *item = g_ptr_array_index(items, i);
+            printf("%s\t%s\t%s\n", file_classify_type_name(item->type), item->name, item->path);
+        }
+    }
+    if (stats) {
+        cli_print_import_stats(&import_stats);
+    }
+    g_array_unref(import_stats.workers);
+    
+    if (target_dir && !cli_save_imported(items, target_dir, force, durability_level, stats, &error_msg)) {
+        fprintf(stderr, "cre8or: %s\n", error_msg);
+        status = 1;
+    }
+
+out:
+    if (items) {
+        g_ptr_array_unref(items);
+    }
+    g_free(target_dir);
+    g_free(error_msg);
+    g_option_context_free(context);
+    g_strfreev(include);
+    g_strfreev(exclude);
+    g_free(icon);
+    g_free(categories);
+    g_free(output_dir);
+    g_free(durability);
+    return status;
+}
+
+int cli_run(int argc, char *argv[]) {
+    if (argc > 1 && strcmp(argv[1], "validate") == 0) {
+        return cli_run_validate(argc - 1, argv + 1);
+    }
+    if (argc > 1 && strcmp(argv[1], "import") == 0) {
+        return cli_run_import(argc - 1, argv + 1);
+    }
+    if (argc > 1 && strcmp(argv[1], "client") == 0) {
+        return cli_run_client(argc - 1, argv + 1);
+    }
+    
+    gchar *name = NULL;
+    gchar *comment = NULL;
+    gchar *exec_path = NULL;
+    gchar *icon_path = NULL;
+    gchar *categories = NULL;
+    gchar *output_dir = NULL;
+    gchar *from_path = NULL;
+    gboolean terminal = FALSE;
+    gboolean to_desktop = FALSE;
+    gboolean to_local_apps = FALSE;
+    gboolean force = FALSE;
+    gboolean skip = FALSE;
+    gboolean fail = FALSE;
+    gboolean stats = FALSE;
+    gboolean watch = FALSE;
+    gboolean daemon = FALSE;
+    gchar *socket_path = NULL;
+    gchar **homes = NULL;
+    gboolean all_users = FALSE;
+    gchar *root = NULL;
+    gint jobs = 0;
+    gchar *durability = NULL;
+    
+    GOptionEntry entries[] = {
+        { "from", 0, 0, G_OPTION_ARG_FILENAME, &from_path, "Start from an existing .desktop file", "FILE" },
+        { "name", 0, 0, G_OPTION_ARG_STRING, &name, "Application name (required unless --exec is an AppImage)", "NAME" },
+        { "comment", 0, 0, G_OPTION_ARG_STRING, &comment, "Short description", "TEXT" },
+        { "exec", 0, 0, G_OPTION_ARG_FILENAME, &exec_path, "Executable location (required)", "PATH" },
+        { "icon", 0, 0, G_OPTION_ARG_FILENAME, &icon_path, "Icon file location or icon theme name", "PATH|NAME" },
+        { "categories", 0, 0, G_OPTION_ARG_STRING, &categories, "Categories, e.g. \"Utility;Development\"", "LIST" },
+        { "terminal", 0, 0, G_OPTION_ARG_NONE, &terminal, "Run in terminal", NULL },
+        { "desktop", 0, 0, G_OPTION_ARG_NONE, &to_desktop, "Save to the user's Desktop", NULL },
+        { "local-apps", 0, 0, G_OPTION_ARG_NONE, &to_local_apps, "Save to the user's local applications", NULL },
+        { "output", 0, 0, G_OPTION_ARG_FILENAME, &output_dir, "Save to a custom (relative) directory", "DIR" },
+        { "home", 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &homes, "Save into this home instead of the user's (repeatable)", "DIR" },
+        { "all-users", 0, 0, G_OPTION_ARG_NONE, &all_users, "Save into the home of every regular user", NULL },
+        { "root", 0, 0, G_OPTION_ARG_FILENAME, &root, "Resolve homes inside a staging root", "DIR" },
+        { "jobs", 'j', 0, G_OPTION_ARG_INT, &jobs, "Homes written in parallel (default: one per CPU)", "N" },
+        { "force", 0, 0, G_OPTION_ARG_NONE, &force, "Overwrite existing files", NULL },
+        { "skip", 0, 0, G_OPTION_ARG_NONE, &skip, "Keep existing files and save the rest", NULL },
+        { "fail", 0, 0, G_OPTION_ARG_NONE, &fail, "Fail if a file already exists (default)", NULL },
+        { "durability", 0, 0, G_OPTION_ARG_STRING, &durability, "none, data or full (default): how much to sync to disk", "LEVEL" },
+        { "stats", 0, 0, G_OPTION_ARG_NONE, &stats, "Print timing of the save to stderr", NULL },
+        { "watch", 0, 0, G_OPTION_ARG_NONE, &watch, "Keep the installed applications index up to date until interrupted", NULL },
+        { "daemon", 0, 0, G_OPTION_ARG_NONE, &daemon, "Serve requests on a Unix socket until interrupted (see cre8or client)", NULL },
+        { "socket", 0, 0, G_OPTION_ARG_FILENAME, &socket_path, "Socket of --daemon (default: $XDG_RUNTIME_DIR/cre8or.sock)", "PATH" },
+        { NULL, 0, 0, 0, NULL, NULL, NULL }
+    };
+    
+    GOptionContext *context = g_option_context_new("- create a .desktop file without the wizard");
+    g_option_context_add_main_entries(context, entries, NULL);
+    g_option_context_set_description(context,
+        "Without --desktop, --local-apps or --output the entry is printed to stdout.");
+    
+    int status = 0;
+    GError *parse_error = NULL;
+    gchar *error_msg = NULL;
+    DesktopEntry *entry = NULL;
+    FileSaveOptions *options = NULL;
+    
+    if (!g_option_context_parse(context, &argc, &argv, &parse_error)) {
+        fprintf(stderr, "cre8or: %s\n", parse_error->message);
+        g_error_free(parse_error);
+        status = 2;
+        goto out;
+    }
+    
+    if (watch) {
+        status = cli_run_watch(stats);
+        goto out;
+    }
+    
+    if (daemon) {
+        status = cli_run_daemon(socket_path, stats);
+        goto out;
+    }
+    
+    if ((force ? 1 : 0) + (skip ? 1 : 0) + (fail ? 1 : 0) > 1) {
+        fprintf(stderr, "cre8or: --force, --skip and --fail are mutually exclusive\n");
+        status = 2;
+        goto out;
+    }
+    
+    FileDurability durability_level = FILE_DURABILITY_FULL;
+    if (durability && !file_durability_from_string(durability, &durability_level)) {
+        fprintf(stderr, "cre8or: unknown --durability \"%s\" (none, data or full)\n", durability);
+        status = 2;
+        goto out;
+    }
+    
+    gboolean provisioning = homes || all_users || root;
+    if (provisioning && output_dir) {
+        fprintf(stderr, "cre8or: --output cannot be combined with --home, --all-users or --root\n");
+        status = 2;
+        goto out;
+    }
+    if (provisioning && !to_desktop && !to_local_apps) {
+        fprintf(stderr, "cre8or: --home, --all-users and --root need --desktop or --local-apps\n");
+        status = 2;
+        goto out;
+    }
+    if (jobs < 0) {
+        fprintf(stderr, "cre8or: --jobs must not be negative\n");
+        status = 2;
+        goto out;
+    }
+    
+    entry = desktop_entry_new();
+    
+    // An existing entry provides the defaults; options given override them
+    if (from_path) {
+        GError *load_error = NULL;
+        DesktopDocument *doc = desktop_document_new_from_file(from_path, &load_error);
+        if (!doc) {
+            fprintf(stderr, "cre8or: %s\n", load_error->message);
+            g_error_free(load_error);
+            status = 2;
+            goto out;
+        }
+        gboolean loaded = desktop_document_to_entry(doc, entry, &error_msg);
+        desktop_document_free(doc);
+        if (!loaded) {
+            fprintf(stderr, "cre8or: %s: %s\n", from_path, error_msg);
+            status = 2;
+            goto out;
+        }
+    }
+    
+    if (name) {
+        g_free(entry->name);
+        entry->name = g_strdup(name);
+    }
+    if (comment) {
+        g_free(entry->comment);
+        entry->comment = g_strdup(comment);
+    }
+    if (exec_path) {
+        g_free(entry->exec_path);
+        entry->exec_path = g_strdup(exec_path);
+    }
+    if (icon_path) {
+        g_free(entry->icon_path);
+        entry->icon_path = g_strdup(icon_path);
+    }
+    if (terminal) {
+        entry->terminal = TRUE;
+    }
+    
+    if (categories) {
+        desktop_entry_clear_categories(&entry->categories);
+    }
+    if (categories && !cli_parse_categories(&entry->categories, categories, &error_msg)) {
+        fprintf(stderr, "cre8or: %s\n", error_msg);
+        status = 2;
+        goto out;
+    }
+    if (categories) {
+        // e.g. IDE also needs Development to show up in menus
+        desktop_categories_add_related(&entry->categories);
+    }
+    
+    if (entry->exec_path && file_utils_detect_file_type(entry->exec_path) == FILE_TYPE_APPIMAGE) {
+        // Icons are only installed for the user running the command
+        cli_apply_exec_metadata(entry, (to_desktop || to_local_apps || output_dir) && !provisioning, stats);
+    }
+    
+    if (!desktop_entry_validate(entry, &error_msg)) {
+        fprintf(stderr, "cre8or: %s\n", error_msg);
+        status = 2;
+        goto out;
+    }
+    
+    // A missing executable is only a warning: entries may be provisioned
+    // before the application itself is installed
+    if (!file_utils_validate_executable(entry->exec_path, &error_msg)) {
+        fprintf(stderr, "cre8or: warning: %s\n", error_msg);
+        g_clear_pointer(&error_msg, g_free);
+    }
+    
+    // Icon names are looked up the way the desktop will resolve them; an
+    // unknown one is only a warning too
+    if (icon_index_is_name(entry->icon_path)) {
+        gint64 start_us = g_get_monotonic_time();
+        IconIndex *icons = icon_index_new(NULL, NULL);
+        gchar *icon_file = icon_index_lookup(icons, entry->icon_path, 48);
+        if (!icon_file) {
+            fprintf(stderr, "cre8or: warning: icon \"%s\" was not found in the %s icon theme\n",
+                    entry->icon_path, icon_index_get_theme(icons) ? icon_index_get_theme(icons) : "hicolor");
+        }
+        if (stats) {
+            fprintf(stderr, "icons: %u name(s) indexed, \"%s\" resolved to %s in %.3f ms\n",
+                    icon_index_get_n_icons(icons), entry->icon_path, icon_file ? icon_file : "nothing",
+                    (g_get_monotonic_time() - start_us) / 1000.0);
+        }
+        g_free(icon_file);
+        icon_index_free(icons);
+    }
+    
+    gchar *content = desktop_entry_generate_content(entry);
+    
+    if (provisioning) {
+        HomeProvisionOptions provision_options;
+        home_provision_options_init(&provision_options);
+        provision_options.root = root;
+        provision_options.to_desktop = to_desktop;
+        provision_options.to_local_apps = to_local_apps;
+        provision_options.overwrite_policy = force ? FILE_OVERWRITE_FORCE :
+                                             skip ? FILE_OVERWRITE_SKIP : FILE_OVERWRITE_FAIL;
+        provision_options.durability = durability_level;
+        provision_options.n_threads = jobs;
+        status = cli_provision_homes(content, entry->name, homes, all_users, &provision_options, stats);
+        g_free(content);
+        goto out;
+    }
+    
+    if (!to_desktop && !to_local_apps && !output_dir) {
+        fputs(content, stdout);
+        g_free(content);
+        goto out;
+    }
+    
+    options = file_save_options_new();
+    options->save_to_desktop = to_desktop;
+    options->save_to_local_apps = to_local_apps;
+    options->save_to_custom = output_dir != NULL;
+    options->custom_path = g_strdup(output_dir);
+    options->overwrite_policy = force ? FILE_OVERWRITE_FORCE :
+                                skip ? FILE_OVERWRITE_SKIP : FILE_OVERWRITE_FAIL;
+    options->durability = durability_level;
+    
+    if (!file_utils_save_desktop_file(content, entry->name, options, &error_msg)) {
+        fprintf(stderr, "cre8or: %s\n", error_msg ? g_strchomp(error_msg) : "Failed to save desktop file");
+        status = 1;
+    }
+    g_free(content);
+    
+    for (guint i = 0; options->duplicates && options->duplicates[i] != NULL; i++) {
+        fprintf(stderr, "cre8or: warning: similar entry already installed: %s\n", options->duplicates[i]);
+    }
+    
+    if (stats) {
+        TypeCacheStats cache_stats;
+        type_cache_get_stats(&cache_stats);
+        fprintf(stderr, "type cache: %" G_GUINT64_FORMAT " hit(s), %" G_GUINT64_FORMAT " miss(es)\n",
+                cache_stats.hits, cache_stats.misses);
+    }
+    if (stats && options->write_stats.files > 0) {
+        FileWriterStats *write = &options->write_stats;
+        fprintf(stderr, "write: %u file(s), %" G_GUINT64_FORMAT " bytes in %.3f ms (%s: %u file sync(s), "
+                "%u directory sync(s))\n",
+                write->files, write->bytes, write->elapsed_us / 1000.0,
+                file_durability_to_string(options->durability), write->file_syncs, write->dir_syncs);
+    }
+    if (stats && options->trust_stats.files > 0) {
+        FileTrustStats *trust = &options->trust_stats;
+        fprintf(stderr, "trust: %u/%u file(s) marked in %.3f ms (%.1f us/file)\n",
+                trust->marked, trust->files, trust->elapsed_us / 1000.0,
+                (gdouble)trust->elapsed_us / trust->files);
+    }
+    if (stats) {
+        cli_print_mime_stats();
+    }
+
+out:
+    g_free(error_msg);
+    file_save_options_free(options);
+    desktop_entry_free(entry);
+    g_option_context_free(context);
+    g_free(name);
+    g_free(comment);
+    g_free(exec_path);
+    g_free(icon_path);
+    g_free(categories);
+    g_free(output_dir);
+    g_free(from_path);
+    g_free(durability);
+    g_free(socket_path);
+    g_strfreev(homes);
+    g_free(root);
+    return status;
+}
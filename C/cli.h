@@ -0,0 +1,15 @@
+#ifndef CLI_H
+#define CLI_H
+
+#include <glib.h>
+
+// Headless (non-interactive) command line mode.
+// Never touches GTK, so it works without a display.
+
+// Returns TRUE if the arguments request headless mode
+gboolean cli_is_headless(int argc, char *argv[]);
+
+// Runs headless mode and returns the process exit status
+int cli_run(int argc, char *argv[]);
+
+#endif // CLI_H
@@ -0,0 +1,29 @@
+#ifndef CRE8OR_H
+#define CRE8OR_H
+
+// Public header of libcre8or, the GTK-free core of Cre8or:
+// desktop entry model, parser and generator, file type detection,
+// applications index, icon theme index and save engine.
+// Link with `pkg-config --libs glib-2.0 gio-2.0` and -lcre8or.
+
+#include "desktop_arena.h"
+#include "desktop_categories.h"
+#include "desktop_entry.h"
+#include "desktop_parser.h"
+#include "file_utils.h"
+#include "file_writer.h"
+#include "file_classify.h"
+#include "type_cache.h"
+#include "app_index.h"
+#include "app_watch.h"
+#include "icon_index.h"
+#include "desktop_validate.h"
+#include "app_import.h"
+#include "exec_metadata.h"
+#include "mime_cache.h"
+#include "daemon_client.h"
+#include "daemon_server.h"
+#include "home_provision.h"
+#include "user_dirs.h"
+
+#endif // CRE8OR_H
@@ -0,0 +1,215 @@
+#define _GNU_SOURCE
+#include "daemon_client.h"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define DAEMON_SOCKET_NAME "cre8or.sock"
+#define DAEMON_RECEIVE_SIZE 65536
+
+struct _DaemonClient {
+    int fd;
+    GString *out;             // Queued requests
+    gsize out_sent;
+    GString *in;              // Received replies not read yet, from in_start
+    gsize in_start;
+    guint pending;
+};
+
+gchar* daemon_get_default_socket_path(void) {
+    return g_build_filename(g_get_user_runtime_dir(), DAEMON_SOCKET_NAME, NULL);
+}
+
+DaemonClient* daemon_client_connect(const gchar *socket_path, gchar **error_msg) {
+    gchar *default_path = socket_path ? NULL : daemon_get_default_socket_path();
+    const gchar *path = socket_path ? socket_path : default_path;
+    struct sockaddr_un addr;
+    DaemonClient *client = NULL;
+    
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        *error_msg = g_strdup_printf("Socket path is too long: %s", path);
+        g_free(default_path);
+        return NULL;
+    }
+    strcpy(addr.sun_path, path);
+    
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        *error_msg = g_strdup_printf("Could not connect to the daemon at %s: %s", path, g_strerror(errno));
+        if (fd >= 0) {
+            close(fd);
+        }
+    } else {
+        client = g_new0(DaemonClient, 1);
+        client->fd = fd;
+        client->out = g_string_new(NULL);
+        client->in = g_string_new(NULL);
+    }
+    g_free(default_path);
+    return client;
+}
+
+void daemon_client_free(DaemonClient *client) {
+    if (client) {
+        close(client->fd);
+        g_string_free(client->out, TRUE);
+        g_string_free(client->in, TRUE);
+        g_free(client);
+    }
+}
+
+static void append_escaped(GString *out, const gchar *value) {
+    for (const gchar *p = value; *p; p++) {
+        switch (*p) {
+            case '\\': g_string_append(out, "\\\\"); break;
+            case '\t': g_string_append(out, "\\t"); break;
+            case '\n': g_string_append(out, "\\n"); break;
+            case '\r': g_string_append(out, "\\r"); break;
+            default: g_string_append_c(out, *p); break;
+        }
+    }
+}
+
+void daemon_client_queue(DaemonClient *client, const gchar *command, const gchar * const *fields) {
+    g_string_append(client->out, command);
+    for (guint i = 0; fields && fields[i]; i++) {
+        const gchar *equals = strchr(fields[i], '=');
+        g_string_append_c(client->out, '\t');
+        if (equals) {
+            g_string_append_len(client->out, fields[i], equals - fields[i] + 1);
+            append_escaped(client->out, equals + 1);
+        } else {
+            append_escaped(client->out, fields[i]);
+        }
+    }
+    g_string_append_c(client->out, '\n');
+    client->pending++;
+}
+
+void daemon_client_queue_line(DaemonClient *client, const gchar *line) {
+    g_string_append(client->out, line);
+    if (!g_str_has_suffix(line, "\n")) {
+        g_string_append_c(client->out, '\n');
+    }
+    client->pending++;
+}
+
+guint daemon_client_get_pending(const DaemonClient *client) {
+    return client->pending;
+}
+
+static gboolean receive(DaemonClient *client, gchar **error_msg) {
+    // Drop what was read before growing the buffer
+    if (client->in_start > 0) {
+        g_string_erase(client->in, 0, client->in_start);
+        client->in_start = 0;
+    }
+    
+    gsize old_len = client->in->len;
+    g_string_set_size(client->in, old_len + DAEMON_RECEIVE_SIZE);
+    ssize_t n;
+    do {
+        n = recv(client->fd, client->in->str + old_len, DAEMON_RECEIVE_SIZE, 0);
+    } while (n < 0 && errno == EINTR);
+    g_string_set_size(client->in, old_len + MAX(n, 0));
+    
+    if (n <= 0) {
+        *error_msg = n == 0 ? g_strdup("The daemon closed the connection") :
+                     g_strdup_printf("Could not read from the daemon: %s", g_strerror(errno));
+        return FALSE;
+    }
+    return TRUE;
+}
+
+gboolean daemon_client_flush(DaemonClient *client, gchar **error_msg) {
+    while (client->out_sent < client->out->len) {
+        struct pollfd pfd = { client->fd, POLLIN | POLLOUT, 0 };
+        if (poll(&pfd, 1, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            *error_msg = g_strdup_printf("Could not wait for the daemon: %s", g_strerror(errno));
+            return FALSE;
+        }
+        
+        // Take replies off the socket so the daemon never blocks on us
+        if ((pfd.revents & (POLLIN | POLLHUP)) && !receive(client, error_msg)) {
+            return FALSE;
+        }
+        if (pfd.revents & (POLLOUT | POLLERR)) {
+            ssize_t n = send(client->fd, client->out->str + client->out_sent,
+                             client->out->len - client->out_sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (n < 0 && errno != EINTR && errno != EAGAIN) {
+                *error_msg = g_strdup_printf("Could not send to the daemon: %s", g_strerror(errno));
+                return FALSE;
+            }
+            client->out_sent += MAX(n, 0);
+        }
+    }
+    g_string_truncate(client->out, 0);
+    client->out_sent = 0;
+    return TRUE;
+}
+
+gboolean daemon_client_read_reply(DaemonClient *client, DaemonReply *reply, gchar **error_msg) {
+    memset(reply, 0, sizeof(*reply));
+    if (client->pending == 0) {
+        *error_msg = g_strdup("No request is waiting for a reply");
+        return FALSE;
+    }
+    if (!daemon_client_flush(client, error_msg)) {
+        return FALSE;
+    }
+    
+    for (;;) {
+        const gchar *start = client->in->str + client->in_start;
+        gsize available = client->in->len - client->in_start;
+        const gchar *newline = memchr(start, '\n', available);
+        if (newline) {
+            gchar *header = g_strndup(start, newline - start);
+            gchar status[8];
+            guint64 length;
+            gint64 latency_us;
+            gboolean valid = sscanf(header, "%7s %" G_GUINT64_FORMAT " %" G_GINT64_FORMAT,
+                                    status, &length, &latency_us) == 3;
+            g_free(header);
+            if (!valid) {
+                *error_msg = g_strdup("Malformed reply from the daemon");
+                return FALSE;
+            }
+            
+            gsize header_length = newline - start + 1;
+            if (available - header_length >= length) {
+                reply->ok = strcmp(status, "ok") == 0;
+                reply->body = g_malloc(length + 1);
+                memcpy(reply->body, newline + 1, length);
+                reply->body[length] = '\0';
+                reply->length = length;
+                reply->latency_us = latency_us;
+                client->in_start += header_length + length;
+                client->pending--;
+                return TRUE;
+            }
+        }
+        if (!receive(client, error_msg)) {
+            return FALSE;
+        }
+    }
+}
+
+gboolean daemon_client_call(DaemonClient *client, const gchar *command, const gchar * const *fields,
+                            DaemonReply *reply, gchar **error_msg) {
+    daemon_client_queue(client, command, fields);
+    return daemon_client_read_reply(client, reply, error_msg);
+}
+
+void daemon_reply_clear(DaemonReply *reply) {
+    g_free(reply->body);
+    memset(reply, 0, sizeof(*reply));
+}
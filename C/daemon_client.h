@@ -0,0 +1,61 @@
+#ifndef DAEMON_CLIENT_H
+#define DAEMON_CLIENT_H
+
+#include <glib.h>
+
+// Client of the cre8or daemon (see daemon_server.h).
+//
+// Protocol, over a Unix stream socket. A request is one line:
+//
+//     COMMAND<TAB>KEY=VALUE<TAB>KEY=VALUE...<LF>
+//
+// with backslash, tab, newline and carriage return in values escaped as
+// \\, \t, \n and \r, like desktop entry values. Requests may be pipelined;
+// replies come back in request order, each a header line followed by a
+// body of exactly LENGTH bytes:
+//
+//     ok|error<SPACE>LENGTH<SPACE>LATENCY_US<LF>BODY
+//
+// LATENCY_US is the time from the request being read to its reply being
+// queued, including time spent waiting for earlier requests of the batch.
+
+typedef struct _DaemonClient DaemonClient;
+
+typedef struct {
+    gboolean ok;
+    gchar *body;              // NUL-terminated
+    gsize length;
+    gint64 latency_us;
+} DaemonReply;
+
+// $XDG_RUNTIME_DIR/cre8or.sock
+gchar* daemon_get_default_socket_path(void);
+
+// Connects to socket_path (NULL = the default path)
+DaemonClient* daemon_client_connect(const gchar *socket_path, gchar **error_msg);
+void daemon_client_free(DaemonClient *client);
+
+// Queues a request without sending it. fields are "KEY=VALUE" strings,
+// NULL-terminated; values are escaped here.
+void daemon_client_queue(DaemonClient *client, const gchar *command, const gchar * const *fields);
+
+// Queues a request already in protocol form; a missing newline is added
+void daemon_client_queue_line(DaemonClient *client, const gchar *line);
+
+// Sends everything queued. Replies that arrive meanwhile are buffered, so
+// any number of requests can be pipelined without deadlocking.
+gboolean daemon_client_flush(DaemonClient *client, gchar **error_msg);
+
+// Requests sent or queued whose replies have not been read
+guint daemon_client_get_pending(const DaemonClient *client);
+
+// Flushes and waits for the reply to the oldest pending request
+gboolean daemon_client_read_reply(DaemonClient *client, DaemonReply *reply, gchar **error_msg);
+
+// Queues one request and waits for its reply
+gboolean daemon_client_call(DaemonClient *client, const gchar *command, const gchar * const *fields,
+                            DaemonReply *reply, gchar **error_msg);
+
+void daemon_reply_clear(DaemonReply *reply);
+
+#endif // DAEMON_CLIENT_H
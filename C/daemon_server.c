@@ -0,0 +1,776 @@
+#define _GNU_SOURCE
+#include "daemon_server.h"
+#include "daemon_client.h"
+#include "app_watch.h"
+#include "desktop_entry.h"
+#include "desktop_parser.h"
+#include "desktop_validate.h"
+#include "exec_metadata.h"
+#include "file_utils.h"
+#include "icon_index.h"
+#include "mime_cache.h"
+#include <glib-unix.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define DAEMON_MAX_REQUEST (1024 * 1024)      // Longest request line accepted
+#define DAEMON_MAX_QUEUED (4 * 1024 * 1024)   // Unsent reply bytes before a connection stops being read
+#define DAEMON_READ_SIZE 65536
+#define DAEMON_LATENCY_SAMPLES 4096           // Latest latencies kept per command
+#define DAEMON_WATCH_FLUSH_MS 500
+
+typedef enum {
+    DAEMON_COMMAND_GENERATE,
+    DAEMON_COMMAND_VALIDATE,
+    DAEMON_COMMAND_SAVE,
+    DAEMON_COMMAND_STATS,
+    DAEMON_N_COMMANDS
+} DaemonCommand;
+
+static const gchar *command_names[DAEMON_N_COMMANDS] = { "generate", "validate", "save", "stats" };
+
+typedef struct {
+    guint64 requests;
+    guint64 errors;
+    gint64 total_us;
+    gint64 max_us;
+    gint64 samples[DAEMON_LATENCY_SAMPLES];  // Ring of the latest latencies
+    guint n_samples;
+    guint next_sample;
+} CommandStats;
+
+typedef struct {
+    DaemonServer *server;
+    int fd;
+    guint read_source;        // 0 once the peer hung up or while replies back up
+    guint write_source;       // Set while replies wait for the socket
+    GString *in;
+    GString *out;
+    gsize out_sent;
+    guint pending;            // Requests read but not answered yet
+    gboolean eof;             // The peer will send no more requests
+    gboolean closed;          // Freed once nothing is pending
+} DaemonConnection;
+
+typedef struct {
+    DaemonConnection *connection;
+    gchar *command;
+    GHashTable *fields;       // Key -> unescaped value
+    gint64 received_us;
+} DaemonRequest;
+
+struct _DaemonServer {
+    gchar *socket_path;
+    int fd;
+    guint accept_source;
+    GHashTable *connections;  // Open DaemonConnection*
+    GQueue requests;          // DaemonRequest* of the next batch
+    guint batch_source;
+    AppWatch *watch;          // NULL when the directories cannot be watched
+    IconIndex *icons;         // Built by the first request that needs it
+    DesktopValidator *validator;
+    CommandStats *commands;   // DAEMON_N_COMMANDS of them
+    DaemonServerStats stats;
+    gchar *mime_error;        // Of the last failed rewrite
+};
+
+static void connection_flush(DaemonConnection *connection);
+
+// Requests
+
+static void request_free(DaemonRequest *request) {
+    g_free(request->command);
+    g_hash_table_destroy(request->fields);
+    g_free(request);
+}
+
+// Splits a request line into its command and KEY=VALUE fields; a field
+// without = is a flag and reads as true
+static DaemonRequest* request_parse(DaemonConnection *connection, const gchar *line, gsize length) {
+    DaemonRequest *request = g_new0(DaemonRequest, 1);
+    request->connection = connection;
+    request->fields = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    request->received_us = g_get_monotonic_time();
+    
+    if (length > 0 && line[length - 1] == '\r') {
+        length--;
+    }
+    gchar *copy = g_strndup(line, length);
+    gchar **parts = g_strsplit(copy, "\t", -1);
+    request->command = g_strdup(parts[0] ? parts[0] : "");
+    for (guint i = 1; parts[0] && parts[i]; i++) {
+        gchar *equals = strchr(parts[i], '=');
+        if (parts[i][0] == '\0') {
+            continue;
+        }
+        if (!equals) {
+            g_hash_table_replace(request->fields, g_strdup(parts[i]), g_strdup("true"));
+            continue;
+        }
+        DesktopSpan value = { equals + 1, strlen(equals + 1) };
+        g_hash_table_replace(request->fields, g_strndup(parts[i], equals - parts[i]),
+                             desktop_span_unescape(value, FALSE));
+    }
+    g_strfreev(parts);
+    g_free(copy);
+    return request;
+}
+
+static const gchar* request_get(const DaemonRequest *request, const gchar *key) {
+    return g_hash_table_lookup(request->fields, key);
+}
+
+static gboolean request_get_boolean(const DaemonRequest *request, const gchar *key) {
+    const gchar *value = request_get(request, key);
+    return value && (strcmp(value, "true") == 0 || strcmp(value, "1") == 0);
+}
+
+static void set_field(gchar **field, const gchar *value) {
+    if (value) {
+        g_free(*field);
+        *field = g_strdup(value);
+    }
+}
+
+static gboolean parse_categories(DesktopCategories *categories, const gchar *list, gchar **error_msg) {
+    gchar **names = g_strsplit_set(list, ";,", -1);
+    gboolean ok = TRUE;
+    for (gchar **name = names; *name && ok; name++) {
+        g_strstrip(*name);
+        if ((*name)[0] != '\0' && !desktop_entry_set_category(categories, *name, TRUE)) {
+            *error_msg = g_strdup_printf("Unknown category: %s", *name);
+            ok = FALSE;
+        }
+    }
+    g_strfreev(names);
+    return ok;
+}
+
+// Builds the entry a request describes, like the command line does.
+// Checks that only warn (a missing executable or icon) are made when
+// warnings is given.
+static DesktopEntry* request_to_entry(DaemonServer *server, const DaemonRequest *request, gboolean saving,
+                                      GString *warnings, gchar **error_msg) {
+    DesktopEntry *entry = desktop_entry_new();
+    
+    const gchar *from = request_get(request, "from");
+    if (from) {
+        GError *load_error = NULL;
+        DesktopDocument *doc = desktop_document_new_from_file(from, &load_error);
+        if (!doc) {
+            *error_msg = g_strdup(load_error->message);
+            g_error_free(load_error);
+            goto fail;
+        }
+        gboolean loaded = desktop_document_to_entry(doc, entry, error_msg);
+        desktop_document_free(doc);
+        if (!loaded) {
+            goto fail;
+        }
+    }
+    
+    set_field(&entry->name, request_get(request, "name"));
+    set_field(&entry->comment, request_get(request, "comment"));
+    set_field(&entry->exec_path, request_get(request, "exec"));
+    set_field(&entry->icon_path, request_get(request, "icon"));
+    if (request_get(request, "terminal")) {
+        entry->terminal = request_get_boolean(request, "terminal");
+    }
+    
+    const gchar *categories = request_get(request, "categories");
+    if (categories) {
+        desktop_entry_clear_categories(&entry->categories);
+        if (!parse_categories(&entry->categories, categories, error_msg)) {
+            goto fail;
+        }
+        desktop_categories_add_related(&entry->categories);
+    }
+    
+    // AppImages fill in what was not given; the icon is installed only
+    // when saving
+    if (entry->exec_path && file_utils_detect_file_type(entry->exec_path) == FILE_TYPE_APPIMAGE) {
+        gboolean need_icon = !entry->icon_path || entry->icon_path[0] == '\0';
+        gchar *meta_error = NULL;
+        ExecMetadata *meta = exec_metadata_read(entry->exec_path,
+                                                saving && need_icon ? EXEC_METADATA_INSTALL_ICON : 0,
+                                                &meta_error);
+        if (meta) {
+            exec_metadata_apply(meta, entry);
+            if (meta->icon_error && warnings) {
+                g_string_append_printf(warnings, "warning: %s\n", meta->icon_error);
+            }
+            exec_metadata_free(meta);
+        } else {
+            if (warnings) {
+                g_string_append_printf(warnings, "warning: %s\n", meta_error);
+            }
+            g_free(meta_error);
+        }
+    }
+    
+    if (!desktop_entry_validate(entry, error_msg)) {
+        goto fail;
+    }
+    
+    if (warnings) {
+        gchar *exec_error = NULL;
+        if (!file_utils_validate_executable(entry->exec_path, &exec_error)) {
+            g_string_append_printf(warnings, "warning: %s\n", exec_error);
+            g_free(exec_error);
+        }
+        if (icon_index_is_name(entry->icon_path)) {
+            if (!server->icons) {
+                server->icons = icon_index_new(NULL, NULL);
+            }
+            gchar *icon_file = icon_index_lookup(server->icons, entry->icon_path, 48);
+            if (!icon_file) {
+                const gchar *theme = icon_index_get_theme(server->icons);
+                g_string_append_printf(warnings, "warning: icon \"%s\" was not found in the %s icon theme\n",
+                                       entry->icon_path, theme ? theme : "hicolor");
+            }
+            g_free(icon_file);
+        }
+    }
+    return entry;
+
+fail:
+    desktop_entry_free(entry);
+    return NULL;
+}
+
+// Commands. Each fills body and returns whether the request succeeded.
+
+static gboolean command_generate(DaemonServer *server, const DaemonRequest *request, GString *body) {
+    gchar *error_msg = NULL;
+    DesktopEntry *entry = request_to_entry(server, request, FALSE, NULL, &error_msg);
+    if (!entry) {
+        g_string_append(body, error_msg);
+        g_free(error_msg);
+        return FALSE;
+    }
+    gchar *content = desktop_entry_generate_content(entry);
+    g_string_append(body, content);
+    g_free(content);
+    desktop_entry_free(entry);
+    return TRUE;
+}
+
+static gboolean command_validate(DaemonServer *server, const DaemonRequest *request, GString *body) {
+    gchar *data = NULL;
+    gsize length = 0;
+    const gchar *path = request_get(request, "path");
+    
+    if (path) {
+        GError *read_error = NULL;
+        if (!g_file_get_contents(path, &data, &length, &read_error)) {
+            g_string_append(body, read_error->message);
+            g_error_free(read_error);
+            return FALSE;
+        }
+    } else {
+        gchar *error_msg = NULL;
+        DesktopEntry *entry = request_to_entry(server, request, FALSE, body, &error_msg);
+        if (!entry) {
+            g_string_append(body, error_msg);
+            g_free(error_msg);
+            return FALSE;
+        }
+        data = desktop_entry_generate_content(entry);
+        length = strlen(data);
+        desktop_entry_free(entry);
+    }
+    
+    GArray *issues = desktop_issues_new();
+    guint n_errors = desktop_validator_check(server->validator, data, length, issues);
+    for (guint i = 0; i < issues->len; i++) {
+        DesktopIssue *issue = &g_array_index(issues, DesktopIssue, i);
+        g_string_append_printf(body, "%u: %s: %s\n", issue->line,
+                               desktop_issue_level_to_string(issue->level), issue->message);
+    }
+    g_array_unref(issues);
+    g_free(data);
+    return n_errors == 0;
+}
+
+static gboolean command_save(DaemonServer *server, const DaemonRequest *request, GString *body) {
+    FileSaveOptions *options = file_save_options_new();
+    const gchar *output = request_get(request, "output");
+    const gchar *overwrite = request_get(request, "overwrite");
+    const gchar *durability = request_get(request, "durability");
+    gchar *error_msg = NULL;
+    gboolean success = FALSE;
+    
+    options->save_to_desktop = request_get_boolean(request, "desktop");
+    options->save_to_local_apps = request_get_boolean(request, "local-apps");
+    options->save_to_custom = output != NULL;
+    options->custom_path = g_strdup(output);
+    options->overwrite_policy = FILE_OVERWRITE_FAIL;
+    if (overwrite && strcmp(overwrite, "force") == 0) {
+        options->overwrite_policy = FILE_OVERWRITE_FORCE;
+    } else if (overwrite && strcmp(overwrite, "skip") == 0) {
+        options->overwrite_policy = FILE_OVERWRITE_SKIP;
+    } else if (overwrite && strcmp(overwrite, "fail") != 0) {
+        g_string_append_printf(body, "Unknown overwrite policy \"%s\" (force, skip or fail)", overwrite);
+        goto out;
+    }
+    if (durability && !file_durability_from_string(durability, &options->durability)) {
+        g_string_append_printf(body, "Unknown durability \"%s\" (none, data or full)", durability);
+        goto out;
+    }
+    if (!options->save_to_desktop && !options->save_to_local_apps && !options->save_to_custom) {
+        g_string_append(body, "save needs desktop, local-apps or output");
+        goto out;
+    }
+    
+    DesktopEntry *entry = request_to_entry(server, request, TRUE, body, &error_msg);
+    if (!entry) {
+        g_string_append(body, error_msg);
+        goto out;
+    }
+    gchar *content = desktop_entry_generate_content(entry);
+    success = file_utils_save_desktop_file(content, entry->name, options, &error_msg);
+    if (!success) {
+        g_string_append(body, error_msg ? g_strchomp(error_msg) : "Failed to save desktop file");
+    }
+    for (guint i = 0; success && options->duplicates && options->duplicates[i]; i++) {
+        g_string_append_printf(body, "duplicate: %s\n", options->duplicates[i]);
+    }
+    g_free(content);
+    desktop_entry_free(entry);
+
+out:
+    g_free(error_msg);
+    file_save_options_free(options);
+    return success;
+}
+
+static gint compare_latency(gconstpointer a, gconstpointer b) {
+    gint64 x = *(const gint64*)a;
+    gint64 y = *(const gint64*)b;
+    return x < y ? -1 : x > y;
+}
+
+gchar* daemon_server_format_stats(const DaemonServer *server) {
+    GString *out = g_string_new(NULL);
+    g_string_append_printf(out, "requests: %" G_GUINT64_FORMAT " in %" G_GUINT64_FORMAT " batch(es), "
+                           "largest %u, %" G_GUINT64_FORMAT " connection(s)\n",
+                           server->stats.requests, server->stats.batches, server->stats.largest_batch,
+                           server->stats.connections);
+    if (server->stats.mime_errors > 0) {
+        g_string_append_printf(out, "mimeinfo.cache: %" G_GUINT64_FORMAT " failed rewrite(s), last: %s\n",
+                               server->stats.mime_errors, server->mime_error ? server->mime_error : "unknown");
+    }
+    
+    gint64 *sorted = g_new(gint64, DAEMON_LATENCY_SAMPLES);
+    for (guint i = 0; i < DAEMON_N_COMMANDS; i++) {
+        const CommandStats *command = &server->commands[i];
+        if (command->requests == 0) {
+            continue;
+        }
+        // Percentiles of the latest samples
+        memcpy(sorted, command->samples, command->n_samples * sizeof(gint64));
+        qsort(sorted, command->n_samples, sizeof(gint64), compare_latency);
+        g_string_append_printf(out, "%s: %" G_GUINT64_FORMAT " request(s), %" G_GUINT64_FORMAT " error(s), "
+                               "latency mean %.0f us, p50 %" G_GINT64_FORMAT " us, p99 %" G_GINT64_FORMAT
+                               " us, max %" G_GINT64_FORMAT " us\n",
+                               command_names[i], command->requests, command->errors,
+                               (gdouble)command->total_us / command->requests,
+                               sorted[command->n_samples / 2], sorted[command->n_samples * 99 / 100],
+                               command->max_us);
+    }
+    g_free(sorted);
+    return g_string_free(out, FALSE);
+}
+
+static void record_latency(CommandStats *command, gboolean ok, gint64 latency_us) {
+    command->requests++;
+    command->errors += ok ? 0 : 1;
+    command->total_us += latency_us;
+    command->max_us = MAX(command->max_us, latency_us);
+    command->samples[command->next_sample] = latency_us;
+    command->next_sample = (command->next_sample + 1) % DAEMON_LATENCY_SAMPLES;
+    command->n_samples = MIN(command->n_samples + 1, DAEMON_LATENCY_SAMPLES);
+}
+
+static void request_answer(DaemonServer *server, DaemonRequest *request) {
+    GString *body = g_string_new(NULL);
+    gint command = -1;
+    for (guint i = 0; i < DAEMON_N_COMMANDS; i++) {
+        if (strcmp(request->command, command_names[i]) == 0) {
+            command = i;
+        }
+    }
+    
+    gboolean ok = FALSE;
+    switch (command) {
+        case DAEMON_COMMAND_GENERATE:
+            ok = command_generate(server, request, body);
+            break;
+        case DAEMON_COMMAND_VALIDATE:
+            ok = command_validate(server, request, body);
+            break;
+        case DAEMON_COMMAND_SAVE:
+            ok = command_save(server, request, body);
+            break;
+        case DAEMON_COMMAND_STATS: {
+            gchar *stats = daemon_server_format_stats(server);
+            g_string_append(body, stats);
+            g_free(stats);
+            ok = TRUE;
+            break;
+        }
+        default:
+            g_string_append_printf(body, "Unknown command \"%s\" (generate, validate, save or stats)",
+                                   request->command);
+            break;
+    }
+    
+    gint64 latency_us = g_get_monotonic_time() - request->received_us;
+    if (command >= 0) {
+        record_latency(&server->commands[command], ok, latency_us);
+    }
+    
+    DaemonConnection *connection = request->connection;
+    if (!connection->closed) {
+        g_string_append_printf(connection->out, "%s %" G_GSIZE_FORMAT " %" G_GINT64_FORMAT "\n",
+                               ok ? "ok" : "error", body->len, latency_us);
+        g_string_append_len(connection->out, body->str, body->len);
+    }
+    connection->pending--;
+    g_string_free(body, TRUE);
+}
+
+// Connections
+
+static void connection_free(DaemonConnection *connection) {
+    g_string_free(connection->in, TRUE);
+    g_string_free(connection->out, TRUE);
+    g_free(connection);
+}
+
+// Stops serving the connection. Its queued requests still run, without
+// replies, and the last one frees it.
+static void connection_close(DaemonConnection *connection) {
+    if (connection->closed) {
+        return;
+    }
+    if (connection->read_source) {
+        g_source_remove(connection->read_source);
+    }
+    if (connection->write_source) {
+        g_source_remove(connection->write_source);
+    }
+    close(connection->fd);
+    connection->closed = TRUE;
+    g_hash_table_remove(connection->server->connections, connection);
+    if (connection->pending == 0) {
+        connection_free(connection);
+    }
+}
+
+static gboolean process_batch(gpointer user_data);
+static gboolean connection_readable(gint fd, GIOCondition condition, gpointer user_data);
+
+static void schedule_batch(DaemonServer *server) {
+    // Runs in the next main loop iteration, so everything that is readable
+    // by then joins the batch
+    if (!server->batch_source && server->requests.length > 0) {
+        server->batch_source = g_idle_add_full(G_PRIORITY_DEFAULT, process_batch, server, NULL);
+    }
+}
+
+static gboolean connection_writable(gint fd, GIOCondition condition, gpointer user_data) {
+    (void)fd;  // Suppress unused parameter warning
+    (void)condition;  // Suppress unused parameter warning
+    DaemonConnection *connection = user_data;
+    connection->write_source = 0;
+    connection_flush(connection);
+    return G_SOURCE_REMOVE;
+}
+
+// Sends as much of the queued replies as the socket takes, and resumes
+// reading once they no longer back up
+static void connection_flush(DaemonConnection *connection) {
+    while (connection->out_sent < connection->out->len) {
+        ssize_t n = send(connection->fd, connection->out->str + connection->out_sent,
+                         connection->out->len - connection->out_sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && errno == EAGAIN) {
+            if (!connection->write_source) {
+                connection->write_source = g_unix_fd_add(connection->fd, G_IO_OUT, connection_writable,
+                                                         connection);
+            }
+            return;
+        }
+        if (n < 0) {
+            connection_close(connection);
+            return;
+        }
+        connection->out_sent += n;
+    }
+    g_string_truncate(connection->out, 0);
+    connection->out_sent = 0;
+    
+    if (connection->eof && connection->pending == 0) {
+        connection_close(connection);
+    } else if (!connection->eof && !connection->read_source) {
+        connection->read_source = g_unix_fd_add(connection->fd, G_IO_IN, connection_readable, connection);
+    }
+}
+
+static gboolean connection_readable(gint fd, GIOCondition condition, gpointer user_data) {
+    (void)condition;  // Suppress unused parameter warning
+    DaemonConnection *connection = user_data;
+    DaemonServer *server = connection->server;
+    
+    gsize old_len = connection->in->len;
+    g_string_set_size(connection->in, old_len + DAEMON_READ_SIZE);
+    ssize_t n = recv(fd, connection->in->str + old_len, DAEMON_READ_SIZE, MSG_DONTWAIT);
+    g_string_set_size(connection->in, old_len + MAX(n, 0));
+    if (n < 0 && (errno == EINTR || errno == EAGAIN)) {
+        return G_SOURCE_CONTINUE;
+    }
+    if (n < 0) {
+        connection->read_source = 0;
+        connection_close(connection);
+        return G_SOURCE_REMOVE;
+    }
+    
+    // Every complete line is a request
+    gsize start = 0;
+    const gchar *newline;
+    while ((newline = memchr(connection->in->str + start, '\n', connection->in->len - start))) {
+        gsize length = newline - (connection->in->str + start);
+        g_queue_push_tail(&server->requests, request_parse(connection, connection->in->str + start, length));
+        connection->pending++;
+        server->stats.requests++;
+        start += length + 1;
+    }
+    g_string_erase(connection->in, 0, start);
+    schedule_batch(server);
+    
+    if (connection->in->len > DAEMON_MAX_REQUEST) {
+        connection->read_source = 0;
+        connection_close(connection);
+        return G_SOURCE_REMOVE;
+    }
+    if (n == 0) {
+        // Answer what was sent, then close
+        connection->eof = TRUE;
+        connection->read_source = 0;
+        if (connection->pending == 0) {
+            connection_close(connection);
+        }
+        return G_SOURCE_REMOVE;
+    }
+    if (connection->out->len - connection->out_sent > DAEMON_MAX_QUEUED) {
+        // The peer is not reading its replies; wait until it catches up
+        connection->read_source = 0;
+        return G_SOURCE_REMOVE;
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean process_batch(gpointer user_data) {
+    DaemonServer *server = user_data;
+    server->batch_source = 0;
+    server->stats.batches++;
+    server->stats.largest_batch = MAX(server->stats.largest_batch, server->requests.length);
+    
+    // One look at the applications directories for the whole batch, and
+    // one mimeinfo.cache rewrite for all of its saves
+    if (server->watch) {
+        app_watch_process(server->watch);
+    }
+    mime_cache_begin_batch();
+    
+    GPtrArray *touched = g_ptr_array_new();
+    DaemonRequest *request;
+    while ((request = g_queue_pop_head(&server->requests))) {
+        if (!g_ptr_array_find(touched, request->connection, NULL)) {
+            g_ptr_array_add(touched, request->connection);
+        }
+        request_answer(server, request);
+        request_free(request);
+    }
+    
+    // The saves were already answered, so a cache that could not be
+    // rewritten shows in the stats. It is scanned again by the next save
+    // to that directory rather than updated from the stale file.
+    gchar *mime_error = NULL;
+    if (!mime_cache_end_batch(&mime_error)) {
+        server->stats.mime_errors++;
+        g_free(server->mime_error);
+        server->mime_error = mime_error;
+    }
+    
+    for (guint i = 0; i < touched->len; i++) {
+        DaemonConnection *connection = g_ptr_array_index(touched, i);
+        if (connection->closed) {
+            if (connection->pending == 0) {
+                connection_free(connection);
+            }
+        } else {
+            connection_flush(connection);
+        }
+    }
+    g_ptr_array_free(touched, TRUE);
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean server_accept(gint fd, GIOCondition condition, gpointer user_data) {
+    (void)condition;  // Suppress unused parameter warning
+    DaemonServer *server = user_data;
+    int client_fd;
+    while ((client_fd = accept4(fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+        DaemonConnection *connection = g_new0(DaemonConnection, 1);
+        connection->server = server;
+        connection->fd = client_fd;
+        connection->in = g_string_new(NULL);
+        connection->out = g_string_new(NULL);
+        connection->read_source = g_unix_fd_add(client_fd, G_IO_IN, connection_readable, connection);
+        g_hash_table_add(server->connections, connection);
+        server->stats.connections++;
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+// Server
+
+DaemonServer* daemon_server_new(const gchar *socket_path, gchar **error_msg) {
+    gchar *path = socket_path ? g_strdup(socket_path) : daemon_get_default_socket_path();
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        *error_msg = g_strdup_printf("Socket path is too long: %s", path);
+        g_free(path);
+        return NULL;
+    }
+    strcpy(addr.sun_path, path);
+    
+    // Never take the socket over from a daemon that still answers
+    gchar *connect_error = NULL;
+    DaemonClient *other = daemon_client_connect(path, &connect_error);
+    g_free(connect_error);
+    if (other) {
+        daemon_client_free(other);
+        *error_msg = g_strdup_printf("A daemon is already listening on %s", path);
+        g_free(path);
+        return NULL;
+    }
+    
+    struct stat st;
+    if (lstat(path, &st) == 0 && !S_ISSOCK(st.st_mode)) {
+        *error_msg = g_strdup_printf("%s exists and is not a socket", path);
+        g_free(path);
+        return NULL;
+    }
+    unlink(path);
+    
+    gchar *dir = g_path_get_dirname(path);
+    gboolean have_dir = file_utils_ensure_directory_exists(dir, error_msg);
+    g_free(dir);
+    if (!have_dir) {
+        g_free(path);
+        return NULL;
+    }
+    
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    // Only the user may connect: the daemon writes files as them
+    mode_t old_umask = umask(0077);
+    gboolean listening = fd >= 0 && bind(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0 &&
+                         listen(fd, SOMAXCONN) == 0;
+    umask(old_umask);
+    if (!listening) {
+        *error_msg = g_strdup_printf("Could not listen on %s: %s", path, g_strerror(errno));
+        if (fd >= 0) {
+            close(fd);
+        }
+        g_free(path);
+        return NULL;
+    }
+    
+    DaemonServer *server = g_new0(DaemonServer, 1);
+    server->socket_path = path;
+    server->fd = fd;
+    server->connections = g_hash_table_new(NULL, NULL);
+    g_queue_init(&server->requests);
+    server->validator = desktop_validator_new();
+    server->commands = g_new0(CommandStats, DAEMON_N_COMMANDS);
+    
+    // Scan the installed entries now rather than on the first save, and
+    // keep them current; saves find the watch through the default
+    gchar *watch_error = NULL;
+    server->watch = app_watch_new_default(&watch_error);
+    g_free(watch_error);
+    if (server->watch) {
+        app_watch_attach(server->watch, DAEMON_WATCH_FLUSH_MS);
+        AppWatch *current = app_watch_dup_default();
+        if (!current) {
+            app_watch_set_default(server->watch);
+        }
+        app_watch_unref(current);
+    }
+    
+    server->accept_source = g_unix_fd_add(fd, G_IO_IN, server_accept, server);
+    return server;
+}
+
+void daemon_server_free(DaemonServer *server) {
+    if (!server) {
+        return;
+    }
+    g_source_remove(server->accept_source);
+    if (server->batch_source) {
+        g_source_remove(server->batch_source);
+    }
+    
+    // Unanswered requests are dropped with their connections
+    DaemonRequest *request;
+    while ((request = g_queue_pop_head(&server->requests))) {
+        DaemonConnection *connection = request->connection;
+        if (--connection->pending == 0 && connection->closed) {
+            connection_free(connection);
+        }
+        request_free(request);
+    }
+    GList *connections = g_hash_table_get_keys(server->connections);
+    for (GList *iter = connections; iter; iter = iter->next) {
+        connection_close(iter->data);
+    }
+    g_list_free(connections);
+    g_hash_table_destroy(server->connections);
+    
+    close(server->fd);
+    unlink(server->socket_path);
+    
+    if (server->watch) {
+        gchar *flush_error = NULL;
+        if (!app_watch_flush(server->watch, &flush_error)) {
+            g_free(flush_error);
+        }
+        app_watch_free(server->watch);
+    }
+    icon_index_free(server->icons);
+    desktop_validator_free(server->validator);
+    g_free(server->commands);
+    g_free(server->mime_error);
+    g_free(server->socket_path);
+    g_free(server);
+}
+
+const gchar* daemon_server_get_socket_path(const DaemonServer *server) {
+    return server->socket_path;
+}
+
+void daemon_server_get_stats(const DaemonServer *server, DaemonServerStats *stats) {
+    *stats = server->stats;
+}
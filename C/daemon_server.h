@@ -0,0 +1,61 @@
+#ifndef DAEMON_SERVER_H
+#define DAEMON_SERVER_H
+
+#include <glib.h>
+
+// Long-running daemon that serves entry generation over a Unix socket.
+// One process keeps the caches a command line run has to rebuild every
+// time: the file type cache, the icon theme index and, through a watch on
+// the applications directories, the installed-entry index used for
+// duplicate and overwrite checks. The protocol is described in
+// daemon_client.h.
+//
+// Requests read from all connections in one main loop iteration form a
+// batch and are answered in order. The installed-entry index is brought
+// up to date once per batch, and the mimeinfo.cache rewrites of the
+// batch's saves are coalesced into one.
+//
+// Commands and their keys:
+//
+//   generate  name, comment, exec, icon, categories, terminal (true/false),
+//             from (an existing entry providing the defaults). The body is
+//             the generated entry.
+//   validate  The generate keys, or path (a file to check). The body
+//             lists "warning: MESSAGE" lines and "LINE: LEVEL: MESSAGE"
+//             issues; the reply is an error when there are errors.
+//   save      The generate keys plus desktop, local-apps (true/false),
+//             output (a directory), overwrite (force, skip or fail) and
+//             durability (none, data or full). The body lists
+//             "warning: MESSAGE" and "duplicate: PATH" lines.
+//   stats     Request counts and latencies per command.
+//
+// A failed request's body is the error message.
+//
+// Everything runs on the thread of the default main context.
+
+typedef struct _DaemonServer DaemonServer;
+
+typedef struct {
+    guint64 connections;      // Accepted so far
+    guint64 requests;
+    guint64 batches;
+    guint largest_batch;
+    guint64 mime_errors;      // Batches whose mimeinfo.cache rewrite failed
+} DaemonServerStats;
+
+// Listens on socket_path (NULL = daemon_get_default_socket_path()) and
+// serves from the default main context. Fails if another daemon already
+// answers there; a stale socket is replaced.
+DaemonServer* daemon_server_new(const gchar *socket_path, gchar **error_msg);
+
+// Stops listening, drops the connections and removes the socket
+void daemon_server_free(DaemonServer *server);
+
+const gchar* daemon_server_get_socket_path(const DaemonServer *server);
+
+void daemon_server_get_stats(const DaemonServer *server, DaemonServerStats *stats);
+
+// Per-command request counts and latency percentiles, one line each
+gchar* daemon_server_format_stats(const DaemonServer *server);
+
+#endif // DAEMON_SERVER_H
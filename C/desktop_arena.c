@@ -0,0 +1,99 @@
+#include "desktop_arena.h"
+#include <string.h>
+
+#define DESKTOP_ARENA_DEFAULT_CHUNK (64 * 1024)
+#define DESKTOP_ARENA_ALIGN 16
+
+typedef struct _DesktopArenaChunk DesktopArenaChunk;
+
+struct _DesktopArenaChunk {
+    DesktopArenaChunk *next;
+    gsize size;
+    gsize used;
+    gsize padding;            // Keeps data aligned to DESKTOP_ARENA_ALIGN
+    gchar data[];
+};
+
+struct _DesktopArena {
+    DesktopArenaChunk *chunks;  // Current chunk first
+    gsize chunk_size;
+    gsize used;
+};
+
+static DesktopArenaChunk* arena_chunk_new(gsize size) {
+    DesktopArenaChunk *chunk = g_malloc(sizeof(DesktopArenaChunk) + size);
+    chunk->next = NULL;
+    chunk->size = size;
+    chunk->used = 0;
+    return chunk;
+}
+
+DesktopArena* desktop_arena_new(gsize chunk_size) {
+    DesktopArena *arena = g_new0(DesktopArena, 1);
+    arena->chunk_size = chunk_size > 0 ? chunk_size : DESKTOP_ARENA_DEFAULT_CHUNK;
+    arena->chunks = arena_chunk_new(arena->chunk_size);
+    return arena;
+}
+
+static void arena_free_chunks(DesktopArenaChunk *chunk) {
+    while (chunk) {
+        DesktopArenaChunk *next = chunk->next;
+        g_free(chunk);
+        chunk = next;
+    }
+}
+
+void desktop_arena_free(DesktopArena *arena) {
+    if (arena) {
+        arena_free_chunks(arena->chunks);
+        g_free(arena);
+    }
+}
+
+gpointer desktop_arena_alloc(DesktopArena *arena, gsize size) {
+    gsize aligned = (size + DESKTOP_ARENA_ALIGN - 1) & ~(gsize)(DESKTOP_ARENA_ALIGN - 1);
+    DesktopArenaChunk *chunk = arena->chunks;
+    
+    if (chunk->size - chunk->used < aligned) {
+        // Grow geometrically so a large batch needs few chunks
+        gsize next_size = MAX(arena->chunk_size, chunk->size * 2);
+        chunk = arena_chunk_new(MAX(next_size, aligned));
+        chunk->next = arena->chunks;
+        arena->chunks = chunk;
+    }
+    
+    gpointer result = chunk->data + chunk->used;
+    chunk->used += aligned;
+    arena->used += aligned;
+    return result;
+}
+
+gchar* desktop_arena_strdup(DesktopArena *arena, const gchar *str) {
+    if (!str) {
+        return NULL;
+    }
+    gsize length = strlen(str) + 1;
+    gchar *copy = desktop_arena_alloc(arena, length);
+    memcpy(copy, str, length);
+    return copy;
+}
+
+void desktop_arena_reset(DesktopArena *arena) {
+    DesktopArenaChunk *chunk = arena->chunks;
+    if (chunk->next) {
+        // Replace the chain with one chunk that holds all of it
+        gsize total = 0;
+        for (DesktopArenaChunk *c = chunk; c; c = c->next) {
+            total += c->size;
+        }
+        arena_free_chunks(chunk);
+        arena->chunks = arena_chunk_new(total);
+    } else {
+        chunk->used = 0;
+    }
+    arena->used = 0;
+}
+
+gsize desktop_arena_get_used(const DesktopArena *arena) {
+    return arena->used;
+}
@@ -0,0 +1,30 @@
+#ifndef DESKTOP_ARENA_H
+#define DESKTOP_ARENA_H
+
+#include <glib.h>
+
+// Bump allocator for bulk entry generation.
+// Allocations live until the arena is reset or freed; there is no per-object
+// free. A reset keeps the memory, folding it into one chunk, so a batch that
+// fits once never touches the heap again.
+
+typedef struct _DesktopArena DesktopArena;
+
+// chunk_size is the size of the first chunk (0 = 64 KiB); larger requests
+// get a chunk of their own
+DesktopArena* desktop_arena_new(gsize chunk_size);
+void desktop_arena_free(DesktopArena *arena);
+
+// Returns size bytes aligned for any scalar type
+gpointer desktop_arena_alloc(DesktopArena *arena, gsize size);
+
+// Copies str (NULL stays NULL)
+gchar* desktop_arena_strdup(DesktopArena *arena, const gchar *str);
+
+// Releases every allocation at once
+void desktop_arena_reset(DesktopArena *arena);
+
+// Bytes handed out since the last reset
+gsize desktop_arena_get_used(const DesktopArena *arena);
+
+#endif // DESKTOP_ARENA_H
@@ -0,0 +1,412 @@
+#include "desktop_categories.h"
+#include <string.h>
+
+// Perfect hash: names hash into one of CATEGORY_BUCKETS buckets, and each
+// bucket carries a displacement that sends its names to free slots. The
+// displacements are searched once, at first use.
+#define CATEGORY_SLOT_BITS 8
+#define CATEGORY_SLOTS (1 << CATEGORY_SLOT_BITS)  // >= DESKTOP_N_CATEGORIES
+#define CATEGORY_BUCKETS 64         // Power of two
+#define CATEGORY_MAX_ALTERNATIVES 3
+
+typedef struct {
+    const gchar *name;
+    DesktopCategoryKind kind;
+    // Required related categories: alternatives separated by '|', each a
+    // ';'-separated list of categories that must all be present
+    const gchar *related;
+} CategoryInfo;
+
+// In DesktopCategory order
+static const CategoryInfo category_registry[DESKTOP_N_CATEGORIES] = {
+    // Main categories
+    { "AudioVideo", DESKTOP_CATEGORY_KIND_MAIN, NULL },
+    { "Audio", DESKTOP_CATEGORY_KIND_MAIN, "AudioVideo" },
+    { "Video", DESKTOP_CATEGORY_KIND_MAIN, "AudioVideo" },
+    { "Development", DESKTOP_CATEGORY_KIND_MAIN, NULL },
+    { "Education", DESKTOP_CATEGORY_KIND_MAIN, NULL },
+    { "Game", DESKTOP_CATEGORY_KIND_MAIN, NULL },
+    { "Graphics", DESKTOP_CATEGORY_KIND_MAIN, NULL },
+    { "Network", DESKTOP_CATEGORY_KIND_MAIN, NULL },
+    { "Office", DESKTOP_CATEGORY_KIND_MAIN, NULL },
+    { "Science", DESKTOP_CATEGORY_KIND_MAIN, NULL },
+    { "Settings", DESKTOP_CATEGORY_KIND_MAIN, NULL },
+    { "System", DESKTOP_CATEGORY_KIND_MAIN, NULL },
+    { "Utility", DESKTOP_CATEGORY_KIND_MAIN, NULL },
+    
+    // Additional categories
+    { "Building", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Development" },
+    { "Debugger", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Development" },
+    { "IDE", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Development" },
+    { "GUIDesigner", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Development" },
+    { "Profiling", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Development" },
+    { "RevisionControl", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Development" },
+    { "Translation", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Development" },
+    { "Calendar", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Office" },
+    { "ContactManagement", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Office" },
+    { "Database", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Office|Development|AudioVideo" },
+    { "Dictionary", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Office;TextTools" },
+    { "Chart", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Office" },
+    { "Email", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Office;Network" },
+    { "Finance", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Office" },
+    { "FlowChart", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Office" },
+    { "PDA", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Office" },
+    { "ProjectManagement", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Office;Development" },
+    { "Presentation", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Office" },
+    { "Spreadsheet", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Office" },
+    { "WordProcessor", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Office" },
+    { "2DGraphics", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Graphics" },
+    { "VectorGraphics", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Graphics;2DGraphics" },
+    { "RasterGraphics", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Graphics;2DGraphics" },
+    { "3DGraphics", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Graphics" },
+    { "Scanning", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Graphics" },
+    { "OCR", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Graphics;Scanning" },
+    { "Photography", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Graphics|Office" },
+    { "Publishing", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Graphics|Office" },
+    { "Viewer", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Graphics|Office" },
+    { "TextTools", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Utility" },
+    { "DesktopSettings", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Settings" },
+    { "HardwareSettings", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Settings" },
+    { "Printing", DESKTOP_CATEGORY_KIND_ADDITIONAL, "HardwareSettings;Settings" },
+    { "PackageManager", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Settings" },
+    { "Dialup", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Network" },
+    { "InstantMessaging", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Network" },
+    { "Chat", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Network" },
+    { "IRCClient", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Network" },
+    { "Feed", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Network" },
+    { "FileTransfer", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Network" },
+    { "HamRadio", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Network|Audio" },
+    { "News", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Network" },
+    { "P2P", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Network" },
+    { "RemoteAccess", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Network" },
+    { "Telephony", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Network" },
+    { "TelephonyTools", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Utility" },
+    { "VideoConference", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Network" },
+    { "WebBrowser", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Network" },
+    { "WebDevelopment", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Network|Development" },
+    { "Midi", DESKTOP_CATEGORY_KIND_ADDITIONAL, "AudioVideo;Audio" },
+    { "Mixer", DESKTOP_CATEGORY_KIND_ADDITIONAL, "AudioVideo;Audio" },
+    { "Sequencer", DESKTOP_CATEGORY_KIND_ADDITIONAL, "AudioVideo;Audio" },
+    { "Tuner", DESKTOP_CATEGORY_KIND_ADDITIONAL, "AudioVideo;Audio" },
+    { "TV", DESKTOP_CATEGORY_KIND_ADDITIONAL, "AudioVideo;Video" },
+    { "AudioVideoEditing", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Audio|Video|AudioVideo" },
+    { "Player", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Audio|Video|AudioVideo" },
+    { "Recorder", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Audio|Video|AudioVideo" },
+    { "DiscBurning", DESKTOP_CATEGORY_KIND_ADDITIONAL, "AudioVideo" },
+    { "ActionGame", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Game" },
+    { "AdventureGame", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Game" },
+    { "ArcadeGame", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Game" },
+    { "BoardGame", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Game" },
+    { "BlocksGame", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Game" },
+    { "CardGame", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Game" },
+    { "KidsGame", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Game" },
+    { "LogicGame", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Game" },
+    { "RolePlaying", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Game" },
+    { "Shooter", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Game" },
+    { "Simulation", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Game" },
+    { "SportsGame", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Game" },
+    { "StrategyGame", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Game" },
+    { "Art", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Education|Science" },
+    { "Construction", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Education|Science" },
+    { "Music", DESKTOP_CATEGORY_KIND_ADDITIONAL, "AudioVideo|Education" },
+    { "Languages", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Education|Science" },
+    { "ArtificialIntelligence", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Education|Science" },
+    { "Astronomy", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Education|Science" },
+    { "Biology", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Education|Science" },
+    { "Chemistry", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Education|Science" },
+    { "ComputerScience", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Education|Science" },
+    { "DataVisualization", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Education|Science" },
+    { "Economy", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Education|Science" },
+    { "Electricity", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Education|Science" },
+    { "Geography", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Education|Science" },
+    { "Geology", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Education|Science" },
+    { "Geoscience", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Education|Science" },
+    { "History", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Education|Science" },
+    { "Humanities", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Education|Science" },
+    { "ImageProcessing", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Education|Science" },
+    { "Literature", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Education|Science" },
+    { "Maps", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Education|Science|Utility" },
+    { "Math", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Education|Science" },
+    { "NumericalAnalysis", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Education;Math|Science;Math" },
+    { "MedicalSoftware", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Education|Science" },
+    { "Physics", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Education|Science" },
+    { "Robotics", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Education|Science" },
+    { "Spirituality", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Education|Science|Utility" },
+    { "Sports", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Education|Science" },
+    { "ParallelComputing", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Education;ComputerScience|Science;ComputerScience" },
+    { "Amusement", DESKTOP_CATEGORY_KIND_ADDITIONAL, NULL },
+    { "Archiving", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Utility" },
+    { "Compression", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Utility" },
+    { "Electronics", DESKTOP_CATEGORY_KIND_ADDITIONAL, NULL },
+    { "Emulator", DESKTOP_CATEGORY_KIND_ADDITIONAL, "System|Game" },
+    { "Engineering", DESKTOP_CATEGORY_KIND_ADDITIONAL, NULL },
+    { "FileTools", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Utility|System" },
+    { "FileManager", DESKTOP_CATEGORY_KIND_ADDITIONAL, "System;FileTools" },
+    { "TerminalEmulator", DESKTOP_CATEGORY_KIND_ADDITIONAL, "System" },
+    { "Filesystem", DESKTOP_CATEGORY_KIND_ADDITIONAL, "System" },
+    { "Monitor", DESKTOP_CATEGORY_KIND_ADDITIONAL, "System|Network" },
+    { "Security", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Settings|System" },
+    { "Accessibility", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Settings|Utility" },
+    { "Calculator", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Utility" },
+    { "Clock", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Utility" },
+    { "TextEditor", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Utility" },
+    { "Documentation", DESKTOP_CATEGORY_KIND_ADDITIONAL, NULL },
+    { "Adult", DESKTOP_CATEGORY_KIND_ADDITIONAL, NULL },
+    { "Core", DESKTOP_CATEGORY_KIND_ADDITIONAL, NULL },
+    { "KDE", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Qt" },
+    { "GNOME", DESKTOP_CATEGORY_KIND_ADDITIONAL, "GTK" },
+    { "XFCE", DESKTOP_CATEGORY_KIND_ADDITIONAL, "GTK" },
+    { "DDE", DESKTOP_CATEGORY_KIND_ADDITIONAL, "Qt" },
+    { "GTK", DESKTOP_CATEGORY_KIND_ADDITIONAL, NULL },
+    { "Qt", DESKTOP_CATEGORY_KIND_ADDITIONAL, NULL },
+    { "Motif", DESKTOP_CATEGORY_KIND_ADDITIONAL, NULL },
+    { "Java", DESKTOP_CATEGORY_KIND_ADDITIONAL, NULL },
+    { "ConsoleOnly", DESKTOP_CATEGORY_KIND_ADDITIONAL, NULL },
+    
+    // Reserved categories (only valid with OnlyShowIn)
+    { "Screensaver", DESKTOP_CATEGORY_KIND_RESERVED, NULL },
+    { "TrayIcon", DESKTOP_CATEGORY_KIND_RESERVED, NULL },
+    { "Applet", DESKTOP_CATEGORY_KIND_RESERVED, NULL },
+    { "Shell", DESKTOP_CATEGORY_KIND_RESERVED, NULL },
+};
+
+typedef struct {
+    guint8 length[DESKTOP_N_CATEGORIES];
+    guint16 displacement[CATEGORY_BUCKETS];
+    guint8 slots[CATEGORY_SLOTS];           // Category + 1, 0 = empty
+    DesktopCategories related[DESKTOP_N_CATEGORIES][CATEGORY_MAX_ALTERNATIVES];
+    guint8 n_related[DESKTOP_N_CATEGORIES];
+    DesktopCategories main;
+} CategoryTables;
+
+static CategoryTables tables;
+
+static inline guint32 category_hash(const gchar *name, gsize length) {
+    guint32 hash = 2166136261u;
+    for (gsize i = 0; i < length; i++) {
+        hash ^= (guint8)name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static inline guint category_slot(guint32 hash, guint32 displacement) {
+    return ((hash ^ displacement) * 0x9e3779b1u) >> (32 - CATEGORY_SLOT_BITS);
+}
+
+static DesktopCategory category_lookup(const gchar *name, gsize length) {
+    guint32 hash = category_hash(name, length);
+    guint slot = category_slot(hash, tables.displacement[hash & (CATEGORY_BUCKETS - 1)]);
+    int category = (int)tables.slots[slot] - 1;
+    if (category >= 0 && tables.length[category] == length &&
+        memcmp(category_registry[category].name, name, length) == 0) {
+        return (DesktopCategory)category;
+    }
+    return DESKTOP_CATEGORY_INVALID;
+}
+
+static void category_build_hash(void) {
+    // Place the fullest buckets first, trying displacements until all of a
+    // bucket's names land in distinct free slots
+    guint32 hashes[DESKTOP_N_CATEGORIES];
+    guint bucket_size[CATEGORY_BUCKETS] = { 0 };
+    for (int i = 0; i < DESKTOP_N_CATEGORIES; i++) {
+        tables.length[i] = strlen(category_registry[i].name);
+        hashes[i] = category_hash(category_registry[i].name, tables.length[i]);
+        bucket_size[hashes[i] & (CATEGORY_BUCKETS - 1)]++;
+    }
+    
+    for (guint size = DESKTOP_N_CATEGORIES; size > 0; size--) {
+        for (guint bucket = 0; bucket < CATEGORY_BUCKETS; bucket++) {
+            if (bucket_size[bucket] != size) {
+                continue;
+            }
+            for (guint32 displacement = 0; ; displacement++) {
+                g_assert(displacement <= G_MAXUINT16);
+                guint placed[DESKTOP_N_CATEGORIES];
+                guint n_placed = 0;
+                gboolean fits = TRUE;
+                for (int i = 0; i < DESKTOP_N_CATEGORIES && fits; i++) {
+                    if ((hashes[i] & (CATEGORY_BUCKETS - 1)) != bucket) {
+                        continue;
+                    }
+                    guint slot = category_slot(hashes[i], displacement);
+                    fits = tables.slots[slot] == 0;
+                    for (guint j = 0; j < n_placed && fits; j++) {
+                        fits = category_slot(hashes[placed[j]], displacement) != slot;
+                    }
+                    placed[n_placed++] = i;
+                }
+                if (fits) {
+                    for (guint j = 0; j < n_placed; j++) {
+                        tables.slots[category_slot(hashes[placed[j]], displacement)] = placed[j] + 1;
+                    }
+                    tables.displacement[bucket] = displacement;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+static void category_build_rules(void) {
+    for (int i = 0; i < DESKTOP_N_CATEGORIES; i++) {
+        const CategoryInfo *info = &category_registry[i];
+        if (info->kind == DESKTOP_CATEGORY_KIND_MAIN) {
+            desktop_categories_add(&tables.main, i);
+        }
+        if (!info->related) {
+            continue;
+        }
+        
+        guint n = 0;
+        desktop_categories_clear(&tables.related[i][0]);
+        for (const gchar *p = info->related; ; p++) {
+            const gchar *start = p;
+            while (*p && *p != ';' && *p != '|') {
+                p++;
+            }
+            DesktopCategory related = category_lookup(start, p - start);
+            g_assert(related != DESKTOP_CATEGORY_INVALID);
+            desktop_categories_add(&tables.related[i][n], related);
+            if (*p == '\0') {
+                break;
+            }
+            if (*p == '|') {
+                n++;
+                g_assert(n < CATEGORY_MAX_ALTERNATIVES);
+                desktop_categories_clear(&tables.related[i][n]);
+            }
+        }
+        tables.n_related[i] = n + 1;
+    }
+}
+
+static void category_tables_init(void) {
+    static gsize initialized = 0;
+    if (g_once_init_enter(&initialized)) {
+        category_build_hash();
+        category_build_rules();
+        g_once_init_leave(&initialized, 1);
+    }
+}
+
+DesktopCategory desktop_category_from_name(const gchar *name, gssize length) {
+    if (!name) {
+        return DESKTOP_CATEGORY_INVALID;
+    }
+    category_tables_init();
+    return category_lookup(name, length < 0 ? strlen(name) : (gsize)length);
+}
+
+const gchar* desktop_category_get_name(DesktopCategory category) {
+    g_return_val_if_fail(category >= 0 && category < DESKTOP_N_CATEGORIES, NULL);
+    return category_registry[category].name;
+}
+
+DesktopCategoryKind desktop_category_get_kind(DesktopCategory category) {
+    g_return_val_if_fail(category >= 0 && category < DESKTOP_N_CATEGORIES, DESKTOP_CATEGORY_KIND_ADDITIONAL);
+    return category_registry[category].kind;
+}
+
+const DesktopCategories* desktop_categories_get_main(void) {
+    category_tables_init();
+    return &tables.main;
+}
+
+guint desktop_categories_parse(DesktopCategories *categories, const gchar *list, gssize length) {
+    if (!list) {
+        return 0;
+    }
+    category_tables_init();
+    
+    const gchar *end = list + (length < 0 ? strlen(list) : (gsize)length);
+    guint unknown = 0;
+    for (const gchar *p = list; p < end; ) {
+        const gchar *separator = memchr(p, ';', end - p);
+        const gchar *name_end = separator ? separator : end;
+        if (name_end > p) {
+            DesktopCategory category = category_lookup(p, name_end - p);
+            if (category != DESKTOP_CATEGORY_INVALID) {
+                desktop_categories_add(categories, category);
+            } else {
+                unknown++;
+            }
+        }
+        p = name_end + 1;
+    }
+    return unknown;
+}
+
+gsize desktop_categories_write(const DesktopCategories *categories, gchar *buffer, gsize size) {
+    category_tables_init();
+    
+    gsize length = 0;
+    for (int word = 0; word < DESKTOP_CATEGORY_WORDS; word++) {
+        for (guint64 bits = categories->bits[word]; bits; bits &= bits - 1) {
+            length += tables.length[word * 64 + __builtin_ctzll(bits)] + 1;
+        }
+    }
+    if (!buffer || length >= size) {
+        return length;
+    }
+    
+    gchar *p = buffer;
+    for (int word = 0; word < DESKTOP_CATEGORY_WORDS; word++) {
+        for (guint64 bits = categories->bits[word]; bits; bits &= bits - 1) {
+            int category = word * 64 + __builtin_ctzll(bits);
+            memcpy(p, category_registry[category].name, tables.length[category]);
+            p += tables.length[category];
+            *p++ = ';';
+        }
+    }
+    *p = '\0';
+    return length;
+}
+
+gchar* desktop_categories_to_string(const DesktopCategories *categories) {
+    gsize length = desktop_categories_write(categories, NULL, 0);
+    gchar *result = g_malloc(length + 1);
+    desktop_categories_write(categories, result, length + 1);
+    return result;
+}
+
+static gboolean category_related_present(const DesktopCategories *categories, int category) {
+    for (guint n = 0; n < tables.n_related[category]; n++) {
+        if (desktop_categories_contains(categories, &tables.related[category][n])) {
+            return TRUE;
+        }
+    }
+    return tables.n_related[category] == 0;
+}
+
+DesktopCategory desktop_categories_check(const DesktopCategories *categories) {
+    category_tables_init();
+    
+    for (int word = 0; word < DESKTOP_CATEGORY_WORDS; word++) {
+        for (guint64 bits = categories->bits[word]; bits; bits &= bits - 1) {
+            int category = word * 64 + __builtin_ctzll(bits);
+            if (!category_related_present(categories, category)) {
+                return (DesktopCategory)category;
+            }
+        }
+    }
+    return DESKTOP_CATEGORY_INVALID;
+}
+
+gboolean desktop_categories_add_related(DesktopCategories *categories) {
+    category_tables_init();
+    
+    // Added categories can have rules of their own (Printing needs
+    // HardwareSettings, which needs Settings), so repeat until stable
+    gboolean added = FALSE;
+    DesktopCategory category;
+    while ((category = desktop_categories_check(categories)) != DESKTOP_CATEGORY_INVALID) {
+        const DesktopCategories *first = &tables.related[category][0];
+        for (int i = 0; i < DESKTOP_CATEGORY_WORDS; i++) {
+            categories->bits[i] |= first->bits[i];
+        }
+        added = TRUE;
+    }
+    return added;
+}
@@ -0,0 +1,269 @@
+#ifndef DESKTOP_CATEGORIES_H
+#define DESKTOP_CATEGORIES_H
+
+#include <glib.h>
+
+// The freedesktop.org category registry (Desktop Menu Specification: Main,
+// Additional and Reserved categories, with their related-category rules) and
+// a bitset over it. Names map to bits through a perfect hash, so parsing a
+// Categories value costs one hash and one compare per name, and filtering a
+// set of entries is a few word operations per entry.
+
+typedef enum {
+    DESKTOP_CATEGORY_INVALID = -1,
+    
+    // Main categories
+    DESKTOP_CATEGORY_AUDIO_VIDEO,
+    DESKTOP_CATEGORY_AUDIO,
+    DESKTOP_CATEGORY_VIDEO,
+    DESKTOP_CATEGORY_DEVELOPMENT,
+    DESKTOP_CATEGORY_EDUCATION,
+    DESKTOP_CATEGORY_GAME,
+    DESKTOP_CATEGORY_GRAPHICS,
+    DESKTOP_CATEGORY_NETWORK,
+    DESKTOP_CATEGORY_OFFICE,
+    DESKTOP_CATEGORY_SCIENCE,
+    DESKTOP_CATEGORY_SETTINGS,
+    DESKTOP_CATEGORY_SYSTEM,
+    DESKTOP_CATEGORY_UTILITY,
+    
+    // Additional categories
+    DESKTOP_CATEGORY_BUILDING,
+    DESKTOP_CATEGORY_DEBUGGER,
+    DESKTOP_CATEGORY_IDE,
+    DESKTOP_CATEGORY_GUI_DESIGNER,
+    DESKTOP_CATEGORY_PROFILING,
+    DESKTOP_CATEGORY_REVISION_CONTROL,
+    DESKTOP_CATEGORY_TRANSLATION,
+    DESKTOP_CATEGORY_CALENDAR,
+    DESKTOP_CATEGORY_CONTACT_MANAGEMENT,
+    DESKTOP_CATEGORY_DATABASE,
+    DESKTOP_CATEGORY_DICTIONARY,
+    DESKTOP_CATEGORY_CHART,
+    DESKTOP_CATEGORY_EMAIL,
+    DESKTOP_CATEGORY_FINANCE,
+    DESKTOP_CATEGORY_FLOW_CHART,
+    DESKTOP_CATEGORY_PDA,
+    DESKTOP_CATEGORY_PROJECT_MANAGEMENT,
+    DESKTOP_CATEGORY_PRESENTATION,
+    DESKTOP_CATEGORY_SPREADSHEET,
+    DESKTOP_CATEGORY_WORD_PROCESSOR,
+    DESKTOP_CATEGORY_2D_GRAPHICS,
+    DESKTOP_CATEGORY_VECTOR_GRAPHICS,
+    DESKTOP_CATEGORY_RASTER_GRAPHICS,
+    DESKTOP_CATEGORY_3D_GRAPHICS,
+    DESKTOP_CATEGORY_SCANNING,
+    DESKTOP_CATEGORY_OCR,
+    DESKTOP_CATEGORY_PHOTOGRAPHY,
+    DESKTOP_CATEGORY_PUBLISHING,
+    DESKTOP_CATEGORY_VIEWER,
+    DESKTOP_CATEGORY_TEXT_TOOLS,
+    DESKTOP_CATEGORY_DESKTOP_SETTINGS,
+    DESKTOP_CATEGORY_HARDWARE_SETTINGS,
+    DESKTOP_CATEGORY_PRINTING,
+    DESKTOP_CATEGORY_PACKAGE_MANAGER,
+    DESKTOP_CATEGORY_DIALUP,
+    DESKTOP_CATEGORY_INSTANT_MESSAGING,
+    DESKTOP_CATEGORY_CHAT,
+    DESKTOP_CATEGORY_IRC_CLIENT,
+    DESKTOP_CATEGORY_FEED,
+    DESKTOP_CATEGORY_FILE_TRANSFER,
+    DESKTOP_CATEGORY_HAM_RADIO,
+    DESKTOP_CATEGORY_NEWS,
+    DESKTOP_CATEGORY_P2P,
+    DESKTOP_CATEGORY_REMOTE_ACCESS,
+    DESKTOP_CATEGORY_TELEPHONY,
+    DESKTOP_CATEGORY_TELEPHONY_TOOLS,
+    DESKTOP_CATEGORY_VIDEO_CONFERENCE,
+    DESKTOP_CATEGORY_WEB_BROWSER,
+    DESKTOP_CATEGORY_WEB_DEVELOPMENT,
+    DESKTOP_CATEGORY_MIDI,
+    DESKTOP_CATEGORY_MIXER,
+    DESKTOP_CATEGORY_SEQUENCER,
+    DESKTOP_CATEGORY_TUNER,
+    DESKTOP_CATEGORY_TV,
+    DESKTOP_CATEGORY_AUDIO_VIDEO_EDITING,
+    DESKTOP_CATEGORY_PLAYER,
+    DESKTOP_CATEGORY_RECORDER,
+    DESKTOP_CATEGORY_DISC_BURNING,
+    DESKTOP_CATEGORY_ACTION_GAME,
+    DESKTOP_CATEGORY_ADVENTURE_GAME,
+    DESKTOP_CATEGORY_ARCADE_GAME,
+    DESKTOP_CATEGORY_BOARD_GAME,
+    DESKTOP_CATEGORY_BLOCKS_GAME,
+    DESKTOP_CATEGORY_CARD_GAME,
+    DESKTOP_CATEGORY_KIDS_GAME,
+    DESKTOP_CATEGORY_LOGIC_GAME,
+    DESKTOP_CATEGORY_ROLE_PLAYING,
+    DESKTOP_CATEGORY_SHOOTER,
+    DESKTOP_CATEGORY_SIMULATION,
+    DESKTOP_CATEGORY_SPORTS_GAME,
+    DESKTOP_CATEGORY_STRATEGY_GAME,
+    DESKTOP_CATEGORY_ART,
+    DESKTOP_CATEGORY_CONSTRUCTION,
+    DESKTOP_CATEGORY_MUSIC,
+    DESKTOP_CATEGORY_LANGUAGES,
+    DESKTOP_CATEGORY_ARTIFICIAL_INTELLIGENCE,
+    DESKTOP_CATEGORY_ASTRONOMY,
+    DESKTOP_CATEGORY_BIOLOGY,
+    DESKTOP_CATEGORY_CHEMISTRY,
+    DESKTOP_CATEGORY_COMPUTER_SCIENCE,
+    DESKTOP_CATEGORY_DATA_VISUALIZATION,
+    DESKTOP_CATEGORY_ECONOMY,
+    DESKTOP_CATEGORY_ELECTRICITY,
+    DESKTOP_CATEGORY_GEOGRAPHY,
+    DESKTOP_CATEGORY_GEOLOGY,
+    DESKTOP_CATEGORY_GEOSCIENCE,
+    DESKTOP_CATEGORY_HISTORY,
+    DESKTOP_CATEGORY_HUMANITIES,
+    DESKTOP_CATEGORY_IMAGE_PROCESSING,
+    DESKTOP_CATEGORY_LITERATURE,
+    DESKTOP_CATEGORY_MAPS,
+    DESKTOP_CATEGORY_MATH,
+    DESKTOP_CATEGORY_NUMERICAL_ANALYSIS,
+    DESKTOP_CATEGORY_MEDICAL_SOFTWARE,
+    DESKTOP_CATEGORY_PHYSICS,
+    DESKTOP_CATEGORY_ROBOTICS,
+    DESKTOP_CATEGORY_SPIRITUALITY,
+    DESKTOP_CATEGORY_SPORTS,
+    DESKTOP_CATEGORY_PARALLEL_COMPUTING,
+    DESKTOP_CATEGORY_AMUSEMENT,
+    DESKTOP_CATEGORY_ARCHIVING,
+    DESKTOP_CATEGORY_COMPRESSION,
+    DESKTOP_CATEGORY_ELECTRONICS,
+    DESKTOP_CATEGORY_EMULATOR,
+    DESKTOP_CATEGORY_ENGINEERING,
+    DESKTOP_CATEGORY_FILE_TOOLS,
+    DESKTOP_CATEGORY_FILE_MANAGER,
+    DESKTOP_CATEGORY_TERMINAL_EMULATOR,
+    DESKTOP_CATEGORY_FILESYSTEM,
+    DESKTOP_CATEGORY_MONITOR,
+    DESKTOP_CATEGORY_SECURITY,
+    DESKTOP_CATEGORY_ACCESSIBILITY,
+    DESKTOP_CATEGORY_CALCULATOR,
+    DESKTOP_CATEGORY_CLOCK,
+    DESKTOP_CATEGORY_TEXT_EDITOR,
+    DESKTOP_CATEGORY_DOCUMENTATION,
+    DESKTOP_CATEGORY_ADULT,
+    DESKTOP_CATEGORY_CORE,
+    DESKTOP_CATEGORY_KDE,
+    DESKTOP_CATEGORY_GNOME,
+    DESKTOP_CATEGORY_XFCE,
+    DESKTOP_CATEGORY_DDE,
+    DESKTOP_CATEGORY_GTK,
+    DESKTOP_CATEGORY_QT,
+    DESKTOP_CATEGORY_MOTIF,
+    DESKTOP_CATEGORY_JAVA,
+    DESKTOP_CATEGORY_CONSOLE_ONLY,
+    
+    // Reserved categories (only valid with OnlyShowIn)
+    DESKTOP_CATEGORY_SCREENSAVER,
+    DESKTOP_CATEGORY_TRAY_ICON,
+    DESKTOP_CATEGORY_APPLET,
+    DESKTOP_CATEGORY_SHELL,
+    
+    DESKTOP_N_CATEGORIES
+} DesktopCategory;
+
+typedef enum {
+    DESKTOP_CATEGORY_KIND_MAIN,
+    DESKTOP_CATEGORY_KIND_ADDITIONAL,
+    DESKTOP_CATEGORY_KIND_RESERVED
+} DesktopCategoryKind;
+
+#define DESKTOP_CATEGORY_WORDS ((DESKTOP_N_CATEGORIES + 63) / 64)
+
+// Room for every category name with its ';' and a NUL (1444 bytes today)
+#define DESKTOP_CATEGORIES_STRING_MAX 1536
+
+typedef struct {
+    guint64 bits[DESKTOP_CATEGORY_WORDS];
+} DesktopCategories;
+
+// Registry
+
+// Looks a name up (case-sensitive, as in the spec). length may be -1 for a
+// NUL-terminated name. Returns DESKTOP_CATEGORY_INVALID for unknown names.
+DesktopCategory desktop_category_from_name(const gchar *name, gssize length);
+const gchar* desktop_category_get_name(DesktopCategory category);
+DesktopCategoryKind desktop_category_get_kind(DesktopCategory category);
+
+// The Main categories as a set
+const DesktopCategories* desktop_categories_get_main(void);
+
+// Set operations
+
+static inline void desktop_categories_clear(DesktopCategories *categories) {
+    for (int i = 0; i < DESKTOP_CATEGORY_WORDS; i++) {
+        categories->bits[i] = 0;
+    }
+}
+
+static inline void desktop_categories_add(DesktopCategories *categories, DesktopCategory category) {
+    categories->bits[category >> 6] |= G_GUINT64_CONSTANT(1) << (category & 63);
+}
+
+static inline void desktop_categories_remove(DesktopCategories *categories, DesktopCategory category) {
+    categories->bits[category >> 6] &= ~(G_GUINT64_CONSTANT(1) << (category & 63));
+}
+
+static inline gboolean desktop_categories_has(const DesktopCategories *categories, DesktopCategory category) {
+    return (categories->bits[category >> 6] >> (category & 63)) & 1;
+}
+
+static inline gboolean desktop_categories_is_empty(const DesktopCategories *categories) {
+    guint64 any = 0;
+    for (int i = 0; i < DESKTOP_CATEGORY_WORDS; i++) {
+        any |= categories->bits[i];
+    }
+    return any == 0;
+}
+
+// TRUE when a and b share a category
+static inline gboolean desktop_categories_intersects(const DesktopCategories *a, const DesktopCategories *b) {
+    guint64 any = 0;
+    for (int i = 0; i < DESKTOP_CATEGORY_WORDS; i++) {
+        any |= a->bits[i] & b->bits[i];
+    }
+    return any != 0;
+}
+
+// TRUE when every category in b is in a
+static inline gboolean desktop_categories_contains(const DesktopCategories *a, const DesktopCategories *b) {
+    guint64 missing = 0;
+    for (int i = 0; i < DESKTOP_CATEGORY_WORDS; i++) {
+        missing |= b->bits[i] & ~a->bits[i];
+    }
+    return missing == 0;
+}
+
+static inline guint desktop_categories_count(const DesktopCategories *categories) {
+    guint count = 0;
+    for (int i = 0; i < DESKTOP_CATEGORY_WORDS; i++) {
+        count += __builtin_popcountll(categories->bits[i]);
+    }
+    return count;
+}
+
+// Strings
+
+// Adds the categories of a ';'-separated list (length -1 = NUL-terminated).
+// Unknown names are skipped; returns how many there were.
+guint desktop_categories_parse(DesktopCategories *categories, const gchar *list, gssize length);
+
+// Writes "Name;Name;" in registry order to buffer when it fits
+// (length < size) and returns the length either way, like snprintf()
+gsize desktop_categories_write(const DesktopCategories *categories, gchar *buffer, gsize size);
+gchar* desktop_categories_to_string(const DesktopCategories *categories);
+
+// Related categories
+
+// Returns the first category in the set whose related categories (e.g.
+// Development for IDE) are missing, or DESKTOP_CATEGORY_INVALID
+DesktopCategory desktop_categories_check(const DesktopCategories *categories);
+
+// Adds the related categories the spec asks for, taking the first listed
+// alternative where there is a choice. Returns TRUE if anything was added.
+gboolean desktop_categories_add_related(DesktopCategories *categories);
+
+#endif // DESKTOP_CATEGORIES_H
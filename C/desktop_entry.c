@@ -31,122 +31,29 @@ gchar* desktop_entry_get_type_string(DesktopEntryType type) {
 }
 
 void desktop_entry_clear_categories(DesktopCategories *categories) {
-    categories->accessories = FALSE;
-    categories->graphics = FALSE;
-    categories->internet = FALSE;
-    categories->office = FALSE;
-    categories->other = FALSE;
-    categories->programming = FALSE;
-    categories->sound_video = FALSE;
-    categories->system_tools = FALSE;
-    categories->utilities = FALSE;
-}
-
-void desktop_entry_set_category(DesktopCategories *categories, const gchar *category, gboolean value) {
-    if (g_strcmp0(category, "Utility") == 0) {
-        categories->accessories = value;
-    } else if (g_strcmp0(category, "Graphics") == 0) {
-        categories->graphics = value;
-    } else if (g_strcmp0(category, "Network") == 0) {
-        categories->internet = value;
-    } else if (g_strcmp0(category, "Office") == 0) {
-        categories->office = value;
-    } else if (g_strcmp0(category, "Development") == 0) {
-        categories->programming = value;
-    } else if (g_strcmp0(category, "AudioVideo") == 0) {
-        categories->sound_video = value;
-    } else if (g_strcmp0(category, "System") == 0) {
-        categories->system_tools = value;
-    } else if (g_strcmp0(category, "Settings") == 0) {
-        categories->utilities = value;
-    } else if (g_strcmp0(category, "Games") == 0) {
-        categories->other = value;
+    desktop_categories_clear(categories);
+}
+
+gboolean desktop_entry_set_category(DesktopCategories *categories, const gchar *category, gboolean value) {
+    DesktopCategory id = desktop_category_from_name(category, -1);
+    if (id == DESKTOP_CATEGORY_INVALID) {
+        return FALSE; // Unknown category
+    }
+    if (value) {
+        desktop_categories_add(categories, id);
+    } else {
+        desktop_categories_remove(categories, id);
     }
+    return TRUE;
 }
 
 gboolean desktop_entry_has_category(DesktopCategories *categories, const gchar *category) {
-    if (g_strcmp0(category, "Accessories") == 0) {
-        return categories->accessories;
-    } else if (g_strcmp0(category, "Graphics") == 0) {
-        return categories->graphics;
-    } else if (g_strcmp0(category, "Internet") == 0) {
-        return categories->internet;
-    } else if (g_strcmp0(category, "Office") == 0) {
-        return categories->office;
-    } else if (g_strcmp0(category, "Other") == 0) {
-        return categories->other;
-    } else if (g_strcmp0(category, "Programming") == 0) {
-        return categories->programming;
-    } else if (g_strcmp0(category, "Sound & Video") == 0) {
-        return categories->sound_video;
-    } else if (g_strcmp0(category, "System Tools") == 0) {
-        return categories->system_tools;
-    } else if (g_strcmp0(category, "Utilities") == 0) {
-        return categories->utilities;
-    }
-    return FALSE;
+    DesktopCategory id = desktop_category_from_name(category, -1);
+    return id != DESKTOP_CATEGORY_INVALID && desktop_categories_has(categories, id);
 }
 
 gchar* desktop_entry_get_categories_string(DesktopCategories *categories) {
-    GString *cat_string = g_string_new(NULL);
-    gboolean first = TRUE;
-    
-    if (categories->accessories) {
-        if (!first) g_string_append(cat_string, ";");
-        g_string_append(cat_string, "Utility");
-        first = FALSE;
-    }
-    if (categories->graphics) {
-        if (!first) g_string_append(cat_string, ";");
-        g_string_append(cat_string, "Graphics");
-        first = FALSE;
-    }
-    if (categories->internet) {
-        if (!first) g_string_append(cat_string, ";");
-        g_string_append(cat_string, "Network");
-        first = FALSE;
-    }
-    if (categories->office) {
-        if (!first) g_string_append(cat_string, ";");
-        g_string_append(cat_string, "Office");
-        first = FALSE;
-    }
-    if (categories->other) {
-        if (!first) g_string_append(cat_string, ";");
-        g_string_append(cat_string, "Utility");
-        first = FALSE;
-    }
-    if (categories->programming) {
-        if (!first) g_string_append(cat_string, ";");
-        g_string_append(cat_string, "Development");
-        first = FALSE;
-    }
-    if (categories->sound_video) {
-        if (!first) g_string_append(cat_string, ";");
-        g_string_append(cat_string, "AudioVideo");
-        first = FALSE;
-    }
-    if (categories->system_tools) {
-        if (!first) g_string_append(cat_string, ";");
-        g_string_append(cat_string, "System");
-        first = FALSE;
-    }
-    if (categories->utilities) {
-        if (!first) g_string_append(cat_string, ";");
-        g_string_append(cat_string, "Settings");
-        first = FALSE;
-    }
-    if (categories->other) {
-        if (!first) g_string_append(cat_string, ";");
-        g_string_append(cat_string, "Games");
-        first = FALSE;
-    }
-    
-    if (cat_string->len > 0) {
-        g_string_append(cat_string, ";");
-    }
-    
-    return g_string_free(cat_string, FALSE);
+    return desktop_categories_to_string(categories);
 }
 
 gboolean desktop_entry_validate(DesktopEntry *entry, gchar **error_msg) {
@@ -167,83 +74,404 @@ gboolean desktop_entry_validate(DesktopEntry *entry, gchar **error_msg) {
     return TRUE;
 }
 
-gchar* desktop_entry_generate_content(DesktopEntry *entry) {
-    GString *content = g_string_new(NULL);
+// Exec argument encoding
+
+// Bytes each character grows by when escaped: one backslash for the quoting
+// rules and every backslash doubled again for the string value
+static const guint8 exec_escape_extra[256] = {
+    ['\t'] = 1, ['\n'] = 1, ['\r'] = 1,
+    ['"'] = 2, ['$'] = 2, ['`'] = 2, ['\\'] = 3,
+    ['%'] = 1
+};
+
+#define WORD_ONES G_GUINT64_CONSTANT(0x0101010101010101)
+#define WORD_HIGHS G_GUINT64_CONSTANT(0x8080808080808080)
+
+// Nonzero when any byte of word is zero
+static inline guint64 word_has_zero(guint64 word) {
+    return (word - WORD_ONES) & ~word & WORD_HIGHS;
+}
+
+// Nonzero when any byte of word may need escaping: one of "$%\` or a
+// control character (which the byte loop then sorts out)
+static inline guint64 word_needs_escape(guint64 word) {
+    return word_has_zero(word ^ (WORD_ONES * '"')) |
+           word_has_zero(word ^ (WORD_ONES * '$')) |
+           word_has_zero(word ^ (WORD_ONES * '%')) |
+           word_has_zero(word ^ (WORD_ONES * '\\')) |
+           word_has_zero(word ^ (WORD_ONES * '`')) |
+           ((word - WORD_ONES * 0x20) & ~word & WORD_HIGHS);
+}
+
+// Bytes each character grows by as a plain string value
+static const guint8 string_escape_extra[256] = {
+    ['\t'] = 1, ['\n'] = 1, ['\r'] = 1, ['\\'] = 1
+};
+
+// Nonzero when any byte of word may need escaping in a string value: \ or
+// a control character
+static inline guint64 word_needs_string_escape(guint64 word) {
+    return word_has_zero(word ^ (WORD_ONES * '\\')) |
+           ((word - WORD_ONES * 0x20) & ~word & WORD_HIGHS);
+}
+
+// Length of the prefix of str that is copied as it is, checked eight bytes
+// at a time; extra and word_test are one of the pairs above
+static inline gsize plain_prefix(const gchar *str, gsize length, const guint8 *extra,
+                                 guint64 (*word_test)(guint64)) {
+    gsize i = 0;
+    while (i < length) {
+        if (i + 8 <= length) {
+            guint64 word;
+            memcpy(&word, str + i, sizeof(word));
+            if (!word_test(word)) {
+                i += 8;
+                continue;
+            }
+        }
+        gsize end = MIN(i + 8, length);
+        for (; i < end; i++) {
+            if (extra[(guchar)str[i]]) {
+                return i;
+            }
+        }
+    }
+    return length;
+}
+
+static gsize exec_plain_prefix(const gchar *str, gsize length) {
+    return plain_prefix(str, length, exec_escape_extra, word_needs_escape);
+}
+
+static gsize string_plain_prefix(const gchar *str, gsize length) {
+    return plain_prefix(str, length, string_escape_extra, word_needs_string_escape);
+}
+
+gsize desktop_exec_escaped_length(const gchar *str, gsize length) {
+    gsize i = exec_plain_prefix(str, length);
+    gsize escaped = length;
+    for (; i < length; i++) {
+        escaped += exec_escape_extra[(guchar)str[i]];
+    }
+    return escaped;
+}
+
+gsize desktop_exec_escape(const gchar *str, gsize length, gchar *buffer) {
+    gchar *p = buffer;
+    gsize i = 0;
+    
+    for (;;) {
+        gsize plain = exec_plain_prefix(str + i, length - i);
+        memcpy(p, str + i, plain);
+        p += plain;
+        i += plain;
+        if (i == length) {
+            break;
+        }
+        
+        gchar c = str[i++];
+        switch (c) {
+            case '"':
+            case '$':
+            case '`':
+                *p++ = '\\';
+                *p++ = '\\';
+                *p++ = c;
+                break;
+            case '\\':
+                memcpy(p, "\\\\\\\\", 4);
+                p += 4;
+                break;
+            case '%':
+                *p++ = '%';
+                *p++ = '%';
+                break;
+            case '\t':
+                *p++ = '\\';
+                *p++ = 't';
+                break;
+            case '\n':
+                *p++ = '\\';
+                *p++ = 'n';
+                break;
+            case '\r':
+                *p++ = '\\';
+                *p++ = 'r';
+                break;
+        }
+    }
+    return p - buffer;
+}
+
+gsize desktop_string_escaped_length(const gchar *str, gsize length) {
+    gsize i = string_plain_prefix(str, length);
+    gsize escaped = length;
+    for (; i < length; i++) {
+        escaped += string_escape_extra[(guchar)str[i]];
+    }
+    return escaped;
+}
+
+gsize desktop_string_escape(const gchar *str, gsize length, gchar *buffer) {
+    gchar *p = buffer;
+    gsize i = 0;
+    
+    for (;;) {
+        gsize plain = string_plain_prefix(str + i, length - i);
+        memcpy(p, str + i, plain);
+        p += plain;
+        i += plain;
+        if (i == length) {
+            break;
+        }
+        
+        gchar c = str[i++];
+        *p++ = '\\';
+        switch (c) {
+            case '\t':
+                *p++ = 't';
+                break;
+            case '\n':
+                *p++ = 'n';
+                break;
+            case '\r':
+                *p++ = 'r';
+                break;
+            default:
+                *p++ = c;
+                break;
+        }
+    }
+    return p - buffer;
+}
+
+gchar* desktop_exec_quote_arg(const gchar *arg) {
+    gsize length = strlen(arg);
+    gsize escaped = desktop_exec_escaped_length(arg, length);
+    gchar *quoted = g_malloc(escaped + 3);
+    quoted[0] = '"';
+    desktop_exec_escape(arg, length, quoted + 1);
+    quoted[escaped + 1] = '"';
+    quoted[escaped + 2] = '\0';
+    return quoted;
+}
+
+// The generated file as a list of string pieces, so its exact size is known
+// before anything is copied
+#define CONTENT_MAX_PIECES 24
+
+typedef enum {
+    PIECE_PLAIN,
+    PIECE_STRING,     // Copied through desktop_string_escape()
+    PIECE_EXEC        // Copied through desktop_exec_escape()
+} PieceEscape;
+
+typedef struct {
+    const gchar *data[CONTENT_MAX_PIECES];
+    gsize length[CONTENT_MAX_PIECES];
+    PieceEscape escape[CONTENT_MAX_PIECES];
+    guint n_pieces;
+    gsize total;
+    gchar categories[DESKTOP_CATEGORIES_STRING_MAX];
+} ContentPieces;
+
+static void pieces_add(ContentPieces *pieces, const gchar *data, gsize length) {
+    pieces->data[pieces->n_pieces] = data;
+    pieces->length[pieces->n_pieces] = length;
+    pieces->escape[pieces->n_pieces] = PIECE_PLAIN;
+    pieces->n_pieces++;
+    pieces->total += length;
+}
+
+#define pieces_add_literal(pieces, literal) pieces_add(pieces, literal, sizeof(literal) - 1)
+
+// Adds str as a string value, so a newline in it can't start a key of its
+// own. Like Exec arguments, strings that need no escaping stay plain.
+static void pieces_add_string(ContentPieces *pieces, const gchar *str) {
+    if (!str) {
+        return;
+    }
+    gsize length = strlen(str);
+    gsize escaped = desktop_string_escaped_length(str, length);
+    pieces_add(pieces, str, length);
+    if (escaped != length) {
+        pieces->escape[pieces->n_pieces - 1] = PIECE_STRING;
+        pieces->total += escaped - length;
+    }
+}
+
+// Adds str for use inside a quoted Exec argument. Only strings that need
+// escaping are copied differently; the rest stay a plain piece.
+static void pieces_add_exec_arg(ContentPieces *pieces, const gchar *str) {
+    if (!str) {
+        return;
+    }
+    gsize length = strlen(str);
+    gsize escaped = desktop_exec_escaped_length(str, length);
+    pieces_add(pieces, str, length);
+    if (escaped != length) {
+        pieces->escape[pieces->n_pieces - 1] = PIECE_EXEC;
+        pieces->total += escaped - length;
+    }
+}
+
+static void pieces_add_exec(ContentPieces *pieces, DesktopEntry *entry) {
+    // Detect file type (cached) unless the caller already did, and
+    // generate appropriate Exec line
+    FileType file_type = entry->exec_type != FILE_TYPE_UNKNOWN ? entry->exec_type :
+                         file_utils_detect_file_type(entry->exec_path);
     
-    // Header
-    g_string_append(content, "[Desktop Entry]\n");
-    g_string_append(content, "Version=1.0\n");
+    switch (file_type) {
+        case FILE_TYPE_PYTHON:
+            if (entry->terminal) {
+                pieces_add_literal(pieces, "Exec=gnome-terminal -- python3 \"");
+            } else {
+                pieces_add_literal(pieces, "Exec=python3 \"");
+            }
+            pieces_add_exec_arg(pieces, entry->exec_path);
+            pieces_add_literal(pieces, "\"\n");
+            break;
+        case FILE_TYPE_SHELL:
+            if (entry->terminal) {
+                // For shell scripts in terminal, use gnome-terminal to keep it
+                // open. The script is passed as $0 rather than spliced into the
+                // command, so no shell quoting of the path is needed.
+                pieces_add_literal(pieces, "Exec=gnome-terminal -- bash -c \"\\\\\"\\\\$0\\\\\"; exec bash\" \"");
+                pieces_add_exec_arg(pieces, entry->exec_path);
+                pieces_add_literal(pieces, "\"\n");
+            } else {
+                // For shell scripts without terminal, run directly
+                pieces_add_literal(pieces, "Exec=bash \"");
+                pieces_add_exec_arg(pieces, entry->exec_path);
+                pieces_add_literal(pieces, "\"\n");
+            }
+            break;
+        case FILE_TYPE_PERL:
+        case FILE_TYPE_RUBY:
+        case FILE_TYPE_NODE:
+        case FILE_TYPE_JAVA_JAR:
+            // Run through the interpreter so CRLF shebangs and
+            // missing execute bits don't matter
+            if (entry->terminal) {
+                pieces_add_literal(pieces, "Exec=gnome-terminal -- ");
+            } else {
+                pieces_add_literal(pieces, "Exec=");
+            }
+            if (file_type == FILE_TYPE_PERL) {
+                pieces_add_literal(pieces, "perl \"");
+            } else if (file_type == FILE_TYPE_RUBY) {
+                pieces_add_literal(pieces, "ruby \"");
+            } else if (file_type == FILE_TYPE_NODE) {
+                pieces_add_literal(pieces, "node \"");
+            } else {
+                pieces_add_literal(pieces, "java -jar \"");
+            }
+            pieces_add_exec_arg(pieces, entry->exec_path);
+            pieces_add_literal(pieces, "\"\n");
+            break;
+        case FILE_TYPE_ELF:
+        case FILE_TYPE_APPIMAGE:
+        case FILE_TYPE_OTHER:
+        case FILE_TYPE_UNKNOWN:
+        default:
+            // Direct execution
+            pieces_add_literal(pieces, "Exec=\"");
+            pieces_add_exec_arg(pieces, entry->exec_path);
+            pieces_add_literal(pieces, "\"\n");
+            break;
+    }
+}
+
+static void desktop_entry_collect_pieces(DesktopEntry *entry, ContentPieces *pieces) {
+    pieces->n_pieces = 0;
+    pieces->total = 0;
     
-    // Type
-    g_string_append_printf(content, "Type=%s\n", desktop_entry_get_type_string(entry->type));
+    // Header and Type
+    pieces_add_literal(pieces, "[Desktop Entry]\nVersion=1.0\nType=");
+    pieces_add_string(pieces, desktop_entry_get_type_string(entry->type));
     
     // Name
-    g_string_append_printf(content, "Name=%s\n", entry->name);
+    pieces_add_literal(pieces, "\nName=");
+    pieces_add_string(pieces, entry->name);
+    pieces_add_literal(pieces, "\n");
     
     // Comment
-    if (entry->comment && strlen(entry->comment) > 0) {
-        g_string_append_printf(content, "Comment=%s\n", entry->comment);
+    if (entry->comment && entry->comment[0] != '\0') {
+        pieces_add_literal(pieces, "Comment=");
+        pieces_add_string(pieces, entry->comment);
+        pieces_add_literal(pieces, "\n");
     }
     
     // Type-specific fields
     switch (entry->type) {
         case DESKTOP_TYPE_APPLICATION:
             if (entry->exec_path) {
-                // Validate executable path
-                gchar *exec_error = NULL;
-                if (!file_utils_validate_executable(entry->exec_path, &exec_error)) {
-                    g_free(exec_error);
-                }
-                
-                // Detect file type and generate appropriate Exec line
-                FileType file_type = file_utils_detect_file_type(entry->exec_path);
-                
-                switch (file_type) {
-                    case FILE_TYPE_PYTHON:
-                        if (entry->terminal) {
-                            g_string_append_printf(content, "Exec=gnome-terminal -- python3 \"%s\"\n", entry->exec_path);
-                        } else {
-                            g_string_append_printf(content, "Exec=python3 \"%s\"\n", entry->exec_path);
-                        }
-                        break;
-                    case FILE_TYPE_SHELL:
-                        if (entry->terminal) {
-                            // For shell scripts in terminal, use gnome-terminal to keep it open
-                            g_string_append_printf(content, "Exec=gnome-terminal -- bash -c \"%s; exec bash\"\n", entry->exec_path);
-                        } else {
-                            // For shell scripts without terminal, run directly
-                            g_string_append_printf(content, "Exec=bash \"%s\"\n", entry->exec_path);
-                        }
-                        break;
-                    case FILE_TYPE_ELF:
-                        g_string_append_printf(content, "Exec=\"%s\"\n", entry->exec_path);
-                        break;
-                    case FILE_TYPE_OTHER:
-                        // For other types, try to use the file directly
-                        g_string_append_printf(content, "Exec=\"%s\"\n", entry->exec_path);
-                        break;
-                    case FILE_TYPE_UNKNOWN:
-                    default:
-                        // Fallback to direct execution
-                        g_string_append_printf(content, "Exec=\"%s\"\n", entry->exec_path);
-                        break;
-                }
+                pieces_add_exec(pieces, entry);
+            }
+            if (entry->terminal) {
+                pieces_add_literal(pieces, "Terminal=true\n");
+            } else {
+                pieces_add_literal(pieces, "Terminal=false\n");
             }
-            g_string_append_printf(content, "Terminal=%s\n", entry->terminal ? "true" : "false");
             break;
     }
     
     // Icon
-    if (entry->icon_path && strlen(entry->icon_path) > 0) {
-        g_string_append_printf(content, "Icon=%s\n", entry->icon_path);
+    if (entry->icon_path && entry->icon_path[0] != '\0') {
+        pieces_add_literal(pieces, "Icon=");
+        pieces_add_string(pieces, entry->icon_path);
+        pieces_add_literal(pieces, "\n");
     }
     
     // Categories
-    gchar *categories = desktop_entry_get_categories_string(&entry->categories);
-    if (strlen(categories) > 0) {
-        g_string_append_printf(content, "Categories=%s\n", categories);
+    gsize categories_length = desktop_categories_write(&entry->categories, pieces->categories,
+                                                       sizeof(pieces->categories));
+    if (categories_length > 0) {
+        pieces_add_literal(pieces, "Categories=");
+        pieces_add(pieces, pieces->categories, categories_length);
+        pieces_add_literal(pieces, "\n");
     }
-    g_free(categories);
-    
-    return g_string_free(content, FALSE);
-} 
\ No newline at end of file
+}
+
+static void pieces_copy(const ContentPieces *pieces, gchar *buffer) {
+    gchar *p = buffer;
+    for (guint i = 0; i < pieces->n_pieces; i++) {
+        if (pieces->escape[i] == PIECE_EXEC) {
+            p += desktop_exec_escape(pieces->data[i], pieces->length[i], p);
+        } else if (pieces->escape[i] == PIECE_STRING) {
+            p += desktop_string_escape(pieces->data[i], pieces->length[i], p);
+        } else {
+            memcpy(p, pieces->data[i], pieces->length[i]);
+            p += pieces->length[i];
+        }
+    }
+    *p = '\0';
+}
+
+gsize desktop_entry_write_content(DesktopEntry *entry, gchar *buffer, gsize size) {
+    ContentPieces pieces;
+    desktop_entry_collect_pieces(entry, &pieces);
+    if (buffer && pieces.total < size) {
+        pieces_copy(&pieces, buffer);
+    }
+    return pieces.total;
+}
+
+gchar* desktop_entry_generate_content_in(DesktopEntry *entry, DesktopArena *arena, gsize *length) {
+    ContentPieces pieces;
+    desktop_entry_collect_pieces(entry, &pieces);
+    gchar *content = desktop_arena_alloc(arena, pieces.total + 1);
+    pieces_copy(&pieces, content);
+    if (length) {
+        *length = pieces.total;
+    }
+    return content;
+}
+
+gchar* desktop_entry_generate_content(DesktopEntry *entry) {
+    ContentPieces pieces;
+    desktop_entry_collect_pieces(entry, &pieces);
+    gchar *content = g_malloc(pieces.total + 1);
+    pieces_copy(&pieces, content);
+    return content;
+}
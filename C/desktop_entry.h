@@ -2,31 +2,23 @@
 #define DESKTOP_ENTRY_H
 
 #include <glib.h>
+#include "desktop_arena.h"
+#include "desktop_categories.h"
+#include "file_classify.h"
 
 // Desktop entry types as per freedesktop.org specification
 typedef enum {
     DESKTOP_TYPE_APPLICATION
 } DesktopEntryType;
 
-// Categories as per freedesktop.org specification
-typedef struct {
-    gboolean accessories;
-    gboolean graphics;
-    gboolean internet;
-    gboolean office;
-    gboolean other;
-    gboolean programming;
-    gboolean sound_video;
-    gboolean system_tools;
-    gboolean utilities;
-} DesktopCategories;
-
 // Main desktop entry structure
 typedef struct {
     DesktopEntryType type;
     gchar *name;
     gchar *comment;
     gchar *exec_path;
+    FileType exec_type;     // Type of exec_path if already detected; FILE_TYPE_UNKNOWN
+                            // makes generation detect it. Reset when exec_path changes.
     gchar *icon_path;
     gboolean terminal;
     DesktopCategories categories;
@@ -36,13 +28,41 @@ typedef struct {
 DesktopEntry* desktop_entry_new(void);
 void desktop_entry_free(DesktopEntry *entry);
 gchar* desktop_entry_generate_content(DesktopEntry *entry);
+
+// Exact-size generation without intermediate strings. The entry's fields are
+// only read, so they may live in an arena or on the stack.
+// Writes the content and its NUL to buffer when it fits (length < size) and
+// returns the content length either way, like snprintf().
+gsize desktop_entry_write_content(DesktopEntry *entry, gchar *buffer, gsize size);
+// Generates into arena memory; length may be NULL
+gchar* desktop_entry_generate_content_in(DesktopEntry *entry, DesktopArena *arena, gsize *length);
 gboolean desktop_entry_validate(DesktopEntry *entry, gchar **error_msg);
 gchar* desktop_entry_get_type_string(DesktopEntryType type);
 gchar* desktop_entry_get_categories_string(DesktopCategories *categories);
 
-// Category management
+// Exec= argument encoding (Desktop Entry Specification, "The Exec key").
+// Escapes str for use between the quotes of a quoted Exec argument: ", `, $
+// and \ get a backslash, % is doubled, and the result is escaped again as a
+// string value (\ becomes \\, a newline \n). Strings without any of these,
+// which is nearly every path, come back unchanged.
+gsize desktop_exec_escaped_length(const gchar *str, gsize length);
+// Writes the escaped form (desktop_exec_escaped_length() bytes, no NUL) to
+// buffer and returns its length
+gsize desktop_exec_escape(const gchar *str, gsize length, gchar *buffer);
+// Returns arg as a complete quoted Exec argument
+gchar* desktop_exec_quote_arg(const gchar *arg);
+
+// String values (Name, Comment, Icon): a backslash, tab, newline or
+// carriage return is written as \\, \t, \n or \r, so a value always stays
+// on its own line. Most strings come back unchanged.
+gsize desktop_string_escaped_length(const gchar *str, gsize length);
+// Writes the escaped form (desktop_string_escaped_length() bytes, no NUL)
+// to buffer and returns its length
+gsize desktop_string_escape(const gchar *str, gsize length, gchar *buffer);
+
+// Category management by freedesktop.org name (see desktop_categories.h)
 void desktop_entry_clear_categories(DesktopCategories *categories);
-void desktop_entry_set_category(DesktopCategories *categories, const gchar *category, gboolean value);
+gboolean desktop_entry_set_category(DesktopCategories *categories, const gchar *category, gboolean value);
 gboolean desktop_entry_has_category(DesktopCategories *categories, const gchar *category);
 
 #endif // DESKTOP_ENTRY_H 
\ No newline at end of file
@@ -0,0 +1,322 @@
+#include "desktop_parser.h"
+#include <string.h>
+
+gboolean desktop_span_equal(DesktopSpan span, const gchar *str) {
+    gsize len = strlen(str);
+    return span.length == len && memcmp(span.data, str, len) == 0;
+}
+
+gchar* desktop_span_dup(DesktopSpan span) {
+    return g_strndup(span.data, span.length);
+}
+
+gchar* desktop_span_unescape(DesktopSpan span, gboolean list) {
+    gchar *result = g_malloc(span.length + 1);
+    gchar *out = result;
+    
+    for (gsize i = 0; i < span.length; i++) {
+        gchar c = span.data[i];
+        if (c == '\\' && i + 1 < span.length) {
+            gchar next = span.data[++i];
+            switch (next) {
+                case 's': *out++ = ' '; break;
+                case 'n': *out++ = '\n'; break;
+                case 't': *out++ = '\t'; break;
+                case 'r': *out++ = '\r'; break;
+                case '\\': *out++ = '\\'; break;
+                case ';':
+                    // Keep the escape so the list can still be split on ';'
+                    if (!list) {
+                        *out++ = '\\';
+                    }
+                    *out++ = ';';
+                    break;
+                default:
+                    // Unknown escapes are kept verbatim
+                    *out++ = '\\';
+                    *out++ = next;
+                    break;
+            }
+        } else {
+            *out++ = c;
+        }
+    }
+    *out = '\0';
+    return result;
+}
+
+static gboolean is_blank(gchar c) {
+    return c == ' ' || c == '\t';
+}
+
+void desktop_parse_line(const gchar *data, gsize length, DesktopLine *line) {
+    memset(line, 0, sizeof(*line));
+    line->group = DESKTOP_NO_GROUP;
+    line->raw.data = data;
+    line->raw.length = length;
+    
+    // Content without the line terminator (\n or \r\n)
+    gsize end = length;
+    if (end > 0 && data[end - 1] == '\n') end--;
+    if (end > 0 && data[end - 1] == '\r') end--;
+    
+    gsize p = 0;
+    while (p < end && is_blank(data[p])) p++;
+    
+    if (p == end) {
+        line->kind = DESKTOP_LINE_BLANK;
+        return;
+    }
+    
+    if (data[p] == '#') {
+        line->kind = DESKTOP_LINE_COMMENT;
+        return;
+    }
+    
+    if (data[p] == '[') {
+        gsize close = end;
+        while (close > p && is_blank(data[close - 1])) close--;
+        if (close - p < 2 || data[close - 1] != ']') {
+            line->kind = DESKTOP_LINE_INVALID;
+            return;
+        }
+        line->kind = DESKTOP_LINE_GROUP;
+        line->name.data = data + p + 1;
+        line->name.length = close - p - 2;
+        return;
+    }
+    
+    // Key[locale] = value
+    gsize key_start = p;
+    while (p < end && data[p] != '=' && data[p] != '[' && !is_blank(data[p])) p++;
+    line->name.data = data + key_start;
+    line->name.length = p - key_start;
+    
+    if (p < end && data[p] == '[') {
+        gsize locale_start = ++p;
+        while (p < end && data[p] != ']') p++;
+        if (p == end) {
+            line->kind = DESKTOP_LINE_INVALID;
+            return;
+        }
+        line->locale.data = data + locale_start;
+        line->locale.length = p - locale_start;
+        p++;
+    }
+    
+    while (p < end && is_blank(data[p])) p++;
+    if (p == end || data[p] != '=' || line->name.length == 0) {
+        line->kind = DESKTOP_LINE_INVALID;
+        return;
+    }
+    p++;
+    while (p < end && is_blank(data[p])) p++;
+    
+    line->kind = DESKTOP_LINE_KEY;
+    line->value.data = data + p;
+    line->value.length = end - p;
+}
+
+DesktopDocument* desktop_document_new_from_data(const gchar *data, gsize length) {
+    DesktopDocument *doc = g_new0(DesktopDocument, 1);
+    doc->data = data;
+    doc->length = length;
+    
+    // Size the line table exactly so parsing allocates only once
+    guint n_lines = 0;
+    const gchar *p = data;
+    const gchar *end = data + length;
+    while (p < end) {
+        const gchar *nl = memchr(p, '\n', end - p);
+        n_lines++;
+        p = nl ? nl + 1 : end;
+    }
+    
+    doc->lines = g_new(DesktopLine, MAX(n_lines, 1));
+    doc->n_lines = n_lines;
+    
+    guint current_group = DESKTOP_NO_GROUP;
+    p = data;
+    for (guint i = 0; i < n_lines; i++) {
+        const gchar *nl = memchr(p, '\n', end - p);
+        const gchar *next = nl ? nl + 1 : end;
+        DesktopLine *line = &doc->lines[i];
+        
+        desktop_parse_line(p, next - p, line);
+        if (line->kind == DESKTOP_LINE_GROUP) {
+            current_group = i;
+        }
+        line->group = current_group;
+        p = next;
+    }
+    
+    return doc;
+}
+
+DesktopDocument* desktop_document_new_from_file(const gchar *path, GError **error) {
+    GMappedFile *mapped = g_mapped_file_new(path, FALSE, error);
+    if (!mapped) {
+        return NULL;
+    }
+    
+    const gchar *contents = g_mapped_file_get_contents(mapped);
+    gsize length = g_mapped_file_get_length(mapped);
+    DesktopDocument *doc = desktop_document_new_from_data(contents ? contents : "", length);
+    doc->mapped = mapped;
+    return doc;
+}
+
+void desktop_document_free(DesktopDocument *doc) {
+    if (doc) {
+        g_free(doc->lines);
+        if (doc->mapped) {
+            g_mapped_file_unref(doc->mapped);
+        }
+        g_free(doc);
+    }
+}
+
+guint desktop_document_find_group(const DesktopDocument *doc, const gchar *group) {
+    for (guint i = 0; i < doc->n_lines; i++) {
+        if (doc->lines[i].kind == DESKTOP_LINE_GROUP && desktop_span_equal(doc->lines[i].name, group)) {
+            return i;
+        }
+    }
+    return DESKTOP_NO_GROUP;
+}
+
+const DesktopLine* desktop_document_lookup(const DesktopDocument *doc, guint group,
+                                           const gchar *key, const gchar *locale) {
+    if (group == DESKTOP_NO_GROUP) {
+        return NULL;
+    }
+    
+    for (guint i = group + 1; i < doc->n_lines && doc->lines[i].group == group; i++) {
+        const DesktopLine *line = &doc->lines[i];
+        if (line->kind != DESKTOP_LINE_KEY || !desktop_span_equal(line->name, key)) {
+            continue;
+        }
+        if (locale ? desktop_span_equal(line->locale, locale) : line->locale.length == 0) {
+            return line;
+        }
+    }
+    return NULL;
+}
+
+void desktop_document_write(const DesktopDocument *doc, GString *out) {
+    for (guint i = 0; i < doc->n_lines; i++) {
+        g_string_append_len(out, doc->lines[i].raw.data, doc->lines[i].raw.length);
+    }
+}
+
+gchar* desktop_exec_get_path(const gchar *exec, gboolean *terminal) {
+    gint argc = 0;
+    gchar **argv = NULL;
+    if (!g_shell_parse_argv(exec, &argc, &argv, NULL)) {
+        return g_strdup(exec);
+    }
+    
+    gint first = 0;
+    if (argc >= 2 && g_strcmp0(argv[0], "gnome-terminal") == 0 && g_strcmp0(argv[1], "--") == 0) {
+        if (terminal) {
+            *terminal = TRUE;
+        }
+        first = 2;
+    }
+    
+    gchar *path = NULL;
+    if (first < argc) {
+        const gchar *program = argv[first];
+        if (g_strcmp0(program, "bash") == 0 && first + 2 < argc && g_strcmp0(argv[first + 1], "-c") == 0) {
+            const gchar *command = argv[first + 2];
+            if (g_strcmp0(command, "\"$0\"; exec bash") == 0 && first + 3 < argc) {
+                // bash -c "\"\$0\"; exec bash" "<path>"
+                path = g_strdup(argv[first + 3]);
+            } else {
+                // bash -c "<path>; exec bash", as older versions wrote it
+                const gchar *suffix = g_strrstr(command, "; exec bash");
+                path = suffix ? g_strndup(command, suffix - command) : g_strdup(command);
+            }
+        } else if (g_strcmp0(program, "java") == 0 && first + 2 < argc && g_strcmp0(argv[first + 1], "-jar") == 0) {
+            path = g_strdup(argv[first + 2]);
+        } else if ((g_strcmp0(program, "python3") == 0 || g_strcmp0(program, "bash") == 0 ||
+                    g_strcmp0(program, "perl") == 0 || g_strcmp0(program, "ruby") == 0 ||
+                    g_strcmp0(program, "node") == 0) && first + 1 < argc) {
+            path = g_strdup(argv[first + 1]);
+        } else {
+            path = g_strdup(program);
+        }
+    }
+    
+    g_strfreev(argv);
+    
+    // A literal % is written as %%
+    if (path && strstr(path, "%%")) {
+        gchar *out = path;
+        for (const gchar *in = path; *in; in++) {
+            *out++ = *in;
+            if (in[0] == '%' && in[1] == '%') {
+                in++;
+            }
+        }
+        *out = '\0';
+    }
+    return path;
+}
+
+gboolean desktop_document_to_entry(const DesktopDocument *doc, DesktopEntry *entry, gchar **error_msg) {
+    guint group = desktop_document_find_group(doc, "Desktop Entry");
+    if (group == DESKTOP_NO_GROUP) {
+        *error_msg = g_strdup("No [Desktop Entry] group found.");
+        return FALSE;
+    }
+    
+    const DesktopLine *line = desktop_document_lookup(doc, group, "Type", NULL);
+    if (line && !desktop_span_equal(line->value, "Application")) {
+        *error_msg = g_strdup_printf("Unsupported entry type: %.*s", (int)line->value.length, line->value.data);
+        return FALSE;
+    }
+    entry->type = DESKTOP_TYPE_APPLICATION;
+    
+    if ((line = desktop_document_lookup(doc, group, "Name", NULL))) {
+        g_free(entry->name);
+        entry->name = desktop_span_unescape(line->value, FALSE);
+    }
+    if ((line = desktop_document_lookup(doc, group, "Comment", NULL))) {
+        g_free(entry->comment);
+        entry->comment = desktop_span_unescape(line->value, FALSE);
+    }
+    if ((line = desktop_document_lookup(doc, group, "Icon", NULL))) {
+        g_free(entry->icon_path);
+        entry->icon_path = desktop_span_unescape(line->value, FALSE);
+    }
+    
+    entry->terminal = FALSE;
+    if ((line = desktop_document_lookup(doc, group, "Terminal", NULL))) {
+        entry->terminal = desktop_span_equal(line->value, "true") || desktop_span_equal(line->value, "1");
+    }
+    
+    if ((line = desktop_document_lookup(doc, group, "Exec", NULL))) {
+        gchar *exec = desktop_span_unescape(line->value, FALSE);
+        gboolean terminal = FALSE;
+        g_free(entry->exec_path);
+        entry->exec_path = desktop_exec_get_path(exec, &terminal);
+        entry->terminal = entry->terminal || terminal;
+        g_free(exec);
+    }
+    
+    // Categories outside the registry (X- extensions, typos) are dropped
+    desktop_categories_clear(&entry->categories);
+    if ((line = desktop_document_lookup(doc, group, "Categories", NULL))) {
+        if (memchr(line->value.data, '\\', line->value.length)) {
+            gchar *categories = desktop_span_unescape(line->value, TRUE);
+            desktop_categories_parse(&entry->categories, categories, -1);
+            g_free(categories);
+        } else {
+            // Nothing to unescape: parse the mapped value in place
+            desktop_categories_parse(&entry->categories, line->value.data, line->value.length);
+        }
+    }
+    
+    return TRUE;
+}
@@ -0,0 +1,81 @@
+#ifndef DESKTOP_PARSER_H
+#define DESKTOP_PARSER_H
+
+#include <glib.h>
+#include "desktop_entry.h"
+
+// Zero-copy parser for the Desktop Entry file format.
+// Lines are recorded as spans into the original (memory-mapped or caller
+// owned) buffer, so parsing needs a single allocation for the line table and
+// writing the lines back reproduces the input byte for byte.
+
+// A view into the parsed buffer; not NUL-terminated
+typedef struct {
+    const gchar *data;
+    gsize length;
+} DesktopSpan;
+
+typedef enum {
+    DESKTOP_LINE_BLANK,
+    DESKTOP_LINE_COMMENT,
+    DESKTOP_LINE_GROUP,
+    DESKTOP_LINE_KEY,
+    DESKTOP_LINE_INVALID
+} DesktopLineKind;
+
+#define DESKTOP_NO_GROUP G_MAXUINT
+
+typedef struct {
+    DesktopLineKind kind;
+    guint group;          // Line index of the enclosing group header, or DESKTOP_NO_GROUP
+    DesktopSpan raw;      // Whole line including its line terminator
+    DesktopSpan name;     // Group name, or key name without locale
+    DesktopSpan locale;   // Locale of a localized key ("de_DE" in Name[de_DE]), else empty
+    DesktopSpan value;    // Raw (still escaped) value, without the line terminator
+} DesktopLine;
+
+typedef struct {
+    const gchar *data;
+    gsize length;
+    DesktopLine *lines;
+    guint n_lines;
+    GMappedFile *mapped;  // Set when loaded from a file
+} DesktopDocument;
+
+// Parses a single line (without or with its terminator) into line.
+// line->group is left as DESKTOP_NO_GROUP.
+void desktop_parse_line(const gchar *data, gsize length, DesktopLine *line);
+
+// Parses data in place; data must outlive the document
+DesktopDocument* desktop_document_new_from_data(const gchar *data, gsize length);
+
+// Maps and parses a file
+DesktopDocument* desktop_document_new_from_file(const gchar *path, GError **error);
+
+void desktop_document_free(DesktopDocument *doc);
+
+// Returns the line index of the group header, or DESKTOP_NO_GROUP
+guint desktop_document_find_group(const DesktopDocument *doc, const gchar *group);
+
+// Returns the key line in group (NULL locale = unlocalized key), or NULL
+const DesktopLine* desktop_document_lookup(const DesktopDocument *doc, guint group,
+                                           const gchar *key, const gchar *locale);
+
+// Appends the document to out exactly as it was read
+void desktop_document_write(const DesktopDocument *doc, GString *out);
+
+// Fills entry from the [Desktop Entry] group
+gboolean desktop_document_to_entry(const DesktopDocument *doc, DesktopEntry *entry, gchar **error_msg);
+
+// Recovers the executable path from an (unescaped) Exec value, undoing the
+// wrappers desktop_entry_generate_content() adds. terminal (may be NULL) is
+// set when the command runs through gnome-terminal.
+gchar* desktop_exec_get_path(const gchar *exec, gboolean *terminal);
+
+// Span helpers
+gboolean desktop_span_equal(DesktopSpan span, const gchar *str);
+gchar* desktop_span_dup(DesktopSpan span);
+// Returns the value with \s \n \t \r \\ (and \; when list is TRUE) unescaped
+gchar* desktop_span_unescape(DesktopSpan span, gboolean list);
+
+#endif // DESKTOP_PARSER_H
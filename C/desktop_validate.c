@@ -0,0 +1,1121 @@
+#define _GNU_SOURCE
+#include "desktop_validate.h"
+#include "desktop_parser.h"
+#include "desktop_categories.h"
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define VALIDATE_CHUNK 64            // Files checked per thread pool job
+
+typedef enum {
+    VALUE_STRING,
+    VALUE_LOCALESTRING,
+    VALUE_ICONSTRING,
+    VALUE_BOOLEAN,
+    VALUE_STRINGS,
+    VALUE_LOCALESTRINGS
+} ValueType;
+
+#define KEY_APPLICATION (1u << 0)    // Only meaningful for Type=Application
+#define KEY_LINK (1u << 1)           // Only meaningful for Type=Link
+#define KEY_ACTION (1u << 2)         // Also allowed in [Desktop Action] groups
+#define KEY_DEPRECATED (1u << 3)
+#define KEY_FILE_PATH (1u << 4)      // A string that names a file, so UTF-8 like the file system
+
+typedef struct {
+    const gchar *name;
+    ValueType type;
+    guint flags;
+} KeyInfo;
+
+// The keys of the specification, sorted by name for bsearch
+static const KeyInfo known_keys[] = {
+    { "Actions", VALUE_STRINGS, KEY_APPLICATION },
+    { "BinaryPattern", VALUE_STRINGS, KEY_DEPRECATED },
+    { "Categories", VALUE_STRINGS, KEY_APPLICATION },
+    { "Comment", VALUE_LOCALESTRING, 0 },
+    { "DBusActivatable", VALUE_BOOLEAN, KEY_APPLICATION },
+    { "Encoding", VALUE_STRING, KEY_DEPRECATED },
+    { "Exec", VALUE_STRING, KEY_APPLICATION | KEY_ACTION | KEY_FILE_PATH },
+    { "Extensions", VALUE_STRINGS, KEY_DEPRECATED },
+    { "FilePattern", VALUE_STRINGS, KEY_DEPRECATED },
+    { "GenericName", VALUE_LOCALESTRING, 0 },
+    { "Hidden", VALUE_BOOLEAN, 0 },
+    { "Icon", VALUE_ICONSTRING, KEY_ACTION },
+    { "Implements", VALUE_STRINGS, 0 },
+    { "Keywords", VALUE_LOCALESTRINGS, 0 },
+    { "MapNotify", VALUE_STRING, KEY_DEPRECATED },
+    { "MimeType", VALUE_STRINGS, KEY_APPLICATION },
+    { "MiniIcon", VALUE_ICONSTRING, KEY_DEPRECATED },
+    { "Name", VALUE_LOCALESTRING, KEY_ACTION },
+    { "NoDisplay", VALUE_BOOLEAN, 0 },
+    { "NotShowIn", VALUE_STRINGS, 0 },
+    { "OnlyShowIn", VALUE_STRINGS, 0 },
+    { "Path", VALUE_STRING, KEY_APPLICATION | KEY_FILE_PATH },
+    { "Patterns", VALUE_STRINGS, KEY_DEPRECATED },
+    { "PrefersNonDefaultGPU", VALUE_BOOLEAN, KEY_APPLICATION },
+    { "Protocols", VALUE_STRINGS, KEY_DEPRECATED },
+    { "SingleMainWindow", VALUE_BOOLEAN, KEY_APPLICATION },
+    { "SortOrder", VALUE_STRINGS, KEY_DEPRECATED },
+    { "StartupNotify", VALUE_BOOLEAN, KEY_APPLICATION },
+    { "StartupWMClass", VALUE_STRING, KEY_APPLICATION },
+    { "SwallowExec", VALUE_STRING, KEY_DEPRECATED },
+    { "SwallowTitle", VALUE_LOCALESTRING, KEY_DEPRECATED },
+    { "Terminal", VALUE_BOOLEAN, KEY_APPLICATION },
+    { "TerminalOptions", VALUE_STRING, KEY_DEPRECATED },
+    { "TryExec", VALUE_STRING, KEY_APPLICATION | KEY_FILE_PATH },
+    { "Type", VALUE_STRING, 0 },
+    { "URL", VALUE_STRING, KEY_LINK },
+    { "Version", VALUE_STRING, 0 },
+};
+
+#define N_KNOWN_KEYS G_N_ELEMENTS(known_keys)
+
+// Registered desktop environments (OnlyShowIn, NotShowIn)
+static const gchar *known_desktops[] = {
+    "Budgie", "Cinnamon", "COSMIC", "DDE", "Deepin", "EDE", "Endless", "Enlightenment", "GNOME",
+    "KDE", "LXDE", "LXQt", "MATE", "Old", "Pantheon", "Razor", "ROX", "TDE", "Unity", "XFCE"
+};
+
+static const gchar *known_versions[] = { "1.0", "1.1", "1.2", "1.3", "1.4", "1.5" };
+
+typedef enum {
+    GROUP_NONE,
+    GROUP_MAIN,              // [Desktop Entry]
+    GROUP_ACTION,            // [Desktop Action id]
+    GROUP_EXTENSION,         // [X-...]
+    GROUP_UNKNOWN
+} GroupKind;
+
+typedef enum {
+    ENTRY_TYPE_MISSING,
+    ENTRY_TYPE_APPLICATION,
+    ENTRY_TYPE_LINK,
+    ENTRY_TYPE_DIRECTORY,
+    ENTRY_TYPE_OTHER         // Extension or deprecated type
+} EntryType;
+
+typedef struct {
+    DesktopSpan name;
+    DesktopSpan locale;
+    guint32 hash;
+} SeenKey;
+
+typedef struct {
+    DesktopSpan id;
+    guint line;
+} ActionGroup;
+
+struct _DesktopValidator {
+    GArray *issues;          // Output of the current check, may be NULL
+    guint n_errors;
+    
+    // Current group
+    GroupKind group_kind;
+    guint group_line;
+    guint key_line[N_KNOWN_KEYS];        // First unlocalized occurrence
+    guint localized_line[N_KNOWN_KEYS];  // First localized occurrence
+    GArray *seen;            // SeenKey, every key of the group
+    guint32 *slots;          // Open addressing over seen: index + 1
+    guint n_slots;           // Power of two
+    
+    GArray *groups;          // DesktopSpan, every group name so far
+    GArray *action_groups;   // ActionGroup
+    
+    // Values from [Desktop Entry] that later checks need
+    EntryType type;
+    gboolean dbus_activatable;
+    DesktopSpan name;
+    DesktopSpan comment;
+    DesktopSpan generic_name;
+    DesktopSpan actions;
+    guint actions_line;
+    DesktopCategories categories;
+    guint categories_line;
+};
+
+static void issue_clear(gpointer data) {
+    g_free(((DesktopIssue*)data)->message);
+}
+
+GArray* desktop_issues_new(void) {
+    GArray *issues = g_array_new(FALSE, FALSE, sizeof(DesktopIssue));
+    g_array_set_clear_func(issues, issue_clear);
+    return issues;
+}
+
+const gchar* desktop_issue_level_to_string(DesktopIssueLevel level) {
+    switch (level) {
+        case DESKTOP_ISSUE_ERROR:
+            return "error";
+        case DESKTOP_ISSUE_WARNING:
+            return "warning";
+        case DESKTOP_ISSUE_HINT:
+        default:
+            return "hint";
+    }
+}
+
+G_GNUC_PRINTF(4, 5)
+static void report(DesktopValidator *v, DesktopIssueLevel level, guint line, const gchar *format, ...) {
+    if (level == DESKTOP_ISSUE_ERROR) {
+        v->n_errors++;
+    }
+    if (!v->issues) {
+        return;
+    }
+    
+    DesktopIssue issue;
+    va_list args;
+    va_start(args, format);
+    issue.level = level;
+    issue.line = line;
+    issue.message = g_strdup_vprintf(format, args);
+    va_end(args);
+    g_array_append_val(v->issues, issue);
+}
+
+DesktopValidator* desktop_validator_new(void) {
+    DesktopValidator *v = g_new0(DesktopValidator, 1);
+    v->seen = g_array_new(FALSE, FALSE, sizeof(SeenKey));
+    v->n_slots = 64;
+    v->slots = g_new0(guint32, v->n_slots);
+    v->groups = g_array_new(FALSE, FALSE, sizeof(DesktopSpan));
+    v->action_groups = g_array_new(FALSE, FALSE, sizeof(ActionGroup));
+    return v;
+}
+
+void desktop_validator_free(DesktopValidator *v) {
+    if (v) {
+        g_array_unref(v->seen);
+        g_free(v->slots);
+        g_array_unref(v->groups);
+        g_array_unref(v->action_groups);
+        g_free(v);
+    }
+}
+
+// Span helpers
+
+static gboolean span_equal(DesktopSpan a, DesktopSpan b) {
+    return a.length == b.length && memcmp(a.data, b.data, a.length) == 0;
+}
+
+static gboolean span_has_prefix(DesktopSpan span, const gchar *prefix) {
+    gsize len = strlen(prefix);
+    return span.length >= len && memcmp(span.data, prefix, len) == 0;
+}
+
+static gboolean span_in(DesktopSpan span, const gchar * const *strings, gsize n_strings) {
+    for (gsize i = 0; i < n_strings; i++) {
+        if (desktop_span_equal(span, strings[i])) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+static guint32 span_hash(guint32 hash, DesktopSpan span) {
+    for (gsize i = 0; i < span.length; i++) {
+        hash = (hash ^ (guchar)span.data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// Splits a list value on unescaped ';'. Returns FALSE after the last item.
+static gboolean list_next(DesktopSpan list, gsize *pos, DesktopSpan *item) {
+    if (*pos >= list.length) {
+        return FALSE;
+    }
+    gsize start = *pos;
+    gsize i = start;
+    while (i < list.length && list.data[i] != ';') {
+        i += list.data[i] == '\\' ? 2 : 1;
+    }
+    i = MIN(i, list.length);
+    item->data = list.data + start;
+    item->length = i - start;
+    *pos = i + 1;
+    return TRUE;
+}
+
+static int key_compare(const void *key, const void *element) {
+    const DesktopSpan *name = key;
+    const gchar *other = ((const KeyInfo*)element)->name;
+    gsize other_length = strlen(other);
+    int cmp = memcmp(name->data, other, MIN(name->length, other_length));
+    if (cmp != 0) {
+        return cmp;
+    }
+    return name->length < other_length ? -1 : name->length > other_length;
+}
+
+static const KeyInfo* key_lookup(DesktopSpan name) {
+    return bsearch(&name, known_keys, N_KNOWN_KEYS, sizeof(KeyInfo), key_compare);
+}
+
+// Line of the first unlocalized occurrence of a key in the current group
+static guint key_seen(const DesktopValidator *v, const gchar *name) {
+    DesktopSpan span = { name, strlen(name) };
+    return v->key_line[key_lookup(span) - known_keys];
+}
+
+// Remembers a key of the current group; FALSE when it was already there
+static gboolean seen_add(DesktopValidator *v, DesktopSpan name, DesktopSpan locale) {
+    if ((v->seen->len + 1) * 2 > v->n_slots) {
+        v->n_slots *= 2;
+        v->slots = g_renew(guint32, v->slots, v->n_slots);
+        memset(v->slots, 0, v->n_slots * sizeof(guint32));
+        for (guint i = 0; i < v->seen->len; i++) {
+            guint32 slot = g_array_index(v->seen, SeenKey, i).hash & (v->n_slots - 1);
+            while (v->slots[slot] != 0) {
+                slot = (slot + 1) & (v->n_slots - 1);
+            }
+            v->slots[slot] = i + 1;
+        }
+    }
+    
+    SeenKey key = { name, locale, span_hash(span_hash(2166136261u, name) * 31, locale) };
+    for (guint32 slot = key.hash & (v->n_slots - 1); ; slot = (slot + 1) & (v->n_slots - 1)) {
+        if (v->slots[slot] == 0) {
+            g_array_append_val(v->seen, key);
+            v->slots[slot] = v->seen->len;
+            return TRUE;
+        }
+        SeenKey *other = &g_array_index(v->seen, SeenKey, v->slots[slot] - 1);
+        if (other->hash == key.hash && span_equal(other->name, name) && span_equal(other->locale, locale)) {
+            return FALSE;
+        }
+    }
+}
+
+// Syntax checks
+
+static gboolean is_key_char(gchar c) {
+    return g_ascii_isalnum(c) || c == '-';
+}
+
+// lang_COUNTRY.ENCODING@MODIFIER, with everything after lang optional
+static gboolean locale_is_valid(DesktopSpan locale) {
+    const gchar *p = locale.data;
+    const gchar *end = p + locale.length;
+    const gchar *start = p;
+    
+    while (p < end && g_ascii_islower(*p)) p++;
+    if (p - start < 2 || p - start > 3) {
+        return FALSE;
+    }
+    if (p < end && *p == '_') {
+        start = ++p;
+        while (p < end && (g_ascii_isupper(*p) || g_ascii_isdigit(*p))) p++;
+        if (p - start < 2) {
+            return FALSE;
+        }
+    }
+    if (p < end && *p == '.') {
+        start = ++p;
+        while (p < end && (g_ascii_isalnum(*p) || *p == '-')) p++;
+        if (p == start) {
+            return FALSE;
+        }
+    }
+    if (p < end && *p == '@') {
+        start = ++p;
+        while (p < end && g_ascii_isalnum(*p)) p++;
+        if (p == start) {
+            return FALSE;
+        }
+    }
+    return p == end;
+}
+
+// Escapes, characters allowed by the type, booleans and empty list items
+static void check_value(DesktopValidator *v, const KeyInfo *info, const DesktopLine *line, guint line_no) {
+    DesktopSpan value = line->value;
+    gboolean list = info->type == VALUE_STRINGS || info->type == VALUE_LOCALESTRINGS;
+    gboolean ascii = (info->type == VALUE_STRING || info->type == VALUE_STRINGS) && !(info->flags & KEY_FILE_PATH);
+    
+    for (gsize i = 0; i < value.length; i++) {
+        guchar c = value.data[i];
+        if (c == '\\') {
+            gchar next = i + 1 < value.length ? value.data[i + 1] : '\0';
+            if (!strchr("sntr\\", next) && !(list && next == ';')) {
+                report(v, DESKTOP_ISSUE_ERROR, line_no, "%s: invalid escape sequence \"\\%c\"",
+                       info->name, next ? next : ' ');
+                return;
+            }
+            i++;
+        } else if (c < 0x20 || c == 0x7f) {
+            report(v, DESKTOP_ISSUE_ERROR, line_no, "%s: value contains a control character", info->name);
+            return;
+        } else if (ascii && c >= 0x80) {
+            report(v, DESKTOP_ISSUE_ERROR, line_no, "%s: value of a string key must be ASCII", info->name);
+            return;
+        }
+    }
+    
+    if (info->type == VALUE_BOOLEAN && !desktop_span_equal(value, "true") && !desktop_span_equal(value, "false")) {
+        report(v, DESKTOP_ISSUE_ERROR, line_no, "%s: value \"%.*s\" is not a boolean (true or false)",
+               info->name, (int)value.length, value.data);
+    }
+    
+    if (list) {
+        DesktopSpan item;
+        gsize pos = 0;
+        while (list_next(value, &pos, &item)) {
+            if (item.length == 0) {
+                report(v, DESKTOP_ISSUE_WARNING, line_no, "%s: list contains an empty item", info->name);
+                break;
+            }
+        }
+    }
+}
+
+static void format_char(gchar c, gchar buffer[8]) {
+    if (g_ascii_isprint(c)) {
+        g_snprintf(buffer, 8, "%c", c);
+    } else {
+        g_snprintf(buffer, 8, "\\x%02x", (guchar)c);
+    }
+}
+
+// Field codes and quoting as the "The Exec key" section describes them,
+// on the value with its string escapes already undone
+static void check_exec(DesktopValidator *v, DesktopSpan value, guint line_no) {
+    static const gchar reserved[] = "\t\n\"'\\><~|&;$*?#()`";
+    gchar shown[8];
+    
+    if (value.length == 0) {
+        report(v, DESKTOP_ISSUE_ERROR, line_no, "Exec: value is empty");
+        return;
+    }
+    
+    gchar *exec = desktop_span_unescape(value, FALSE);
+    gboolean in_quotes = FALSE;
+    gsize arg_start = 0;
+    guint file_codes = 0;
+    
+    for (gsize i = 0; exec[i] != '\0'; i++) {
+        gchar c = exec[i];
+        if (in_quotes) {
+            if (c == '"') {
+                in_quotes = FALSE;
+                if (exec[i + 1] != ' ' && exec[i + 1] != '\0') {
+                    report(v, DESKTOP_ISSUE_ERROR, line_no, "Exec: a quoted argument must end at its closing quote");
+                    goto out;
+                }
+            } else if (c == '\\') {
+                if (!exec[i + 1] || !strchr("\"`$\\", exec[i + 1])) {
+                    report(v, DESKTOP_ISSUE_ERROR, line_no,
+                           "Exec: a backslash inside quotes must escape \", `, $ or \\");
+                    goto out;
+                }
+                i++;
+            } else if (c == '`' || c == '$') {
+                report(v, DESKTOP_ISSUE_ERROR, line_no, "Exec: '%c' must be escaped inside quotes", c);
+                goto out;
+            } else if (c == '%') {
+                if (exec[i + 1] != '%') {
+                    report(v, DESKTOP_ISSUE_ERROR, line_no, "Exec: field codes must not be used inside quotes");
+                    goto out;
+                }
+                i++;
+            }
+            continue;
+        }
+        
+        if (c == ' ') {
+            arg_start = i + 1;
+        } else if (c == '"') {
+            if (i != arg_start) {
+                report(v, DESKTOP_ISSUE_ERROR, line_no, "Exec: quotes must enclose a whole argument");
+                goto out;
+            }
+            in_quotes = TRUE;
+        } else if (c == '%') {
+            gchar code = exec[i + 1];
+            switch (code) {
+                case '%':
+                case 'i':
+                case 'c':
+                case 'k':
+                    break;
+                case 'f':
+                case 'u':
+                    file_codes++;
+                    break;
+                case 'F':
+                case 'U':
+                    file_codes++;
+                    if (i != arg_start || (exec[i + 2] != ' ' && exec[i + 2] != '\0')) {
+                        report(v, DESKTOP_ISSUE_ERROR, line_no, "Exec: %%%c must be an argument on its own", code);
+                        goto out;
+                    }
+                    break;
+                case 'd':
+                case 'D':
+                case 'n':
+                case 'N':
+                case 'v':
+                case 'm':
+                    report(v, DESKTOP_ISSUE_WARNING, line_no, "Exec: field code %%%c is deprecated", code);
+                    break;
+                case '\0':
+                    report(v, DESKTOP_ISSUE_ERROR, line_no, "Exec: '%%' at the end of the value; use %%%% for a literal one");
+                    goto out;
+                default:
+                    format_char(code, shown);
+                    report(v, DESKTOP_ISSUE_ERROR, line_no, "Exec: unknown field code %%%s", shown);
+                    goto out;
+            }
+            i++;
+        } else if (strchr(reserved, c)) {
+            format_char(c, shown);
+            report(v, DESKTOP_ISSUE_ERROR, line_no, "Exec: reserved character '%s' must be inside a quoted argument", shown);
+            goto out;
+        }
+    }
+    
+    if (in_quotes) {
+        report(v, DESKTOP_ISSUE_ERROR, line_no, "Exec: unterminated quoted argument");
+    } else if (file_codes > 1) {
+        report(v, DESKTOP_ISSUE_ERROR, line_no, "Exec: only one of %%f, %%F, %%u and %%U may be used");
+    }
+
+out:
+    g_free(exec);
+}
+
+static void check_type(DesktopValidator *v, DesktopSpan value, guint line_no) {
+    if (desktop_span_equal(value, "Application")) {
+        v->type = ENTRY_TYPE_APPLICATION;
+    } else if (desktop_span_equal(value, "Link")) {
+        v->type = ENTRY_TYPE_LINK;
+    } else if (desktop_span_equal(value, "Directory")) {
+        v->type = ENTRY_TYPE_DIRECTORY;
+    } else {
+        static const gchar *deprecated[] = { "Service", "ServiceType", "FSDevice", "MimeType" };
+        v->type = ENTRY_TYPE_OTHER;
+        if (span_in(value, deprecated, G_N_ELEMENTS(deprecated))) {
+            report(v, DESKTOP_ISSUE_WARNING, line_no, "Type: \"%.*s\" is deprecated", (int)value.length, value.data);
+        } else if (!span_has_prefix(value, "X-")) {
+            report(v, DESKTOP_ISSUE_ERROR, line_no, "Type: unknown type \"%.*s\"; use Application, Link or Directory",
+                   (int)value.length, value.data);
+        }
+    }
+}
+
+static void check_categories(DesktopValidator *v, DesktopSpan value, guint line_no) {
+    DesktopSpan item;
+    gsize pos = 0;
+    
+    v->categories_line = line_no;
+    while (list_next(value, &pos, &item)) {
+        if (item.length == 0 || span_has_prefix(item, "X-")) {
+            continue;
+        }
+        DesktopCategory category = desktop_category_from_name(item.data, item.length);
+        if (category == DESKTOP_CATEGORY_INVALID) {
+            report(v, DESKTOP_ISSUE_ERROR, line_no, "Categories: unknown category \"%.*s\"; extensions start with X-",
+                   (int)item.length, item.data);
+        } else if (desktop_categories_has(&v->categories, category)) {
+            report(v, DESKTOP_ISSUE_WARNING, line_no, "Categories: \"%.*s\" is listed twice",
+                   (int)item.length, item.data);
+        } else {
+            desktop_categories_add(&v->categories, category);
+        }
+    }
+}
+
+static void check_desktops(DesktopValidator *v, const KeyInfo *info, DesktopSpan value, guint line_no) {
+    DesktopSpan item;
+    gsize pos = 0;
+    while (list_next(value, &pos, &item)) {
+        if (item.length > 0 && !span_has_prefix(item, "X-") &&
+            !span_in(item, known_desktops, G_N_ELEMENTS(known_desktops))) {
+            report(v, DESKTOP_ISSUE_ERROR, line_no, "%s: unknown desktop environment \"%.*s\"",
+                   info->name, (int)item.length, item.data);
+        }
+    }
+}
+
+static void check_mime_types(DesktopValidator *v, DesktopSpan value, guint line_no) {
+    DesktopSpan item;
+    gsize pos = 0;
+    while (list_next(value, &pos, &item)) {
+        if (item.length == 0) {
+            continue;
+        }
+        const gchar *slash = memchr(item.data, '/', item.length);
+        gboolean valid = slash && slash != item.data && slash != item.data + item.length - 1 &&
+                         !memchr(slash + 1, '/', item.data + item.length - slash - 1);
+        for (gsize i = 0; valid && i < item.length; i++) {
+            valid = g_ascii_isgraph(item.data[i]);
+        }
+        if (!valid) {
+            report(v, DESKTOP_ISSUE_ERROR, line_no, "MimeType: \"%.*s\" is not a MIME type",
+                   (int)item.length, item.data);
+        }
+    }
+}
+
+static gboolean action_id_is_valid(DesktopSpan id) {
+    for (gsize i = 0; i < id.length; i++) {
+        if (!is_key_char(id.data[i])) {
+            return FALSE;
+        }
+    }
+    return id.length > 0;
+}
+
+static void check_icon(DesktopValidator *v, DesktopSpan value, guint line_no) {
+    static const gchar *extensions[] = { ".png", ".svg", ".xpm" };
+    if (value.length == 0 || value.data[0] == '/') {
+        return;
+    }
+    for (guint i = 0; i < G_N_ELEMENTS(extensions); i++) {
+        if (value.length > 4 && memcmp(value.data + value.length - 4, extensions[i], 4) == 0) {
+            report(v, DESKTOP_ISSUE_WARNING, line_no,
+                   "Icon: \"%.*s\" is not an absolute path, so it should be an icon name without extension",
+                   (int)value.length, value.data);
+            return;
+        }
+    }
+}
+
+static void check_key(DesktopValidator *v, const DesktopLine *line, guint line_no) {
+    for (gsize i = 0; i < line->name.length; i++) {
+        if (!is_key_char(line->name.data[i])) {
+            report(v, DESKTOP_ISSUE_ERROR, line_no, "Invalid key name \"%.*s\"; keys may only contain A-Za-z0-9-",
+                   (int)line->name.length, line->name.data);
+            return;
+        }
+    }
+    if (line->locale.length > 0 && !locale_is_valid(line->locale)) {
+        report(v, DESKTOP_ISSUE_ERROR, line_no, "%.*s: invalid locale \"%.*s\"",
+               (int)line->name.length, line->name.data, (int)line->locale.length, line->locale.data);
+    }
+    if (!seen_add(v, line->name, line->locale)) {
+        if (line->locale.length > 0) {
+            report(v, DESKTOP_ISSUE_ERROR, line_no, "Key \"%.*s[%.*s]\" appears more than once in this group",
+                   (int)line->name.length, line->name.data, (int)line->locale.length, line->locale.data);
+        } else {
+            report(v, DESKTOP_ISSUE_ERROR, line_no, "Key \"%.*s\" appears more than once in this group",
+                   (int)line->name.length, line->name.data);
+        }
+        return;
+    }
+    
+    // Extension groups and keys are not specified any further
+    if (v->group_kind == GROUP_EXTENSION || v->group_kind == GROUP_UNKNOWN ||
+        span_has_prefix(line->name, "X-")) {
+        return;
+    }
+    
+    const KeyInfo *info = key_lookup(line->name);
+    if (!info) {
+        report(v, DESKTOP_ISSUE_ERROR, line_no, "Unknown key \"%.*s\"; extension keys start with X-",
+               (int)line->name.length, line->name.data);
+        return;
+    }
+    if (v->group_kind == GROUP_ACTION && !(info->flags & KEY_ACTION)) {
+        report(v, DESKTOP_ISSUE_ERROR, line_no, "%s is not allowed in a [Desktop Action] group", info->name);
+        return;
+    }
+    
+    gboolean localized = line->locale.length > 0;
+    if (localized && info->type != VALUE_LOCALESTRING && info->type != VALUE_ICONSTRING &&
+        info->type != VALUE_LOCALESTRINGS) {
+        report(v, DESKTOP_ISSUE_ERROR, line_no, "%s cannot be localized", info->name);
+    }
+    guint *first_line = localized ? &v->localized_line[info - known_keys] : &v->key_line[info - known_keys];
+    if (*first_line == 0) {
+        *first_line = line_no;
+    }
+    if (info->flags & KEY_DEPRECATED) {
+        report(v, DESKTOP_ISSUE_WARNING, line_no, "%s is deprecated", info->name);
+    }
+    
+    check_value(v, info, line, line_no);
+    
+    const gchar *key = info->name;
+    DesktopSpan value = line->value;
+    if (strcmp(key, "Exec") == 0) {
+        check_exec(v, value, line_no);
+    } else if (strcmp(key, "Icon") == 0) {
+        check_icon(v, value, line_no);
+    }
+    if (v->group_kind != GROUP_MAIN || localized) {
+        return;
+    }
+    
+    if (strcmp(key, "Type") == 0) {
+        check_type(v, value, line_no);
+    } else if (strcmp(key, "Version") == 0) {
+        if (!span_in(value, known_versions, G_N_ELEMENTS(known_versions))) {
+            report(v, DESKTOP_ISSUE_WARNING, line_no, "Version: unknown specification version \"%.*s\"",
+                   (int)value.length, value.data);
+        }
+    } else if (strcmp(key, "Name") == 0) {
+        v->name = value;
+    } else if (strcmp(key, "Comment") == 0) {
+        v->comment = value;
+    } else if (strcmp(key, "GenericName") == 0) {
+        v->generic_name = value;
+    } else if (strcmp(key, "DBusActivatable") == 0) {
+        v->dbus_activatable = desktop_span_equal(value, "true");
+    } else if (strcmp(key, "Categories") == 0) {
+        check_categories(v, value, line_no);
+    } else if (strcmp(key, "OnlyShowIn") == 0 || strcmp(key, "NotShowIn") == 0) {
+        check_desktops(v, info, value, line_no);
+    } else if (strcmp(key, "MimeType") == 0) {
+        check_mime_types(v, value, line_no);
+    } else if (strcmp(key, "Actions") == 0) {
+        DesktopSpan item;
+        gsize pos = 0;
+        v->actions = value;
+        v->actions_line = line_no;
+        while (list_next(value, &pos, &item)) {
+            if (item.length > 0 && !action_id_is_valid(item)) {
+                report(v, DESKTOP_ISSUE_ERROR, line_no, "Actions: invalid action identifier \"%.*s\"",
+                       (int)item.length, item.data);
+            }
+        }
+    }
+}
+
+// Checks that need the whole group
+
+static void check_localized_keys(DesktopValidator *v) {
+    for (guint i = 0; i < N_KNOWN_KEYS; i++) {
+        if (v->localized_line[i] && !v->key_line[i]) {
+            report(v, DESKTOP_ISSUE_ERROR, v->localized_line[i], "Localized %s without an unlocalized %s",
+                   known_keys[i].name, known_keys[i].name);
+        }
+    }
+}
+
+static void check_main_group(DesktopValidator *v) {
+    guint line = v->group_line;
+    
+    if (!key_seen(v, "Type")) {
+        report(v, DESKTOP_ISSUE_ERROR, line, "Required key Type is missing");
+    }
+    if (!key_seen(v, "Name")) {
+        report(v, DESKTOP_ISSUE_ERROR, line, "Required key Name is missing");
+    }
+    if (v->type == ENTRY_TYPE_APPLICATION && !key_seen(v, "Exec") && !v->dbus_activatable) {
+        report(v, DESKTOP_ISSUE_ERROR, line, "Exec is required for Type=Application unless DBusActivatable=true");
+    }
+    if (v->type == ENTRY_TYPE_LINK && !key_seen(v, "URL")) {
+        report(v, DESKTOP_ISSUE_ERROR, line, "URL is required for Type=Link");
+    }
+    
+    // Keys that belong to another type
+    for (guint i = 0; i < N_KNOWN_KEYS; i++) {
+        guint key_line = v->key_line[i] ? v->key_line[i] : v->localized_line[i];
+        if (!key_line || v->type == ENTRY_TYPE_MISSING || v->type == ENTRY_TYPE_OTHER) {
+            continue;
+        }
+        if ((known_keys[i].flags & KEY_APPLICATION) && v->type != ENTRY_TYPE_APPLICATION) {
+            report(v, DESKTOP_ISSUE_WARNING, key_line, "%s is only used by Type=Application", known_keys[i].name);
+        } else if ((known_keys[i].flags & KEY_LINK) && v->type != ENTRY_TYPE_LINK) {
+            report(v, DESKTOP_ISSUE_WARNING, key_line, "%s is only used by Type=Link", known_keys[i].name);
+        }
+    }
+    check_localized_keys(v);
+    
+    guint only_show_in = key_seen(v, "OnlyShowIn");
+    if (only_show_in && key_seen(v, "NotShowIn")) {
+        report(v, DESKTOP_ISSUE_ERROR, only_show_in, "OnlyShowIn and NotShowIn must not both be set");
+    }
+    
+    if (v->categories_line) {
+        for (DesktopCategory c = DESKTOP_CATEGORY_SCREENSAVER; c <= DESKTOP_CATEGORY_SHELL; c++) {
+            if (desktop_categories_has(&v->categories, c) && !only_show_in) {
+                report(v, DESKTOP_ISSUE_ERROR, v->categories_line,
+                       "Categories: reserved category %s requires OnlyShowIn", desktop_category_get_name(c));
+            }
+        }
+        DesktopCategory unrelated = desktop_categories_check(&v->categories);
+        if (unrelated != DESKTOP_CATEGORY_INVALID) {
+            report(v, DESKTOP_ISSUE_WARNING, v->categories_line,
+                   "Categories: %s should come with one of its related categories",
+                   desktop_category_get_name(unrelated));
+        }
+        if (!desktop_categories_is_empty(&v->categories) &&
+            !desktop_categories_intersects(&v->categories, desktop_categories_get_main())) {
+            report(v, DESKTOP_ISSUE_HINT, v->categories_line, "Categories: no Main category is listed");
+        }
+    }
+    
+    if (v->name.data && v->comment.data && span_equal(v->name, v->comment)) {
+        report(v, DESKTOP_ISSUE_HINT, key_seen(v, "Comment"), "Comment repeats Name");
+    }
+    if (v->name.data && v->generic_name.data && span_equal(v->name, v->generic_name)) {
+        report(v, DESKTOP_ISSUE_HINT, key_seen(v, "GenericName"), "GenericName repeats Name");
+    }
+}
+
+static void check_action_group(DesktopValidator *v) {
+    if (!key_seen(v, "Name")) {
+        report(v, DESKTOP_ISSUE_ERROR, v->group_line, "Required key Name is missing");
+    }
+    if (!key_seen(v, "Exec") && !v->dbus_activatable) {
+        report(v, DESKTOP_ISSUE_ERROR, v->group_line, "Exec is required in actions unless DBusActivatable=true");
+    }
+    check_localized_keys(v);
+}
+
+static void group_end(DesktopValidator *v) {
+    if (v->group_kind == GROUP_MAIN) {
+        check_main_group(v);
+    } else if (v->group_kind == GROUP_ACTION) {
+        check_action_group(v);
+    }
+}
+
+static void group_start(DesktopValidator *v, const DesktopLine *line, guint line_no) {
+    DesktopSpan name = line->name;
+    
+    v->group_line = line_no;
+    memset(v->key_line, 0, sizeof(v->key_line));
+    memset(v->localized_line, 0, sizeof(v->localized_line));
+    g_array_set_size(v->seen, 0);
+    memset(v->slots, 0, v->n_slots * sizeof(guint32));
+    
+    for (gsize i = 0; i < name.length; i++) {
+        if (name.data[i] == '[' || name.data[i] == ']' || (guchar)name.data[i] < 0x20) {
+            report(v, DESKTOP_ISSUE_ERROR, line_no, "Invalid group name \"%.*s\"", (int)name.length, name.data);
+            v->group_kind = GROUP_UNKNOWN;
+            return;
+        }
+    }
+    for (guint i = 0; i < v->groups->len; i++) {
+        if (span_equal(g_array_index(v->groups, DesktopSpan, i), name)) {
+            report(v, DESKTOP_ISSUE_ERROR, line_no, "Group [%.*s] appears more than once",
+                   (int)name.length, name.data);
+            v->group_kind = GROUP_UNKNOWN;
+            return;
+        }
+    }
+    g_array_append_val(v->groups, name);
+    
+    if (v->groups->len == 1 && !desktop_span_equal(name, "Desktop Entry")) {
+        report(v, DESKTOP_ISSUE_ERROR, line_no, "The first group must be [Desktop Entry]");
+    }
+    
+    if (desktop_span_equal(name, "Desktop Entry")) {
+        v->group_kind = GROUP_MAIN;
+    } else if (span_has_prefix(name, "Desktop Action ")) {
+        ActionGroup action = { { name.data + 15, name.length - 15 }, line_no };
+        v->group_kind = GROUP_ACTION;
+        if (!action_id_is_valid(action.id)) {
+            report(v, DESKTOP_ISSUE_ERROR, line_no, "Invalid action identifier in [%.*s]",
+                   (int)name.length, name.data);
+        }
+        g_array_append_val(v->action_groups, action);
+    } else if (span_has_prefix(name, "X-")) {
+        v->group_kind = GROUP_EXTENSION;
+    } else {
+        report(v, DESKTOP_ISSUE_ERROR, line_no, "Unknown group [%.*s]; extension groups start with X-",
+               (int)name.length, name.data);
+        v->group_kind = GROUP_UNKNOWN;
+    }
+}
+
+static void check_actions(DesktopValidator *v) {
+    DesktopSpan item;
+    gsize pos = 0;
+    
+    while (v->actions_line && list_next(v->actions, &pos, &item)) {
+        gboolean found = FALSE;
+        for (guint i = 0; !found && i < v->action_groups->len; i++) {
+            found = span_equal(g_array_index(v->action_groups, ActionGroup, i).id, item);
+        }
+        if (item.length > 0 && !found) {
+            report(v, DESKTOP_ISSUE_ERROR, v->actions_line, "Actions: \"%.*s\" has no [Desktop Action %.*s] group",
+                   (int)item.length, item.data, (int)item.length, item.data);
+        }
+    }
+    
+    for (guint i = 0; i < v->action_groups->len; i++) {
+        ActionGroup *action = &g_array_index(v->action_groups, ActionGroup, i);
+        gboolean listed = FALSE;
+        pos = 0;
+        while (!listed && v->actions_line && list_next(v->actions, &pos, &item)) {
+            listed = span_equal(item, action->id);
+        }
+        if (!listed) {
+            report(v, DESKTOP_ISSUE_WARNING, action->line, "Action \"%.*s\" is not listed in Actions",
+                   (int)action->id.length, action->id.data);
+        }
+    }
+}
+
+static gint compare_issues(gconstpointer a, gconstpointer b, gpointer user_data) {
+    (void)user_data;  // Suppress unused parameter warning
+    guint line_a = ((const DesktopIssue*)a)->line;
+    guint line_b = ((const DesktopIssue*)b)->line;
+    return line_a < line_b ? -1 : line_a > line_b;
+}
+
+guint desktop_validator_check(DesktopValidator *v, const gchar *data, gsize length, GArray *issues) {
+    guint first_issue = issues ? issues->len : 0;
+    v->issues = issues;
+    v->n_errors = 0;
+    v->group_kind = GROUP_NONE;
+    g_array_set_size(v->groups, 0);
+    g_array_set_size(v->action_groups, 0);
+    v->type = ENTRY_TYPE_MISSING;
+    v->dbus_activatable = FALSE;
+    v->name.data = v->comment.data = v->generic_name.data = NULL;
+    v->actions_line = 0;
+    v->categories_line = 0;
+    desktop_categories_clear(&v->categories);
+    
+    const gchar *p = data;
+    const gchar *end = data + length;
+    guint line_no = 0;
+    while (p < end) {
+        const gchar *nl = memchr(p, '\n', end - p);
+        gsize line_length = nl ? (gsize)(nl - p + 1) : (gsize)(end - p);
+        DesktopLine line;
+        desktop_parse_line(p, line_length, &line);
+        line_no++;
+        
+        if (!g_utf8_validate(p, line_length, NULL)) {
+            report(v, DESKTOP_ISSUE_ERROR, line_no, "Line is not valid UTF-8");
+        } else if (line.kind == DESKTOP_LINE_INVALID) {
+            report(v, DESKTOP_ISSUE_ERROR, line_no, "Line is not a group header, a comment or a key=value pair");
+        } else if (line.kind == DESKTOP_LINE_GROUP) {
+            group_end(v);
+            group_start(v, &line, line_no);
+        } else if (line.kind == DESKTOP_LINE_KEY) {
+            if (v->group_kind == GROUP_NONE) {
+                report(v, DESKTOP_ISSUE_ERROR, line_no, "Key outside of any group");
+            } else {
+                check_key(v, &line, line_no);
+            }
+        }
+        p += line_length;
+    }
+    group_end(v);
+    
+    if (v->groups->len == 0) {
+        report(v, DESKTOP_ISSUE_ERROR, 0, "No [Desktop Entry] group");
+    }
+    check_actions(v);
+    
+    // Group and file checks report after the lines; present them in line
+    // order (the sort is stable, so same-line issues keep theirs)
+    if (issues && issues->len - first_issue > 1) {
+        g_qsort_with_data(&g_array_index(issues, DesktopIssue, first_issue), issues->len - first_issue,
+                          sizeof(DesktopIssue), compare_issues, NULL);
+    }
+    v->issues = NULL;
+    return v->n_errors;
+}
+
+guint desktop_validate(const gchar *data, gsize length, GArray *issues) {
+    DesktopValidator *v = desktop_validator_new();
+    guint n_errors = desktop_validator_check(v, data, length, issues);
+    desktop_validator_free(v);
+    return n_errors;
+}
+
+// Bulk validation
+
+typedef struct {
+    DesktopValidateResult **results;
+    guint n_files;
+    guint64 bytes;           // Updated atomically by the jobs
+} ValidateContext;
+
+void desktop_validate_result_free(DesktopValidateResult *result) {
+    if (result) {
+        g_free(result->path);
+        g_free(result->read_error);
+        if (result->issues) {
+            g_array_unref(result->issues);
+        }
+        g_free(result);
+    }
+}
+
+static gboolean is_validated_file(const gchar *name) {
+    return g_str_has_suffix(name, ".desktop") || g_str_has_suffix(name, ".directory");
+}
+
+static void collect_files(const gchar *dir_path, GPtrArray *files) {
+    DIR *handle = opendir(dir_path);
+    if (!handle) {
+        return;
+    }
+    
+    struct dirent *ent;
+    while ((ent = readdir(handle)) != NULL) {
+        if (ent->d_name[0] == '.') {
+            continue;
+        }
+        
+        gchar *child = g_build_filename(dir_path, ent->d_name, NULL);
+        gboolean is_dir = ent->d_type == DT_DIR;
+        if (ent->d_type == DT_UNKNOWN) {
+            struct stat st;
+            is_dir = lstat(child, &st) == 0 && S_ISDIR(st.st_mode);
+        }
+        
+        if (is_dir) {
+            collect_files(child, files);
+            g_free(child);
+        } else if (is_validated_file(ent->d_name)) {
+            g_ptr_array_add(files, child);
+        } else {
+            g_free(child);
+        }
+    }
+    closedir(handle);
+}
+
+static gint compare_paths(gconstpointer a, gconstpointer b) {
+    return strcmp(*(const gchar * const *)a, *(const gchar * const *)b);
+}
+
+// Reads path into *buffer (grown as needed). Returns the length, or -1 with
+// errno set.
+static gssize read_file(const gchar *path, gchar **buffer, gsize *capacity) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        int saved_errno = errno;
+        close(fd);
+        errno = saved_errno;
+        return -1;
+    }
+    if (S_ISDIR(st.st_mode)) {
+        close(fd);
+        errno = EISDIR;
+        return -1;
+    }
+    
+    gsize length = 0;
+    for (;;) {
+        if (length + MAX((gsize)st.st_size, 4096) + 1 > *capacity) {
+            *capacity = length + MAX((gsize)st.st_size, 4096) + 1;
+            *buffer = g_realloc(*buffer, *capacity);
+        }
+        gssize n = read(fd, *buffer + length, *capacity - length - 1);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            int saved_errno = errno;
+            close(fd);
+            errno = saved_errno;
+            return -1;
+        }
+        if (n == 0) {
+            break;
+        }
+        length += n;
+    }
+    close(fd);
+    return length;
+}
+
+static void validate_chunk_thread(gpointer data, gpointer user_data) {
+    ValidateContext *context = user_data;
+    guint start = (GPOINTER_TO_UINT(data) - 1) * VALIDATE_CHUNK;
+    guint end = MIN(start + VALIDATE_CHUNK, context->n_files);
+    DesktopValidator *validator = desktop_validator_new();
+    GArray *issues = desktop_issues_new();
+    gchar *buffer = NULL;
+    gsize capacity = 0;
+    guint64 bytes = 0;
+    
+    for (guint i = start; i < end; i++) {
+        DesktopValidateResult *result = context->results[i];
+        gssize length = read_file(result->path, &buffer, &capacity);
+        if (length < 0) {
+            result->read_error = g_strdup(g_strerror(errno));
+            continue;
+        }
+        bytes += length;
+        
+        result->n_errors = desktop_validator_check(validator, buffer, length, issues);
+        if (issues->len > 0) {
+            for (guint j = 0; j < issues->len; j++) {
+                result->n_warnings += g_array_index(issues, DesktopIssue, j).level == DESKTOP_ISSUE_WARNING;
+            }
+            result->issues = issues;
+            issues = desktop_issues_new();
+        }
+    }
+    
+    __atomic_fetch_add(&context->bytes, bytes, __ATOMIC_RELAXED);
+    g_free(buffer);
+    g_array_unref(issues);
+    desktop_validator_free(validator);
+}
+
+GPtrArray* desktop_validate_paths(const gchar * const *paths, guint n_threads,
+                                  DesktopValidateStats *stats) {
+    GPtrArray *files = g_ptr_array_new();
+    for (guint i = 0; paths[i] != NULL; i++) {
+        struct stat st;
+        if (stat(paths[i], &st) == 0 && S_ISDIR(st.st_mode)) {
+            guint first = files->len;
+            collect_files(paths[i], files);
+            // Directory order is arbitrary; keep reports reproducible
+            qsort(files->pdata + first, files->len - first, sizeof(gpointer), compare_paths);
+        } else {
+            // Including missing files, which are reported as unreadable
+            g_ptr_array_add(files, g_strdup(paths[i]));
+        }
+    }
+    
+    GPtrArray *results = g_ptr_array_new_full(files->len, (GDestroyNotify)desktop_validate_result_free);
+    for (guint i = 0; i < files->len; i++) {
+        DesktopValidateResult *result = g_new0(DesktopValidateResult, 1);
+        result->path = g_ptr_array_index(files, i);
+        g_ptr_array_add(results, result);
+    }
+    g_ptr_array_free(files, TRUE);
+    
+    ValidateContext context;
+    context.results = (DesktopValidateResult**)results->pdata;
+    context.n_files = results->len;
+    context.bytes = 0;
+    
+    gint64 start_us = g_get_monotonic_time();
+    gint max_threads = n_threads > 0 ? (gint)n_threads : MAX((gint)g_get_num_processors(), 1);
+    GThreadPool *pool = g_thread_pool_new(validate_chunk_thread, &context, max_threads, FALSE, NULL);
+    for (guint chunk = 0; chunk * VALIDATE_CHUNK < context.n_files; chunk++) {
+        g_thread_pool_push(pool, GUINT_TO_POINTER(chunk + 1), NULL);
+    }
+    g_thread_pool_free(pool, FALSE, TRUE);
+    
+    if (stats) {
+        stats->files = results->len;
+        stats->files_with_errors = 0;
+        for (guint i = 0; i < results->len; i++) {
+            DesktopValidateResult *result = g_ptr_array_index(results, i);
+            stats->files_with_errors += result->n_errors > 0 || result->read_error;
+        }
+        stats->bytes = context.bytes;
+        stats->elapsed_us = g_get_monotonic_time() - start_us;
+    }
+    return results;
+}
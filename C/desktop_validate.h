@@ -0,0 +1,70 @@
+#ifndef DESKTOP_VALIDATE_H
+#define DESKTOP_VALIDATE_H
+
+#include <glib.h>
+
+// Desktop Entry Specification validator.
+// Checks what desktop-file-validate checks: group and key syntax, required
+// keys, value types and escapes, locale suffixes, Categories rules (unknown,
+// related and reserved categories), OnlyShowIn/NotShowIn, Actions and their
+// groups, and the Exec field codes and quoting. A document is checked in one
+// pass over its buffer without copying it; a DesktopValidator keeps its
+// scratch tables between documents, so checking many files allocates only
+// for the issues found.
+
+typedef enum {
+    DESKTOP_ISSUE_ERROR,      // Violates the specification
+    DESKTOP_ISSUE_WARNING,    // Deprecated or likely to be a mistake
+    DESKTOP_ISSUE_HINT        // Could be improved
+} DesktopIssueLevel;
+
+typedef struct {
+    DesktopIssueLevel level;
+    guint line;               // 1-based, 0 for the whole file
+    gchar *message;
+} DesktopIssue;
+
+typedef struct _DesktopValidator DesktopValidator;
+
+// A GArray of DesktopIssue that frees the messages
+GArray* desktop_issues_new(void);
+const gchar* desktop_issue_level_to_string(DesktopIssueLevel level);
+
+DesktopValidator* desktop_validator_new(void);
+void desktop_validator_free(DesktopValidator *validator);
+
+// Appends the problems of the document in data to issues (may be NULL to
+// only count them) and returns the number of errors
+guint desktop_validator_check(DesktopValidator *validator, const gchar *data, gsize length,
+                              GArray *issues);
+
+// One-off check of a document
+guint desktop_validate(const gchar *data, gsize length, GArray *issues);
+
+// Bulk validation
+
+typedef struct {
+    gchar *path;
+    gchar *read_error;        // Set when the file could not be read
+    GArray *issues;           // DesktopIssue, NULL when there were none
+    guint n_errors;
+    guint n_warnings;
+} DesktopValidateResult;
+
+typedef struct {
+    guint files;
+    guint files_with_errors;
+    guint64 bytes;
+    gint64 elapsed_us;        // Reading and checking, without the walk
+} DesktopValidateStats;
+
+// Checks paths, which may be .desktop and .directory files or directory
+// trees to search for them, on n_threads worker threads (0 = one per CPU).
+// Returns DesktopValidateResult* in a stable order (the order of paths,
+// then sorted within each tree).
+GPtrArray* desktop_validate_paths(const gchar * const *paths, guint n_threads,
+                                  DesktopValidateStats *stats);
+
+void desktop_validate_result_free(DesktopValidateResult *result);
+
+#endif // DESKTOP_VALIDATE_H
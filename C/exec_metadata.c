@@ -0,0 +1,859 @@
+#define _GNU_SOURCE
+#include "exec_metadata.h"
+#include "desktop_parser.h"
+#include "file_utils.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+// squashfs 4.0 (see squashfs_fs.h in the kernel)
+#define SQUASHFS_MAGIC 0x73717368
+#define SQUASHFS_SUPERBLOCK_SIZE 96
+#define SQUASHFS_METADATA_SIZE 8192
+#define SQUASHFS_COMPRESSED_BIT 0x8000          // In metadata headers: set = stored
+#define SQUASHFS_BLOCK_UNCOMPRESSED (1u << 24)  // In data block sizes
+#define SQUASHFS_NO_FRAGMENT 0xffffffffu
+#define SQUASHFS_FRAGMENTS_PER_BLOCK (SQUASHFS_METADATA_SIZE / 16)
+#define SQUASHFS_GZIP 1
+
+// Inode types
+#define SQUASHFS_DIR 1
+#define SQUASHFS_FILE 2
+#define SQUASHFS_SYMLINK 3
+#define SQUASHFS_LDIR 8
+#define SQUASHFS_LFILE 9
+#define SQUASHFS_LSYMLINK 10
+
+#define METADATA_SYMLINK_DEPTH 8
+#define METADATA_MAX_DESKTOP (1 << 20)
+#define METADATA_MAX_ICON (8 << 20)
+
+// Decoded metadata blocks, keyed by position
+typedef struct {
+    guchar data[SQUASHFS_METADATA_SIZE];
+    gsize length;
+    guint64 next;             // Position of the following block
+} SquashBlock;
+
+typedef struct {
+    const guchar *base;       // Start of the image in the mapping
+    guint64 size;             // Bytes from base to the end of the file
+    guint32 block_size;
+    guint64 inode_table;
+    guint64 directory_table;
+    guint64 fragment_table;
+    guint32 n_fragments;
+    guint64 root_inode;
+    GConverter *zlib;
+    GHashTable *blocks;       // guint64* position -> SquashBlock*
+    guint64 bytes_read;
+    gchar *error;
+} Squash;
+
+// A position in a metadata table
+typedef struct {
+    guint64 block;
+    guint offset;
+} SquashCursor;
+
+typedef struct {
+    guint16 type;
+    guint32 dir_block;        // Directories
+    guint16 dir_offset;
+    guint32 dir_size;
+    guint64 blocks_start;     // Regular files
+    guint32 fragment;
+    guint32 fragment_offset;
+    guint64 file_size;
+    SquashCursor block_sizes;
+    gchar *target;            // Symbolic links
+} SquashInode;
+
+static guint16 get_u16(const guchar *p) {
+    return (guint16)(p[0] | (p[1] << 8));
+}
+
+static guint32 get_u32(const guchar *p) {
+    return (guint32)p[0] | ((guint32)p[1] << 8) | ((guint32)p[2] << 16) | ((guint32)p[3] << 24);
+}
+
+static guint64 get_u64(const guchar *p) {
+    return (guint64)get_u32(p) | ((guint64)get_u32(p + 4) << 32);
+}
+
+static gboolean squash_fail(Squash *sq, const gchar *message) {
+    if (!sq->error) {
+        sq->error = g_strdup(message);
+    }
+    return FALSE;
+}
+
+// Decompresses one block; stored blocks are copied
+static gboolean squash_decode(Squash *sq, guint64 pos, gsize length, gboolean compressed,
+                              guchar *out, gsize capacity, gsize *out_length) {
+    if (pos > sq->size || length > sq->size - pos) {
+        return squash_fail(sq, "squashfs block lies beyond the end of the file");
+    }
+    sq->bytes_read += length;
+    const guchar *in = sq->base + pos;
+    
+    if (!compressed) {
+        if (length > capacity) {
+            return squash_fail(sq, "squashfs block is larger than its table allows");
+        }
+        memcpy(out, in, length);
+        *out_length = length;
+        return TRUE;
+    }
+    
+    g_converter_reset(sq->zlib);
+    gsize in_done = 0;
+    gsize out_done = 0;
+    for (;;) {
+        gsize bytes_in = 0;
+        gsize bytes_out = 0;
+        GError *error = NULL;
+        GConverterResult result = g_converter_convert(sq->zlib, in + in_done, length - in_done,
+                                                      out + out_done, capacity - out_done,
+                                                      G_CONVERTER_INPUT_AT_END, &bytes_in, &bytes_out, &error);
+        in_done += bytes_in;
+        out_done += bytes_out;
+        if (result == G_CONVERTER_FINISHED) {
+            break;
+        }
+        if (result == G_CONVERTER_ERROR || (bytes_in == 0 && bytes_out == 0)) {
+            g_clear_error(&error);
+            return squash_fail(sq, "squashfs block does not decompress");
+        }
+    }
+    *out_length = out_done;
+    return TRUE;
+}
+
+static const SquashBlock* squash_metadata_block(Squash *sq, guint64 pos) {
+    SquashBlock *block = g_hash_table_lookup(sq->blocks, &pos);
+    if (block) {
+        return block;
+    }
+    if (pos > sq->size || sq->size - pos < 2) {
+        squash_fail(sq, "squashfs table lies beyond the end of the file");
+        return NULL;
+    }
+    
+    guint16 header = get_u16(sq->base + pos);
+    gsize length = header & ~SQUASHFS_COMPRESSED_BIT;
+    block = g_new(SquashBlock, 1);
+    if (!squash_decode(sq, pos + 2, length, !(header & SQUASHFS_COMPRESSED_BIT),
+                       block->data, sizeof(block->data), &block->length)) {
+        g_free(block);
+        return NULL;
+    }
+    block->next = pos + 2 + length;
+    sq->bytes_read += 2;
+    
+    guint64 *key = g_new(guint64, 1);
+    *key = pos;
+    g_hash_table_insert(sq->blocks, key, block);
+    return block;
+}
+
+// Copies length bytes from a metadata table, moving on to the next block
+// as needed
+static gboolean squash_read(Squash *sq, SquashCursor *cursor, void *out, gsize length) {
+    guchar *dest = out;
+    while (length > 0) {
+        const SquashBlock *block = squash_metadata_block(sq, cursor->block);
+        if (!block) {
+            return FALSE;
+        }
+        if (cursor->offset >= block->length) {
+            if (block->length == 0) {
+                return squash_fail(sq, "empty squashfs metadata block");
+            }
+            cursor->offset -= block->length;
+            cursor->block = block->next;
+            continue;
+        }
+        gsize n = MIN(length, block->length - cursor->offset);
+        memcpy(dest, block->data + cursor->offset, n);
+        dest += n;
+        cursor->offset += n;
+        length -= n;
+    }
+    return TRUE;
+}
+
+static gboolean squash_read_inode(Squash *sq, guint64 ref, SquashInode *inode) {
+    SquashCursor cursor = { sq->inode_table + (ref >> 16), ref & 0xffff };
+    guchar buffer[40];
+    memset(inode, 0, sizeof(*inode));
+    
+    if (!squash_read(sq, &cursor, buffer, 16)) {
+        return FALSE;
+    }
+    inode->type = get_u16(buffer);
+    
+    switch (inode->type) {
+        case SQUASHFS_DIR:
+            if (!squash_read(sq, &cursor, buffer, 16)) return FALSE;
+            inode->dir_block = get_u32(buffer);
+            inode->dir_size = get_u16(buffer + 8);
+            inode->dir_offset = get_u16(buffer + 10);
+            return TRUE;
+        case SQUASHFS_LDIR:
+            if (!squash_read(sq, &cursor, buffer, 24)) return FALSE;
+            inode->dir_size = get_u32(buffer + 4);
+            inode->dir_block = get_u32(buffer + 8);
+            inode->dir_offset = get_u16(buffer + 18);
+            return TRUE;
+        case SQUASHFS_FILE:
+            if (!squash_read(sq, &cursor, buffer, 16)) return FALSE;
+            inode->blocks_start = get_u32(buffer);
+            inode->fragment = get_u32(buffer + 4);
+            inode->fragment_offset = get_u32(buffer + 8);
+            inode->file_size = get_u32(buffer + 12);
+            inode->block_sizes = cursor;
+            return TRUE;
+        case SQUASHFS_LFILE:
+            if (!squash_read(sq, &cursor, buffer, 40)) return FALSE;
+            inode->blocks_start = get_u64(buffer);
+            inode->file_size = get_u64(buffer + 8);
+            inode->fragment = get_u32(buffer + 28);
+            inode->fragment_offset = get_u32(buffer + 32);
+            inode->block_sizes = cursor;
+            return TRUE;
+        case SQUASHFS_SYMLINK:
+        case SQUASHFS_LSYMLINK: {
+            if (!squash_read(sq, &cursor, buffer, 8)) return FALSE;
+            guint32 length = get_u32(buffer + 4);
+            if (length == 0 || length > 4096) {
+                return squash_fail(sq, "squashfs symbolic link is too long");
+            }
+            inode->target = g_malloc(length + 1);
+            if (!squash_read(sq, &cursor, inode->target, length)) {
+                g_clear_pointer(&inode->target, g_free);
+                return FALSE;
+            }
+            inode->target[length] = '\0';
+            return TRUE;
+        }
+        default:
+            // Devices, fifos and sockets have nothing to offer
+            return TRUE;
+    }
+}
+
+static void squash_inode_clear(SquashInode *inode) {
+    g_clear_pointer(&inode->target, g_free);
+}
+
+static gboolean squash_is_dir(const SquashInode *inode) {
+    return inode->type == SQUASHFS_DIR || inode->type == SQUASHFS_LDIR;
+}
+
+// Calls func for each entry of dir until it returns TRUE
+typedef gboolean (*SquashDirFunc)(const gchar *name, guint64 ref, gpointer user_data);
+
+static gboolean squash_list_dir(Squash *sq, const SquashInode *dir, SquashDirFunc func, gpointer user_data) {
+    // The size counts the implicit . and .. as 3 bytes
+    if (dir->dir_size <= 3) {
+        return TRUE;
+    }
+    SquashCursor cursor = { sq->directory_table + dir->dir_block, dir->dir_offset };
+    gsize remaining = dir->dir_size - 3;
+    
+    while (remaining >= 12) {
+        guchar header[12];
+        if (!squash_read(sq, &cursor, header, 12)) {
+            return FALSE;
+        }
+        remaining -= 12;
+        guint32 count = get_u32(header) + 1;
+        guint32 start = get_u32(header + 4);
+        
+        for (guint32 i = 0; i < count; i++) {
+            guchar entry[8];
+            gchar name[257];
+            if (remaining < 8 || !squash_read(sq, &cursor, entry, 8)) {
+                return squash_fail(sq, "squashfs directory is truncated");
+            }
+            gsize name_length = get_u16(entry + 6) + 1;
+            if (name_length > 256 || remaining - 8 < name_length ||
+                !squash_read(sq, &cursor, name, name_length)) {
+                return squash_fail(sq, "squashfs directory is truncated");
+            }
+            remaining -= 8 + name_length;
+            name[name_length] = '\0';
+            
+            guint64 ref = ((guint64)start << 16) | get_u16(entry);
+            if (func(name, ref, user_data)) {
+                return TRUE;
+            }
+        }
+    }
+    return TRUE;
+}
+
+typedef struct {
+    const gchar *name;
+    guint64 ref;
+    gboolean found;
+} SquashFind;
+
+static gboolean squash_find_func(const gchar *name, guint64 ref, gpointer user_data) {
+    SquashFind *find = user_data;
+    if (strcmp(name, find->name) == 0) {
+        find->ref = ref;
+        find->found = TRUE;
+    }
+    return find->found;
+}
+
+// Resolves path from the root of the image, following symbolic links
+// (relative to their directory, or to the image root when absolute).
+// Returns FALSE without an error when the path does not exist.
+static gboolean squash_lookup(Squash *sq, const gchar *path, SquashInode *inode, guint depth) {
+    if (depth > METADATA_SYMLINK_DEPTH) {
+        return squash_fail(sq, "too many levels of symbolic links in the AppImage");
+    }
+    
+    gchar **parts = g_strsplit(path, "/", -1);
+    GArray *dirs = g_array_new(FALSE, FALSE, sizeof(guint64));   // Refs from the root down
+    GString *resolved = g_string_new(NULL);                      // Path of the last dir in dirs
+    gboolean success = FALSE;
+    g_array_append_val(dirs, sq->root_inode);
+    
+    if (!squash_read_inode(sq, sq->root_inode, inode)) {
+        goto out;
+    }
+    for (guint i = 0; parts[i]; i++) {
+        const gchar *part = parts[i];
+        if (part[0] == '\0' || strcmp(part, ".") == 0) {
+            continue;
+        }
+        if (strcmp(part, "..") == 0) {
+            if (dirs->len > 1) {
+                g_array_set_size(dirs, dirs->len - 1);
+                gchar *slash = strrchr(resolved->str, '/');
+                g_string_truncate(resolved, slash ? (gsize)(slash - resolved->str) : 0);
+            }
+            squash_inode_clear(inode);
+            if (!squash_read_inode(sq, g_array_index(dirs, guint64, dirs->len - 1), inode)) {
+                goto out;
+            }
+            continue;
+        }
+        if (!squash_is_dir(inode)) {
+            goto out;
+        }
+        
+        SquashFind find = { part, 0, FALSE };
+        if (!squash_list_dir(sq, inode, squash_find_func, &find) || !find.found) {
+            goto out;
+        }
+        squash_inode_clear(inode);
+        if (!squash_read_inode(sq, find.ref, inode)) {
+            goto out;
+        }
+        
+        if (inode->target) {
+            // Start over with the link replaced by its target
+            GString *next = g_string_new(inode->target[0] == '/' ? NULL : resolved->str);
+            g_string_append_printf(next, "/%s", inode->target);
+            for (guint j = i + 1; parts[j]; j++) {
+                g_string_append_printf(next, "/%s", parts[j]);
+            }
+            squash_inode_clear(inode);
+            success = squash_lookup(sq, next->str, inode, depth + 1);
+            g_string_free(next, TRUE);
+            goto out;
+        }
+        if (squash_is_dir(inode)) {
+            g_array_append_val(dirs, find.ref);
+            g_string_append_printf(resolved, "/%s", part);
+        }
+    }
+    success = TRUE;
+
+out:
+    if (!success) {
+        squash_inode_clear(inode);
+    }
+    g_string_free(resolved, TRUE);
+    g_array_unref(dirs);
+    g_strfreev(parts);
+    return success;
+}
+
+// Fragment that holds the tail of a file: its position and stored size
+static gboolean squash_fragment(Squash *sq, guint32 index, guint64 *start, guint32 *size) {
+    if (index >= sq->n_fragments) {
+        return squash_fail(sq, "squashfs fragment index out of range");
+    }
+    guint64 pointer = sq->fragment_table + (guint64)(index / SQUASHFS_FRAGMENTS_PER_BLOCK) * 8;
+    if (pointer > sq->size || sq->size - pointer < 8) {
+        return squash_fail(sq, "squashfs fragment table lies beyond the end of the file");
+    }
+    sq->bytes_read += 8;
+    
+    SquashCursor cursor = { get_u64(sq->base + pointer), (index % SQUASHFS_FRAGMENTS_PER_BLOCK) * 16 };
+    guchar entry[16];
+    if (!squash_read(sq, &cursor, entry, 16)) {
+        return FALSE;
+    }
+    *start = get_u64(entry);
+    *size = get_u32(entry + 8);
+    return TRUE;
+}
+
+// Reads a whole regular file, refusing ones larger than max_size
+static GBytes* squash_read_file(Squash *sq, const SquashInode *inode, gsize max_size) {
+    if (inode->type != SQUASHFS_FILE && inode->type != SQUASHFS_LFILE) {
+        squash_fail(sq, "not a regular file");
+        return NULL;
+    }
+    if (inode->file_size > max_size) {
+        squash_fail(sq, "embedded file is implausibly large");
+        return NULL;
+    }
+    
+    gsize size = inode->file_size;
+    gboolean has_fragment = inode->fragment != SQUASHFS_NO_FRAGMENT;
+    guint64 n_blocks = has_fragment ? size / sq->block_size : (size + sq->block_size - 1) / sq->block_size;
+    guchar *data = g_malloc0(MAX(size, 1));
+    guchar *block = g_malloc(sq->block_size);
+    SquashCursor sizes = inode->block_sizes;
+    guint64 pos = inode->blocks_start;
+    gsize done = 0;
+    
+    for (guint64 i = 0; i < n_blocks; i++) {
+        guchar word[4];
+        if (!squash_read(sq, &sizes, word, 4)) {
+            goto fail;
+        }
+        guint32 stored = get_u32(word);
+        gsize length = stored & ~SQUASHFS_BLOCK_UNCOMPRESSED;
+        gsize wanted = MIN(sq->block_size, size - done);
+        if (length == 0) {
+            // Sparse block, already zeroed
+            done += wanted;
+            continue;
+        }
+        gsize decoded = 0;
+        if (!squash_decode(sq, pos, length, !(stored & SQUASHFS_BLOCK_UNCOMPRESSED),
+                           block, sq->block_size, &decoded) || decoded < wanted) {
+            squash_fail(sq, "squashfs data block is short");
+            goto fail;
+        }
+        memcpy(data + done, block, wanted);
+        done += wanted;
+        pos += length;
+    }
+    
+    if (has_fragment && done < size) {
+        guint64 start;
+        guint32 stored;
+        gsize decoded = 0;
+        if (!squash_fragment(sq, inode->fragment, &start, &stored) ||
+            !squash_decode(sq, start, stored & ~SQUASHFS_BLOCK_UNCOMPRESSED,
+                           !(stored & SQUASHFS_BLOCK_UNCOMPRESSED), block, sq->block_size, &decoded)) {
+            goto fail;
+        }
+        if (inode->fragment_offset > decoded || decoded - inode->fragment_offset < size - done) {
+            squash_fail(sq, "squashfs fragment is short");
+            goto fail;
+        }
+        memcpy(data + done, block + inode->fragment_offset, size - done);
+    }
+    
+    g_free(block);
+    return g_bytes_new_take(data, size);
+
+fail:
+    g_free(block);
+    g_free(data);
+    return NULL;
+}
+
+static GBytes* squash_read_path(Squash *sq, const gchar *path, gsize max_size) {
+    SquashInode inode;
+    if (!squash_lookup(sq, path, &inode, 0)) {
+        return NULL;
+    }
+    GBytes *bytes = squash_read_file(sq, &inode, max_size);
+    squash_inode_clear(&inode);
+    return bytes;
+}
+
+static gboolean squash_open(Squash *sq, const guchar *base, guint64 size) {
+    memset(sq, 0, sizeof(*sq));
+    sq->base = base;
+    sq->size = size;
+    if (size < SQUASHFS_SUPERBLOCK_SIZE || get_u32(base) != SQUASHFS_MAGIC) {
+        return squash_fail(sq, "no squashfs image follows the ELF runtime");
+    }
+    sq->bytes_read = SQUASHFS_SUPERBLOCK_SIZE;
+    
+    guint16 compressor = get_u16(base + 20);
+    guint16 block_log = get_u16(base + 22);
+    sq->block_size = get_u32(base + 12);
+    sq->n_fragments = get_u32(base + 16);
+    if (get_u16(base + 28) != 4) {
+        return squash_fail(sq, "unsupported squashfs version");
+    }
+    if (block_log < 12 || block_log > 20 || sq->block_size != (1u << block_log)) {
+        return squash_fail(sq, "corrupt squashfs superblock");
+    }
+    if (compressor != SQUASHFS_GZIP) {
+        static const gchar *names[] = { NULL, "gzip", "lzma", "lzo", "xz", "lz4", "zstd" };
+        gchar *message = g_strdup_printf("squashfs images compressed with %s are not supported",
+                                         compressor < G_N_ELEMENTS(names) && names[compressor] ?
+                                         names[compressor] : "an unknown method");
+        squash_fail(sq, message);
+        g_free(message);
+        return FALSE;
+    }
+    
+    sq->root_inode = get_u64(base + 32);
+    sq->inode_table = get_u64(base + 64);
+    sq->directory_table = get_u64(base + 72);
+    sq->fragment_table = get_u64(base + 80);
+    sq->zlib = G_CONVERTER(g_zlib_decompressor_new(G_ZLIB_COMPRESSOR_FORMAT_ZLIB));
+    sq->blocks = g_hash_table_new_full(g_int64_hash, g_int64_equal, g_free, g_free);
+    return TRUE;
+}
+
+static void squash_close(Squash *sq) {
+    g_clear_object(&sq->zlib);
+    g_clear_pointer(&sq->blocks, g_hash_table_destroy);
+    g_clear_pointer(&sq->error, g_free);
+}
+
+static guint16 elf_u16(const guchar *p, gboolean big_endian) {
+    return big_endian ? (guint16)((p[0] << 8) | p[1]) : get_u16(p);
+}
+
+static guint32 elf_u32(const guchar *p, gboolean big_endian) {
+    return big_endian ? ((guint32)p[0] << 24) | ((guint32)p[1] << 16) | ((guint32)p[2] << 8) | p[3] : get_u32(p);
+}
+
+static guint64 elf_u64(const guchar *p, gboolean big_endian) {
+    return big_endian ? ((guint64)elf_u32(p, TRUE) << 32) | elf_u32(p + 4, TRUE) : get_u64(p);
+}
+
+// Finds the image behind the ELF runtime: it starts where the section
+// header table ends
+static gboolean elf_appimage_offset(const guchar *map, gsize size, guint *appimage_type,
+                                    guint64 *offset, gchar **error_msg) {
+    if (size < 64 || memcmp(map, "\177ELF", 4) != 0) {
+        *error_msg = g_strdup("Not an ELF executable");
+        return FALSE;
+    }
+    // AppImage magic in e_ident padding: 'A' 'I' <type>
+    *appimage_type = map[8] == 'A' && map[9] == 'I' ? map[10] : 0;
+    if (*appimage_type == 1) {
+        *error_msg = g_strdup("Type 1 (ISO 9660) AppImages are not supported");
+        return FALSE;
+    }
+    
+    gboolean big_endian = map[5] == 2;
+    guint64 shoff;
+    guint16 shentsize, shnum;
+    if (map[4] == 2) {
+        shoff = elf_u64(map + 0x28, big_endian);
+        shentsize = elf_u16(map + 0x3a, big_endian);
+        shnum = elf_u16(map + 0x3c, big_endian);
+    } else {
+        shoff = elf_u32(map + 0x20, big_endian);
+        shentsize = elf_u16(map + 0x2e, big_endian);
+        shnum = elf_u16(map + 0x30, big_endian);
+    }
+    
+    *offset = shoff + (guint64)shentsize * shnum;
+    if (shoff == 0 || *offset + SQUASHFS_SUPERBLOCK_SIZE > size ||
+        get_u32(map + *offset) != SQUASHFS_MAGIC) {
+        *error_msg = g_strdup(*appimage_type == 2 ? "The AppImage has no squashfs image after its runtime"
+                                                  : "Plain ELF executable without embedded metadata");
+        return FALSE;
+    }
+    *appimage_type = 2;
+    return TRUE;
+}
+
+typedef struct {
+    gchar *desktop_file;
+    gboolean has_dir_icon;
+} RootScan;
+
+static gboolean root_scan_func(const gchar *name, guint64 ref, gpointer user_data) {
+    (void)ref;  // Suppress unused parameter warning
+    RootScan *scan = user_data;
+    if (!scan->desktop_file && g_str_has_suffix(name, ".desktop")) {
+        scan->desktop_file = g_strdup(name);
+    } else if (strcmp(name, ".DirIcon") == 0) {
+        scan->has_dir_icon = TRUE;
+    }
+    return FALSE;
+}
+
+static void read_desktop_fields(ExecMetadata *meta, GBytes *desktop) {
+    gsize length = 0;
+    const gchar *data = g_bytes_get_data(desktop, &length);
+    DesktopDocument *doc = desktop_document_new_from_data(data ? data : "", length);
+    guint group = desktop_document_find_group(doc, "Desktop Entry");
+    const DesktopLine *line;
+    
+    if ((line = desktop_document_lookup(doc, group, "Name", NULL))) {
+        meta->name = desktop_span_unescape(line->value, FALSE);
+    }
+    if ((line = desktop_document_lookup(doc, group, "Comment", NULL))) {
+        meta->comment = desktop_span_unescape(line->value, FALSE);
+    }
+    if ((line = desktop_document_lookup(doc, group, "Icon", NULL))) {
+        meta->icon = desktop_span_unescape(line->value, FALSE);
+    }
+    if ((line = desktop_document_lookup(doc, group, "Categories", NULL))) {
+        meta->categories = desktop_span_unescape(line->value, TRUE);
+    }
+    desktop_document_free(doc);
+}
+
+// Identifies the icon format from its first bytes
+static void sniff_icon(ExecMetadata *meta) {
+    gsize length = 0;
+    const guchar *data = g_bytes_get_data(meta->icon_data, &length);
+    if (length >= 24 && memcmp(data, "\211PNG\r\n\032\n", 8) == 0) {
+        meta->icon_extension = "png";
+        meta->icon_size = ((guint)data[16] << 24) | ((guint)data[17] << 16) | ((guint)data[18] << 8) | data[19];
+    } else if (length >= 9 && memcmp(data, "/* XPM */", 9) == 0) {
+        meta->icon_extension = "xpm";
+    } else {
+        // SVG may start with an XML declaration, a comment or <svg itself
+        meta->icon_extension = "svg";
+    }
+}
+
+static void read_icon(ExecMetadata *meta, Squash *sq, gboolean has_dir_icon) {
+    if (has_dir_icon) {
+        meta->icon_data = squash_read_path(sq, ".DirIcon", METADATA_MAX_ICON);
+    }
+    // The specification also puts <Icon>.{png,svg,xpm} in the root
+    static const gchar *extensions[] = { "png", "svg", "xpm" };
+    for (guint i = 0; !meta->icon_data && meta->icon && !strchr(meta->icon, '/') && i < G_N_ELEMENTS(extensions); i++) {
+        gchar *name = g_strdup_printf("%s.%s", meta->icon, extensions[i]);
+        meta->icon_data = squash_read_path(sq, name, METADATA_MAX_ICON);
+        g_free(name);
+    }
+    if (meta->icon_data) {
+        sniff_icon(meta);
+    }
+}
+
+ExecMetadata* exec_metadata_read(const gchar *path, ExecMetadataFlags flags, gchar **error_msg) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC | O_NOCTTY);
+    if (fd < 0) {
+        *error_msg = g_strdup_printf("Cannot open %s: %s", path, g_strerror(errno));
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+        close(fd);
+        *error_msg = g_strdup_printf("%s is not a regular file", path);
+        return NULL;
+    }
+    
+    gsize size = st.st_size;
+    guchar *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        *error_msg = g_strdup_printf("Cannot map %s: %s", path, g_strerror(errno));
+        return NULL;
+    }
+    // Only a handful of scattered pages are needed; readahead would pull
+    // in megabytes of compressed application around each of them
+    posix_madvise(map, size, POSIX_MADV_RANDOM);
+    
+    ExecMetadata *meta = g_new0(ExecMetadata, 1);
+    Squash sq;
+    memset(&sq, 0, sizeof(sq));
+    if (!elf_appimage_offset(map, size, &meta->appimage_type, &meta->squashfs_offset, error_msg)) {
+        goto fail;
+    }
+    if (!squash_open(&sq, map + meta->squashfs_offset, size - meta->squashfs_offset)) {
+        goto fail_squash;
+    }
+    
+    SquashInode root;
+    RootScan scan = { NULL, FALSE };
+    if (!squash_read_inode(&sq, sq.root_inode, &root) || !squash_is_dir(&root) ||
+        !squash_list_dir(&sq, &root, root_scan_func, &scan)) {
+        g_free(scan.desktop_file);
+        squash_fail(&sq, "cannot read the root directory of the AppImage");
+        goto fail_squash;
+    }
+    
+    if (scan.desktop_file) {
+        meta->desktop_file = scan.desktop_file;
+        GBytes *desktop = squash_read_path(&sq, scan.desktop_file, METADATA_MAX_DESKTOP);
+        if (desktop) {
+            read_desktop_fields(meta, desktop);
+            g_bytes_unref(desktop);
+        }
+    }
+    if (flags & (EXEC_METADATA_ICON | EXEC_METADATA_INSTALL_ICON)) {
+        read_icon(meta, &sq, scan.has_dir_icon);
+    }
+    if (!meta->desktop_file && !meta->icon_data) {
+        squash_fail(&sq, "the AppImage contains no .desktop file");
+        goto fail_squash;
+    }
+    
+    // The ELF header, then what the image needed
+    meta->bytes_read = 64 + sq.bytes_read;
+    squash_close(&sq);
+    munmap(map, size);
+    
+    // A failed install leaves icon_path unset; the rest is still good
+    if ((flags & EXEC_METADATA_INSTALL_ICON) && meta->icon_data) {
+        exec_metadata_install_icon(meta, &meta->icon_error);
+    }
+    return meta;
+
+fail_squash:
+    *error_msg = g_strdup_printf("%s: %s", path, sq.error ? sq.error : "cannot read the AppImage");
+    squash_close(&sq);
+    munmap(map, size);
+    exec_metadata_free(meta);
+    return NULL;
+
+fail:
+    munmap(map, size);
+    exec_metadata_free(meta);
+    return NULL;
+}
+
+void exec_metadata_free(ExecMetadata *meta) {
+    if (meta) {
+        g_free(meta->desktop_file);
+        g_free(meta->name);
+        g_free(meta->comment);
+        g_free(meta->icon);
+        g_free(meta->categories);
+        if (meta->icon_data) {
+            g_bytes_unref(meta->icon_data);
+        }
+        g_free(meta->icon_path);
+        g_free(meta->icon_error);
+        g_free(meta);
+    }
+}
+
+gboolean exec_metadata_install_icon(ExecMetadata *meta, gchar **error_msg) {
+    if (!meta->icon_data) {
+        *error_msg = g_strdup("The AppImage has no icon");
+        return FALSE;
+    }
+    
+    // The icon is named after Icon= so that the theme name resolves too
+    gchar *base = meta->icon && meta->icon[0] != '\0' && !strchr(meta->icon, '/') ?
+                  g_strdup(meta->icon) : file_utils_sanitize_filename(meta->name);
+    gchar *size_dir = g_strcmp0(meta->icon_extension, "svg") == 0 ? g_strdup("scalable") :
+                      meta->icon_size > 0 ? g_strdup_printf("%ux%u", meta->icon_size, meta->icon_size) :
+                      g_strdup("48x48");
+    gchar *dir = g_build_filename(g_get_user_data_dir(), "icons", "hicolor", size_dir, "apps", NULL);
+    gchar *file_name = g_strdup_printf("%s.%s", base, meta->icon_extension);
+    gchar *path = g_build_filename(dir, file_name, NULL);
+    gboolean success = FALSE;
+    
+    if (file_utils_ensure_directory_exists(dir, error_msg)) {
+        gsize length = 0;
+        const gchar *data = g_bytes_get_data(meta->icon_data, &length);
+        GError *error = NULL;
+        success = g_file_set_contents(path, data, length, &error);
+        if (success) {
+            g_free(meta->icon_path);
+            meta->icon_path = g_steal_pointer(&path);
+        } else {
+            *error_msg = g_strdup_printf("Failed to install icon: %s", error->message);
+            g_error_free(error);
+        }
+    }
+    
+    g_free(path);
+    g_free(file_name);
+    g_free(dir);
+    g_free(size_dir);
+    g_free(base);
+    return success;
+}
+
+static gboolean is_empty(const gchar *str) {
+    return !str || str[0] == '\0';
+}
+
+void exec_metadata_apply(const ExecMetadata *meta, DesktopEntry *entry) {
+    if (is_empty(entry->name) && meta->name) {
+        g_free(entry->name);
+        entry->name = g_strdup(meta->name);
+    }
+    if (is_empty(entry->comment) && meta->comment) {
+        g_free(entry->comment);
+        entry->comment = g_strdup(meta->comment);
+    }
+    if (is_empty(entry->icon_path) && (meta->icon_path || meta->icon)) {
+        g_free(entry->icon_path);
+        entry->icon_path = g_strdup(meta->icon_path ? meta->icon_path : meta->icon);
+    }
+    if (desktop_categories_is_empty(&entry->categories) && meta->categories) {
+        desktop_categories_parse(&entry->categories, meta->categories, -1);
+    }
+}
+
+typedef struct {
+    gchar *path;
+    ExecMetadataFlags flags;
+} MetadataTask;
+
+static void metadata_task_free(gpointer data) {
+    MetadataTask *read = data;
+    g_free(read->path);
+    g_free(read);
+}
+
+static void metadata_thread(GTask *task, gpointer source_object, gpointer task_data,
+                            GCancellable *cancellable) {
+    (void)source_object;  // Suppress unused parameter warning
+    (void)cancellable;    // Checked through the task
+    MetadataTask *read = task_data;
+    
+    if (g_task_return_error_if_cancelled(task)) {
+        return;
+    }
+    gchar *error_msg = NULL;
+    ExecMetadata *meta = exec_metadata_read(read->path, read->flags, &error_msg);
+    if (meta) {
+        g_task_return_pointer(task, meta, (GDestroyNotify)exec_metadata_free);
+    } else {
+        g_task_return_new_error(task, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED, "%s", error_msg);
+        g_free(error_msg);
+    }
+}
+
+void exec_metadata_read_async(const gchar *path, ExecMetadataFlags flags, GCancellable *cancellable,
+                              GAsyncReadyCallback callback, gpointer user_data) {
+    MetadataTask *read = g_new0(MetadataTask, 1);
+    read->path = g_strdup(path);
+    read->flags = flags;
+    
+    GTask *task = g_task_new(NULL, cancellable, callback, user_data);
+    g_task_set_task_data(task, read, metadata_task_free);
+    g_task_run_in_thread(task, metadata_thread);
+    g_object_unref(task);
+}
+
+ExecMetadata* exec_metadata_read_finish(GAsyncResult *result, GError **error) {
+    return g_task_propagate_pointer(G_TASK(result), error);
+}
@@ -0,0 +1,62 @@
+#ifndef EXEC_METADATA_H
+#define EXEC_METADATA_H
+
+#include <glib.h>
+#include <gio/gio.h>
+#include "desktop_entry.h"
+
+// Metadata embedded in executables.
+// A type 2 AppImage is an ELF runtime with a squashfs image appended right
+// after the ELF section headers. The image's root holds the application's
+// .desktop file and its icon (.DirIcon). The file is mapped without
+// readahead and only the superblock, the root directory and the blocks of
+// those two files are decoded, so reading a few hundred megabytes of
+// AppImage costs a few pages. Plain ELF binaries carry no such metadata.
+//
+// Squashfs images compressed with gzip (mksquashfs' default) or stored
+// uncompressed are understood; xz, lzo, lz4 and zstd images are reported
+// as unsupported, as are type 1 (ISO 9660) AppImages.
+
+typedef enum {
+    EXEC_METADATA_ICON         = 1 << 0,  // Also load the icon
+    EXEC_METADATA_INSTALL_ICON = 1 << 1   // ... and install it (implies ICON)
+} ExecMetadataFlags;
+
+typedef struct {
+    guint appimage_type;        // 2; the extractor fails for anything else
+    guint64 squashfs_offset;    // Where the image starts in the file
+    gchar *desktop_file;        // Name of the embedded .desktop file
+    gchar *name;                // Fields of the embedded entry, NULL when absent
+    gchar *comment;
+    gchar *icon;                // Icon= as written, usually a theme name
+    gchar *categories;
+    GBytes *icon_data;          // With EXEC_METADATA_ICON, NULL if there is none
+    const gchar *icon_extension; // "png", "svg" or "xpm"
+    guint icon_size;            // Pixel width of a PNG icon, 0 otherwise
+    gchar *icon_path;           // With EXEC_METADATA_INSTALL_ICON, where it went
+    gchar *icon_error;          // ... or why it could not be installed
+    guint64 bytes_read;         // Bytes of the file decoded, headers included
+} ExecMetadata;
+
+// Reads the metadata of the executable at path. Returns NULL with an error
+// when it is not a type 2 AppImage or its image cannot be read.
+ExecMetadata* exec_metadata_read(const gchar *path, ExecMetadataFlags flags, gchar **error_msg);
+
+void exec_metadata_free(ExecMetadata *meta);
+
+// Writes the icon into the user's hicolor theme
+// ($XDG_DATA_HOME/icons/hicolor/<size>/apps, or scalable/apps for SVG)
+// under the name of Icon=, and sets icon_path
+gboolean exec_metadata_install_icon(ExecMetadata *meta, gchar **error_msg);
+
+// Fills the fields of entry that are still empty: Name, Comment,
+// Categories, and Icon (the installed icon's path if there is one,
+// otherwise the Icon= name)
+void exec_metadata_apply(const ExecMetadata *meta, DesktopEntry *entry);
+
+// Reads on a worker thread
+void exec_metadata_read_async(const gchar *path, ExecMetadataFlags flags, GCancellable *cancellable,
+                              GAsyncReadyCallback callback, gpointer user_data);
+ExecMetadata* exec_metadata_read_finish(GAsyncResult *result, GError **error);
+
+#endif // EXEC_METADATA_H
@@ -0,0 +1,368 @@
+#define _GNU_SOURCE
+#include "file_classify.h"
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+// Magic signatures matched at a fixed offset of the header
+typedef struct {
+    gsize offset;
+    const gchar *magic;
+    gsize length;
+    FileType type;
+} FileMagic;
+
+static const FileMagic file_magics[] = {
+    { 0, "\177ELF", 4, FILE_TYPE_ELF },
+    { 0, "PK\003\004", 4, FILE_TYPE_JAVA_JAR },
+};
+
+// Shebang interpreters; a name also matches when followed by a version,
+// e.g. "python3.11" or "perl5"
+typedef struct {
+    const gchar *name;
+    FileType type;
+} FileInterpreter;
+
+static const FileInterpreter file_interpreters[] = {
+    { "python", FILE_TYPE_PYTHON },
+    { "pypy", FILE_TYPE_PYTHON },
+    { "bash", FILE_TYPE_SHELL },
+    { "sh", FILE_TYPE_SHELL },
+    { "dash", FILE_TYPE_SHELL },
+    { "zsh", FILE_TYPE_SHELL },
+    { "ksh", FILE_TYPE_SHELL },
+    { "mksh", FILE_TYPE_SHELL },
+    { "ash", FILE_TYPE_SHELL },
+    { "perl", FILE_TYPE_PERL },
+    { "ruby", FILE_TYPE_RUBY },
+    { "node", FILE_TYPE_NODE },
+    { "nodejs", FILE_TYPE_NODE },
+};
+
+// File name extensions that decide the type without reading the file
+typedef struct {
+    const gchar *suffix;
+    FileType type;
+} FileExtension;
+
+static const FileExtension file_extensions[] = {
+    { ".py", FILE_TYPE_PYTHON },
+    { ".sh", FILE_TYPE_SHELL },
+    { ".bash", FILE_TYPE_SHELL },
+    { ".jar", FILE_TYPE_JAVA_JAR },
+    { ".pl", FILE_TYPE_PERL },
+    { ".rb", FILE_TYPE_RUBY },
+    { ".js", FILE_TYPE_NODE },
+};
+
+FileType file_classify_by_extension(const gchar *name) {
+    if (!name) {
+        return FILE_TYPE_UNKNOWN;
+    }
+    
+    gsize name_len = strlen(name);
+    for (gsize i = 0; i < G_N_ELEMENTS(file_extensions); i++) {
+        gsize suffix_len = strlen(file_extensions[i].suffix);
+        if (name_len >= suffix_len &&
+            g_ascii_strcasecmp(name + name_len - suffix_len, file_extensions[i].suffix) == 0) {
+            return file_extensions[i].type;
+        }
+    }
+    return FILE_TYPE_UNKNOWN;
+}
+
+static guint16 read_u16(const guchar *p, gboolean big_endian) {
+    return big_endian ? (guint16)((p[0] << 8) | p[1]) : (guint16)((p[1] << 8) | p[0]);
+}
+
+static void classify_elf(const guchar *header, gsize length, FileClassification *result) {
+    result->type = FILE_TYPE_ELF;
+    
+    if (length < 20) {
+        return;
+    }
+    
+    result->elf_class = header[4];
+    gboolean big_endian = header[5] == 2;
+    if (big_endian) {
+        result->flags |= FILE_CLASSIFY_ELF_BIG_ENDIAN;
+    }
+    result->elf_machine = read_u16(header + 18, big_endian);
+    
+    // AppImages carry "AI" plus the format version in EI_PAD (bytes 8-10)
+    if (header[8] == 'A' && header[9] == 'I' && (header[10] == 1 || header[10] == 2)) {
+        result->type = FILE_TYPE_APPIMAGE;
+        result->appimage_type = header[10];
+    }
+}
+
+static void classify_zip(const guchar *header, gsize length, const gchar *name,
+                         FileClassification *result) {
+    // A JAR is a zip whose first entry is META-INF/ (or that is named *.jar)
+    static const gchar meta_inf[] = "META-INF/";
+    result->type = FILE_TYPE_OTHER;
+    
+    if (length >= 30 + sizeof(meta_inf) - 1) {
+        guint16 name_len = read_u16(header + 26, FALSE);
+        if (name_len >= sizeof(meta_inf) - 1 &&
+            memcmp(header + 30, meta_inf, sizeof(meta_inf) - 1) == 0) {
+            result->type = FILE_TYPE_JAVA_JAR;
+            return;
+        }
+    }
+    if (file_classify_by_extension(name) == FILE_TYPE_JAVA_JAR) {
+        result->type = FILE_TYPE_JAVA_JAR;
+    }
+}
+
+static FileType match_interpreter(const gchar *name, gsize len) {
+    for (gsize i = 0; i < G_N_ELEMENTS(file_interpreters); i++) {
+        gsize prefix_len = strlen(file_interpreters[i].name);
+        if (len < prefix_len || memcmp(name, file_interpreters[i].name, prefix_len) != 0) {
+            continue;
+        }
+        
+        // Allow only a version suffix after the name
+        gsize j = prefix_len;
+        while (j < len && (g_ascii_isdigit(name[j]) || name[j] == '.')) {
+            j++;
+        }
+        if (j == len) {
+            return file_interpreters[i].type;
+        }
+    }
+    return FILE_TYPE_UNKNOWN;
+}
+
+// Splits the next blank-separated token off [*pos, end)
+static gboolean next_token(const gchar **pos, const gchar *end, const gchar **token, gsize *token_len) {
+    const gchar *p = *pos;
+    while (p < end && (*p == ' ' || *p == '\t')) {
+        p++;
+    }
+    if (p == end) {
+        return FALSE;
+    }
+    
+    *token = p;
+    while (p < end && *p != ' ' && *p != '\t') {
+        p++;
+    }
+    *token_len = p - *token;
+    *pos = p;
+    return TRUE;
+}
+
+static void token_basename(const gchar **token, gsize *token_len) {
+    for (gsize i = *token_len; i > 0; i--) {
+        if ((*token)[i - 1] == '/') {
+            *token += i;
+            *token_len -= i;
+            return;
+        }
+    }
+}
+
+static void classify_shebang(const guchar *header, gsize length, FileClassification *result) {
+    const gchar *line = (const gchar*)header + 2;
+    const gchar *end = memchr(line, '\n', length - 2);
+    if (!end) {
+        end = (const gchar*)header + length;
+    }
+    if (end > line && end[-1] == '\r') {
+        result->flags |= FILE_CLASSIFY_CRLF;
+        end--;
+    }
+    
+    result->flags |= FILE_CLASSIFY_SHEBANG;
+    result->type = FILE_TYPE_OTHER;
+    
+    const gchar *pos = line;
+    const gchar *token;
+    gsize token_len;
+    if (!next_token(&pos, end, &token, &token_len)) {
+        return;
+    }
+    token_basename(&token, &token_len);
+    
+    // "#!/usr/bin/env [-S] [-i] [VAR=value ...] interpreter"
+    if (token_len == 3 && memcmp(token, "env", 3) == 0) {
+        result->flags |= FILE_CLASSIFY_ENV;
+        gboolean found = FALSE;
+        while (next_token(&pos, end, &token, &token_len)) {
+            if (token[0] == '-') {
+                if (token_len >= 2 && token[1] == 'S') {
+                    result->flags |= FILE_CLASSIFY_ENV_SPLIT;
+                    if (token_len > 2) {
+                        // "-Sinterpreter" glued together
+                        token += 2;
+                        token_len -= 2;
+                        found = TRUE;
+                        break;
+                    }
+                } else if ((token_len == 2 && (token[1] == 'u' || token[1] == 'C')) ||
+                           (token_len == 7 && memcmp(token, "--unset", 7) == 0) ||
+                           (token_len == 7 && memcmp(token, "--chdir", 7) == 0)) {
+                    // Options that take a separate argument
+                    const gchar *skipped;
+                    gsize skipped_len;
+                    next_token(&pos, end, &skipped, &skipped_len);
+                }
+                continue;
+            }
+            if (memchr(token, '=', token_len)) {
+                continue; // Environment assignment
+            }
+            found = TRUE;
+            break;
+        }
+        if (!found) {
+            return;
+        }
+        token_basename(&token, &token_len);
+    }
+    
+    gsize copy_len = MIN(token_len, sizeof(result->interpreter) - 1);
+    memcpy(result->interpreter, token, copy_len);
+    result->interpreter[copy_len] = '\0';
+    
+    FileType type = match_interpreter(token, token_len);
+    if (type != FILE_TYPE_UNKNOWN) {
+        result->type = type;
+    }
+}
+
+void file_classify_buffer(const guchar *header, gsize length, const gchar *name,
+                          guint mode, FileClassification *result) {
+    memset(result, 0, sizeof(*result));
+    if (mode & (S_IXUSR | S_IXGRP | S_IXOTH)) {
+        result->flags |= FILE_CLASSIFY_EXECUTABLE;
+    }
+    
+    // File extension wins, as it always has
+    FileType by_extension = file_classify_by_extension(name);
+    if (by_extension != FILE_TYPE_UNKNOWN && by_extension != FILE_TYPE_JAVA_JAR) {
+        result->type = by_extension;
+        result->flags |= FILE_CLASSIFY_BY_EXTENSION;
+        return;
+    }
+    
+    if (length < 4) {
+        result->type = by_extension;
+        return;
+    }
+    
+    for (gsize i = 0; i < G_N_ELEMENTS(file_magics); i++) {
+        const FileMagic *magic = &file_magics[i];
+        if (length >= magic->offset + magic->length &&
+            memcmp(header + magic->offset, magic->magic, magic->length) == 0) {
+            switch (magic->type) {
+                case FILE_TYPE_ELF:
+                    classify_elf(header, length, result);
+                    break;
+                case FILE_TYPE_JAVA_JAR:
+                    classify_zip(header, length, name, result);
+                    break;
+                default:
+                    result->type = magic->type;
+                    break;
+            }
+            return;
+        }
+    }
+    
+    if (header[0] == '#' && header[1] == '!') {
+        classify_shebang(header, length, result);
+        return;
+    }
+    
+    result->type = by_extension != FILE_TYPE_UNKNOWN ? by_extension : FILE_TYPE_OTHER;
+}
+
+gboolean file_classify_path(const gchar *path, FileClassification *result) {
+    memset(result, 0, sizeof(*result));
+    if (!path) {
+        return FALSE;
+    }
+    
+    int fd = open(path, O_RDONLY | O_CLOEXEC | O_NOCTTY);
+    if (fd < 0) {
+        return FALSE;
+    }
+    
+    struct stat st;
+    guint mode = fstat(fd, &st) == 0 ? st.st_mode : 0;
+    
+    // Skip the read entirely when the name already decides
+    FileType by_extension = file_classify_by_extension(path);
+    if (by_extension != FILE_TYPE_UNKNOWN && by_extension != FILE_TYPE_JAVA_JAR) {
+        close(fd);
+        file_classify_buffer(NULL, 0, path, mode, result);
+        return TRUE;
+    }
+    
+    guchar header[FILE_CLASSIFY_HEADER_SIZE];
+    ssize_t bytes_read;
+    do {
+        bytes_read = read(fd, header, sizeof(header));
+    } while (bytes_read < 0 && errno == EINTR);
+    close(fd);
+    
+    file_classify_buffer(header, bytes_read > 0 ? (gsize)bytes_read : 0, path, mode, result);
+    return TRUE;
+}
+
+const gchar* file_classify_type_name(FileType type) {
+    switch (type) {
+        case FILE_TYPE_ELF:
+            return "ELF";
+        case FILE_TYPE_PYTHON:
+            return "Python";
+        case FILE_TYPE_SHELL:
+            return "Shell";
+        case FILE_TYPE_APPIMAGE:
+            return "AppImage";
+        case FILE_TYPE_JAVA_JAR:
+            return "Java JAR";
+        case FILE_TYPE_PERL:
+            return "Perl";
+        case FILE_TYPE_RUBY:
+            return "Ruby";
+        case FILE_TYPE_NODE:
+            return "Node.js";
+        case FILE_TYPE_OTHER:
+            return "Other";
+        case FILE_TYPE_UNKNOWN:
+        default:
+            return "Unknown";
+    }
+}
+
+const gchar* file_classify_elf_machine_name(guint16 machine) {
+    switch (machine) {
+        case 3:
+            return "x86";
+        case 8:
+            return "MIPS";
+        case 20:
+            return "PowerPC";
+        case 21:
+            return "PowerPC64";
+        case 22:
+            return "S/390";
+        case 40:
+            return "ARM";
+        case 62:
+            return "x86-64";
+        case 183:
+            return "AArch64";
+        case 243:
+            return "RISC-V";
+        default:
+            return "unknown";
+    }
+}
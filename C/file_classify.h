@@ -0,0 +1,61 @@
+#ifndef FILE_CLASSIFY_H
+#define FILE_CLASSIFY_H
+
+#include <glib.h>
+
+// File type detection
+typedef enum {
+    FILE_TYPE_UNKNOWN,
+    FILE_TYPE_ELF,
+    FILE_TYPE_PYTHON,
+    FILE_TYPE_SHELL,
+    FILE_TYPE_OTHER,
+    FILE_TYPE_APPIMAGE,
+    FILE_TYPE_JAVA_JAR,
+    FILE_TYPE_PERL,
+    FILE_TYPE_RUBY,
+    FILE_TYPE_NODE
+} FileType;
+
+// Number of bytes read from the start of a file for classification
+#define FILE_CLASSIFY_HEADER_SIZE 512
+
+// Classification flags
+#define FILE_CLASSIFY_EXECUTABLE   (1 << 0)  // Has an execute bit set
+#define FILE_CLASSIFY_BY_EXTENSION (1 << 1)  // Decided from the file name alone
+#define FILE_CLASSIFY_SHEBANG      (1 << 2)  // Starts with #!
+#define FILE_CLASSIFY_ENV          (1 << 3)  // Shebang goes through /usr/bin/env
+#define FILE_CLASSIFY_ENV_SPLIT    (1 << 4)  // ... with env -S
+#define FILE_CLASSIFY_CRLF         (1 << 5)  // Shebang line ends in \r\n
+#define FILE_CLASSIFY_ELF_BIG_ENDIAN (1 << 6)
+
+// ELF classes (EI_CLASS)
+#define FILE_ELF_CLASS_32 1
+#define FILE_ELF_CLASS_64 2
+
+// Result of classifying one file
+typedef struct {
+    FileType type;
+    guint flags;
+    guint8 elf_class;       // FILE_ELF_CLASS_32/64, 0 if not ELF
+    guint16 elf_machine;    // ELF e_machine (62 = x86-64, 183 = AArch64, ...)
+    guint8 appimage_type;   // 1 or 2 for AppImages, 0 otherwise
+    gchar interpreter[32];  // Shebang interpreter name, e.g. "python3"
+} FileClassification;
+
+// Classifies the file at path with a single open and one bounded read.
+// Returns FALSE (and type FILE_TYPE_UNKNOWN) if the file cannot be opened.
+gboolean file_classify_path(const gchar *path, FileClassification *result);
+
+// Classifies from the first bytes of a file. name is used for the extension
+// fast path and may be NULL; mode is the st_mode of the file (0 if unknown).
+void file_classify_buffer(const guchar *header, gsize length, const gchar *name,
+                          guint mode, FileClassification *result);
+
+// Returns the extension fast-path type for name, or FILE_TYPE_UNKNOWN
+FileType file_classify_by_extension(const gchar *name);
+
+const gchar* file_classify_type_name(FileType type);
+const gchar* file_classify_elf_machine_name(guint16 machine);
+
+#endif // FILE_CLASSIFY_H
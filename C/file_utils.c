@@ -1,8 +1,16 @@
+#define _GNU_SOURCE
 #include "file_utils.h"
+#include "type_cache.h"
+#include "app_index.h"
+#include "app_watch.h"
+#include "desktop_parser.h"
+#include "mime_cache.h"
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <string.h>
+#include <stdio.h>
 #include <glib/gstdio.h>
 #include <gio/gio.h>
 
@@ -12,22 +20,44 @@ FileSaveOptions* file_save_options_new(void) {
     options->save_to_local_apps = FALSE;
     options->save_to_custom = FALSE;
     options->custom_path = NULL;
+    options->overwrite_policy = FILE_OVERWRITE_ASK;
+    options->confirm_overwrite = NULL;
+    options->confirm_data = NULL;
+    options->check_duplicates = TRUE;
+    options->durability = FILE_DURABILITY_FULL;
+    memset(&options->write_stats, 0, sizeof(options->write_stats));
+    options->trust_stats.files = 0;
+    options->trust_stats.marked = 0;
+    options->trust_stats.elapsed_us = 0;
+    options->duplicates = NULL;
     return options;
 }
 
 void file_save_options_free(FileSaveOptions *options) {
     if (options) {
         g_free(options->custom_path);
+        g_strfreev(options->duplicates);
         g_free(options);
     }
 }
 
 gchar* file_utils_get_desktop_directory(void) {
-    return g_build_filename(g_get_home_dir(), "Desktop", NULL);
+    return user_dirs_dup_path(USER_DIR_DESKTOP);
 }
 
 gchar* file_utils_get_local_applications_directory(void) {
-    return g_build_filename(g_get_home_dir(), ".local", "share", "applications", NULL);
+    return user_dirs_dup_path(USER_DIR_APPLICATIONS);
+}
+
+// Whether path is directly in one of the user directories, and its name there
+static gboolean in_user_dir(const gchar *path, UserDir *dir, gchar **name) {
+    gchar *dir_path = g_path_get_dirname(path);
+    gboolean found = user_dirs_find(dir_path, dir);
+    g_free(dir_path);
+    if (found) {
+        *name = g_path_get_basename(path);
+    }
+    return found;
 }
 
 gboolean file_utils_ensure_directory_exists(const gchar *dirpath, gchar **error_msg) {
@@ -40,6 +70,19 @@ gboolean file_utils_ensure_directory_exists(const gchar *dirpath, gchar **error_
     return TRUE;
 }
 
+gboolean file_utils_prepare_directory(FileWriter *writer, const gchar *dir_path, gchar **error_msg) {
+    UserDir dir;
+    if (!user_dirs_find(dir_path, &dir)) {
+        return file_utils_ensure_directory_exists(dir_path, error_msg);
+    }
+    int dir_fd = user_dirs_open(dir, TRUE, error_msg);
+    if (dir_fd < 0) {
+        return FALSE;
+    }
+    file_writer_adopt_dir(writer, dir_path, dir_fd);
+    return TRUE;
+}
+
 gchar* file_utils_sanitize_filename(const gchar *name) {
     if (!name) return g_strdup("my_application");
     
@@ -67,81 +110,283 @@ gchar* file_utils_sanitize_filename(const gchar *name) {
 }
 
 gboolean file_utils_set_executable_permissions(const gchar *filepath, gchar **error_msg) {
-    struct stat st;
-    if (stat(filepath, &st) != 0) {
-        *error_msg = g_strdup_printf("Failed to get file stats for: %s", filepath);
-        return FALSE;
+    // Files in the user directories are changed through their descriptors
+    UserDir dir;
+    gchar *name = NULL;
+    const gchar *target = filepath;
+    int dir_fd = AT_FDCWD;
+    if (in_user_dir(filepath, &dir, &name)) {
+        dir_fd = user_dirs_open(dir, FALSE, error_msg);
+        if (dir_fd < 0) {
+            g_free(name);
+            return FALSE;
+        }
+        target = name;
     }
     
-    mode_t new_mode = st.st_mode | S_IXUSR | S_IXGRP | S_IXOTH;
-    if (chmod(filepath, new_mode) != 0) {
+    struct stat st;
+    gboolean success = FALSE;
+    if (fstatat(dir_fd, target, &st, 0) != 0) {
+        *error_msg = g_strdup_printf("Failed to get file stats for: %s", filepath);
+    } else if (fchmodat(dir_fd, target, st.st_mode | S_IXUSR | S_IXGRP | S_IXOTH, 0) != 0) {
         *error_msg = g_strdup_printf("Failed to set executable permissions for: %s", filepath);
-        return FALSE;
+    } else {
+        success = TRUE;
     }
     
-    return TRUE;
+    if (dir_fd >= 0) {
+        close(dir_fd);
+    }
+    g_free(name);
+    return success;
 }
 
 gboolean file_utils_mark_as_trusted(const gchar *filepath, gchar **error_msg) {
-    gchar *abs_path = g_canonicalize_filename(filepath, NULL);
-    if (!abs_path) {
-        *error_msg = g_strdup_printf("Failed to get absolute path for: %s", filepath);
-        return FALSE;
+    const gchar *filepaths[] = { filepath };
+    return file_utils_mark_as_trusted_batch(filepaths, 1, NULL, error_msg);
+}
+
+// set_mode is FALSE for files the save path created with their final mode
+static gboolean mark_as_trusted(const gchar * const *filepaths, guint n_files, gboolean set_mode,
+                                FileTrustStats *stats, gchar **error_msg) {
+    gint64 start_time = g_get_monotonic_time();
+    guint marked = 0;
+    GString *errors = NULL;
+    
+    // One attribute set shared by the whole batch, written in-process through
+    // GIO's metadata store instead of spawning /usr/bin/gio per file
+    GFileInfo *info = g_file_info_new();
+    g_file_info_set_attribute_string(info, "metadata::trusted", "true");
+    
+    for (guint i = 0; i < n_files; i++) {
+        gchar *abs_path = g_canonicalize_filename(filepaths[i], NULL);
+        
+        // First, ensure the file is executable (this can help with trust)
+        if (set_mode && chmod(abs_path, FILE_UTILS_DESKTOP_MODE) != 0) {
+            // Warning - could not set executable permissions
+        }
+        
+        GFile *file = g_file_new_for_path(abs_path);
+        GError *attr_error = NULL;
+        if (g_file_set_attributes_from_info(file, info, G_FILE_QUERY_INFO_NONE, NULL, &attr_error)) {
+            marked++;
+        } else {
+            if (!errors) errors = g_string_new(NULL);
+            g_string_append_printf(errors, "%s%s: %s", errors->len > 0 ? "\n" : "", abs_path,
+                                   attr_error ? attr_error->message : "Unknown error");
+            if (attr_error) g_error_free(attr_error);
+        }
+        g_object_unref(file);
+        g_free(abs_path);
     }
     
-    // First, ensure the file is executable (this can help with trust)
-    if (chmod(abs_path, S_IRWXU | S_IRGRP | S_IROTH) != 0) {
-        // Warning - could not set executable permissions
+    g_object_unref(info);
+    
+    if (stats) {
+        stats->files = n_files;
+        stats->marked = marked;
+        stats->elapsed_us = g_get_monotonic_time() - start_time;
     }
     
-    // Use g_spawn_sync instead of system() to avoid command injection
-    gchar *argv[] = {"/usr/bin/gio", "set", abs_path, "metadata::trusted", "true", NULL};
-    gchar *stdout_buf = NULL;
-    gchar *stderr_buf = NULL;
-    gint exit_status = 0;
-    GError *spawn_error = NULL;
+    if (errors) {
+        *error_msg = g_string_free(errors, FALSE);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+gboolean file_utils_mark_as_trusted_batch(const gchar * const *filepaths, guint n_files,
+                                          FileTrustStats *stats, gchar **error_msg) {
+    return mark_as_trusted(filepaths, n_files, TRUE, stats, error_msg);
+}
+
+typedef struct {
+    gchar **filepaths;
+    FileTrustStats stats;
+} TrustBatchTask;
+
+static void trust_batch_task_free(gpointer data) {
+    TrustBatchTask *batch = data;
+    g_strfreev(batch->filepaths);
+    g_free(batch);
+}
+
+static void trust_batch_thread(GTask *task, gpointer source_object, gpointer task_data,
+                               GCancellable *cancellable) {
+    (void)source_object;  // Suppress unused parameter warning
+    (void)cancellable;    // Checked through the task
+    TrustBatchTask *batch = task_data;
+    gchar *error_msg = NULL;
+    
+    if (g_task_return_error_if_cancelled(task)) {
+        return;
+    }
     
-    gboolean success = g_spawn_sync(NULL, argv, NULL, G_SPAWN_DEFAULT, 
-                                   NULL, NULL, &stdout_buf, &stderr_buf, 
-                                   &exit_status, &spawn_error);
+    if (file_utils_mark_as_trusted_batch((const gchar * const *)batch->filepaths,
+                                         g_strv_length(batch->filepaths), &batch->stats, &error_msg)) {
+        g_task_return_boolean(task, TRUE);
+    } else {
+        g_task_return_new_error(task, G_IO_ERROR, G_IO_ERROR_FAILED, "%s", error_msg);
+        g_free(error_msg);
+    }
+}
+
+void file_utils_mark_as_trusted_batch_async(const gchar * const *filepaths, guint n_files,
+                                            GCancellable *cancellable,
+                                            GAsyncReadyCallback callback, gpointer user_data) {
+    TrustBatchTask *batch = g_new0(TrustBatchTask, 1);
+    batch->filepaths = g_new0(gchar*, n_files + 1);
+    for (guint i = 0; i < n_files; i++) {
+        batch->filepaths[i] = g_strdup(filepaths[i]);
+    }
+    
+    GTask *task = g_task_new(NULL, cancellable, callback, user_data);
+    g_task_set_task_data(task, batch, trust_batch_task_free);
+    g_task_run_in_thread(task, trust_batch_thread);
+    g_object_unref(task);
+}
+
+gboolean file_utils_mark_as_trusted_batch_finish(GAsyncResult *result, FileTrustStats *stats,
+                                                 GError **error) {
+    GTask *task = G_TASK(result);
+    if (stats) {
+        TrustBatchTask *batch = g_task_get_task_data(task);
+        *stats = batch->stats;
+    }
+    return g_task_propagate_boolean(task, error);
+}
+
+// Looks the entry in content up in the running watch, else in the
+// applications index. Entries at one of the target paths are left out;
+// those are handled by the overwrite policy.
+static gchar** find_duplicate_entries(AppWatch *watch, AppIndex *index, const gchar *content,
+                                      GList *target_paths) {
+    DesktopDocument *doc = desktop_document_new_from_data(content, strlen(content));
+    guint group = desktop_document_find_group(doc, "Desktop Entry");
+    const DesktopLine *name_line = desktop_document_lookup(doc, group, "Name", NULL);
+    const DesktopLine *exec_line = desktop_document_lookup(doc, group, "Exec", NULL);
+    gchar *name = name_line ? desktop_span_unescape(name_line->value, FALSE) : NULL;
+    gchar *exec = exec_line ? desktop_span_unescape(exec_line->value, FALSE) : NULL;
+    gchar *exec_path = exec ? desktop_exec_get_path(exec, NULL) : NULL;
+    desktop_document_free(doc);
+    
+    GPtrArray *duplicates = g_ptr_array_new();
+    if (watch) {
+        gchar **matches = app_watch_find_duplicates(watch, name, exec_path);
+        for (gchar **match = matches; *match; match++) {
+            if (!g_list_find_custom(target_paths, *match, (GCompareFunc)g_strcmp0)) {
+                g_ptr_array_add(duplicates, g_strdup(*match));
+            }
+        }
+        g_strfreev(matches);
+    } else if (index) {
+        GArray *matches = app_index_find_duplicates(index, name, exec_path);
+        for (guint i = 0; i < matches->len; i++) {
+            AppIndexEntry entry;
+            app_index_get_entry(index, g_array_index(matches, guint, i), &entry);
+            if (!g_list_find_custom(target_paths, entry.path, (GCompareFunc)g_strcmp0)) {
+                g_ptr_array_add(duplicates, g_strdup(entry.path));
+            }
+        }
+        g_array_free(matches, TRUE);
+    }
     
-    g_free(abs_path);
-    g_free(stdout_buf);
-    g_free(stderr_buf);
+    g_free(name);
+    g_free(exec);
+    g_free(exec_path);
     
-    if (!success) {
-        *error_msg = g_strdup_printf("Failed to execute gio: %s", 
-                                    spawn_error ? spawn_error->message : "Unknown error");
-        if (spawn_error) g_error_free(spawn_error);
-        return FALSE;
+    if (duplicates->len == 0) {
+        g_ptr_array_free(duplicates, TRUE);
+        return NULL;
     }
+    g_ptr_array_add(duplicates, NULL);
+    return (gchar**)g_ptr_array_free(duplicates, FALSE);
+}
+
+// Runs func(data) on the thread that owns context (directly when that is
+// this thread, or nobody runs it) and waits for it to return
+typedef struct {
+    GSourceFunc func;
+    gpointer data;
+    GMutex lock;
+    GCond cond;
+    gboolean done;
+} ContextCall;
+
+static gboolean context_call_dispatch(gpointer user_data) {
+    ContextCall *call = user_data;
+    call->func(call->data);
+    g_mutex_lock(&call->lock);
+    call->done = TRUE;
+    g_cond_signal(&call->cond);
+    g_mutex_unlock(&call->lock);
+    return G_SOURCE_REMOVE;
+}
+
+static void file_utils_call_on_context(GMainContext *context, GSourceFunc func, gpointer data) {
+    ContextCall call = { func, data, { 0 }, { 0 }, FALSE };
+    g_mutex_init(&call.lock);
+    g_cond_init(&call.cond);
     
-    if (exit_status != 0) {
-        *error_msg = g_strdup("Failed to mark file as trusted using gio");
-        return FALSE;
+    g_main_context_invoke(context, context_call_dispatch, &call);
+    g_mutex_lock(&call.lock);
+    while (!call.done) {
+        g_cond_wait(&call.cond, &call.lock);
     }
+    g_mutex_unlock(&call.lock);
     
-    // Also try using GIO's file attribute method as a backup
-    GFile *file = g_file_new_for_path(abs_path);
-    GError *attr_error = NULL;
-    gboolean attr_success = g_file_set_attribute_string(file, "metadata::trusted", "true", 
-                                                      G_FILE_QUERY_INFO_NONE, NULL, &attr_error);
-    if (!attr_success) {
-        if (attr_error) g_error_free(attr_error);
+    g_mutex_clear(&call.lock);
+    g_cond_clear(&call.cond);
+}
+
+typedef struct {
+    const gchar *content;
+    GList *target_paths;
+    FileSaveOptions *options;
+    GList *existing_files;  // Filled in
+    AppIndex *owned_index;  // Filled in when the check loaded the index itself
+} SaveTargetCheck;
+
+// Existing files are looked up on disk, relative to the kept directory
+// descriptors: the overwrite policy must not trust a snapshot. Duplicates
+// come from the running watch, else from the cached index file.
+// The watch is fetched here, on its own thread, since it may have been
+// cleared while this call waited to be dispatched.
+static gboolean check_save_targets(gpointer user_data) {
+    SaveTargetCheck *check = user_data;
+    FileSaveOptions *options = check->options;
+    AppWatch *watch = app_watch_dup_default();
+    AppIndex *index = NULL;
+    if (watch) {
+        app_watch_process(watch);
+    } else if (options->check_duplicates) {
+        check->owned_index = index = app_index_open(NULL);
+    }
+    
+    for (GList *iter = check->target_paths; iter != NULL; iter = iter->next) {
+        gchar *target_path = (gchar*)iter->data;
+        if (file_utils_file_exists(target_path)) {
+            check->existing_files = g_list_append(check->existing_files, g_strdup(target_path));
+        }
     }
-    g_object_unref(file);
     
-    return TRUE;
+    // Warn about the same application installed under another name
+    g_clear_pointer(&options->duplicates, g_strfreev);
+    if (options->check_duplicates) {
+        options->duplicates = find_duplicate_entries(watch, index, check->content, check->target_paths);
+    }
+    app_watch_unref(watch);
+    return G_SOURCE_REMOVE;
 }
 
 gboolean file_utils_save_desktop_file(const gchar *content, const gchar *filename, 
-                                     FileSaveOptions *options, GtkWidget *parent_window, gchar **error_msg) {
+                                     FileSaveOptions *options, gchar **error_msg) {
     if (!content || !filename || !options) {
         *error_msg = g_strdup("Invalid parameters");
         return FALSE;
     }
     
-
+    
     
     gchar *sanitized_filename = file_utils_sanitize_filename(filename);
     gchar *actual_filename = g_strdup_printf("%s.desktop", sanitized_filename);
@@ -182,77 +427,158 @@ gboolean file_utils_save_desktop_file(const gchar *content, const gchar *filenam
         }
     }
     
-    // Check for existing files
-    for (GList *iter = target_paths; iter != NULL; iter = iter->next) {
-        gchar *target_path = (gchar*)iter->data;
-        if (file_utils_file_exists(target_path)) {
-            existing_files = g_list_append(existing_files, g_strdup(target_path));
-        }
+    // Check for existing files and installed duplicates
+    SaveTargetCheck check = { content, target_paths, options, NULL, NULL };
+    AppWatch *watch = app_watch_dup_default();
+    if (watch) {
+        // The watch belongs to the main loop; a save running on a worker
+        // thread makes its lookups there
+        app_watch_unref(watch);
+        file_utils_call_on_context(NULL, check_save_targets, &check);
+    } else {
+        check_save_targets(&check);
     }
+    existing_files = check.existing_files;
     
-    // If there are existing files, show confirmation dialog
+    // If there are existing files, apply the overwrite policy
+    gint skipped_count = 0;
     if (existing_files) {
-        if (!file_utils_confirm_overwrite(existing_files, parent_window)) {
-            g_list_free_full(existing_files, g_free);
-            g_list_free_full(target_paths, g_free);
-            g_free(actual_filename);
-            g_string_free(error_messages, TRUE);
-            return FALSE;
+        FileOverwritePolicy policy = options->overwrite_policy;
+        if (policy == FILE_OVERWRITE_ASK && !options->confirm_overwrite) {
+            // Nobody to ask, so never overwrite silently
+            policy = FILE_OVERWRITE_FAIL;
+        }
+        
+        switch (policy) {
+            case FILE_OVERWRITE_ASK:
+                if (!options->confirm_overwrite(existing_files, options->confirm_data)) {
+                    app_index_free(check.owned_index);
+                    g_list_free_full(existing_files, g_free);
+                    g_list_free_full(target_paths, g_free);
+                    g_free(actual_filename);
+                    g_string_free(error_messages, TRUE);
+                    return FALSE;
+                }
+                break;
+            case FILE_OVERWRITE_FORCE:
+                break;
+            case FILE_OVERWRITE_SKIP:
+                // Drop existing files from the targets, keep saving the rest
+                for (GList *iter = existing_files; iter != NULL; iter = iter->next) {
+                    GList *link = g_list_find_custom(target_paths, iter->data, (GCompareFunc)g_strcmp0);
+                    if (link) {
+                        g_free(link->data);
+                        target_paths = g_list_delete_link(target_paths, link);
+                        skipped_count++;
+                    }
+                }
+                break;
+            case FILE_OVERWRITE_FAIL:
+                for (GList *iter = existing_files; iter != NULL; iter = iter->next) {
+                    g_string_append_printf(error_messages, "File already exists: %s\n", (gchar*)iter->data);
+                }
+                *error_msg = g_string_free(error_messages, FALSE);
+                app_index_free(check.owned_index);
+                g_list_free_full(existing_files, g_free);
+                g_list_free_full(target_paths, g_free);
+                g_free(actual_filename);
+                return FALSE;
         }
         g_list_free_full(existing_files, g_free);
     }
     
-    // Save to all target paths
+    // The index can only be stamped again for directories nobody else
+    // changed since it was loaded
+    GPtrArray *dir_stamps = g_ptr_array_new_with_free_func((GDestroyNotify)app_index_dir_stamp_free);
+    for (GList *iter = check.owned_index ? target_paths : NULL; iter != NULL; iter = iter->next) {
+        AppIndexDirStamp *stamp = g_new0(AppIndexDirStamp, 1);
+        stamp->path = g_path_get_dirname(iter->data);
+        app_index_dir_stamp_update(stamp);
+        g_ptr_array_add(dir_stamps, stamp);
+    }
+    
+    // Save to all target paths. Each file is created with its final mode
+    // and swapped in atomically; directories are synced once at the end.
+    FileWriter *writer = file_writer_new(options->durability);
+    GPtrArray *saved_paths = g_ptr_array_new();
     for (GList *iter = target_paths; iter != NULL; iter = iter->next) {
         gchar *target_path = (gchar*)iter->data;
         
         // Ensure directory exists
         gchar *dir_path = g_path_get_dirname(target_path);
-        if (!file_utils_ensure_directory_exists(dir_path, error_msg)) {
-            g_string_append_printf(error_messages, "Failed to create directory: %s\n", dir_path);
+        gchar *dir_error = NULL;
+        if (!file_utils_prepare_directory(writer, dir_path, &dir_error)) {
+            g_string_append_printf(error_messages, "%s\n", dir_error);
+            g_free(dir_error);
             g_free(dir_path);
             success = FALSE;
             continue;
         }
         g_free(dir_path);
         
-        // If file exists and user confirmed overwrite, just delete it
+        // Write file content, replacing a file the user chose to overwrite
         // (no backup since user explicitly chose to overwrite)
-        if (file_utils_file_exists(target_path)) {
-            g_unlink(target_path);
-        }
-        
-        // Write file content
-        GError *write_error = NULL;
-        if (!g_file_set_contents(target_path, content, -1, &write_error)) {
-            g_string_append_printf(error_messages, "Failed to write file %s: %s\n", 
-                                 target_path, write_error ? write_error->message : "Unknown error");
-            if (write_error) g_error_free(write_error);
+        gchar *write_error = NULL;
+        if (!file_writer_write(writer, target_path, content, -1, FILE_UTILS_DESKTOP_MODE, &write_error)) {
+            g_string_append_printf(error_messages, "%s\n", write_error);
+            g_free(write_error);
             success = FALSE;
             continue;
         }
         
-        // Set executable permissions
-        gchar *perm_error = NULL;
-        if (!file_utils_set_executable_permissions(target_path, &perm_error)) {
-            g_string_append_printf(error_messages, "Failed to set permissions for %s: %s\n", 
-                                 target_path, perm_error ? perm_error : "Unknown error");
-            if (perm_error) g_free(perm_error);
-            success = FALSE;
-            continue;
-        }
-        
-        // Mark as trusted
+        g_ptr_array_add(saved_paths, target_path);
+        saved_count++;
+    }
+    
+    gchar *commit_error = NULL;
+    if (!file_writer_commit(writer, &commit_error)) {
+        g_string_append_printf(error_messages, "%s\n", commit_error);
+        g_free(commit_error);
+        success = FALSE;
+    }
+    file_writer_get_stats(writer, &options->write_stats);
+    file_writer_free(writer);
+    
+    // Mark everything that was written as trusted in one batch
+    if (saved_paths->len > 0) {
         gchar *trust_error = NULL;
-        if (!file_utils_mark_as_trusted(target_path, &trust_error)) {
-            g_string_append_printf(error_messages, "Warning: Could not mark %s as trusted: %s\n", 
-                                 target_path, trust_error ? trust_error : "Unknown error");
+        if (!mark_as_trusted((const gchar * const *)saved_paths->pdata, saved_paths->len, FALSE,
+                             &options->trust_stats, &trust_error)) {
+            g_string_append_printf(error_messages, "Warning: Could not mark files as trusted:\n%s\n", 
+                                 trust_error ? trust_error : "Unknown error");
             if (trust_error) g_free(trust_error);
             // This is a warning, not a fatal error
         }
         
-        saved_count++;
+        // Register the MimeType handlers; queued when inside a batch
+        gchar *mime_error = NULL;
+        if (!mime_cache_update_paths((const gchar * const *)saved_paths->pdata, saved_paths->len,
+                                     &mime_error)) {
+            g_string_append_printf(error_messages, "Warning: Could not update mimeinfo.cache:\n%s\n",
+                                 mime_error ? mime_error : "Unknown error");
+            g_free(mime_error);
+        }
+        
+        // Without a watch to do it, bring the index loaded for the check up
+        // to date, so the next save maps it instead of rescanning
+        if (check.owned_index) {
+            gchar *index_path = app_index_get_default_path();
+            gchar *index_error = NULL;
+            AppIndex *updated = app_index_update(check.owned_index, index_path,
+                                                 (const gchar * const *)saved_paths->pdata, saved_paths->len,
+                                                 dir_stamps, &index_error);
+            if (!updated) {
+                g_string_append_printf(error_messages, "Warning: Could not update the application index:\n%s\n",
+                                     index_error ? index_error : "Unknown error");
+                g_free(index_error);
+            }
+            app_index_free(updated);
+            g_free(index_path);
+        }
     }
+    app_index_free(check.owned_index);
+    g_ptr_array_free(dir_stamps, TRUE);
+    g_ptr_array_free(saved_paths, TRUE);
     
     // Clean up
     g_list_free_full(target_paths, g_free);
@@ -265,11 +591,28 @@ gboolean file_utils_save_desktop_file(const gchar *content, const gchar *filenam
         g_string_free(error_messages, TRUE);
     }
     
-    return success && saved_count > 0;
+    // Skipped files count as handled so a skip-only run is not a failure
+    return success && (saved_count > 0 || skipped_count > 0);
 }
 
 gboolean file_utils_file_exists(const gchar *filepath) {
-    return g_file_test(filepath, G_FILE_TEST_EXISTS);
+    UserDir dir;
+    gchar *name = NULL;
+    if (!in_user_dir(filepath, &dir, &name)) {
+        return g_file_test(filepath, G_FILE_TEST_EXISTS);
+    }
+    
+    // Looked up in the kept descriptor; a missing directory holds nothing
+    gchar *open_error = NULL;
+    int dir_fd = user_dirs_open(dir, FALSE, &open_error);
+    struct stat st;
+    gboolean exists = dir_fd >= 0 && fstatat(dir_fd, name, &st, 0) == 0;
+    if (dir_fd >= 0) {
+        close(dir_fd);
+    }
+    g_free(open_error);
+    g_free(name);
+    return exists;
 }
 
 gboolean file_utils_validate_custom_path(const gchar *path, gchar **error_msg) {
@@ -294,17 +637,19 @@ gboolean file_utils_validate_custom_path(const gchar *path, gchar **error_msg) {
 }
 
 gboolean file_utils_validate_executable(const gchar *filepath, gchar **error_msg) {
-    if (!file_utils_file_exists(filepath)) {
+    // One stat() answers existence and type, access() the execute permission
+    struct stat st;
+    if (stat(filepath, &st) != 0) {
         *error_msg = g_strdup_printf("Executable file does not exist: %s", filepath);
         return FALSE;
     }
     
-    if (!g_file_test(filepath, G_FILE_TEST_IS_REGULAR)) {
+    if (!S_ISREG(st.st_mode)) {
         *error_msg = g_strdup_printf("Path is not a regular file: %s", filepath);
         return FALSE;
     }
     
-    if (!g_file_test(filepath, G_FILE_TEST_IS_EXECUTABLE)) {
+    if (access(filepath, X_OK) != 0) {
         *error_msg = g_strdup_printf("File is not executable: %s", filepath);
         return FALSE;
     }
@@ -312,143 +657,284 @@ gboolean file_utils_validate_executable(const gchar *filepath, gchar **error_msg
     return TRUE;
 }
 
-gboolean file_utils_confirm_overwrite(GList *existing_files, GtkWidget *parent_window) {
-    if (!existing_files) {
-        return TRUE; // No existing files to worry about
+FileType file_utils_detect_file_type(const gchar *filepath) {
+    FileClassification classification;
+    type_cache_classify(filepath, &classification);
+    return classification.type;
+}
+
+// Asynchronous probes. The task runs with the probe's own cancellable, which
+// the caller's cancellable and the timeout both cancel; with return-on-cancel
+// the callback then runs at once even if the worker is stuck in the kernel.
+typedef struct {
+    gchar *path;
+    gboolean returned;          // Set by a worker that got to return; then:
+    gboolean valid;
+    gchar *error_msg;
+    FileType file_type;
+    GCancellable *cancellable;
+    GCancellable *caller_cancellable;
+    gulong caller_handler;
+    GSource *timeout_source;
+    gboolean timed_out;
+    guint timeout_ms;
+    GAsyncReadyCallback callback;
+    gpointer user_data;
+} FileProbe;
+
+static void file_probe_free(gpointer data) {
+    FileProbe *probe = data;
+    g_free(probe->path);
+    g_free(probe->error_msg);
+    g_object_unref(probe->cancellable);
+    g_clear_object(&probe->caller_cancellable);
+    g_free(probe);
+}
+
+static void file_probe_on_caller_cancelled(GCancellable *cancellable, gpointer user_data) {
+    (void)cancellable;  // Suppress unused parameter warning
+    FileProbe *probe = user_data;
+    g_cancellable_cancel(probe->cancellable);
+}
+
+static gboolean file_probe_on_timeout(gpointer user_data) {
+    FileProbe *probe = user_data;
+    probe->timed_out = TRUE;
+    g_cancellable_cancel(probe->cancellable);
+    return G_SOURCE_REMOVE;
+}
+
+// Runs on the caller's context once the task has returned, before the
+// caller's callback, so nothing else touches the probe after that
+static void file_probe_ready(GObject *source_object, GAsyncResult *result, gpointer user_data) {
+    FileProbe *probe = user_data;
+    if (probe->timeout_source) {
+        g_source_destroy(probe->timeout_source);
+        g_clear_pointer(&probe->timeout_source, g_source_unref);
     }
-    
-    // Count existing files
-    gint count = g_list_length(existing_files);
-    if (count == 0) {
-        return TRUE;
+    if (probe->caller_handler) {
+        g_cancellable_disconnect(probe->caller_cancellable, probe->caller_handler);
+        probe->caller_handler = 0;
     }
-    
-    // Create confirmation dialog
-    GtkWidget *dialog = gtk_message_dialog_new(GTK_WINDOW(parent_window),
-                                              GTK_DIALOG_MODAL,
-                                              GTK_MESSAGE_QUESTION,
-                                              GTK_BUTTONS_YES_NO,
-                                              "Overwrite Existing Files?");
-    
-    // Build message text
-    GString *message = g_string_new("The following files already exist:\n\n");
-    
-    for (GList *iter = existing_files; iter != NULL; iter = iter->next) {
-        gchar *filepath = (gchar*)iter->data;
-        g_string_append_printf(message, "• %s\n", filepath);
+    if (probe->callback) {
+        probe->callback(source_object, result, probe->user_data);
     }
-    
-    g_string_append(message, "\nDo you want to overwrite these files?");
-    
-    gtk_message_dialog_format_secondary_text(GTK_MESSAGE_DIALOG(dialog), "%s", message->str);
-    g_string_free(message, TRUE);
-    
-    // Show dialog and get response
-    gint response = gtk_dialog_run(GTK_DIALOG(dialog));
-    gtk_widget_destroy(dialog);
-    
-    return (response == GTK_RESPONSE_YES);
 }
 
-FileType file_utils_detect_file_type(const gchar *filepath) {
-    if (!filepath || !file_utils_file_exists(filepath)) {
-        return FILE_TYPE_UNKNOWN;
+static void file_probe_start(const gchar *path, guint timeout_ms, GCancellable *cancellable,
+                             GTaskThreadFunc thread_func,
+                             GAsyncReadyCallback callback, gpointer user_data) {
+    FileProbe *probe = g_new0(FileProbe, 1);
+    probe->path = g_strdup(path);
+    probe->cancellable = g_cancellable_new();
+    probe->timeout_ms = timeout_ms;
+    probe->callback = callback;
+    probe->user_data = user_data;
+    
+    GTask *task = g_task_new(NULL, probe->cancellable, file_probe_ready, probe);
+    g_task_set_task_data(task, probe, file_probe_free);
+    g_task_set_return_on_cancel(task, TRUE);
+    
+    if (cancellable) {
+        probe->caller_cancellable = g_object_ref(cancellable);
+        probe->caller_handler = g_cancellable_connect(cancellable, G_CALLBACK(file_probe_on_caller_cancelled),
+                                                      probe, NULL);
+    }
+    if (timeout_ms > 0) {
+        probe->timeout_source = g_timeout_source_new(timeout_ms);
+        g_source_set_callback(probe->timeout_source, file_probe_on_timeout, probe, NULL);
+        g_source_attach(probe->timeout_source, g_main_context_get_thread_default());
+    }
+    
+    g_task_run_in_thread(task, thread_func);
+    g_object_unref(task);
+}
+
+// Worker side: keeps the result unless the task already returned
+// (cancelled or timed out), in which case nobody is listening
+static void file_probe_return(GTask *task, FileProbe *probe, gboolean valid, gchar *error_msg,
+                              FileType file_type) {
+    if (!g_task_set_return_on_cancel(task, FALSE)) {
+        g_free(error_msg);
+        return;
+    }
+    probe->returned = TRUE;
+    probe->valid = valid;
+    probe->error_msg = error_msg;
+    probe->file_type = file_type;
+    g_task_return_boolean(task, TRUE);
+}
+
+// A result kept by the worker wins over a cancellation that came too late
+static gboolean file_probe_propagate(GAsyncResult *result, GError **error) {
+    GTask *task = G_TASK(result);
+    FileProbe *probe = g_task_get_task_data(task);
+    GError *local_error = NULL;
+    
+    g_task_propagate_boolean(task, &local_error);
+    if (probe->returned) {
+        g_clear_error(&local_error);
+        if (!probe->valid) {
+            g_set_error(error, G_IO_ERROR, G_IO_ERROR_FAILED, "%s", probe->error_msg);
+        }
+        return probe->valid;
     }
-    
-    // First check file extension for quick identification
-    gchar *lower_path = g_ascii_strdown(filepath, -1);
-    gboolean is_python = g_str_has_suffix(lower_path, ".py");
-    gboolean is_shell = g_str_has_suffix(lower_path, ".sh");
-    g_free(lower_path);
-    
-    if (is_python) {
-        return FILE_TYPE_PYTHON;
+    if (probe->timed_out) {
+        g_clear_error(&local_error);
+        local_error = g_error_new(G_IO_ERROR, G_IO_ERROR_TIMED_OUT, "No answer from %s after %u ms",
+                                  probe->path, probe->timeout_ms);
     }
-    if (is_shell) {
-        return FILE_TYPE_SHELL;
+    g_propagate_error(error, local_error);
+    return FALSE;
+}
+
+static void probe_executable_thread(GTask *task, gpointer source_object, gpointer task_data,
+                                    GCancellable *cancellable) {
+    (void)source_object;  // Suppress unused parameter warning
+    (void)cancellable;    // Checked through the task
+    FileProbe *probe = task_data;
+    gchar *error_msg = NULL;
+    
+    gboolean valid = file_utils_validate_executable(probe->path, &error_msg);
+    FileType file_type = file_utils_detect_file_type(probe->path);
+    file_probe_return(task, probe, valid, error_msg, file_type);
+}
+
+void file_utils_probe_executable_async(const gchar *filepath, guint timeout_ms, GCancellable *cancellable,
+                                       GAsyncReadyCallback callback, gpointer user_data) {
+    file_probe_start(filepath, timeout_ms, cancellable, probe_executable_thread, callback, user_data);
+}
+
+gboolean file_utils_probe_executable_finish(GAsyncResult *result, FileType *file_type, GError **error) {
+    FileProbe *probe = g_task_get_task_data(G_TASK(result));
+    gboolean valid = file_probe_propagate(result, error);
+    if (file_type) {
+        // FILE_TYPE_UNKNOWN unless the worker got to return
+        *file_type = probe->returned ? probe->file_type : FILE_TYPE_UNKNOWN;
+    }
+    return valid;
+}
+
+typedef struct {
+    gchar *content;
+    gchar *filename;
+    FileSaveOptions options;    // Copy of the caller's; outputs go back in finish
+    GMainContext *context;      // Where confirm_overwrite runs
+    GCancellable *cancellable;  // May be NULL
+} SaveTask;
+
+// Saves whose worker may still call into their main context
+static gint saves_running = 0;
+
+static void save_task_free(gpointer data) {
+    SaveTask *save = data;
+    g_free(save->content);
+    g_free(save->filename);
+    g_free(save->options.custom_path);
+    g_strfreev(save->options.duplicates);
+    g_main_context_unref(save->context);
+    g_clear_object(&save->cancellable);
+    g_free(save);
+}
+
+typedef struct {
+    SaveTask *save;
+    GList *existing_files;
+    gboolean answer;
+} SaveConfirm;
+
+static gboolean save_confirm_dispatch(gpointer user_data) {
+    SaveConfirm *confirm = user_data;
+    FileSaveOptions *options = &confirm->save->options;
+    // Whoever would have answered may be gone
+    confirm->answer = !g_cancellable_is_cancelled(confirm->save->cancellable) &&
+                      options->confirm_overwrite(confirm->existing_files, options->confirm_data);
+    return G_SOURCE_REMOVE;
+}
+
+// Asks the caller's confirm_overwrite on its own thread, since it usually
+// shows a dialog
+static gboolean save_confirm_from_worker(GList *existing_files, gpointer user_data) {
+    SaveConfirm confirm = { user_data, existing_files, FALSE };
+    file_utils_call_on_context(confirm.save->context, save_confirm_dispatch, &confirm);
+    return confirm.answer;
+}
+
+// The worker makes no more calls into the save's context
+static void save_thread_done(SaveTask *save) {
+    if (g_atomic_int_dec_and_test(&saves_running)) {
+        g_main_context_wakeup(save->context);
     }
+}
+
+static void save_thread(GTask *task, gpointer source_object, gpointer task_data,
+                        GCancellable *cancellable) {
+    (void)source_object;  // Suppress unused parameter warning
+    (void)cancellable;    // Checked through the task
+    SaveTask *save = task_data;
     
-    // For non-extension files, check the file header (magic bytes)
-    FILE *file = fopen(filepath, "rb");
-    if (!file) {
-        return FILE_TYPE_UNKNOWN;
+    // Once files are being written the save runs to the end
+    if (g_task_return_error_if_cancelled(task)) {
+        save_thread_done(save);
+        return;
     }
     
-    unsigned char header[8];
-    size_t bytes_read = fread(header, 1, 8, file);
-    fclose(file);
-    
-    if (bytes_read < 4) {
-        return FILE_TYPE_UNKNOWN;
+    FileSaveOptions options = save->options;
+    if (options.confirm_overwrite) {
+        options.confirm_overwrite = save_confirm_from_worker;
+        options.confirm_data = save;
     }
+    gchar *error_msg = NULL;
+    gboolean success = file_utils_save_desktop_file(save->content, save->filename, &options, &error_msg);
+    save->options.write_stats = options.write_stats;
+    save->options.trust_stats = options.trust_stats;
+    save->options.duplicates = options.duplicates;
     
-    // Check for ELF magic number (0x7f 0x45 0x4c 0x46)
-    if (header[0] == 0x7f && header[1] == 0x45 && header[2] == 0x4c && header[3] == 0x46) {
-        return FILE_TYPE_ELF;
-    }
+    save_thread_done(save);
     
-    // Check for Python shebang (#!/usr/bin/python or #!/usr/bin/env python)
-    if (header[0] == '#' && header[1] == '!') {
-        // Read more to check for python in shebang
-        file = fopen(filepath, "r");
-        if (file) {
-            char line[256];
-            if (fgets(line, sizeof(line), file)) {
-                gchar *lower_line = g_ascii_strdown(line, -1);
-                gboolean has_python = g_strstr_len(lower_line, -1, "python") != NULL;
-                g_free(lower_line);
-                fclose(file);
-                if (has_python) {
-                    return FILE_TYPE_PYTHON;
-                }
-            }
-            fclose(file);
-        }
+    if (success) {
+        g_task_return_boolean(task, TRUE);
+    } else {
+        g_task_return_new_error(task, G_IO_ERROR, G_IO_ERROR_FAILED, "%s",
+                                error_msg ? error_msg : "Save cancelled");
+        g_free(error_msg);
     }
-    
-    // Check for shell shebang (#!/bin/bash, #!/bin/sh, etc.)
-    if (header[0] == '#' && header[1] == '!') {
-        file = fopen(filepath, "r");
-        if (file) {
-            char line[256];
-            if (fgets(line, sizeof(line), file)) {
-                gchar *lower_line = g_ascii_strdown(line, -1);
-                gboolean has_shell = (g_strstr_len(lower_line, -1, "/bin/bash") != NULL ||
-                                    g_strstr_len(lower_line, -1, "/bin/sh") != NULL ||
-                                    g_strstr_len(lower_line, -1, "/bin/zsh") != NULL ||
-                                    g_strstr_len(lower_line, -1, "/bin/dash") != NULL);
-                g_free(lower_line);
-                fclose(file);
-                if (has_shell) {
-                    return FILE_TYPE_SHELL;
-                }
-            }
-            fclose(file);
-        }
+}
+
+void file_utils_save_desktop_file_async(const gchar *content, const gchar *filename,
+                                        const FileSaveOptions *options, GCancellable *cancellable,
+                                        GAsyncReadyCallback callback, gpointer user_data) {
+    SaveTask *save = g_new0(SaveTask, 1);
+    save->content = g_strdup(content);
+    save->filename = g_strdup(filename);
+    save->options = *options;
+    save->options.custom_path = g_strdup(options->custom_path);
+    save->options.duplicates = NULL;
+    save->context = g_main_context_ref_thread_default();
+    save->cancellable = cancellable ? g_object_ref(cancellable) : NULL;
+    
+    GTask *task = g_task_new(NULL, cancellable, callback, user_data);
+    g_task_set_task_data(task, save, save_task_free);
+    g_atomic_int_inc(&saves_running);
+    g_task_run_in_thread(task, save_thread);
+    g_object_unref(task);
+}
+
+void file_utils_wait_for_saves(void) {
+    while (g_atomic_int_get(&saves_running) > 0) {
+        g_main_context_iteration(NULL, TRUE);
     }
-    
-    // Check if file is executable (might be a script without extension)
-    if (g_file_test(filepath, G_FILE_TEST_IS_EXECUTABLE)) {
-        // Check first line for shebang
-        file = fopen(filepath, "r");
-        if (file) {
-            char line[256];
-            if (fgets(line, sizeof(line), file)) {
-                gchar *lower_line = g_ascii_strdown(line, -1);
-                if (g_strstr_len(lower_line, -1, "python") != NULL) {
-                    g_free(lower_line);
-                    fclose(file);
-                    return FILE_TYPE_PYTHON;
-                } else if (g_strstr_len(lower_line, -1, "/bin/") != NULL) {
-                    g_free(lower_line);
-                    fclose(file);
-                    return FILE_TYPE_SHELL;
-                }
-                g_free(lower_line);
-            }
-            fclose(file);
-        }
+}
+
+gboolean file_utils_save_desktop_file_finish(GAsyncResult *result, FileSaveOptions *options,
+                                             GError **error) {
+    GTask *task = G_TASK(result);
+    if (options) {
+        SaveTask *save = g_task_get_task_data(task);
+        options->write_stats = save->options.write_stats;
+        options->trust_stats = save->options.trust_stats;
+        g_strfreev(options->duplicates);
+        options->duplicates = g_steal_pointer(&save->options.duplicates);
     }
-    
-    return FILE_TYPE_OTHER;
-} 
\ No newline at end of file
+    return g_task_propagate_boolean(task, error);
+}
@@ -2,8 +2,34 @@
 #define FILE_UTILS_H
 
 #include <glib.h>
-#include <gtk/gtk.h>
+#include <gio/gio.h>
 #include "desktop_entry.h"
+#include "file_classify.h"
+#include "file_writer.h"
+#include "user_dirs.h"
+
+// Permissions of saved entries: executable, which launchers require of a
+// trusted desktop file, and readable by everyone
+#define FILE_UTILS_DESKTOP_MODE 0744
+
+// What to do when a target file already exists
+typedef enum {
+    FILE_OVERWRITE_ASK,     // Ask the user with a confirmation dialog
+    FILE_OVERWRITE_FORCE,   // Overwrite without asking
+    FILE_OVERWRITE_SKIP,    // Leave existing files alone, save the rest
+    FILE_OVERWRITE_FAIL     // Abort the save with an error
+} FileOverwritePolicy;
+
+// Asks whether the listed existing files may be overwritten (FILE_OVERWRITE_ASK).
+// Frontends supply this; the core library never shows UI itself.
+typedef gboolean (*FileOverwriteConfirmFunc)(GList *existing_files, gpointer user_data);
+
+// Result of marking a batch of files as trusted
+typedef struct {
+    guint files;        // Files in the batch
+    guint marked;       // Files successfully marked
+    gint64 elapsed_us;  // Wall time for the whole batch
+} FileTrustStats;
 
 // File save options
 typedef struct {
@@ -11,33 +37,77 @@ typedef struct {
     gboolean save_to_local_apps;
     gboolean save_to_custom;
     gchar *custom_path;
+    FileOverwritePolicy overwrite_policy;
+    FileOverwriteConfirmFunc confirm_overwrite;
+    gpointer confirm_data;
+    gboolean check_duplicates;   // Look for installed entries with the same Name or Exec
+    FileDurability durability;   // How hard to make sure the files reach the disk (default: full)
+    FileWriterStats write_stats; // Filled in by file_utils_save_desktop_file
+    FileTrustStats trust_stats;  // Filled in by file_utils_save_desktop_file
+    gchar **duplicates;          // Filled in: paths of those entries (NULL if none)
 } FileSaveOptions;
 
 // Function prototypes
 gboolean file_utils_save_desktop_file(const gchar *content, const gchar *filename, 
-                                     FileSaveOptions *options, GtkWidget *parent_window, gchar **error_msg);
+                                     FileSaveOptions *options, gchar **error_msg);
 gboolean file_utils_set_executable_permissions(const gchar *filepath, gchar **error_msg);
 gboolean file_utils_mark_as_trusted(const gchar *filepath, gchar **error_msg);
+gboolean file_utils_mark_as_trusted_batch(const gchar * const *filepaths, guint n_files,
+                                          FileTrustStats *stats, gchar **error_msg);
+void file_utils_mark_as_trusted_batch_async(const gchar * const *filepaths, guint n_files,
+                                            GCancellable *cancellable,
+                                            GAsyncReadyCallback callback, gpointer user_data);
+gboolean file_utils_mark_as_trusted_batch_finish(GAsyncResult *result, FileTrustStats *stats,
+                                                 GError **error);
+
+// The user's desktop (from user-dirs.dirs) and applications directory
+// (in $XDG_DATA_HOME); see user_dirs.h
 gchar* file_utils_get_desktop_directory(void);
 gchar* file_utils_get_local_applications_directory(void);
+
 gboolean file_utils_ensure_directory_exists(const gchar *dirpath, gchar **error_msg);
+
+// Makes sure dir_path exists before writer writes there. The user's own
+// directories are created and handed over through their kept descriptors.
+gboolean file_utils_prepare_directory(FileWriter *writer, const gchar *dir_path, gchar **error_msg);
 gchar* file_utils_sanitize_filename(const gchar *name);
 gboolean file_utils_file_exists(const gchar *filepath);
 gboolean file_utils_validate_executable(const gchar *filepath, gchar **error_msg);
-gboolean file_utils_confirm_overwrite(GList *existing_files, GtkWidget *parent_window);
 gboolean file_utils_validate_custom_path(const gchar *path, gchar **error_msg);
 
-// File type detection
-typedef enum {
-    FILE_TYPE_UNKNOWN,
-    FILE_TYPE_ELF,
-    FILE_TYPE_PYTHON,
-    FILE_TYPE_SHELL,
-    FILE_TYPE_OTHER
-} FileType;
-
+// File type detection (see file_classify.h for the detailed classifier)
 FileType file_utils_detect_file_type(const gchar *filepath);
 
+// Asynchronous variants for callers on a main loop. The work runs on a
+// GTask worker thread and the callback on the calling thread's context.
+
+// Default for timeout_ms below; 0 waits forever
+#define FILE_UTILS_PROBE_TIMEOUT_MS 5000
+
+// Validates filepath like file_utils_validate_executable() and detects its
+// type. Fails with G_IO_ERROR_TIMED_OUT after timeout_ms and with
+// G_IO_ERROR_CANCELLED on cancellation, both without waiting for a worker
+// stuck on a dead mount. file_type is set even if validation fails.
+void file_utils_probe_executable_async(const gchar *filepath, guint timeout_ms, GCancellable *cancellable,
+                                       GAsyncReadyCallback callback, gpointer user_data);
+gboolean file_utils_probe_executable_finish(GAsyncResult *result, FileType *file_type, GError **error);
+
+// Runs file_utils_save_desktop_file() on a copy of options. finish copies
+// the outputs (duplicates, write_stats, trust_stats) into options if not NULL.
+// confirm_overwrite is called on the calling thread's context, and not at
+// all once cancelled (the answer is then no). Cancelling only takes effect
+// before the first file is written.
+void file_utils_save_desktop_file_async(const gchar *content, const gchar *filename,
+                                        const FileSaveOptions *options, GCancellable *cancellable,
+                                        GAsyncReadyCallback callback, gpointer user_data);
+gboolean file_utils_save_desktop_file_finish(GAsyncResult *result, FileSaveOptions *options,
+                                             GError **error);
+
+// Iterates the default main context until every save started with
+// file_utils_save_desktop_file_async() from it has left its worker thread.
+// For after the main loop has quit: the workers make calls into it.
+void file_utils_wait_for_saves(void);
+
 // File save options management
 FileSaveOptions* file_save_options_new(void);
 void file_save_options_free(FileSaveOptions *options);
@@ -0,0 +1,286 @@
+#define _GNU_SOURCE
+#include "file_writer.h"
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define TEMP_NAME_ATTEMPTS 16
+
+typedef struct {
+    int fd;
+    gboolean dirty;          // Has entries that commit still has to sync
+    gboolean no_tmpfile;     // The file system rejected O_TMPFILE
+} WriterDir;
+
+struct _FileWriter {
+    FileDurability durability;
+    GHashTable *dirs;        // Directory path -> WriterDir
+    mode_t umask;            // Bits the kernel strips from creation modes
+    uid_t uid;               // Owner of new files, -1 = the process'
+    gid_t gid;
+    FileWriterStats stats;
+};
+
+static void writer_dir_free(gpointer data) {
+    WriterDir *dir = data;
+    close(dir->fd);
+    g_free(dir);
+}
+
+// The process umask, read without the set-and-restore race of umask(2).
+// Without /proc every bit is assumed masked, so modes are always set.
+static mode_t read_umask(void) {
+    gchar *status = NULL;
+    mode_t mask = 0777;
+    if (g_file_get_contents("/proc/self/status", &status, NULL, NULL)) {
+        const gchar *line = strstr(status, "\nUmask:");
+        if (line) {
+            mask = strtoul(line + 7, NULL, 8) & 0777;
+        }
+        g_free(status);
+    }
+    return mask;
+}
+
+FileWriter* file_writer_new(FileDurability durability) {
+    FileWriter *writer = g_new0(FileWriter, 1);
+    writer->durability = durability;
+    writer->dirs = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, writer_dir_free);
+    writer->umask = read_umask();
+    writer->uid = (uid_t)-1;
+    writer->gid = (gid_t)-1;
+    return writer;
+}
+
+void file_writer_free(FileWriter *writer) {
+    if (writer) {
+        g_hash_table_destroy(writer->dirs);
+        g_free(writer);
+    }
+}
+
+static WriterDir* writer_get_dir(FileWriter *writer, const gchar *dir_path, gchar **error_msg) {
+    WriterDir *dir = g_hash_table_lookup(writer->dirs, dir_path);
+    if (dir) {
+        return dir;
+    }
+    
+    int fd = open(dir_path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        *error_msg = g_strdup_printf("Failed to open directory %s: %s", dir_path, g_strerror(errno));
+        return NULL;
+    }
+    dir = g_new0(WriterDir, 1);
+    dir->fd = fd;
+    g_hash_table_insert(writer->dirs, g_strdup(dir_path), dir);
+    return dir;
+}
+
+void file_writer_adopt_dir(FileWriter *writer, const gchar *dir_path, int dir_fd) {
+    // Keep the one already open, which may have entries to sync
+    if (g_hash_table_contains(writer->dirs, dir_path)) {
+        close(dir_fd);
+        return;
+    }
+    WriterDir *dir = g_new0(WriterDir, 1);
+    dir->fd = dir_fd;
+    g_hash_table_insert(writer->dirs, g_strdup(dir_path), dir);
+}
+
+void file_writer_set_owner(FileWriter *writer, uid_t uid, gid_t gid) {
+    writer->uid = uid;
+    writer->gid = gid;
+}
+
+static gboolean write_all(int fd, const gchar *data, gsize length) {
+    while (length > 0) {
+        gssize n = write(fd, data, length);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return FALSE;
+        }
+        data += n;
+        length -= n;
+    }
+    return TRUE;
+}
+
+static gchar* make_temp_name(const gchar *name) {
+    return g_strdup_printf(".%s.%08x~", name, g_random_int());
+}
+
+gboolean file_writer_write(FileWriter *writer, const gchar *path, const gchar *content, gssize length,
+                           mode_t mode, gchar **error_msg) {
+    gint64 start_us = g_get_monotonic_time();
+    gsize content_length = length < 0 ? strlen(content) : (gsize)length;
+    gchar *dir_path = g_path_get_dirname(path);
+    gchar *name = g_path_get_basename(path);
+    gchar *temp_name = NULL;   // Set while the new file has a name of its own
+    gboolean success = FALSE;
+    int fd = -1;
+    
+    WriterDir *dir = writer_get_dir(writer, dir_path, error_msg);
+    if (!dir) {
+        goto out;
+    }
+
+#ifdef O_TMPFILE
+    if (!dir->no_tmpfile) {
+        fd = openat(dir->fd, ".", O_TMPFILE | O_WRONLY | O_CLOEXEC, mode);
+        if (fd < 0 && errno != EOPNOTSUPP && errno != EISDIR && errno != EINVAL) {
+            goto fail;
+        }
+        dir->no_tmpfile = fd < 0;
+    }
+#endif
+    for (int attempt = 0; fd < 0 && attempt < TEMP_NAME_ATTEMPTS; attempt++) {
+        g_free(temp_name);
+        temp_name = make_temp_name(name);
+        fd = openat(dir->fd, temp_name, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, mode);
+        if (fd < 0 && errno != EEXIST) {
+            int saved_errno = errno;
+            g_clear_pointer(&temp_name, g_free);
+            errno = saved_errno;
+            goto fail;
+        }
+    }
+    if (fd < 0) {
+        // Every temporary name was taken
+        g_clear_pointer(&temp_name, g_free);
+        errno = EEXIST;
+        goto fail;
+    }
+    
+    // The creation mode went through the umask; only fix it up if that
+    // actually took something away
+    if ((mode & writer->umask) != 0 && fchmod(fd, mode) != 0) {
+        goto fail;
+    }
+    if ((writer->uid != (uid_t)-1 || writer->gid != (gid_t)-1) && fchown(fd, writer->uid, writer->gid) != 0) {
+        goto fail;
+    }
+    if (!write_all(fd, content, content_length)) {
+        goto fail;
+    }
+    if (writer->durability >= FILE_DURABILITY_DATA) {
+        if (fdatasync(fd) != 0) {
+            goto fail;
+        }
+        writer->stats.file_syncs++;
+    }
+    
+    if (!temp_name) {
+        // Name the O_TMPFILE inode: a new target gets it directly, an
+        // existing one is replaced through a temporary name
+        gchar proc_path[32];
+        g_snprintf(proc_path, sizeof(proc_path), "/proc/self/fd/%d", fd);
+        if (linkat(AT_FDCWD, proc_path, dir->fd, name, AT_SYMLINK_FOLLOW) == 0) {
+            success = TRUE;
+            goto done;
+        }
+        if (errno != EEXIST) {
+            goto fail;
+        }
+        for (int attempt = 0; !temp_name && attempt < TEMP_NAME_ATTEMPTS; attempt++) {
+            temp_name = make_temp_name(name);
+            if (linkat(AT_FDCWD, proc_path, dir->fd, temp_name, AT_SYMLINK_FOLLOW) != 0) {
+                int saved_errno = errno;
+                g_clear_pointer(&temp_name, g_free);
+                if (saved_errno != EEXIST) {
+                    errno = saved_errno;
+                    goto fail;
+                }
+            }
+        }
+        if (!temp_name) {
+            errno = EEXIST;
+            goto fail;
+        }
+    }
+    if (renameat(dir->fd, temp_name, dir->fd, name) != 0) {
+        goto fail;
+    }
+    g_clear_pointer(&temp_name, g_free);
+    success = TRUE;
+
+done:
+    dir->dirty = TRUE;
+    writer->stats.files++;
+    writer->stats.bytes += content_length;
+    goto out;
+
+fail:
+    *error_msg = g_strdup_printf("Failed to write %s: %s", path, g_strerror(errno));
+    if (temp_name && dir) {
+        unlinkat(dir->fd, temp_name, 0);
+    }
+
+out:
+    if (fd >= 0) {
+        close(fd);
+    }
+    g_free(temp_name);
+    g_free(name);
+    g_free(dir_path);
+    writer->stats.elapsed_us += g_get_monotonic_time() - start_us;
+    return success;
+}
+
+gboolean file_writer_commit(FileWriter *writer, gchar **error_msg) {
+    gint64 start_us = g_get_monotonic_time();
+    GString *errors = NULL;
+    GHashTableIter iter;
+    gpointer key, value;
+    
+    g_hash_table_iter_init(&iter, writer->dirs);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        WriterDir *dir = value;
+        if (!dir->dirty) {
+            continue;
+        }
+        dir->dirty = FALSE;
+        if (writer->durability < FILE_DURABILITY_FULL) {
+            continue;
+        }
+        if (fsync(dir->fd) == 0) {
+            writer->stats.dir_syncs++;
+        } else {
+            if (!errors) errors = g_string_new(NULL);
+            g_string_append_printf(errors, "%sFailed to sync directory %s: %s", errors->len > 0 ? "\n" : "",
+                                   (const gchar*)key, g_strerror(errno));
+        }
+    }
+    
+    writer->stats.elapsed_us += g_get_monotonic_time() - start_us;
+    if (errors) {
+        *error_msg = g_string_free(errors, FALSE);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+void file_writer_get_stats(const FileWriter *writer, FileWriterStats *stats) {
+    *stats = writer->stats;
+}
+
+static const gchar *durability_names[] = { "none", "data", "full" };
+
+const gchar* file_durability_to_string(FileDurability durability) {
+    return durability <= FILE_DURABILITY_FULL ? durability_names[durability] : NULL;
+}
+
+gboolean file_durability_from_string(const gchar *name, FileDurability *durability) {
+    for (guint i = 0; i < G_N_ELEMENTS(durability_names); i++) {
+        if (g_strcmp0(name, durability_names[i]) == 0) {
+            *durability = (FileDurability)i;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
@@ -0,0 +1,60 @@
+#ifndef FILE_WRITER_H
+#define FILE_WRITER_H
+
+#include <glib.h>
+#include <sys/types.h>
+
+// Batched, atomic file writes.
+// Every file is written to an unnamed O_TMPFILE inode (or a hidden
+// temporary name where the file system has no O_TMPFILE) that is created
+// with its final mode, and only linked or renamed over the target once it
+// is complete, so nobody ever sees a partial file. Target directories stay
+// open for the life of the writer and are synced once per commit instead
+// of once per file.
+
+typedef enum {
+    FILE_DURABILITY_NONE,   // Atomic replacement only; the kernel writes back when it likes
+    FILE_DURABILITY_DATA,   // Each file's contents reach the disk before it gets its name
+    FILE_DURABILITY_FULL    // DATA, and commit syncs each directory once so new names survive a crash
+} FileDurability;
+
+typedef struct {
+    guint files;
+    guint64 bytes;
+    guint file_syncs;
+    guint dir_syncs;
+    gint64 elapsed_us;      // Time spent writing and committing
+} FileWriterStats;
+
+typedef struct _FileWriter FileWriter;
+
+FileWriter* file_writer_new(FileDurability durability);
+
+// Closes the directories. Files written since the last commit are in
+// place, but with FILE_DURABILITY_FULL their names are not synced yet.
+void file_writer_free(FileWriter *writer);
+
+// Takes dir_fd, an open directory, as the directory at dir_path: writes
+// there then resolve no path, only the file name within it. The writer
+// closes dir_fd, at once if it already has dir_path open.
+void file_writer_adopt_dir(FileWriter *writer, const gchar *dir_path, int dir_fd);
+
+// Gives the files written from now on this owner (-1 keeps either id),
+// before they get their names
+void file_writer_set_owner(FileWriter *writer, uid_t uid, gid_t gid);
+
+// Atomically creates or replaces path (whose directory must exist) with
+// content (length -1 = NUL-terminated) and permissions mode
+gboolean file_writer_write(FileWriter *writer, const gchar *path, const gchar *content, gssize length,
+                           mode_t mode, gchar **error_msg);
+
+// Makes everything written so far durable at the writer's level
+gboolean file_writer_commit(FileWriter *writer, gchar **error_msg);
+
+void file_writer_get_stats(const FileWriter *writer, FileWriterStats *stats);
+
+// "none", "data" and "full"
+const gchar* file_durability_to_string(FileDurability durability);
+gboolean file_durability_from_string(const gchar *name, FileDurability *durability);
+
+#endif // FILE_WRITER_H
@@ -0,0 +1,326 @@
+#define _GNU_SOURCE
+#include "home_provision.h"
+#include "mime_cache.h"
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef SYS_openat2
+#include <linux/openat2.h>
+#endif
+
+#define PROVISION_UID_MIN 1000       // Defaults of login.defs
+#define PROVISION_UID_MAX 60000
+
+typedef struct {
+    const gchar * const *homes;
+    const HomeProvisionItem *items;
+    guint n_items;
+    const HomeProvisionOptions *options;
+    int root_fd;              // -1 without a root
+    HomeProvisionResult **results;
+} ProvisionContext;
+
+typedef struct {
+    gchar *subdir;            // Relative to the home
+    int fd;
+    gchar *path;              // For messages and the writer
+    GPtrArray *written;       // File names written there
+} ProvisionTarget;
+
+void home_provision_options_init(HomeProvisionOptions *options) {
+    memset(options, 0, sizeof(*options));
+    options->overwrite_policy = FILE_OVERWRITE_FAIL;
+    options->durability = FILE_DURABILITY_FULL;
+}
+
+void home_provision_result_free(HomeProvisionResult *result) {
+    if (result) {
+        g_free(result->home);
+        g_free(result->error);
+        g_free(result);
+    }
+}
+
+// Opens path, relative to the root when there is one, without letting
+// symbolic links resolve outside of it
+static int open_home(const ProvisionContext *context, const gchar *home) {
+    int flags = O_RDONLY | O_DIRECTORY | O_CLOEXEC;
+    if (context->root_fd < 0) {
+        return open(home, flags);
+    }
+    while (*home == '/') {
+        home++;
+    }
+    if (*home == '\0') {
+        home = ".";
+    }
+#ifdef SYS_openat2
+    struct open_how how;
+    memset(&how, 0, sizeof(how));
+    how.flags = flags;
+    how.resolve = RESOLVE_IN_ROOT | RESOLVE_NO_MAGICLINKS;
+    int fd = syscall(SYS_openat2, context->root_fd, home, &how, sizeof(how));
+    if (fd >= 0 || errno != ENOSYS) {
+        return fd;
+    }
+#endif
+    return openat(context->root_fd, home, flags);
+}
+
+static void provision_home(ProvisionContext *context, guint index) {
+    gint64 start_us = g_get_monotonic_time();
+    const HomeProvisionOptions *options = context->options;
+    const gchar *home = context->homes[index];
+    HomeProvisionResult *result = g_new0(HomeProvisionResult, 1);
+    result->home = g_strdup(home);
+    context->results[index] = result;
+    
+    gchar *home_path = g_build_filename(options->root ? options->root : "/", home, NULL);
+    int home_fd = open_home(context, home);
+    struct stat st;
+    if (home_fd < 0 || fstat(home_fd, &st) != 0) {
+        result->error = g_strdup_printf("Could not open %s: %s", home_path, g_strerror(errno));
+        if (home_fd >= 0) {
+            close(home_fd);
+        }
+        g_free(home_path);
+        result->elapsed_us = g_get_monotonic_time() - start_us;
+        return;
+    }
+    
+    // Writing into someone else's home: hand over what we create
+    gboolean foreign = st.st_uid != geteuid();
+    uid_t owner_uid = foreign && geteuid() == 0 ? st.st_uid : (uid_t)-1;
+    gid_t owner_gid = foreign && geteuid() == 0 ? st.st_gid : (gid_t)-1;
+    FileWriter *writer = file_writer_new(options->durability);
+    file_writer_set_owner(writer, owner_uid, owner_gid);
+    
+    // Their desktop as their user-dirs.dirs names it; the data directory
+    // is the default, their environment being unknown
+    ProvisionTarget targets[2];
+    guint n_targets = 0;
+    if (options->to_desktop) {
+        targets[n_targets++].subdir = user_dirs_get_desktop_subdir_at(home_fd);
+    }
+    if (options->to_local_apps) {
+        targets[n_targets++].subdir = g_strdup(USER_DIRS_APPLICATIONS_SUBDIR);
+    }
+    
+    GString *errors = g_string_new(NULL);
+    for (guint t = 0; t < n_targets; t++) {
+        ProvisionTarget *target = &targets[t];
+        target->path = g_build_filename(home_path, target->subdir, NULL);
+        target->written = g_ptr_array_new();
+        // In a foreign home or a staging root links are not followed, so
+        // none can lead out of it; as root the directories created get the
+        // home's owner
+        gboolean confined = foreign || context->root_fd >= 0;
+        target->fd = user_dirs_make_at(home_fd, target->subdir, confined ? O_NOFOLLOW : 0,
+                                       owner_uid, owner_gid);
+        if (target->fd < 0) {
+            g_string_append_printf(errors, "%sCould not open %s: %s", errors->len > 0 ? "\n" : "",
+                                   target->path, g_strerror(errno));
+            continue;
+        }
+        
+        // Existence is checked against the descriptor; the writer keeps a
+        // duplicate for its own writes
+        int writer_fd = fcntl(target->fd, F_DUPFD_CLOEXEC, 0);
+        if (writer_fd < 0) {
+            g_string_append_printf(errors, "%sCould not open %s: %s", errors->len > 0 ? "\n" : "",
+                                   target->path, g_strerror(errno));
+            continue;
+        }
+        file_writer_adopt_dir(writer, target->path, writer_fd);
+        for (guint i = 0; i < context->n_items; i++) {
+            const HomeProvisionItem *item = &context->items[i];
+            struct stat existing;
+            if (fstatat(target->fd, item->filename, &existing, AT_SYMLINK_NOFOLLOW) == 0 &&
+                options->overwrite_policy != FILE_OVERWRITE_FORCE) {
+                if (options->overwrite_policy == FILE_OVERWRITE_SKIP) {
+                    result->skipped++;
+                } else {
+                    g_string_append_printf(errors, "%sFile already exists: %s/%s", errors->len > 0 ? "\n" : "",
+                                           target->path, item->filename);
+                }
+                continue;
+            }
+            
+            gchar *path = g_build_filename(target->path, item->filename, NULL);
+            gchar *write_error = NULL;
+            if (file_writer_write(writer, path, item->content, -1, FILE_UTILS_DESKTOP_MODE, &write_error)) {
+                result->written++;
+                g_ptr_array_add(target->written, (gpointer)item->filename);
+            } else {
+                g_string_append_printf(errors, "%s%s", errors->len > 0 ? "\n" : "", write_error);
+                g_free(write_error);
+            }
+            g_free(path);
+        }
+    }
+    close(home_fd);
+    
+    gchar *commit_error = NULL;
+    if (!file_writer_commit(writer, &commit_error)) {
+        g_string_append_printf(errors, "%s%s", errors->len > 0 ? "\n" : "", commit_error);
+        g_free(commit_error);
+    }
+    file_writer_get_stats(writer, &result->write_stats);
+    file_writer_free(writer);
+    
+    // Through the descriptors the entries were written to, so the cache
+    // can't be redirected by a link and ends up owned like the entries.
+    // Other users' directories are only touched when they already keep a
+    // mimeinfo.cache.
+    for (guint t = 0; t < n_targets; t++) {
+        ProvisionTarget *target = &targets[t];
+        if (target->fd >= 0) {
+            gboolean create = !foreign && strcmp(target->subdir, USER_DIRS_APPLICATIONS_SUBDIR) == 0;
+            gchar *mime_error = NULL;
+            if (!mime_cache_update_at(target->fd, target->path, (const gchar * const *)target->written->pdata,
+                                      target->written->len, create, owner_uid, owner_gid, &mime_error)) {
+                g_string_append_printf(errors, "%sCould not update mimeinfo.cache in %s: %s",
+                                       errors->len > 0 ? "\n" : "", target->path,
+                                       mime_error ? mime_error : "Unknown error");
+                g_free(mime_error);
+            }
+            close(target->fd);
+        }
+        g_ptr_array_unref(target->written);
+        g_free(target->path);
+        g_free(target->subdir);
+    }
+    
+    if (errors->len > 0) {
+        result->error = g_string_free(errors, FALSE);
+    } else {
+        g_string_free(errors, TRUE);
+    }
+    g_free(home_path);
+    result->elapsed_us = g_get_monotonic_time() - start_us;
+}
+
+static void provision_thread(gpointer data, gpointer user_data) {
+    provision_home(user_data, GPOINTER_TO_UINT(data) - 1);
+}
+
+GPtrArray* home_provision_run(const gchar * const *homes, const HomeProvisionItem *items, guint n_items,
+                              const HomeProvisionOptions *options, HomeProvisionStats *stats) {
+    gint64 start_us = g_get_monotonic_time();
+    guint n_homes = homes ? g_strv_length((gchar**)homes) : 0;
+    ProvisionContext context = { homes, items, n_items, options, -1, NULL };
+    context.results = g_new0(HomeProvisionResult*, MAX(n_homes, 1));
+    
+    if (options->root) {
+        context.root_fd = open(options->root, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    }
+    gint max_threads = options->n_threads > 0 ? (gint)options->n_threads : MAX((gint)g_get_num_processors(), 1);
+    max_threads = MIN(max_threads, (gint)MAX(n_homes, 1));
+    
+    if (options->root && context.root_fd < 0) {
+        // Every home fails the same way
+        int saved_errno = errno;
+        for (guint i = 0; i < n_homes; i++) {
+            context.results[i] = g_new0(HomeProvisionResult, 1);
+            context.results[i]->home = g_strdup(homes[i]);
+            context.results[i]->error = g_strdup_printf("Could not open %s: %s", options->root,
+                                                        g_strerror(saved_errno));
+        }
+    } else {
+        GThreadPool *pool = g_thread_pool_new(provision_thread, &context, max_threads, FALSE, NULL);
+        for (guint i = 0; i < n_homes; i++) {
+            g_thread_pool_push(pool, GUINT_TO_POINTER(i + 1), NULL);
+        }
+        g_thread_pool_free(pool, FALSE, TRUE);
+    }
+    if (context.root_fd >= 0) {
+        close(context.root_fd);
+    }
+    
+    GPtrArray *results = g_ptr_array_new_with_free_func((GDestroyNotify)home_provision_result_free);
+    for (guint i = 0; i < n_homes; i++) {
+        g_ptr_array_add(results, context.results[i]);
+    }
+    g_free(context.results);
+    
+    if (stats) {
+        memset(stats, 0, sizeof(*stats));
+        stats->homes = n_homes;
+        stats->n_threads = max_threads;
+        for (guint i = 0; i < results->len; i++) {
+            HomeProvisionResult *result = g_ptr_array_index(results, i);
+            stats->failed += result->error != NULL;
+            stats->written += result->written;
+            stats->skipped += result->skipped;
+        }
+        stats->elapsed_us = g_get_monotonic_time() - start_us;
+    }
+    return results;
+}
+
+// Reads KEY VALUE settings such as UID_MIN from login.defs
+static guint read_login_def(const gchar *defs, const gchar *key, guint fallback) {
+    if (!defs) {
+        return fallback;
+    }
+    gsize key_length = strlen(key);
+    for (const gchar *line = defs; line && *line; line = strchr(line, '\n') ? strchr(line, '\n') + 1 : NULL) {
+        while (*line == ' ' || *line == '\t') {
+            line++;
+        }
+        if (strncmp(line, key, key_length) == 0 && (line[key_length] == ' ' || line[key_length] == '\t')) {
+            return (guint)strtoul(line + key_length, NULL, 10);
+        }
+    }
+    return fallback;
+}
+
+gchar** home_provision_list_user_homes(const gchar *root, gchar **error_msg) {
+    gchar *passwd_path = g_build_filename(root ? root : "/", "etc", "passwd", NULL);
+    gchar *defs_path = g_build_filename(root ? root : "/", "etc", "login.defs", NULL);
+    gchar *passwd = NULL;
+    gchar *defs = NULL;
+    GError *read_error = NULL;
+    
+    if (!g_file_get_contents(passwd_path, &passwd, NULL, &read_error)) {
+        *error_msg = g_strdup(read_error->message);
+        g_error_free(read_error);
+        g_free(passwd_path);
+        g_free(defs_path);
+        return NULL;
+    }
+    g_file_get_contents(defs_path, &defs, NULL, NULL);
+    guint uid_min = read_login_def(defs, "UID_MIN", PROVISION_UID_MIN);
+    guint uid_max = read_login_def(defs, "UID_MAX", PROVISION_UID_MAX);
+    
+    // name:password:uid:gid:gecos:home:shell
+    GPtrArray *homes = g_ptr_array_new();
+    GHashTable *seen = g_hash_table_new(g_str_hash, g_str_equal);
+    gchar **lines = g_strsplit(passwd, "\n", -1);
+    for (gchar **line = lines; *line; line++) {
+        gchar **fields = g_strsplit(*line, ":", 7);
+        if (g_strv_length(fields) == 7 && fields[5][0] == '/') {
+            guint uid = (guint)strtoul(fields[2], NULL, 10);
+            gboolean no_login = g_str_has_suffix(fields[6], "/nologin") || g_str_has_suffix(fields[6], "/false");
+            if (uid >= uid_min && uid <= uid_max && !no_login && !g_hash_table_contains(seen, fields[5])) {
+                gchar *home = g_strdup(fields[5]);
+                g_hash_table_add(seen, home);
+                g_ptr_array_add(homes, home);
+            }
+        }
+        g_strfreev(fields);
+    }
+    g_strfreev(lines);
+    g_hash_table_destroy(seen);
+    g_ptr_array_add(homes, NULL);
+    
+    g_free(defs);
+    g_free(passwd);
+    g_free(defs_path);
+    g_free(passwd_path);
+    return (gchar**)g_ptr_array_free(homes, FALSE);
+}
@@ -0,0 +1,66 @@
+#ifndef HOME_PROVISION_H
+#define HOME_PROVISION_H
+
+#include <glib.h>
+#include "file_utils.h"
+
+// Installs the same entries into many home directories at once, for
+// shared machines and for building images in a staging root.
+// Homes are handled in parallel on a thread pool. Each worker opens its
+// home once, creates and opens the target directories relative to it
+// (mkdirat/openat) and writes every entry relative to those descriptors
+// through a FileWriter, so no full path is looked up per file. The
+// desktop is the one named by the home's own user-dirs.dirs.
+//
+// With a root, homes are resolved inside it and symbolic links cannot
+// lead out of it (openat2 RESOLVE_IN_ROOT where the kernel has it). When
+// a home belongs to another user, as when root provisions /home, new
+// directories and files are given to the home's owner. In both cases
+// symbolic links inside the home are not followed.
+
+typedef struct {
+    gchar *filename;          // e.g. "Tool.desktop"
+    gchar *content;
+} HomeProvisionItem;
+
+typedef struct {
+    const gchar *root;        // Prefix of every home, NULL for /
+    gboolean to_desktop;
+    gboolean to_local_apps;
+    FileOverwritePolicy overwrite_policy;  // FORCE, SKIP or FAIL (ASK fails)
+    FileDurability durability;
+    guint n_threads;          // 0 = one per CPU
+} HomeProvisionOptions;
+
+typedef struct {
+    gchar *home;              // As given
+    guint written;
+    guint skipped;            // Existing files kept
+    gchar *error;             // Set when the home could not be fully provisioned
+    gint64 elapsed_us;        // Time its worker spent on it
+    FileWriterStats write_stats;
+} HomeProvisionResult;
+
+typedef struct {
+    guint homes;
+    guint failed;
+    guint written;
+    guint skipped;
+    guint n_threads;
+    gint64 elapsed_us;
+} HomeProvisionStats;
+
+void home_provision_options_init(HomeProvisionOptions *options);
+
+// Writes items into every home. Returns HomeProvisionResult* in the order
+// of homes; stats may be NULL.
+GPtrArray* home_provision_run(const gchar * const *homes, const HomeProvisionItem *items, guint n_items,
+                              const HomeProvisionOptions *options, HomeProvisionStats *stats);
+
+void home_provision_result_free(HomeProvisionResult *result);
+
+// Home directories of the regular users in root's /etc/passwd (UID_MIN to
+// UID_MAX of its login.defs, without nologin or false shells)
+gchar** home_provision_list_user_homes(const gchar *root, gchar **error_msg);
+
+#endif // HOME_PROVISION_H
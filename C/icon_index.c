@@ -0,0 +1,597 @@
+#define _GNU_SOURCE
+#include "icon_index.h"
+#include "desktop_parser.h"
+#include <sys/stat.h>
+#include <dirent.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ICON_INDEX_MAX_THEMES 32     // Guards against Inherits cycles
+#define ICON_CACHE_NO_OFFSET 0xffffffffu
+
+// Icon file extensions, in order of preference
+typedef enum {
+    ICON_EXT_PNG,
+    ICON_EXT_SVG,
+    ICON_EXT_XPM,
+    ICON_EXT_NONE
+} IconExt;
+
+static const gchar *icon_ext_names[] = { ".png", ".svg", ".xpm" };
+
+// icon-theme.cache image flags
+#define ICON_CACHE_HAS_XPM (1u << 0)
+#define ICON_CACHE_HAS_SVG (1u << 1)
+#define ICON_CACHE_HAS_PNG (1u << 2)
+
+typedef enum {
+    ICON_DIR_FIXED,
+    ICON_DIR_SCALABLE,
+    ICON_DIR_THRESHOLD
+} IconDirType;
+
+// A subdirectory listed in index.theme
+typedef struct {
+    gchar *name;             // Relative to the theme, e.g. "48x48/apps"
+    IconDirType type;
+    gint size;
+    gint min_size;
+    gint max_size;
+    gint threshold;
+    gint scale;
+} IconThemeDir;
+
+typedef struct {
+    gchar *name;
+    GArray *dirs;            // IconThemeDir
+    GHashTable *dir_lookup;  // Directory name -> index + 1
+} IconTheme;
+
+// One file providing an icon. The unthemed icons of the base directories
+// use theme == themes->len.
+typedef struct {
+    guint16 theme;
+    guint16 dir;
+    guint16 base;
+    guint16 ext;
+} IconCandidate;
+
+struct _IconIndex {
+    gchar **base_dirs;
+    GPtrArray *themes;       // IconTheme*, in lookup order, hicolor last
+    GHashTable *icons;       // Name -> GArray of IconCandidate, in lookup order
+};
+
+static void icon_theme_free(IconTheme *theme) {
+    for (guint i = 0; i < theme->dirs->len; i++) {
+        g_free(g_array_index(theme->dirs, IconThemeDir, i).name);
+    }
+    g_array_unref(theme->dirs);
+    g_hash_table_unref(theme->dir_lookup);
+    g_free(theme->name);
+    g_free(theme);
+}
+
+gchar** icon_index_get_default_base_dirs(void) {
+    GPtrArray *dirs = g_ptr_array_new();
+    g_ptr_array_add(dirs, g_build_filename(g_get_home_dir(), ".icons", NULL));
+    g_ptr_array_add(dirs, g_build_filename(g_get_user_data_dir(), "icons", NULL));
+    
+    const gchar * const *system_dirs = g_get_system_data_dirs();
+    for (guint i = 0; system_dirs[i] != NULL; i++) {
+        g_ptr_array_add(dirs, g_build_filename(system_dirs[i], "icons", NULL));
+    }
+    
+    g_ptr_array_add(dirs, g_strdup("/usr/share/pixmaps"));
+    g_ptr_array_add(dirs, NULL);
+    return (gchar**)g_ptr_array_free(dirs, FALSE);
+}
+
+static gchar* read_settings_theme(const gchar *config_dir) {
+    gchar *path = g_build_filename(config_dir, "gtk-3.0", "settings.ini", NULL);
+    DesktopDocument *doc = desktop_document_new_from_file(path, NULL);
+    gchar *theme = NULL;
+    
+    if (doc) {
+        guint group = desktop_document_find_group(doc, "Settings");
+        const DesktopLine *line = desktop_document_lookup(doc, group, "gtk-icon-theme-name", NULL);
+        if (line && line->value.length > 0) {
+            theme = desktop_span_unescape(line->value, FALSE);
+            g_strstrip(theme);
+        }
+        desktop_document_free(doc);
+    }
+    g_free(path);
+    return theme;
+}
+
+gchar* icon_index_get_default_theme(void) {
+    gchar *theme = read_settings_theme(g_get_user_config_dir());
+    
+    const gchar * const *system_dirs = g_get_system_config_dirs();
+    for (guint i = 0; !theme && system_dirs[i] != NULL; i++) {
+        theme = read_settings_theme(system_dirs[i]);
+    }
+    return theme ? theme : g_strdup("hicolor");
+}
+
+gboolean icon_index_is_name(const gchar *icon) {
+    return icon && icon[0] != '\0' && !g_path_is_absolute(icon);
+}
+
+static gint line_get_int(const DesktopDocument *doc, guint group, const gchar *key, gint fallback) {
+    const DesktopLine *line = desktop_document_lookup(doc, group, key, NULL);
+    if (!line || line->value.length == 0) {
+        return fallback;
+    }
+    gchar *value = desktop_span_dup(line->value);
+    gint result = atoi(value);
+    g_free(value);
+    return result;
+}
+
+// Adds the directories listed under key (Directories, ScaledDirectories)
+static void theme_add_dirs(IconTheme *theme, const DesktopDocument *doc, guint group, const gchar *key) {
+    const DesktopLine *line = desktop_document_lookup(doc, group, key, NULL);
+    if (!line) {
+        return;
+    }
+    
+    gchar *list = desktop_span_unescape(line->value, TRUE);
+    gchar **names = g_strsplit(list, ",", -1);
+    for (guint i = 0; names[i] != NULL; i++) {
+        g_strstrip(names[i]);
+        guint dir_group = desktop_document_find_group(doc, names[i]);
+        if (names[i][0] == '\0' || dir_group == DESKTOP_NO_GROUP ||
+            g_hash_table_contains(theme->dir_lookup, names[i])) {
+            continue;
+        }
+        
+        IconThemeDir dir = { 0 };
+        dir.name = g_strdup(names[i]);
+        dir.size = line_get_int(doc, dir_group, "Size", 0);
+        dir.min_size = line_get_int(doc, dir_group, "MinSize", dir.size);
+        dir.max_size = line_get_int(doc, dir_group, "MaxSize", dir.size);
+        dir.threshold = line_get_int(doc, dir_group, "Threshold", 2);
+        dir.scale = MAX(line_get_int(doc, dir_group, "Scale", 1), 1);
+        
+        const DesktopLine *type = desktop_document_lookup(doc, dir_group, "Type", NULL);
+        if (type && desktop_span_equal(type->value, "Fixed")) {
+            dir.type = ICON_DIR_FIXED;
+        } else if (type && desktop_span_equal(type->value, "Scalable")) {
+            dir.type = ICON_DIR_SCALABLE;
+        } else {
+            dir.type = ICON_DIR_THRESHOLD;
+        }
+        
+        g_array_append_val(theme->dirs, dir);
+        g_hash_table_insert(theme->dir_lookup, dir.name, GUINT_TO_POINTER(theme->dirs->len));
+    }
+    g_strfreev(names);
+    g_free(list);
+}
+
+// Reads the first index.theme of name found in the base directories.
+// Parents listed in Inherits are appended to inherits.
+static IconTheme* theme_load(const gchar *name, gchar **base_dirs, GPtrArray *inherits) {
+    for (guint i = 0; base_dirs[i] != NULL; i++) {
+        gchar *path = g_build_filename(base_dirs[i], name, "index.theme", NULL);
+        DesktopDocument *doc = desktop_document_new_from_file(path, NULL);
+        g_free(path);
+        if (!doc) {
+            continue;
+        }
+        
+        IconTheme *theme = g_new0(IconTheme, 1);
+        theme->name = g_strdup(name);
+        theme->dirs = g_array_new(FALSE, FALSE, sizeof(IconThemeDir));
+        theme->dir_lookup = g_hash_table_new(g_str_hash, g_str_equal);
+        
+        guint group = desktop_document_find_group(doc, "Icon Theme");
+        theme_add_dirs(theme, doc, group, "Directories");
+        theme_add_dirs(theme, doc, group, "ScaledDirectories");
+        
+        const DesktopLine *line = desktop_document_lookup(doc, group, "Inherits", NULL);
+        if (line) {
+            gchar *list = desktop_span_unescape(line->value, TRUE);
+            gchar **parents = g_strsplit(list, ",", -1);
+            for (guint j = 0; parents[j] != NULL; j++) {
+                g_strstrip(parents[j]);
+                if (parents[j][0] != '\0') {
+                    g_ptr_array_add(inherits, g_strdup(parents[j]));
+                }
+            }
+            g_strfreev(parents);
+            g_free(list);
+        }
+        
+        desktop_document_free(doc);
+        return theme;
+    }
+    return NULL;
+}
+
+static gboolean theme_list_contains(GPtrArray *themes, const gchar *name) {
+    for (guint i = 0; i < themes->len; i++) {
+        if (strcmp(((IconTheme*)g_ptr_array_index(themes, i))->name, name) == 0) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+// Appends name, then (depth first) the themes it inherits
+static void theme_chain_add(IconIndex *index, const gchar *name) {
+    if (index->themes->len >= ICON_INDEX_MAX_THEMES || theme_list_contains(index->themes, name)) {
+        return;
+    }
+    
+    GPtrArray *inherits = g_ptr_array_new_with_free_func(g_free);
+    IconTheme *theme = theme_load(name, index->base_dirs, inherits);
+    if (theme) {
+        g_ptr_array_add(index->themes, theme);
+        for (guint i = 0; i < inherits->len; i++) {
+            theme_chain_add(index, g_ptr_array_index(inherits, i));
+        }
+    }
+    g_ptr_array_unref(inherits);
+}
+
+static IconExt ext_from_name(const gchar *filename, gsize *stem_length) {
+    gsize length = strlen(filename);
+    for (guint ext = 0; ext < G_N_ELEMENTS(icon_ext_names); ext++) {
+        if (length > 4 && strcmp(filename + length - 4, icon_ext_names[ext]) == 0) {
+            *stem_length = length - 4;
+            return ext;
+        }
+    }
+    return ICON_EXT_NONE;
+}
+
+static void index_add(IconIndex *index, const gchar *name, gsize name_length, IconCandidate candidate) {
+    gchar *key = g_strndup(name, name_length);
+    GArray *candidates = g_hash_table_lookup(index->icons, key);
+    
+    if (!candidates) {
+        candidates = g_array_sized_new(FALSE, FALSE, sizeof(IconCandidate), 1);
+        g_hash_table_insert(index->icons, key, candidates);
+    } else {
+        g_free(key);
+        // The same file in another format: keep the preferred one
+        for (guint i = 0; i < candidates->len; i++) {
+            IconCandidate *other = &g_array_index(candidates, IconCandidate, i);
+            if (other->theme == candidate.theme && other->dir == candidate.dir &&
+                other->base == candidate.base) {
+                other->ext = MIN(other->ext, candidate.ext);
+                return;
+            }
+        }
+    }
+    g_array_append_val(candidates, candidate);
+}
+
+static gboolean cache_read32(const gchar *data, gsize length, guint32 offset, guint32 *value) {
+    if ((gsize)offset + 4 > length) {
+        return FALSE;
+    }
+    guint32 raw;
+    memcpy(&raw, data + offset, 4);
+    *value = GUINT32_FROM_BE(raw);
+    return TRUE;
+}
+
+static guint16 cache_get16(const gchar *data, guint32 offset) {
+    guint16 raw;
+    memcpy(&raw, data + offset, 2);
+    return GUINT16_FROM_BE(raw);
+}
+
+static const gchar* cache_string(const gchar *data, gsize length, guint32 offset) {
+    if (offset >= length || !memchr(data + offset, '\0', length - offset)) {
+        return NULL;
+    }
+    return data + offset;
+}
+
+// Adds the icons listed in a GTK icon-theme.cache (big-endian: header with
+// the hash and directory list offsets, hash buckets chaining icons, each
+// icon with a list of directory/format images)
+static gboolean index_add_cache(IconIndex *index, guint16 theme_index, guint16 base,
+                                const gchar *data, gsize length) {
+    IconTheme *theme = g_ptr_array_index(index->themes, theme_index);
+    guint32 hash_offset, dir_list_offset, n_dirs, n_buckets;
+    
+    if (length < 12 || cache_get16(data, 0) != 1 ||
+        !cache_read32(data, length, 4, &hash_offset) ||
+        !cache_read32(data, length, 8, &dir_list_offset) ||
+        !cache_read32(data, length, dir_list_offset, &n_dirs) ||
+        !cache_read32(data, length, hash_offset, &n_buckets) ||
+        n_dirs > G_MAXUINT16 || n_buckets > length / 4) {
+        return FALSE;
+    }
+    
+    // Cache directory index -> theme directory index + 1 (0 = not listed)
+    guint16 *dir_map = g_new0(guint16, n_dirs);
+    for (guint32 i = 0; i < n_dirs; i++) {
+        guint32 name_offset;
+        const gchar *name;
+        if (!cache_read32(data, length, dir_list_offset + 4 + i * 4, &name_offset) ||
+            !(name = cache_string(data, length, name_offset))) {
+            g_free(dir_map);
+            return FALSE;
+        }
+        dir_map[i] = GPOINTER_TO_UINT(g_hash_table_lookup(theme->dir_lookup, name));
+    }
+    
+    gboolean ok = TRUE;
+    for (guint32 bucket = 0; ok && bucket < n_buckets; bucket++) {
+        guint32 icon_offset;
+        ok = cache_read32(data, length, hash_offset + 4 + bucket * 4, &icon_offset);
+        
+        // A corrupt chain could loop; no chain is longer than the file
+        for (gsize steps = 0; ok && icon_offset != ICON_CACHE_NO_OFFSET; steps++) {
+            guint32 next, name_offset, images_offset, n_images;
+            const gchar *name;
+            ok = steps < length &&
+                 cache_read32(data, length, icon_offset, &next) &&
+                 cache_read32(data, length, icon_offset + 4, &name_offset) &&
+                 cache_read32(data, length, icon_offset + 8, &images_offset) &&
+                 cache_read32(data, length, images_offset, &n_images) &&
+                 (gsize)images_offset + 4 + (gsize)n_images * 8 <= length &&
+                 (name = cache_string(data, length, name_offset)) != NULL;
+            
+            for (guint32 i = 0; ok && i < n_images; i++) {
+                guint32 image = images_offset + 4 + i * 8;
+                guint16 dir = cache_get16(data, image);
+                guint16 flags = cache_get16(data, image + 2);
+                if (dir >= n_dirs || dir_map[dir] == 0) {
+                    continue;
+                }
+                
+                IconCandidate candidate = { theme_index, dir_map[dir] - 1, base, ICON_EXT_NONE };
+                if (flags & ICON_CACHE_HAS_PNG) {
+                    candidate.ext = ICON_EXT_PNG;
+                } else if (flags & ICON_CACHE_HAS_SVG) {
+                    candidate.ext = ICON_EXT_SVG;
+                } else if (flags & ICON_CACHE_HAS_XPM) {
+                    candidate.ext = ICON_EXT_XPM;
+                } else {
+                    continue;
+                }
+                index_add(index, name, strlen(name), candidate);
+            }
+            icon_offset = next;
+        }
+    }
+    
+    g_free(dir_map);
+    return ok;
+}
+
+// Adds the icon files in directory path
+static void index_add_dir(IconIndex *index, const gchar *path, IconCandidate candidate) {
+    DIR *dir = opendir(path);
+    if (!dir) {
+        return;
+    }
+    
+    struct dirent *dirent;
+    while ((dirent = readdir(dir)) != NULL) {
+        gsize stem_length;
+        IconExt ext = ext_from_name(dirent->d_name, &stem_length);
+        if (ext != ICON_EXT_NONE && dirent->d_name[0] != '.') {
+            candidate.ext = ext;
+            index_add(index, dirent->d_name, stem_length, candidate);
+        }
+    }
+    closedir(dir);
+}
+
+// Indexes one theme in one base directory. GTK's cache is used only when it
+// is at least as new as the theme directory, as GTK itself does.
+static void index_add_theme(IconIndex *index, guint16 theme_index, guint16 base) {
+    IconTheme *theme = g_ptr_array_index(index->themes, theme_index);
+    gchar *theme_path = g_build_filename(index->base_dirs[base], theme->name, NULL);
+    struct stat theme_st, cache_st;
+    
+    if (stat(theme_path, &theme_st) != 0 || !S_ISDIR(theme_st.st_mode)) {
+        g_free(theme_path);
+        return;
+    }
+    
+    gchar *cache_path = g_build_filename(theme_path, "icon-theme.cache", NULL);
+    gboolean cached = FALSE;
+    if (stat(cache_path, &cache_st) == 0 && cache_st.st_mtime >= theme_st.st_mtime) {
+        GMappedFile *mapped = g_mapped_file_new(cache_path, FALSE, NULL);
+        if (mapped) {
+            // A cache rejected halfway may have added some icons; the
+            // directory listing below adds the same candidates again
+            cached = index_add_cache(index, theme_index, base, g_mapped_file_get_contents(mapped),
+                                     g_mapped_file_get_length(mapped));
+            g_mapped_file_unref(mapped);
+        }
+    }
+    g_free(cache_path);
+    
+    for (guint i = 0; !cached && i < theme->dirs->len; i++) {
+        IconThemeDir *dir = &g_array_index(theme->dirs, IconThemeDir, i);
+        gchar *dir_path = g_build_filename(theme_path, dir->name, NULL);
+        IconCandidate candidate = { theme_index, i, base, ICON_EXT_NONE };
+        index_add_dir(index, dir_path, candidate);
+        g_free(dir_path);
+    }
+    g_free(theme_path);
+}
+
+IconIndex* icon_index_new(const gchar *theme, const gchar * const *base_dirs) {
+    IconIndex *index = g_new0(IconIndex, 1);
+    index->base_dirs = base_dirs ? g_strdupv((gchar**)base_dirs) : icon_index_get_default_base_dirs();
+    index->themes = g_ptr_array_new_with_free_func((GDestroyNotify)icon_theme_free);
+    index->icons = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_array_unref);
+    
+    gchar *default_theme = theme ? NULL : icon_index_get_default_theme();
+    theme_chain_add(index, theme ? theme : default_theme);
+    // hicolor is always searched, last
+    theme_chain_add(index, "hicolor");
+    g_free(default_theme);
+    
+    guint n_bases = g_strv_length(index->base_dirs);
+    for (guint t = 0; t < index->themes->len; t++) {
+        for (guint b = 0; b < n_bases; b++) {
+            index_add_theme(index, t, b);
+        }
+    }
+    
+    // Unthemed icons directly in the base directories
+    for (guint b = 0; b < n_bases; b++) {
+        IconCandidate candidate = { index->themes->len, 0, b, ICON_EXT_NONE };
+        index_add_dir(index, index->base_dirs[b], candidate);
+    }
+    return index;
+}
+
+void icon_index_free(IconIndex *index) {
+    if (index) {
+        g_strfreev(index->base_dirs);
+        g_ptr_array_unref(index->themes);
+        g_hash_table_unref(index->icons);
+        g_free(index);
+    }
+}
+
+static void icon_index_thread(GTask *task, gpointer source_object, gpointer task_data,
+                              GCancellable *cancellable) {
+    (void)source_object;  // Suppress unused parameter warning
+    (void)cancellable;    // Checked through the task
+    
+    if (g_task_return_error_if_cancelled(task)) {
+        return;
+    }
+    g_task_return_pointer(task, icon_index_new(task_data, NULL), (GDestroyNotify)icon_index_free);
+}
+
+void icon_index_new_async(const gchar *theme, GCancellable *cancellable,
+                          GAsyncReadyCallback callback, gpointer user_data) {
+    GTask *task = g_task_new(NULL, cancellable, callback, user_data);
+    g_task_set_task_data(task, g_strdup(theme), g_free);
+    g_task_run_in_thread(task, icon_index_thread);
+    g_object_unref(task);
+}
+
+IconIndex* icon_index_new_finish(GAsyncResult *result, GError **error) {
+    return g_task_propagate_pointer(G_TASK(result), error);
+}
+
+const gchar* icon_index_get_theme(const IconIndex *index) {
+    return index->themes->len > 0 ? ((IconTheme*)g_ptr_array_index(index->themes, 0))->name : NULL;
+}
+
+guint icon_index_get_n_icons(const IconIndex *index) {
+    return g_hash_table_size(index->icons);
+}
+
+static gboolean dir_matches_size(const IconThemeDir *dir, gint size) {
+    if (dir->scale != 1) {
+        return FALSE;
+    }
+    switch (dir->type) {
+        case ICON_DIR_FIXED:
+            return dir->size == size;
+        case ICON_DIR_SCALABLE:
+            return dir->min_size <= size && size <= dir->max_size;
+        case ICON_DIR_THRESHOLD:
+        default:
+            return dir->size - dir->threshold <= size && size <= dir->size + dir->threshold;
+    }
+}
+
+static gint dir_size_distance(const IconThemeDir *dir, gint size) {
+    gint min_size, max_size;
+    switch (dir->type) {
+        case ICON_DIR_FIXED:
+            return ABS(dir->size * dir->scale - size);
+        case ICON_DIR_SCALABLE:
+            min_size = dir->min_size;
+            max_size = dir->max_size;
+            break;
+        case ICON_DIR_THRESHOLD:
+        default:
+            min_size = dir->size - dir->threshold;
+            max_size = dir->size + dir->threshold;
+            break;
+    }
+    if (size < min_size * dir->scale) {
+        return min_size * dir->scale - size;
+    }
+    if (size > max_size * dir->scale) {
+        return size - max_size * dir->scale;
+    }
+    return 0;
+}
+
+static gchar* candidate_path(const IconIndex *index, const IconCandidate *candidate, const gchar *name) {
+    gchar *filename = g_strconcat(name, icon_ext_names[candidate->ext], NULL);
+    gchar *path;
+    if (candidate->theme < index->themes->len) {
+        IconTheme *theme = g_ptr_array_index(index->themes, candidate->theme);
+        IconThemeDir *dir = &g_array_index(theme->dirs, IconThemeDir, candidate->dir);
+        path = g_build_filename(index->base_dirs[candidate->base], theme->name, dir->name, filename, NULL);
+    } else {
+        path = g_build_filename(index->base_dirs[candidate->base], filename, NULL);
+    }
+    g_free(filename);
+    return path;
+}
+
+gchar* icon_index_lookup(const IconIndex *index, const gchar *name, gint size) {
+    GArray *candidates = g_hash_table_lookup(index->icons, name);
+    if (!candidates) {
+        return NULL;
+    }
+    
+    // Candidates are in lookup order, so the first theme with any match
+    // wins; within it an exact size beats the closest one
+    const IconCandidate *best = NULL;
+    gint best_distance = G_MAXINT;
+    for (guint i = 0; i < candidates->len; i++) {
+        const IconCandidate *candidate = &g_array_index(candidates, IconCandidate, i);
+        if (best && candidate->theme != best->theme) {
+            break;
+        }
+        if (candidate->theme >= index->themes->len) {
+            best = candidate;
+            break;
+        }
+        IconTheme *theme = g_ptr_array_index(index->themes, candidate->theme);
+        IconThemeDir *dir = &g_array_index(theme->dirs, IconThemeDir, candidate->dir);
+        gint distance = dir_matches_size(dir, size) ? 0 : dir_size_distance(dir, size) + 1;
+        if (distance < best_distance) {
+            best = candidate;
+            best_distance = distance;
+            if (distance == 0) {
+                break;
+            }
+        }
+    }
+    return candidate_path(index, best, name);
+}
+
+gchar* icon_index_name_for_path(const IconIndex *index, const gchar *path) {
+    gchar *basename = g_path_get_basename(path);
+    gsize stem_length;
+    gchar *name = NULL;
+    
+    if (ext_from_name(basename, &stem_length) != ICON_EXT_NONE) {
+        basename[stem_length] = '\0';
+        GArray *candidates = g_hash_table_lookup(index->icons, basename);
+        for (guint i = 0; candidates && !name && i < candidates->len; i++) {
+            gchar *indexed = candidate_path(index, &g_array_index(candidates, IconCandidate, i), basename);
+            if (strcmp(indexed, path) == 0) {
+                name = g_strdup(basename);
+            }
+            g_free(indexed);
+        }
+    }
+    g_free(basename);
+    return name;
+}
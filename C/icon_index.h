@@ -0,0 +1,48 @@
+#ifndef ICON_INDEX_H
+#define ICON_INDEX_H
+
+#include <glib.h>
+#include <gio/gio.h>
+
+// Icon theme lookup index.
+// Icon= may hold a theme name instead of a file. Names are resolved as the
+// freedesktop.org Icon Theme spec describes: the theme, the themes it
+// inherits, hicolor, then unthemed icons in the base directories. Every
+// theme is indexed once, from its icon-theme.cache when that is up to date
+// and otherwise by listing its directories, so resolving a name is a hash
+// lookup rather than a directory walk.
+
+typedef struct _IconIndex IconIndex;
+
+// Base directories: ~/.icons, the icons directory of $XDG_DATA_HOME and
+// each of $XDG_DATA_DIRS, then /usr/share/pixmaps
+gchar** icon_index_get_default_base_dirs(void);
+
+// The icon theme selected in GTK's settings.ini, or "hicolor"
+gchar* icon_index_get_default_theme(void);
+
+// Indexes theme (NULL = the default theme) and what it inherits, searching
+// base_dirs (NULL = the defaults). Missing themes just index nothing.
+IconIndex* icon_index_new(const gchar *theme, const gchar * const *base_dirs);
+
+// Builds the index on a worker thread
+void icon_index_new_async(const gchar *theme, GCancellable *cancellable,
+                          GAsyncReadyCallback callback, gpointer user_data);
+IconIndex* icon_index_new_finish(GAsyncResult *result, GError **error);
+
+void icon_index_free(IconIndex *index);
+
+const gchar* icon_index_get_theme(const IconIndex *index);
+guint icon_index_get_n_icons(const IconIndex *index);
+
+// TRUE when an Icon value is a theme name rather than an absolute path
+gboolean icon_index_is_name(const gchar *icon);
+
+// Returns the file that best matches name at size (pixels), or NULL
+gchar* icon_index_lookup(const IconIndex *index, const gchar *name, gint size);
+
+// Returns the theme name under which path is found, or NULL when path is
+// not an indexed icon (so an entry can use the name instead of the path)
+gchar* icon_index_name_for_path(const IconIndex *index, const gchar *path);
+
+#endif // ICON_INDEX_H
@@ -1,16 +1,128 @@
+#define _GNU_SOURCE
 #include <gtk/gtk.h>
 #include <glib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
 #include "wizard.h"
+#include "cli.h"
+#include "app_watch.h"
 
 // Global window reference for About dialog
 static GtkWidget *g_main_window = NULL;
 
+// Live applications index used by the save path
+static AppWatch *g_app_watch = NULL;
+
+// Images are compiled in (cre8or.gresource.xml) and decoded on first use
+#define RESOURCE_PATH "/io/github/ashes00/cre8or/"
+
+static GdkPixbuf *g_logo = NULL;
+
+// Startup profile (--profile-startup): time from process start to the
+// first painted frame, split into phases
+#define STARTUP_BUDGET_MS 250
+
+typedef struct {
+    const gchar *phase;
+    gint64 time_us;
+} StartupMark;
+
+static gboolean g_profile_startup = FALSE;
+static gint64 g_process_start_us = 0;
+static StartupMark g_startup_marks[8];
+static guint g_n_startup_marks = 0;
+
 static void on_window_destroy(GtkWidget *widget, gpointer data) {
     (void)widget;  // Suppress unused parameter warning
     (void)data;    // Suppress unused parameter warning
     gtk_main_quit();
 }
 
+static GdkPixbuf* get_logo(void) {
+    static gboolean loaded = FALSE;
+    
+    if (!loaded) {
+        loaded = TRUE;
+        GError *error = NULL;
+        g_logo = gdk_pixbuf_new_from_resource(RESOURCE_PATH "images/robot-icon2.png", &error);
+        if (!g_logo) {
+            g_printerr("Warning: %s\n", error->message);
+            g_error_free(error);
+        }
+    }
+    return g_logo;
+}
+
+// Removes flag from argv, returning whether it was there
+static gboolean take_flag(int *argc, char *argv[], const gchar *flag) {
+    for (int i = 1; i < *argc; i++) {
+        if (strcmp(argv[i], flag) == 0) {
+            memmove(&argv[i], &argv[i + 1], (*argc - i) * sizeof(char*));
+            (*argc)--;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+// Monotonic time at which the process was started, from /proc/self/stat
+// (clock tick resolution), or 0 if unavailable
+static gint64 get_process_start_us(void) {
+    gchar *stat = NULL;
+    struct timespec boot_now;
+    gint64 start_us = 0;
+    
+    if (!g_file_get_contents("/proc/self/stat", &stat, NULL, NULL)) {
+        return 0;
+    }
+    // starttime is field 22; the command name (field 2) may contain spaces
+    gchar *fields = strrchr(stat, ')');
+    if (fields && clock_gettime(CLOCK_BOOTTIME, &boot_now) == 0) {
+        gchar **values = g_strsplit(fields + 2, " ", 21);
+        if (g_strv_length(values) == 21) {
+            guint64 start_ticks = g_ascii_strtoull(values[19], NULL, 10);
+            gint64 age_us = (gint64)boot_now.tv_sec * G_USEC_PER_SEC + boot_now.tv_nsec / 1000 -
+                            (gint64)(start_ticks * G_USEC_PER_SEC / sysconf(_SC_CLK_TCK));
+            start_us = g_get_monotonic_time() - age_us;
+        }
+        g_strfreev(values);
+    }
+    g_free(stat);
+    return start_us;
+}
+
+static void startup_mark(const gchar *phase) {
+    if (g_profile_startup && g_n_startup_marks < G_N_ELEMENTS(g_startup_marks)) {
+        g_startup_marks[g_n_startup_marks].phase = phase;
+        g_startup_marks[g_n_startup_marks].time_us = g_get_monotonic_time();
+        g_n_startup_marks++;
+    }
+}
+
+static void print_startup_profile(void) {
+    gint64 origin_us = g_process_start_us ? g_process_start_us : g_startup_marks[0].time_us;
+    gint64 previous_us = origin_us;
+    
+    g_printerr("Startup profile (from %s):\n", g_process_start_us ? "process start" : "main");
+    for (guint i = 0; i < g_n_startup_marks; i++) {
+        g_printerr("  %-16s %8.2f ms  (+%.2f ms)\n", g_startup_marks[i].phase,
+                   (g_startup_marks[i].time_us - origin_us) / 1000.0,
+                   (g_startup_marks[i].time_us - previous_us) / 1000.0);
+        previous_us = g_startup_marks[i].time_us;
+    }
+    gint64 total_ms = (previous_us - origin_us) / 1000;
+    g_printerr("  time to first frame: %" G_GINT64_FORMAT " ms, budget %d ms%s\n",
+               total_ms, STARTUP_BUDGET_MS, total_ms > STARTUP_BUDGET_MS ? " (OVER BUDGET)" : "");
+}
+
+static void on_first_frame(GdkFrameClock *clock, gpointer data) {
+    (void)data;  // Suppress unused parameter warning
+    startup_mark("first frame");
+    print_startup_profile();
+    g_signal_handlers_disconnect_by_func(clock, on_first_frame, NULL);
+}
+
 static void show_about_dialog(GtkWidget *parent) {
     (void)parent;  // Suppress unused parameter warning
     GtkWidget *dialog = gtk_about_dialog_new();
@@ -21,18 +133,10 @@ static void show_about_dialog(GtkWidget *parent) {
     }
     
     // Set the logo
-    gchar *logo_path = g_build_filename("images", "robot-icon2.png", NULL);
-    if (g_file_test(logo_path, G_FILE_TEST_EXISTS)) {
-        GError *logo_error = NULL;
-        GdkPixbuf *logo = gdk_pixbuf_new_from_file(logo_path, &logo_error);
-        if (logo) {
-            gtk_about_dialog_set_logo(GTK_ABOUT_DIALOG(dialog), logo);
-            g_object_unref(logo);
-        } else if (logo_error) {
-            g_error_free(logo_error);
-        }
+    GdkPixbuf *logo = get_logo();
+    if (logo) {
+        gtk_about_dialog_set_logo(GTK_ABOUT_DIALOG(dialog), logo);
     }
-    g_free(logo_path);
     
     gtk_about_dialog_set_program_name(GTK_ABOUT_DIALOG(dialog), "Cre8or");
     gtk_about_dialog_set_version(GTK_ABOUT_DIALOG(dialog), "2.0");
@@ -78,8 +182,43 @@ static void create_menu_bar(GtkWidget *container, GtkWidget *window) {
     gtk_box_pack_start(GTK_BOX(container), menu_bar, FALSE, FALSE, 0);
 }
 
+static void on_app_watch_error(const gchar *error_msg, gpointer user_data) {
+    (void)user_data;  // Suppress unused parameter warning
+    g_printerr("Warning: %s\n", error_msg);
+}
+
+// The watch is built on a worker thread so a first-time scan never stalls
+// the window; until it is ready, saves use the index file
+static void on_app_watch_ready(GObject *source, GAsyncResult *result, gpointer user_data) {
+    (void)source;     // Suppress unused parameter warning
+    (void)user_data;
+    GError *error = NULL;
+    
+    g_app_watch = app_watch_new_finish(result, &error);
+    if (g_app_watch) {
+        app_watch_set_error_func(g_app_watch, on_app_watch_error, NULL);
+        app_watch_attach(g_app_watch, 1000);
+        app_watch_set_default(g_app_watch);
+    } else {
+        g_printerr("Warning: %s\n", error->message);
+        g_error_free(error);
+    }
+}
+
 int main(int argc, char *argv[]) {
+    g_profile_startup = take_flag(&argc, argv, "--profile-startup");
+    if (g_profile_startup) {
+        g_process_start_us = get_process_start_us();
+        startup_mark("main");
+    }
+    
+    // Headless mode runs before (and instead of) any GTK initialization
+    if (cli_is_headless(argc, argv)) {
+        return cli_run(argc, argv);
+    }
+    
     gtk_init(&argc, &argv);
+    startup_mark("gtk_init");
     
     // Create main window
     GtkWidget *window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
@@ -90,11 +229,9 @@ int main(int argc, char *argv[]) {
     // Store window reference globally
     g_main_window = window;
     
-    // Set window icon if available
-    GtkIconTheme *icon_theme = gtk_icon_theme_get_default();
-    if (gtk_icon_theme_has_icon(icon_theme, "applications-development")) {
-        gtk_window_set_icon_name(GTK_WINDOW(window), "applications-development");
-    }
+    // Set window icon; resolved by GTK when the window is realized, and
+    // ignored if the theme doesn't have it, so the theme isn't loaded here
+    gtk_window_set_icon_name(GTK_WINDOW(window), "applications-development");
     
     // Create main container
     GtkWidget *main_container = gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
@@ -106,6 +243,7 @@ int main(int argc, char *argv[]) {
     // Create wizard
     WizardState *wizard = wizard_new(window);
     gtk_box_pack_start(GTK_BOX(main_container), wizard->main_container, TRUE, TRUE, 0);
+    startup_mark("wizard built");
     
     // Connect signals
     g_signal_connect(window, "destroy", G_CALLBACK(on_window_destroy), NULL);
@@ -113,12 +251,31 @@ int main(int argc, char *argv[]) {
     // Show the wizard
     wizard_show(wizard);
     gtk_widget_show_all(window);
+    startup_mark("window shown");
+    if (g_profile_startup && gtk_widget_get_frame_clock(window)) {
+        g_signal_connect(gtk_widget_get_frame_clock(window), "after-paint",
+                        G_CALLBACK(on_first_frame), NULL);
+    }
+    app_watch_new_default_async(NULL, on_app_watch_ready, NULL);
     
     // Start GTK main loop
     gtk_main();
     
-    // Cleanup
+    // Cleanup. A save still on its worker thread was cancelled with the
+    // wizard but may be waiting on this thread; it is let finish against
+    // the index file before the watch goes.
     wizard_free(wizard);
+    app_watch_set_default(NULL);
+    file_utils_wait_for_saves();
+    if (g_app_watch) {
+        gchar *error_msg = NULL;
+        if (!app_watch_flush(g_app_watch, &error_msg)) {
+            g_printerr("Warning: %s\n", error_msg);
+            g_free(error_msg);
+        }
+        app_watch_free(g_app_watch);
+    }
+    g_clear_object(&g_logo);
     
     return 0;
 } 
\ No newline at end of file
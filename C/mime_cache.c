@@ -0,0 +1,527 @@
+#define _GNU_SOURCE
+#include "mime_cache.h"
+#include "desktop_parser.h"
+#include "file_utils.h"
+#include "file_writer.h"
+#include <sys/stat.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MIME_CACHE_FILE "mimeinfo.cache"
+#define MIME_CACHE_GROUP "[MIME Cache]"
+#define MIME_CACHE_MAX_DEPTH 32      // Bounds scans through linked directories
+
+struct _MimeCache {
+    gchar *dir;
+    int dir_fd;               // Everything is opened relative to it; -1 when dir is missing
+    int open_flags;           // Added to every openat (O_NOFOLLOW refuses links)
+    uid_t uid;                // Owner given to a rewritten cache, -1 to keep ours
+    gid_t gid;
+    GHashTable *types;        // MIME type -> GPtrArray of desktop IDs, in cache order
+    GHashTable *entries;      // Desktop ID -> GPtrArray of its MIME types
+    gboolean dirty;
+    MimeCacheStats stats;
+};
+
+// Process totals, and the paths queued by open batches (directory ->
+// GPtrArray of paths)
+G_LOCK_DEFINE_STATIC(mime_state);
+static MimeCacheStats mime_totals;
+static guint batch_depth;
+static GHashTable *batch_paths;
+static GHashTable *unwritten_dirs;   // Caches that could not be rewritten, scanned again on load
+
+// Serialises rewrites so that two threads never load the same cache, each
+// apply their own change and overwrite the other's
+G_LOCK_DEFINE_STATIC(mime_flush);
+
+static GPtrArray* string_array_new(void) {
+    return g_ptr_array_new_with_free_func(g_free);
+}
+
+static gboolean string_array_contains(GPtrArray *array, const gchar *str, guint *index) {
+    for (guint i = 0; i < array->len; i++) {
+        if (strcmp(g_ptr_array_index(array, i), str) == 0) {
+            if (index) {
+                *index = i;
+            }
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+static void cache_add(MimeCache *cache, const gchar *mime_type, const gchar *id) {
+    GPtrArray *ids = g_hash_table_lookup(cache->types, mime_type);
+    if (!ids) {
+        ids = string_array_new();
+        g_hash_table_insert(cache->types, g_strdup(mime_type), ids);
+    }
+    if (string_array_contains(ids, id, NULL)) {
+        return;
+    }
+    g_ptr_array_add(ids, g_strdup(id));
+    
+    GPtrArray *types = g_hash_table_lookup(cache->entries, id);
+    if (!types) {
+        types = string_array_new();
+        g_hash_table_insert(cache->entries, g_strdup(id), types);
+    }
+    g_ptr_array_add(types, g_strdup(mime_type));
+}
+
+static void cache_remove(MimeCache *cache, const gchar *id) {
+    GPtrArray *types = g_hash_table_lookup(cache->entries, id);
+    if (!types) {
+        return;
+    }
+    for (guint i = 0; i < types->len; i++) {
+        const gchar *mime_type = g_ptr_array_index(types, i);
+        GPtrArray *ids = g_hash_table_lookup(cache->types, mime_type);
+        guint index;
+        if (ids && string_array_contains(ids, id, &index)) {
+            // Keeps the order of the other handlers, which is their priority
+            g_ptr_array_remove_index(ids, index);
+            if (ids->len == 0) {
+                g_hash_table_remove(cache->types, mime_type);
+            }
+        }
+    }
+    g_hash_table_remove(cache->entries, id);
+    cache->dirty = TRUE;
+}
+
+// Maps the regular file name in dir_fd; NULL for anything else, so a FIFO
+// planted in place of an entry can't block the reader
+static GMappedFile* map_file_at(int dir_fd, const gchar *name, int open_flags) {
+    int fd = openat(dir_fd, name, O_RDONLY | O_NONBLOCK | O_CLOEXEC | open_flags);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    GMappedFile *mapped = fstat(fd, &st) == 0 && S_ISREG(st.st_mode) ?
+                          g_mapped_file_new_from_fd(fd, FALSE, NULL) : NULL;
+    close(fd);
+    return mapped;
+}
+
+// MIME types of the entry name in dir_fd, or NULL when it is not a
+// readable file (an empty array when it has none or is hidden)
+static GPtrArray* read_entry_types(int dir_fd, const gchar *name, int open_flags) {
+    GMappedFile *mapped = map_file_at(dir_fd, name, open_flags);
+    if (!mapped) {
+        return NULL;
+    }
+    const gchar *contents = g_mapped_file_get_contents(mapped);
+    DesktopDocument *doc = desktop_document_new_from_data(contents ? contents : "",
+                                                          g_mapped_file_get_length(mapped));
+    doc->mapped = mapped;
+    
+    GPtrArray *types = string_array_new();
+    guint group = desktop_document_find_group(doc, "Desktop Entry");
+    const DesktopLine *hidden = desktop_document_lookup(doc, group, "Hidden", NULL);
+    const DesktopLine *line = desktop_document_lookup(doc, group, "MimeType", NULL);
+    if (line && !(hidden && desktop_span_equal(hidden->value, "true"))) {
+        gchar *list = desktop_span_unescape(line->value, TRUE);
+        gchar **names = g_strsplit(list, ";", -1);
+        for (gchar **name = names; *name; name++) {
+            g_strstrip(*name);
+            if (strchr(*name, '/') && !string_array_contains(types, *name, NULL)) {
+                g_ptr_array_add(types, g_strdup(*name));
+            }
+        }
+        g_strfreev(names);
+        g_free(list);
+    }
+    desktop_document_free(doc);
+    return types;
+}
+
+// Adds every entry under the directory open at dir_fd, named by its path
+// relative to the applications directory with / turned into -
+static void cache_scan_dir(MimeCache *cache, int dir_fd, const gchar *prefix, guint depth) {
+    int fd = fcntl(dir_fd, F_DUPFD_CLOEXEC, 0);
+    DIR *handle = fd >= 0 ? fdopendir(fd) : NULL;
+    if (!handle) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return;
+    }
+    
+    int stat_flags = (cache->open_flags & O_NOFOLLOW) ? AT_SYMLINK_NOFOLLOW : 0;
+    struct dirent *ent;
+    while ((ent = readdir(handle)) != NULL) {
+        const gchar *name = ent->d_name;
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
+            continue;
+        }
+        struct stat st;
+        if (fstatat(dirfd(handle), name, &st, stat_flags) != 0) {
+            continue;
+        }
+        gchar *id = g_strconcat(prefix, name, NULL);
+        if (S_ISDIR(st.st_mode) && depth < MIME_CACHE_MAX_DEPTH) {
+            int sub_fd = openat(dirfd(handle), name, O_RDONLY | O_DIRECTORY | O_CLOEXEC | cache->open_flags);
+            if (sub_fd >= 0) {
+                gchar *sub_prefix = g_strconcat(id, "-", NULL);
+                cache_scan_dir(cache, sub_fd, sub_prefix, depth + 1);
+                g_free(sub_prefix);
+                close(sub_fd);
+            }
+        } else if (S_ISREG(st.st_mode) && g_str_has_suffix(name, ".desktop")) {
+            GPtrArray *types = read_entry_types(dirfd(handle), name, cache->open_flags);
+            for (guint i = 0; types && i < types->len; i++) {
+                cache_add(cache, g_ptr_array_index(types, i), id);
+            }
+            if (types) {
+                g_ptr_array_unref(types);
+            }
+        }
+        g_free(id);
+    }
+    closedir(handle);
+}
+
+static void cache_parse(MimeCache *cache, const gchar *contents) {
+    gboolean in_group = FALSE;
+    gchar **lines = g_strsplit(contents, "\n", -1);
+    for (gchar **iter = lines; *iter; iter++) {
+        gchar *line = g_strstrip(*iter);
+        if (line[0] == '[') {
+            in_group = strcmp(line, MIME_CACHE_GROUP) == 0;
+            continue;
+        }
+        gchar *equals = strchr(line, '=');
+        if (!in_group || !equals || line[0] == '#') {
+            continue;
+        }
+        *equals = '\0';
+        gchar **ids = g_strsplit(equals + 1, ";", -1);
+        for (gchar **id = ids; *id; id++) {
+            if ((*id)[0] != '\0') {
+                cache_add(cache, line, *id);
+            }
+        }
+        g_strfreev(ids);
+    }
+    g_strfreev(lines);
+}
+
+static gboolean cache_is_unwritten(const gchar *dir) {
+    G_LOCK(mime_state);
+    gboolean unwritten = unwritten_dirs && g_hash_table_contains(unwritten_dirs, dir);
+    G_UNLOCK(mime_state);
+    return unwritten;
+}
+
+static void cache_set_unwritten(const gchar *dir, gboolean unwritten) {
+    G_LOCK(mime_state);
+    if (unwritten) {
+        if (!unwritten_dirs) {
+            unwritten_dirs = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+        }
+        g_hash_table_add(unwritten_dirs, g_strdup(dir));
+    } else if (unwritten_dirs) {
+        g_hash_table_remove(unwritten_dirs, dir);
+    }
+    G_UNLOCK(mime_state);
+}
+
+// Takes dir_fd
+static MimeCache* cache_load_at(int dir_fd, const gchar *dir, int open_flags, uid_t uid, gid_t gid) {
+    gint64 start_us = g_get_monotonic_time();
+    MimeCache *cache = g_new0(MimeCache, 1);
+    cache->dir = g_strdup(dir);
+    cache->dir_fd = dir_fd;
+    cache->open_flags = open_flags;
+    cache->uid = uid;
+    cache->gid = gid;
+    cache->types = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_ptr_array_unref);
+    cache->entries = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_ptr_array_unref);
+    
+    // A cache this process failed to rewrite lacks the entries of that
+    // write, so it is scanned again instead of trusted
+    gboolean unwritten = cache_is_unwritten(dir);
+    GMappedFile *mapped = dir_fd >= 0 && !unwritten ? map_file_at(dir_fd, MIME_CACHE_FILE, open_flags) : NULL;
+    if (mapped) {
+        gchar *contents = g_strndup(g_mapped_file_get_contents(mapped), g_mapped_file_get_length(mapped));
+        cache_parse(cache, contents);
+        g_free(contents);
+        g_mapped_file_unref(mapped);
+    } else if (dir_fd >= 0) {
+        // What update-desktop-database would have written
+        cache_scan_dir(cache, dir_fd, "", 0);
+        cache->dirty = unwritten || g_hash_table_size(cache->types) > 0;
+        cache->stats.scans++;
+    }
+    
+    cache->stats.elapsed_us += g_get_monotonic_time() - start_us;
+    return cache;
+}
+
+MimeCache* mime_cache_load(const gchar *dir) {
+    return cache_load_at(open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC), dir, 0, (uid_t)-1, (gid_t)-1);
+}
+
+void mime_cache_free(MimeCache *cache) {
+    if (cache) {
+        G_LOCK(mime_state);
+        mime_totals.updated += cache->stats.updated;
+        mime_totals.removed += cache->stats.removed;
+        mime_totals.scans += cache->stats.scans;
+        mime_totals.writes += cache->stats.writes;
+        mime_totals.elapsed_us += cache->stats.elapsed_us;
+        G_UNLOCK(mime_state);
+        
+        g_hash_table_destroy(cache->types);
+        g_hash_table_destroy(cache->entries);
+        if (cache->dir_fd >= 0) {
+            close(cache->dir_fd);
+        }
+        g_free(cache->dir);
+        g_free(cache);
+    }
+}
+
+void mime_cache_update_entry(MimeCache *cache, const gchar *path) {
+    gint64 start_us = g_get_monotonic_time();
+    gchar *id = g_path_get_basename(path);
+    GPtrArray *types = cache->dir_fd >= 0 ? read_entry_types(cache->dir_fd, id, cache->open_flags) : NULL;
+    GPtrArray *old_types = g_hash_table_lookup(cache->entries, id);
+    
+    if (!types) {
+        cache->stats.removed++;
+        cache_remove(cache, id);
+    } else {
+        cache->stats.updated++;
+        gboolean same = old_types ? old_types->len == types->len : types->len == 0;
+        for (guint i = 0; same && i < types->len; i++) {
+            same = strcmp(g_ptr_array_index(old_types, i), g_ptr_array_index(types, i)) == 0;
+        }
+        // Rewriting an entry without touching MimeType leaves the cache as is
+        if (!same) {
+            cache_remove(cache, id);
+            for (guint i = 0; i < types->len; i++) {
+                cache_add(cache, g_ptr_array_index(types, i), id);
+            }
+            cache->dirty = TRUE;
+        }
+        g_ptr_array_unref(types);
+    }
+    
+    g_free(id);
+    cache->stats.elapsed_us += g_get_monotonic_time() - start_us;
+}
+
+const gchar * const * mime_cache_lookup(MimeCache *cache, const gchar *mime_type) {
+    GPtrArray *ids = g_hash_table_lookup(cache->types, mime_type);
+    if (!ids) {
+        return NULL;
+    }
+    // Keep the array NULL-terminated for callers without touching its length
+    g_ptr_array_add(ids, NULL);
+    g_ptr_array_set_size(ids, ids->len - 1);
+    return (const gchar * const *)ids->pdata;
+}
+
+gboolean mime_cache_write(MimeCache *cache, gchar **error_msg) {
+    if (!cache->dirty) {
+        return TRUE;
+    }
+    gint64 start_us = g_get_monotonic_time();
+    
+    // Sorted by type like update-desktop-database, so diffs stay readable
+    GList *types = g_list_sort(g_hash_table_get_keys(cache->types), (GCompareFunc)strcmp);
+    GString *out = g_string_new(MIME_CACHE_GROUP "\n");
+    for (GList *iter = types; iter; iter = iter->next) {
+        GPtrArray *ids = g_hash_table_lookup(cache->types, iter->data);
+        g_string_append_printf(out, "%s=", (const gchar*)iter->data);
+        for (guint i = 0; i < ids->len; i++) {
+            g_string_append_printf(out, "%s;", (const gchar*)g_ptr_array_index(ids, i));
+        }
+        g_string_append_c(out, '\n');
+    }
+    g_list_free(types);
+    
+    // The cache can always be rebuilt, so atomic replacement is enough
+    gchar *path = g_build_filename(cache->dir, MIME_CACHE_FILE, NULL);
+    FileWriter *writer = file_writer_new(FILE_DURABILITY_NONE);
+    if (cache->dir_fd >= 0) {
+        file_writer_adopt_dir(writer, cache->dir, fcntl(cache->dir_fd, F_DUPFD_CLOEXEC, 0));
+    }
+    file_writer_set_owner(writer, cache->uid, cache->gid);
+    gboolean success = file_writer_write(writer, path, out->str, out->len, 0644, error_msg) &&
+                       file_writer_commit(writer, error_msg);
+    file_writer_free(writer);
+    g_free(path);
+    g_string_free(out, TRUE);
+    
+    if (success) {
+        cache->dirty = FALSE;
+        cache->stats.writes++;
+    }
+    cache_set_unwritten(cache->dir, !success);
+    cache->stats.elapsed_us += g_get_monotonic_time() - start_us;
+    return success;
+}
+
+// The user's applications directory, and directories someone already
+// keeps a cache for
+static gboolean is_maintained(const gchar *dir) {
+    gchar *local_apps = file_utils_get_local_applications_directory();
+    gboolean maintained = strcmp(dir, local_apps) == 0;
+    g_free(local_apps);
+    if (!maintained) {
+        gchar *path = g_build_filename(dir, MIME_CACHE_FILE, NULL);
+        maintained = g_file_test(path, G_FILE_TEST_IS_REGULAR);
+        g_free(path);
+    }
+    return maintained;
+}
+
+static GHashTable* paths_by_dir_new(void) {
+    return g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_ptr_array_unref);
+}
+
+static void queue_path(GHashTable *queue, const gchar *dir, const gchar *path) {
+    GPtrArray *paths = g_hash_table_lookup(queue, dir);
+    if (!paths) {
+        paths = string_array_new();
+        g_hash_table_insert(queue, g_strdup(dir), paths);
+    }
+    if (!string_array_contains(paths, path, NULL)) {
+        g_ptr_array_add(paths, g_strdup(path));
+    }
+}
+
+// Applies every queued path with one load and one write per directory
+static gboolean flush_queue(GHashTable *queue, gchar **error_msg) {
+    GString *errors = NULL;
+    GHashTableIter iter;
+    gpointer key, value;
+    
+    G_LOCK(mime_flush);
+    g_hash_table_iter_init(&iter, queue);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        GPtrArray *paths = value;
+        MimeCache *cache = mime_cache_load(key);
+        for (guint i = 0; i < paths->len; i++) {
+            mime_cache_update_entry(cache, g_ptr_array_index(paths, i));
+        }
+        gchar *write_error = NULL;
+        if (!mime_cache_write(cache, &write_error)) {
+            if (!errors) errors = g_string_new(NULL);
+            g_string_append_printf(errors, "%s%s", errors->len > 0 ? "\n" : "", write_error);
+            g_free(write_error);
+        }
+        mime_cache_free(cache);
+    }
+    G_UNLOCK(mime_flush);
+    
+    if (errors) {
+        *error_msg = g_string_free(errors, FALSE);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+gboolean mime_cache_update_paths(const gchar * const *paths, guint n_paths, gchar **error_msg) {
+    GHashTable *queue = paths_by_dir_new();
+    for (guint i = 0; i < n_paths; i++) {
+        if (!g_str_has_suffix(paths[i], ".desktop")) {
+            continue;
+        }
+        gchar *absolute = g_canonicalize_filename(paths[i], NULL);
+        gchar *dir = g_path_get_dirname(absolute);
+        if (is_maintained(dir)) {
+            queue_path(queue, dir, absolute);
+        }
+        g_free(dir);
+        g_free(absolute);
+    }
+    
+    G_LOCK(mime_state);
+    if (batch_depth > 0) {
+        // Merge into the open batch; its end writes
+        GHashTableIter iter;
+        gpointer key, value;
+        g_hash_table_iter_init(&iter, queue);
+        while (g_hash_table_iter_next(&iter, &key, &value)) {
+            GPtrArray *dir_paths = value;
+            for (guint i = 0; i < dir_paths->len; i++) {
+                queue_path(batch_paths, key, g_ptr_array_index(dir_paths, i));
+            }
+        }
+        G_UNLOCK(mime_state);
+        g_hash_table_destroy(queue);
+        return TRUE;
+    }
+    G_UNLOCK(mime_state);
+    
+    gboolean success = flush_queue(queue, error_msg);
+    g_hash_table_destroy(queue);
+    return success;
+}
+
+gboolean mime_cache_update_at(int dir_fd, const gchar *dir_path, const gchar * const *names, guint n_names,
+                              gboolean create, uid_t uid, gid_t gid, gchar **error_msg) {
+    struct stat st;
+    gboolean maintained = fstatat(dir_fd, MIME_CACHE_FILE, &st, AT_SYMLINK_NOFOLLOW) == 0 ?
+                          S_ISREG(st.st_mode) : errno == ENOENT && create;
+    if (!maintained || n_names == 0) {
+        return TRUE;
+    }
+    
+    int fd = fcntl(dir_fd, F_DUPFD_CLOEXEC, 0);
+    if (fd < 0) {
+        *error_msg = g_strdup_printf("Failed to open %s: %s", dir_path, g_strerror(errno));
+        return FALSE;
+    }
+    
+    G_LOCK(mime_flush);
+    MimeCache *cache = cache_load_at(fd, dir_path, O_NOFOLLOW, uid, gid);
+    for (guint i = 0; i < n_names; i++) {
+        if (g_str_has_suffix(names[i], ".desktop") && !strchr(names[i], '/')) {
+            mime_cache_update_entry(cache, names[i]);
+        }
+    }
+    gboolean success = mime_cache_write(cache, error_msg);
+    mime_cache_free(cache);
+    G_UNLOCK(mime_flush);
+    return success;
+}
+
+void mime_cache_begin_batch(void) {
+    G_LOCK(mime_state);
+    if (batch_depth++ == 0) {
+        batch_paths = paths_by_dir_new();
+    }
+    G_UNLOCK(mime_state);
+}
+
+gboolean mime_cache_end_batch(gchar **error_msg) {
+    GHashTable *queue = NULL;
+    G_LOCK(mime_state);
+    if (batch_depth > 0 && --batch_depth == 0) {
+        queue = batch_paths;
+        batch_paths = NULL;
+    }
+    G_UNLOCK(mime_state);
+    
+    if (!queue) {
+        return TRUE;
+    }
+    gboolean success = flush_queue(queue, error_msg);
+    g_hash_table_destroy(queue);
+    return success;
+}
+
+void mime_cache_get_stats(MimeCacheStats *stats) {
+    G_LOCK(mime_state);
+    *stats = mime_totals;
+    G_UNLOCK(mime_state);
+}
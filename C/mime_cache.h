@@ -0,0 +1,63 @@
+#ifndef MIME_CACHE_H
+#define MIME_CACHE_H
+
+#include <glib.h>
+#include <sys/types.h>
+
+// In-process update-desktop-database.
+// mimeinfo.cache maps each MIME type to the desktop IDs whose MimeType key
+// lists it. Instead of rescanning the whole applications directory, the
+// existing cache is loaded and only the entries that were written or
+// removed are read again; the directory is scanned only when it has no
+// cache yet, or when this process failed to rewrite it. Maintained directories are the user's applications directory
+// and any other directory that already has a mimeinfo.cache.
+
+typedef struct _MimeCache MimeCache;
+
+typedef struct {
+    guint64 updated;          // Entries read again
+    guint64 removed;          // Entries dropped because their file is gone
+    guint64 scans;            // Full scans of directories without a usable cache
+    guint64 writes;           // Caches rewritten
+    gint64 elapsed_us;
+} MimeCacheStats;
+
+// Loads the cache of the applications directory dir, scanning the
+// directory when there is none
+MimeCache* mime_cache_load(const gchar *dir);
+void mime_cache_free(MimeCache *cache);
+
+// Reads the entry at path (directly in the cache's directory) again, or
+// drops it when the file no longer exists
+void mime_cache_update_entry(MimeCache *cache, const gchar *path);
+
+// Desktop IDs registered for mime_type, in cache order; NULL if none
+const gchar * const * mime_cache_lookup(MimeCache *cache, const gchar *mime_type);
+
+// Writes mimeinfo.cache if the associations changed since it was loaded
+gboolean mime_cache_write(MimeCache *cache, gchar **error_msg);
+
+// Brings the caches of the directories holding paths up to date, with one
+// rewrite per directory. Paths in directories that are not maintained are
+// ignored. Inside a batch the paths are only queued.
+gboolean mime_cache_update_paths(const gchar * const *paths, guint n_paths, gchar **error_msg);
+
+// mime_cache_update_paths() for the entries names in the directory open at
+// dir_fd (dir_path only names it in messages), meant for other users'
+// directories: nothing is opened through a symbolic link, and a rewritten
+// cache is given uid and gid (-1 keeps either id). The directory is left
+// alone unless it already has a mimeinfo.cache or create is set. Not
+// affected by batches.
+gboolean mime_cache_update_at(int dir_fd, const gchar *dir_path, const gchar * const *names, guint n_names,
+                              gboolean create, uid_t uid, gid_t gid, gchar **error_msg);
+
+// Coalesces updates: between begin and the matching end, saves only queue
+// their paths, and end rewrites each affected cache once. Batches nest
+// and may be used from any thread.
+void mime_cache_begin_batch(void);
+gboolean mime_cache_end_batch(gchar **error_msg);
+
+// Totals of this process
+void mime_cache_get_stats(MimeCacheStats *stats);
+
+#endif // MIME_CACHE_H
@@ -0,0 +1,158 @@
+// Importing a tree finds each executable once, whichever worker reaches it,
+// and leaves out what is hidden, excluded or behind a directory link
+
+#define _GNU_SOURCE
+#include "../app_import.h"
+#include "tests.h"
+#include <glib/gstdio.h>
+#include <string.h>
+#include <unistd.h>
+
+static gchar *sandbox;
+static gchar *root;
+
+static void write_file(const gchar *relative, const gchar *contents, gssize length, int mode) {
+    gchar *path = g_build_filename(root, relative, NULL);
+    gchar *dir = g_path_get_dirname(path);
+    g_assert_cmpint(g_mkdir_with_parents(dir, 0755), ==, 0);
+    g_assert_true(g_file_set_contents(path, contents, length, NULL));
+    g_assert_cmpint(g_chmod(path, mode), ==, 0);
+    g_free(dir);
+    g_free(path);
+}
+
+static void make_link(const gchar *target, const gchar *relative) {
+    gchar *path = g_build_filename(root, relative, NULL);
+    g_assert_cmpint(symlink(target, path), ==, 0);
+    g_free(path);
+}
+
+// The paths of items relative to root, one per line
+static gchar* relative_paths(GPtrArray *items) {
+    GString *out = g_string_new(NULL);
+    for (guint i = 0; i < items->len; i++) {
+        const AppImportItem *item = g_ptr_array_index(items, i);
+        g_assert_true(g_str_has_prefix(item->path, root));
+        g_string_append_printf(out, "%s\n", item->path + strlen(root) + 1);
+    }
+    return g_string_free(out, FALSE);
+}
+
+static const AppImportItem* find_item(GPtrArray *items, const gchar *relative) {
+    gchar *path = g_build_filename(root, relative, NULL);
+    const AppImportItem *found = NULL;
+    for (guint i = 0; i < items->len && !found; i++) {
+        const AppImportItem *item = g_ptr_array_index(items, i);
+        if (strcmp(item->path, path) == 0) {
+            found = item;
+        }
+    }
+    g_free(path);
+    g_assert_nonnull(found);
+    return found;
+}
+
+static void test_scan(void) {
+    AppImportOptions options;
+    app_import_options_init(&options);
+    gchar *exclude[] = { "*.so", "build", NULL };
+    options.exclude = exclude;
+    options.n_threads = 4;
+    options.terminal = TRUE;
+    options.icon = "utilities-terminal";
+    
+    gchar *missing = g_build_filename(sandbox, "missing", NULL);
+    gchar *bin = g_build_filename(root, "bin", NULL);
+    // Overlapping roots: bin is found through both
+    const gchar *roots[] = { root, bin, missing, NULL };
+    AppImportStats stats;
+    GPtrArray *items = app_import_scan(roots, &options, &stats);
+    
+    gchar *paths = relative_paths(items);
+    g_assert_cmpstr(paths, ==,
+                    "bin/data\n"
+                    "bin/run.sh\n"
+                    "bin/tool\n"
+                    "deep/a/b/c/d/e/f/x.py\n"
+                    "link-to-tool\n");
+    g_free(paths);
+    g_assert_cmpuint(stats.entries, ==, items->len);
+    g_assert_cmpuint(stats.unreadable, ==, 1);
+    g_assert_cmpuint(stats.workers->len, >=, 1);
+    guint worker_dirs = 0;
+    for (guint i = 0; i < stats.workers->len; i++) {
+        worker_dirs += g_array_index(stats.workers, AppImportWorkerStats, i).dirs;
+    }
+    g_assert_cmpuint(worker_dirs, ==, stats.dirs);
+    g_array_unref(stats.workers);
+    
+    const AppImportItem *item = find_item(items, "bin/run.sh");
+    g_assert_cmpstr(item->name, ==, "run");
+    g_assert_cmpint(item->type, ==, FILE_TYPE_SHELL);
+    g_assert_nonnull(strstr(item->content, "\nName=run\n"));
+    g_assert_nonnull(strstr(item->content, "\nIcon=utilities-terminal\n"));
+    g_assert_nonnull(strstr(item->content, "\nExec=gnome-terminal -- bash -c"));
+    g_assert_nonnull(strstr(item->content, item->path));
+    item = find_item(items, "bin/tool");
+    g_assert_cmpint(item->type, ==, FILE_TYPE_ELF);
+    g_assert_cmpstr(item->name, ==, "tool");
+    item = find_item(items, "deep/a/b/c/d/e/f/x.py");
+    g_assert_cmpint(item->type, ==, FILE_TYPE_PYTHON);
+    g_assert_cmpstr(item->name, ==, "x");
+    // A link to a file is imported under its own name
+    item = find_item(items, "link-to-tool");
+    g_assert_cmpint(item->type, ==, FILE_TYPE_ELF);
+    
+    g_ptr_array_unref(items);
+    g_free(bin);
+    g_free(missing);
+}
+
+static void test_include(void) {
+    AppImportOptions options;
+    app_import_options_init(&options);
+    gchar *include_path = g_build_filename(root, "deep", "*", NULL);
+    gchar *include[] = { "*.sh", include_path, NULL };
+    options.include = include;
+    
+    const gchar *roots[] = { root, NULL };
+    AppImportStats stats;
+    GPtrArray *items = app_import_scan(roots, &options, &stats);
+    gchar *paths = relative_paths(items);
+    g_assert_cmpstr(paths, ==, "bin/run.sh\ndeep/a/b/c/d/e/f/x.py\n");
+    g_free(paths);
+    g_assert_cmpuint(stats.executables, ==, 2);
+    g_array_unref(stats.workers);
+    
+    g_ptr_array_unref(items);
+    g_free(include_path);
+}
+
+int main(int argc, char *argv[]) {
+    sandbox = test_sandbox_new();
+    root = g_build_filename(sandbox, "tree", NULL);
+    
+    static const gchar elf[64] = { 0x7f, 'E', 'L', 'F', 2, 1, 1 };
+    write_file("bin/tool", elf, sizeof(elf), 0755);
+    write_file("bin/run.sh", "#!/bin/sh\n", -1, 0755);
+    write_file("bin/data", "plain", -1, 0755);
+    write_file("bin/notes.txt", "not executable", -1, 0644);
+    write_file("bin/empty", "", 0, 0755);
+    write_file("bin/.hidden", "#!/bin/sh\n", -1, 0755);
+    write_file(".config/tool", "#!/bin/sh\n", -1, 0755);
+    write_file("lib/libtool.so", elf, sizeof(elf), 0755);
+    write_file("build/tool", elf, sizeof(elf), 0755);
+    write_file("deep/a/b/c/d/e/f/x.py", "print()\n", -1, 0755);
+    make_link("bin/tool", "link-to-tool");
+    make_link(".", "link-to-root");
+    make_link("missing", "dangling");
+    
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/app_import/scan", test_scan);
+    g_test_add_func("/app_import/include", test_include);
+    int status = g_test_run();
+    
+    g_free(root);
+    test_sandbox_free(sandbox);
+    return status;
+}
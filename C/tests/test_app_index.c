@@ -0,0 +1,142 @@
+// Saves keep the applications index current instead of invalidating it,
+// without hiding what others wrote meanwhile
+
+#include "../app_index.h"
+#include "../file_utils.h"
+#include "tests.h"
+#include <glib/gstdio.h>
+#include <string.h>
+
+static gchar *sandbox;
+static gchar *system_apps;
+
+static const gchar *other_entry =
+    "[Desktop Entry]\nType=Application\nName=Other\nExec=/usr/bin/other\n";
+
+static void write_file(const gchar *path, const gchar *content) {
+    g_assert_true(g_file_set_contents(path, content, -1, NULL));
+}
+
+static FileSaveOptions* local_apps_options(FileOverwritePolicy policy) {
+    FileSaveOptions *options = file_save_options_new();
+    options->save_to_local_apps = TRUE;
+    options->overwrite_policy = policy;
+    options->durability = FILE_DURABILITY_NONE;
+    return options;
+}
+
+static void save(const gchar *name, FileSaveOptions *options) {
+    gchar *content = g_strdup_printf("[Desktop Entry]\nType=Application\nName=%s\nExec=/usr/bin/%s\n",
+                                     name, name);
+    gchar *error_msg = NULL;
+    g_assert_true(file_utils_save_desktop_file(content, name, options, &error_msg));
+    g_assert_null(error_msg);
+    g_free(content);
+}
+
+static gchar* local_apps_path(const gchar *filename) {
+    gchar *apps = file_utils_get_local_applications_directory();
+    gchar *path = g_build_filename(apps, filename, NULL);
+    g_free(apps);
+    return path;
+}
+
+static gboolean index_has_path(const AppIndex *index, const gchar *path) {
+    gboolean exists = FALSE;
+    return app_index_lookup_path(index, path, &exists) && exists;
+}
+
+static AppIndex* load_default_index(void) {
+    gchar **dirs = app_index_get_default_dirs();
+    gchar *index_path = app_index_get_default_path();
+    AppIndex *index = app_index_load(index_path, (const gchar * const *)dirs);
+    g_free(index_path);
+    g_strfreev(dirs);
+    return index;
+}
+
+static void test_saves_update_index(void) {
+    FileSaveOptions *options = local_apps_options(FILE_OVERWRITE_FORCE);
+    
+    // The first save builds the index, the second reports the system entry
+    // of the same name from it
+    save("First", options);
+    save("Other", options);
+    g_assert_nonnull(options->duplicates);
+    
+    // Both saves left an index that is current as it is
+    AppIndex *index = load_default_index();
+    g_assert_nonnull(index);
+    gchar *first = local_apps_path("First.desktop");
+    gchar *second = local_apps_path("Other.desktop");
+    g_assert_true(index_has_path(index, first));
+    g_assert_true(index_has_path(index, second));
+    
+    app_index_free(index);
+    g_free(second);
+    g_free(first);
+    file_save_options_free(options);
+}
+
+// Runs between the check and the write: another process adding an entry
+static gboolean plant_entry(GList *existing_files, gpointer user_data) {
+    (void)existing_files;  // Suppress unused parameter warning
+    write_file(user_data, other_entry);
+    return TRUE;
+}
+
+static void test_concurrent_write_not_hidden(void) {
+    FileSaveOptions *options = local_apps_options(FILE_OVERWRITE_FORCE);
+    save("Third", options);
+    file_save_options_free(options);
+    
+    gchar *planted = local_apps_path("Planted.desktop");
+    options = local_apps_options(FILE_OVERWRITE_ASK);
+    options->confirm_overwrite = plant_entry;
+    options->confirm_data = planted;
+    save("Third", options);
+    
+    // The directory changed under the save, so the index is not trusted...
+    AppIndex *index = load_default_index();
+    g_assert_null(index);
+    
+    // ...and the next load finds the planted entry
+    gchar *error_msg = NULL;
+    index = app_index_open(&error_msg);
+    g_assert_null(error_msg);
+    g_assert_true(index_has_path(index, planted));
+    app_index_free(index);
+    
+    // Which a later save doesn't replace
+    file_save_options_free(options);
+    options = local_apps_options(FILE_OVERWRITE_FAIL);
+    gchar *content = g_strdup("[Desktop Entry]\nType=Application\nName=Planted\nExec=/usr/bin/planted\n");
+    g_assert_false(file_utils_save_desktop_file(content, "Planted", options, &error_msg));
+    g_assert_nonnull(strstr(error_msg, "File already exists"));
+    
+    g_free(error_msg);
+    g_free(content);
+    g_free(planted);
+    file_save_options_free(options);
+}
+
+int main(int argc, char *argv[]) {
+    // Everything the save path touches lives in the sandbox
+    sandbox = test_sandbox_new();
+    test_sandbox_set_home(sandbox);
+    system_apps = g_build_filename(sandbox, "system", "applications", NULL);
+    g_assert_cmpint(g_mkdir_with_parents(system_apps, 0755), ==, 0);
+    
+    gchar *other = g_build_filename(system_apps, "other.desktop", NULL);
+    write_file(other, other_entry);
+    
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/app_index/saves-update-index", test_saves_update_index);
+    g_test_add_func("/app_index/concurrent-write-not-hidden", test_concurrent_write_not_hidden);
+    int status = g_test_run();
+    
+    g_free(other);
+    g_free(system_apps);
+    test_sandbox_free(sandbox);
+    return status;
+}
@@ -0,0 +1,154 @@
+// The watch is built off the calling thread, answers duplicate checks from
+// its live state and stays valid for whoever holds a reference to it
+
+#include "../app_watch.h"
+#include "../file_utils.h"
+#include "tests.h"
+#include <glib/gstdio.h>
+#include <string.h>
+
+static gchar *sandbox;
+static gchar *apps;
+
+static void write_entry(const gchar *filename, const gchar *name, const gchar *exec) {
+    gchar *path = g_build_filename(apps, filename, NULL);
+    gchar *content = g_strdup_printf("[Desktop Entry]\nType=Application\nName=%s\nExec=%s\n", name, exec);
+    g_assert_true(g_file_set_contents(path, content, -1, NULL));
+    g_free(content);
+    g_free(path);
+}
+
+static void remove_entry(const gchar *filename) {
+    gchar *path = g_build_filename(apps, filename, NULL);
+    g_assert_cmpint(g_unlink(path), ==, 0);
+    g_free(path);
+}
+
+static guint count_duplicates(AppWatch *watch, const gchar *name, const gchar *exec_path) {
+    gchar **paths = app_watch_find_duplicates(watch, name, exec_path);
+    guint count = g_strv_length(paths);
+    g_strfreev(paths);
+    return count;
+}
+
+static void on_watch_ready(GObject *source, GAsyncResult *result, gpointer user_data) {
+    (void)source;  // Suppress unused parameter warning
+    AppWatch **watch = user_data;
+    GError *error = NULL;
+    *watch = app_watch_new_finish(result, &error);
+    g_assert_no_error(error);
+}
+
+static AppWatch* new_watch(void) {
+    const gchar *dirs[] = { apps, NULL };
+    AppWatch *watch = NULL;
+    app_watch_new_async(NULL, dirs, NULL, on_watch_ready, &watch);
+    while (!watch) {
+        g_main_context_iteration(NULL, TRUE);
+    }
+    return watch;
+}
+
+static void test_live_duplicates(void) {
+    write_entry("editor.desktop", "Editor", "/usr/bin/editor");
+    
+    AppWatch *watch = new_watch();
+    
+    // Names compare case-insensitively; either key is enough
+    g_assert_cmpuint(count_duplicates(watch, "EDITOR", NULL), ==, 1);
+    g_assert_cmpuint(count_duplicates(watch, NULL, "/usr/bin/editor"), ==, 1);
+    g_assert_cmpuint(count_duplicates(watch, "Editor", "/usr/bin/editor"), ==, 1);
+    g_assert_cmpuint(count_duplicates(watch, "Viewer", "/usr/bin/viewer"), ==, 0);
+    
+    // Renaming an entry moves it between the name keys
+    write_entry("editor.desktop", "Viewer", "/usr/bin/editor");
+    write_entry("other.desktop", "Other", "/usr/bin/editor");
+    app_watch_process(watch);
+    g_assert_cmpuint(count_duplicates(watch, "Editor", NULL), ==, 0);
+    g_assert_cmpuint(count_duplicates(watch, "Viewer", NULL), ==, 1);
+    g_assert_cmpuint(count_duplicates(watch, NULL, "/usr/bin/editor"), ==, 2);
+    
+    remove_entry("editor.desktop");
+    app_watch_process(watch);
+    g_assert_cmpuint(count_duplicates(watch, "Viewer", NULL), ==, 0);
+    gchar **paths = app_watch_find_duplicates(watch, "Other", "/usr/bin/editor");
+    g_assert_cmpuint(g_strv_length(paths), ==, 1);
+    g_assert_true(g_str_has_suffix(paths[0], "/other.desktop"));
+    g_strfreev(paths);
+    
+    app_watch_free(watch);
+}
+
+static void test_default_reference(void) {
+    write_entry("shell.desktop", "Shell", "/usr/bin/shell");
+    AppWatch *watch = new_watch();
+    g_assert_null(app_watch_dup_default());
+    
+    app_watch_set_default(watch);
+    AppWatch *held = app_watch_dup_default();
+    g_assert_true(held == watch);
+    
+    // Stopping the watch clears the default; a reference taken before
+    // still answers
+    app_watch_free(watch);
+    g_assert_null(app_watch_dup_default());
+    g_assert_cmpuint(count_duplicates(held, "Shell", NULL), ==, 1);
+    app_watch_unref(held);
+    remove_entry("shell.desktop");
+}
+
+static void on_save_finished(GObject *source, GAsyncResult *result, gpointer user_data) {
+    (void)source;  // Suppress unused parameter warning
+    GError *error = NULL;
+    gboolean saved = file_utils_save_desktop_file_finish(result, NULL, &error);
+    g_assert_no_error(error);
+    g_assert_true(saved);
+    *(gboolean*)user_data = TRUE;
+}
+
+// A save still running when the main loop is done with the watch finishes
+// without it
+static void test_save_outlives_default(void) {
+    AppWatch *watch = new_watch();
+    app_watch_attach(watch, 1000);
+    app_watch_set_default(watch);
+    
+    FileSaveOptions *options = file_save_options_new();
+    options->save_to_local_apps = TRUE;
+    options->check_duplicates = FALSE;
+    options->durability = FILE_DURABILITY_NONE;
+    gboolean finished = FALSE;
+    file_utils_save_desktop_file_async("[Desktop Entry]\nType=Application\nName=Late\nExec=/usr/bin/late\n",
+                                       "Late", options, NULL, on_save_finished, &finished);
+    
+    app_watch_set_default(NULL);
+    file_utils_wait_for_saves();
+    app_watch_free(watch);
+    while (!finished) {
+        g_main_context_iteration(NULL, TRUE);
+    }
+    
+    gchar *local_apps = file_utils_get_local_applications_directory();
+    gchar *path = g_build_filename(local_apps, "Late.desktop", NULL);
+    g_assert_true(g_file_test(path, G_FILE_TEST_IS_REGULAR));
+    g_free(path);
+    g_free(local_apps);
+    file_save_options_free(options);
+}
+
+int main(int argc, char *argv[]) {
+    sandbox = test_sandbox_new();
+    test_sandbox_set_home(sandbox);
+    apps = g_build_filename(sandbox, "applications", NULL);
+    g_assert_cmpint(g_mkdir_with_parents(apps, 0755), ==, 0);
+    
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/app_watch/live-duplicates", test_live_duplicates);
+    g_test_add_func("/app_watch/default-reference", test_default_reference);
+    g_test_add_func("/app_watch/save-outlives-default", test_save_outlives_default);
+    int status = g_test_run();
+    
+    g_free(apps);
+    test_sandbox_free(sandbox);
+    return status;
+}
@@ -0,0 +1,283 @@
+// Pipelined requests are answered in order, in batches, whatever their
+// outcome, and the socket belongs to one daemon at a time
+
+#include "../daemon_client.h"
+#include "../daemon_server.h"
+#include "tests.h"
+#include <glib/gstdio.h>
+#include <string.h>
+
+#define PIPELINED 64
+
+static gchar *sandbox;
+static gchar *socket_path;
+static DaemonServer *server;
+
+// The client blocks, so it runs on a thread while this one serves
+static gint client_done;
+
+static gpointer run_client(gpointer data) {
+    ((void (*)(void))data)();
+    g_atomic_int_set(&client_done, 1);
+    g_main_context_wakeup(NULL);
+    return NULL;
+}
+
+static void serve_client(void (*client_func)(void)) {
+    g_atomic_int_set(&client_done, 0);
+    GThread *thread = g_thread_new("client", run_client, client_func);
+    while (!g_atomic_int_get(&client_done)) {
+        g_main_context_iteration(NULL, TRUE);
+    }
+    g_thread_join(thread);
+}
+
+static DaemonClient* connect_client(void) {
+    gchar *error_msg = NULL;
+    DaemonClient *client = daemon_client_connect(socket_path, &error_msg);
+    g_assert_null(error_msg);
+    g_assert_nonnull(client);
+    return client;
+}
+
+static void call(DaemonClient *client, const gchar *command, const gchar * const *fields, DaemonReply *reply) {
+    gchar *error_msg = NULL;
+    g_assert_true(daemon_client_call(client, command, fields, reply, &error_msg));
+    g_assert_null(error_msg);
+    g_assert_cmpuint(strlen(reply->body), ==, reply->length);
+    g_assert_cmpint(reply->latency_us, >=, 0);
+}
+
+static void generate_client(void) {
+    DaemonClient *client = connect_client();
+    DaemonReply reply;
+    
+    // Tabs and newlines in values survive the trip
+    const gchar *fields[] = { "name=Tool", "comment=one\ntwo\tthree", "exec=/bin/sh", "categories=IDE",
+                              "terminal=true", NULL };
+    call(client, "generate", fields, &reply);
+    g_assert_true(reply.ok);
+    g_assert_nonnull(strstr(reply.body, "\nName=Tool\n"));
+    g_assert_nonnull(strstr(reply.body, "\nComment=one\\ntwo\\tthree\n"));
+    g_assert_nonnull(strstr(reply.body, "\nTerminal=true\n"));
+    g_assert_nonnull(strstr(reply.body, "\nCategories=Development;IDE;\n"));
+    daemon_reply_clear(&reply);
+    
+    const gchar *unknown_category[] = { "name=Tool", "exec=/bin/sh", "categories=Nope", NULL };
+    call(client, "generate", unknown_category, &reply);
+    g_assert_false(reply.ok);
+    g_assert_cmpstr(reply.body, ==, "Unknown category: Nope");
+    daemon_reply_clear(&reply);
+    
+    call(client, "frobnicate", NULL, &reply);
+    g_assert_false(reply.ok);
+    g_assert_cmpstr(reply.body, ==, "Unknown command \"frobnicate\" (generate, validate, save or stats)");
+    daemon_reply_clear(&reply);
+    
+    // The connection is still good after errors
+    const gchar *minimal[] = { "name=Again", "exec=/bin/sh", NULL };
+    call(client, "generate", minimal, &reply);
+    g_assert_true(reply.ok);
+    g_assert_nonnull(strstr(reply.body, "\nName=Again\n"));
+    daemon_reply_clear(&reply);
+    
+    gchar *error_msg = NULL;
+    g_assert_false(daemon_client_read_reply(client, &reply, &error_msg));
+    g_assert_cmpstr(error_msg, ==, "No request is waiting for a reply");
+    g_free(error_msg);
+    daemon_client_free(client);
+}
+
+static void test_generate(void) {
+    serve_client(generate_client);
+}
+
+static void pipeline_client(void) {
+    DaemonClient *client = connect_client();
+    gchar *error_msg = NULL;
+    
+    for (guint i = 0; i < PIPELINED; i++) {
+        gchar *name = g_strdup_printf("name=Tool %u", i);
+        const gchar *fields[] = { name, "exec=/bin/sh", NULL };
+        daemon_client_queue(client, i % 8 == 7 ? "nope" : "generate", fields);
+        g_free(name);
+    }
+    // Already in protocol form, with a CRLF ending
+    daemon_client_queue_line(client, "generate\tname=Raw\\ttab\texec=/bin/sh\r\n");
+    g_assert_cmpuint(daemon_client_get_pending(client), ==, PIPELINED + 1);
+    g_assert_true(daemon_client_flush(client, &error_msg));
+    
+    for (guint i = 0; i < PIPELINED; i++) {
+        DaemonReply reply;
+        g_assert_true(daemon_client_read_reply(client, &reply, &error_msg));
+        if (i % 8 == 7) {
+            g_assert_false(reply.ok);
+            g_assert_true(g_str_has_prefix(reply.body, "Unknown command \"nope\""));
+        } else {
+            gchar *name = g_strdup_printf("\nName=Tool %u\n", i);
+            g_assert_true(reply.ok);
+            g_assert_nonnull(strstr(reply.body, name));
+            g_free(name);
+        }
+        daemon_reply_clear(&reply);
+    }
+    DaemonReply reply;
+    g_assert_true(daemon_client_read_reply(client, &reply, &error_msg));
+    g_assert_true(reply.ok);
+    g_assert_nonnull(strstr(reply.body, "\nName=Raw\\ttab\n"));
+    daemon_reply_clear(&reply);
+    g_assert_cmpuint(daemon_client_get_pending(client), ==, 0);
+    
+    // Only known commands have latencies
+    call(client, "stats", NULL, &reply);
+    g_assert_true(reply.ok);
+    g_assert_true(g_str_has_prefix(reply.body, "requests: "));
+    g_assert_nonnull(strstr(reply.body, "\ngenerate: "));
+    g_assert_nonnull(strstr(reply.body, " us, p99 "));
+    g_assert_null(strstr(reply.body, "nope"));
+    daemon_reply_clear(&reply);
+    
+    // Hanging up with requests in flight costs the daemon nothing
+    for (guint i = 0; i < PIPELINED; i++) {
+        daemon_client_queue_line(client, "generate\tname=Gone\texec=/bin/sh");
+    }
+    g_assert_true(daemon_client_flush(client, &error_msg));
+    daemon_client_free(client);
+}
+
+static void test_pipeline(void) {
+    DaemonServerStats before;
+    daemon_server_get_stats(server, &before);
+    serve_client(pipeline_client);
+    // Let the daemon see the last connection go
+    while (g_main_context_iteration(NULL, FALSE)) {
+    }
+    
+    DaemonServerStats stats;
+    daemon_server_get_stats(server, &stats);
+    g_assert_cmpuint(stats.connections - before.connections, ==, 1);
+    g_assert_cmpuint(stats.requests - before.requests, >=, PIPELINED + 2);
+    // One write of pipelined requests is read as a batch
+    g_assert_cmpuint(stats.batches - before.batches, <, stats.requests - before.requests);
+    g_assert_cmpuint(stats.largest_batch, >, 1);
+}
+
+static void save_client(void) {
+    DaemonClient *client = connect_client();
+    DaemonReply reply;
+    gchar *saved = g_build_filename(g_get_user_data_dir(), "applications", "Saved_Tool.desktop", NULL);
+    
+    const gchar *save[] = { "name=Saved Tool", "exec=/bin/sh", "local-apps", "durability=full", NULL };
+    call(client, "save", save, &reply);
+    g_assert_true(reply.ok);
+    g_assert_cmpstr(reply.body, ==, "");
+    daemon_reply_clear(&reply);
+    g_assert_true(g_file_test(saved, G_FILE_TEST_IS_REGULAR));
+    
+    call(client, "save", save, &reply);
+    g_assert_false(reply.ok);
+    g_assert_nonnull(strstr(reply.body, "File already exists: "));
+    daemon_reply_clear(&reply);
+    const gchar *skip[] = { "name=Saved Tool", "exec=/bin/sh", "local-apps=true", "overwrite=skip", NULL };
+    call(client, "save", skip, &reply);
+    g_assert_true(reply.ok);
+    daemon_reply_clear(&reply);
+    
+    // The same program under another name elsewhere is reported
+    const gchar *again[] = { "name=Other Name", "exec=/bin/sh", "desktop", NULL };
+    call(client, "save", again, &reply);
+    g_assert_true(reply.ok);
+    gchar *duplicate = g_strdup_printf("duplicate: %s\n", saved);
+    g_assert_cmpstr(reply.body, ==, duplicate);
+    g_free(duplicate);
+    daemon_reply_clear(&reply);
+    
+    const gchar *bad_durability[] = { "name=X", "exec=/bin/sh", "desktop", "durability=fsync", NULL };
+    call(client, "save", bad_durability, &reply);
+    g_assert_false(reply.ok);
+    g_assert_cmpstr(reply.body, ==, "Unknown durability \"fsync\" (none, data or full)");
+    daemon_reply_clear(&reply);
+    const gchar *nowhere[] = { "name=X", "exec=/bin/sh", NULL };
+    call(client, "save", nowhere, &reply);
+    g_assert_false(reply.ok);
+    g_assert_cmpstr(reply.body, ==, "save needs desktop, local-apps or output");
+    daemon_reply_clear(&reply);
+    
+    // What was saved validates cleanly; a broken file does not
+    gchar *path_field = g_strdup_printf("path=%s", saved);
+    const gchar *validate[] = { path_field, NULL };
+    call(client, "validate", validate, &reply);
+    g_assert_true(reply.ok);
+    g_assert_cmpstr(reply.body, ==, "");
+    daemon_reply_clear(&reply);
+    gchar *broken = g_build_filename(sandbox, "broken.desktop", NULL);
+    g_assert_true(g_file_set_contents(broken, "[Desktop Entry]\nType=Application\nName=B\n", -1, NULL));
+    g_free(path_field);
+    path_field = g_strdup_printf("path=%s", broken);
+    const gchar *validate_broken[] = { path_field, NULL };
+    call(client, "validate", validate_broken, &reply);
+    g_assert_false(reply.ok);
+    g_assert_cmpstr(reply.body, ==, "1: error: Exec is required for Type=Application unless DBusActivatable=true\n");
+    daemon_reply_clear(&reply);
+    
+    g_free(broken);
+    g_free(path_field);
+    g_free(saved);
+    daemon_client_free(client);
+}
+
+static void test_save(void) {
+    serve_client(save_client);
+}
+
+static void test_socket(void) {
+    gchar *error_msg = NULL;
+    g_assert_null(daemon_server_new(socket_path, &error_msg));
+    g_assert_nonnull(strstr(error_msg, "A daemon is already listening on "));
+    g_clear_pointer(&error_msg, g_free);
+    
+    gchar *other_path = g_build_filename(sandbox, "run", "other.sock", NULL);
+    DaemonServer *other = daemon_server_new(other_path, &error_msg);
+    g_assert_nonnull(other);
+    g_assert_cmpstr(daemon_server_get_socket_path(other), ==, other_path);
+    daemon_server_free(other);
+    // Gone with the daemon
+    g_assert_false(g_file_test(other_path, G_FILE_TEST_EXISTS));
+    g_assert_null(daemon_client_connect(other_path, &error_msg));
+    g_assert_nonnull(strstr(error_msg, "Could not connect to the daemon at "));
+    g_clear_pointer(&error_msg, g_free);
+    
+    gchar *regular = g_build_filename(sandbox, "regular", NULL);
+    g_assert_true(g_file_set_contents(regular, "", -1, NULL));
+    g_assert_null(daemon_server_new(regular, &error_msg));
+    g_assert_nonnull(strstr(error_msg, "exists and is not a socket"));
+    g_clear_pointer(&error_msg, g_free);
+    g_assert_true(g_file_test(regular, G_FILE_TEST_IS_REGULAR));
+    
+    g_free(regular);
+    g_free(other_path);
+}
+
+int main(int argc, char *argv[]) {
+    sandbox = test_sandbox_new();
+    test_sandbox_set_home(sandbox);
+    
+    socket_path = g_build_filename(sandbox, "run", "cre8or.sock", NULL);
+    gchar *error_msg = NULL;
+    server = daemon_server_new(socket_path, &error_msg);
+    g_assert_null(error_msg);
+    g_assert_nonnull(server);
+    
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/daemon/generate", test_generate);
+    g_test_add_func("/daemon/pipeline", test_pipeline);
+    g_test_add_func("/daemon/save", test_save);
+    g_test_add_func("/daemon/socket", test_socket);
+    int status = g_test_run();
+    
+    daemon_server_free(server);
+    g_assert_false(g_file_test(socket_path, G_FILE_TEST_EXISTS));
+    g_free(socket_path);
+    test_sandbox_free(sandbox);
+    return status;
+}
@@ -0,0 +1,132 @@
+// A Categories value goes into the bitset and back out unchanged, apart
+// from registry order and unknown names
+
+#include "../desktop_categories.h"
+#include "tests.h"
+#include <string.h>
+
+static void test_registry(void) {
+    // Every name hashes back to its own category
+    for (int i = 0; i < DESKTOP_N_CATEGORIES; i++) {
+        const gchar *name = desktop_category_get_name(i);
+        g_assert_nonnull(name);
+        g_assert_cmpint(desktop_category_from_name(name, -1), ==, i);
+        g_assert_cmpint(desktop_category_from_name(name, strlen(name)), ==, i);
+    }
+    
+    // Case-sensitive, and whole names only
+    g_assert_cmpint(desktop_category_from_name("development", -1), ==, DESKTOP_CATEGORY_INVALID);
+    g_assert_cmpint(desktop_category_from_name("Develop", -1), ==, DESKTOP_CATEGORY_INVALID);
+    g_assert_cmpint(desktop_category_from_name("IDEs", -1), ==, DESKTOP_CATEGORY_INVALID);
+    g_assert_cmpint(desktop_category_from_name("IDEs", 3), ==, DESKTOP_CATEGORY_IDE);
+    g_assert_cmpint(desktop_category_from_name("", -1), ==, DESKTOP_CATEGORY_INVALID);
+    
+    g_assert_cmpint(desktop_category_get_kind(DESKTOP_CATEGORY_GAME), ==, DESKTOP_CATEGORY_KIND_MAIN);
+    g_assert_cmpint(desktop_category_get_kind(DESKTOP_CATEGORY_IDE), ==, DESKTOP_CATEGORY_KIND_ADDITIONAL);
+    g_assert_cmpint(desktop_category_get_kind(DESKTOP_CATEGORY_SHELL), ==, DESKTOP_CATEGORY_KIND_RESERVED);
+    const DesktopCategories *main_categories = desktop_categories_get_main();
+    g_assert_cmpuint(desktop_categories_count(main_categories), ==, DESKTOP_CATEGORY_UTILITY + 1);
+    g_assert_true(desktop_categories_has(main_categories, DESKTOP_CATEGORY_AUDIO_VIDEO));
+    g_assert_false(desktop_categories_has(main_categories, DESKTOP_CATEGORY_BUILDING));
+}
+
+static void test_round_trip(void) {
+    static const struct {
+        const gchar *in;
+        const gchar *out;
+        guint unknown;
+    } cases[] = {
+        { "", "", 0 },
+        { "Development;IDE;", "Development;IDE;", 0 },
+        { "IDE;Development", "Development;IDE;", 0 },
+        { ";;Game;;Game;ActionGame;", "Game;ActionGame;", 0 },
+        { "Utility;X-Vendor-Tool;TextEditor;utility;", "Utility;TextEditor;", 2 },
+        // Either side of the word boundaries, and both ends of the registry
+        { "Documentation;Sequencer;Shell;TextEditor;Mixer;AudioVideo;",
+          "AudioVideo;Mixer;Sequencer;TextEditor;Documentation;Shell;", 0 }
+    };
+    for (guint i = 0; i < G_N_ELEMENTS(cases); i++) {
+        DesktopCategories categories;
+        desktop_categories_clear(&categories);
+        g_assert_cmpuint(desktop_categories_parse(&categories, cases[i].in, -1), ==, cases[i].unknown);
+        gchar *out = desktop_categories_to_string(&categories);
+        g_assert_cmpstr(out, ==, cases[i].out);
+        
+        // What was written reads back as the same set
+        DesktopCategories again;
+        desktop_categories_clear(&again);
+        g_assert_cmpuint(desktop_categories_parse(&again, out, -1), ==, 0);
+        g_assert_cmpint(memcmp(again.bits, categories.bits, sizeof(again.bits)), ==, 0);
+        g_free(out);
+    }
+    
+    // Only the given length is read
+    DesktopCategories categories;
+    desktop_categories_clear(&categories);
+    g_assert_cmpuint(desktop_categories_parse(&categories, "Game;Office", 4), ==, 0);
+    g_assert_cmpuint(desktop_categories_count(&categories), ==, 1);
+    g_assert_true(desktop_categories_has(&categories, DESKTOP_CATEGORY_GAME));
+}
+
+static void test_all(void) {
+    DesktopCategories all;
+    desktop_categories_clear(&all);
+    for (int i = 0; i < DESKTOP_N_CATEGORIES; i++) {
+        desktop_categories_add(&all, i);
+    }
+    g_assert_cmpuint(desktop_categories_count(&all), ==, DESKTOP_N_CATEGORIES);
+    
+    gsize length = desktop_categories_write(&all, NULL, 0);
+    g_assert_cmpuint(length, <, DESKTOP_CATEGORIES_STRING_MAX);
+    gchar buffer[DESKTOP_CATEGORIES_STRING_MAX];
+    g_assert_cmpuint(desktop_categories_write(&all, buffer, sizeof(buffer)), ==, length);
+    g_assert_cmpuint(strlen(buffer), ==, length);
+    
+    DesktopCategories again;
+    desktop_categories_clear(&again);
+    desktop_categories_parse(&again, buffer, -1);
+    g_assert_true(desktop_categories_contains(&again, &all));
+    g_assert_true(desktop_categories_contains(&all, &again));
+    
+    // Too small: nothing is written, the length still comes back
+    buffer[0] = 'x';
+    g_assert_cmpuint(desktop_categories_write(&all, buffer, length), ==, length);
+    g_assert_cmpint(buffer[0], ==, 'x');
+    
+    for (int i = 0; i < DESKTOP_N_CATEGORIES; i++) {
+        desktop_categories_remove(&again, i);
+    }
+    g_assert_true(desktop_categories_is_empty(&again));
+    g_assert_false(desktop_categories_intersects(&again, &all));
+}
+
+static void test_related(void) {
+    DesktopCategories categories;
+    desktop_categories_clear(&categories);
+    desktop_categories_parse(&categories, "IDE;Database;", -1);
+    g_assert_cmpint(desktop_categories_check(&categories), ==, DESKTOP_CATEGORY_IDE);
+    g_assert_true(desktop_categories_add_related(&categories));
+    gchar *out = desktop_categories_to_string(&categories);
+    // Development satisfies Database as well, so Office isn't added
+    g_assert_cmpstr(out, ==, "Development;IDE;Database;");
+    g_free(out);
+    g_assert_cmpint(desktop_categories_check(&categories), ==, DESKTOP_CATEGORY_INVALID);
+    g_assert_false(desktop_categories_add_related(&categories));
+    
+    // Rules that bring in categories with rules of their own
+    desktop_categories_clear(&categories);
+    desktop_categories_parse(&categories, "Printing;", -1);
+    g_assert_true(desktop_categories_add_related(&categories));
+    out = desktop_categories_to_string(&categories);
+    g_assert_cmpstr(out, ==, "Settings;HardwareSettings;Printing;");
+    g_free(out);
+}
+
+int main(int argc, char *argv[]) {
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/desktop_categories/registry", test_registry);
+    g_test_add_func("/desktop_categories/round-trip", test_round_trip);
+    g_test_add_func("/desktop_categories/all", test_all);
+    g_test_add_func("/desktop_categories/related", test_related);
+    return g_test_run();
+}
@@ -0,0 +1,169 @@
+// String values and Exec arguments are written back escaped, so what was
+// one value stays one value
+
+#include "../desktop_parser.h"
+#include "../desktop_validate.h"
+#include "tests.h"
+#include <string.h>
+
+static gchar* escape_exec(const gchar *str) {
+    gsize length = strlen(str);
+    gchar *escaped = g_malloc(desktop_exec_escaped_length(str, length) + 1);
+    escaped[desktop_exec_escape(str, length, escaped)] = '\0';
+    return escaped;
+}
+
+static gchar* escape_string(const gchar *str) {
+    gsize length = strlen(str);
+    gchar *escaped = g_malloc(desktop_string_escaped_length(str, length) + 1);
+    escaped[desktop_string_escape(str, length, escaped)] = '\0';
+    return escaped;
+}
+
+static guint count_keys(const DesktopDocument *doc, const gchar *key) {
+    guint count = 0;
+    for (guint i = 0; i < doc->n_lines; i++) {
+        count += doc->lines[i].kind == DESKTOP_LINE_KEY && desktop_span_equal(doc->lines[i].name, key);
+    }
+    return count;
+}
+
+static void test_string_escape(void) {
+    static const struct {
+        const gchar *in;
+        const gchar *out;
+    } cases[] = {
+        { "", "" },
+        { "Plain Name", "Plain Name" },
+        { "a\nb", "a\\nb" },
+        { "tab\there", "tab\\there" },
+        { "cr\r", "cr\\r" },
+        { "C:\\Apps", "C:\\\\Apps" },
+        // Exec quoting doesn't apply to string values
+        { "\"$HOME\" 100%", "\"$HOME\" 100%" },
+        // Either side of the eight-byte words the plain prefix is checked in
+        { "1234567\n", "1234567\\n" },
+        { "12345678\n", "12345678\\n" },
+        { "123456781234567\\", "123456781234567\\\\" },
+        { "1234567812345678", "1234567812345678" }
+    };
+    for (guint i = 0; i < G_N_ELEMENTS(cases); i++) {
+        gchar *escaped = escape_string(cases[i].in);
+        g_assert_cmpstr(escaped, ==, cases[i].out);
+        g_free(escaped);
+    }
+}
+
+static void test_exec_escape(void) {
+    static const struct {
+        const gchar *in;
+        const gchar *out;
+    } cases[] = {
+        { "", "" },
+        { "/opt/My Tool/run", "/opt/My Tool/run" },
+        // Quoting rules first, then the string escape on top
+        { "say \"hi\"", "say \\\\\"hi\\\\\"" },
+        { "$HOME", "\\\\$HOME" },
+        { "`id`", "\\\\`id\\\\`" },
+        { "C:\\", "C:\\\\\\\\" },
+        { "100%", "100%%" },
+        { "a\tb\nc\r", "a\\tb\\nc\\r" },
+        // Exec quoting leaves these alone
+        { "it's ~/a;b|c&d", "it's ~/a;b|c&d" }
+    };
+    for (guint i = 0; i < G_N_ELEMENTS(cases); i++) {
+        gchar *escaped = escape_exec(cases[i].in);
+        g_assert_cmpstr(escaped, ==, cases[i].out);
+        g_free(escaped);
+    }
+    
+    // Every byte at every offset of the eight-byte words the plain prefix
+    // is checked in escapes the same as it does on its own
+    for (guint c = 1; c < 256; c++) {
+        gchar single[2] = { (gchar)c, '\0' };
+        gchar *alone = escape_exec(single);
+        for (guint offset = 0; offset <= 16; offset++) {
+            gchar str[18];
+            memset(str, 'a', 17);
+            str[offset] = (gchar)c;
+            str[17] = '\0';
+            gchar *escaped = escape_exec(str);
+            gchar *expected = g_strdup_printf("%.*s%s%.*s", offset, str, alone, 16 - offset, str + offset + 1);
+            g_assert_cmpstr(escaped, ==, expected);
+            g_free(expected);
+            g_free(escaped);
+        }
+        g_free(alone);
+    }
+}
+
+static void test_round_trip(void) {
+    const gchar *data =
+        "[Desktop Entry]\n"
+        "Type=Application\n"
+        "Name=Tool\\nExec=/tmp/injected\n"
+        "Comment=Tabs\\there and a \\\\ backslash\n"
+        "Icon=/opt/icons/tool\\r\\nTerminal=true\n"
+        "Exec=/usr/bin/tool\n";
+    DesktopDocument *doc = desktop_document_new_from_data(data, strlen(data));
+    DesktopEntry *entry = desktop_entry_new();
+    gchar *error_msg = NULL;
+    g_assert_true(desktop_document_to_entry(doc, entry, &error_msg));
+    g_assert_cmpstr(entry->name, ==, "Tool\nExec=/tmp/injected");
+    
+    gchar *content = desktop_entry_generate_content(entry);
+    DesktopDocument *generated = desktop_document_new_from_data(content, strlen(content));
+    g_assert_cmpuint(count_keys(generated, "Exec"), ==, 1);
+    g_assert_cmpuint(count_keys(generated, "Terminal"), ==, 1);
+    
+    // Read back, every value is what the first file held
+    DesktopEntry *again = desktop_entry_new();
+    g_assert_true(desktop_document_to_entry(generated, again, &error_msg));
+    g_assert_cmpstr(again->name, ==, entry->name);
+    g_assert_cmpstr(again->comment, ==, "Tabs\there and a \\ backslash");
+    g_assert_cmpstr(again->icon_path, ==, entry->icon_path);
+    g_assert_cmpstr(again->exec_path, ==, "/usr/bin/tool");
+    g_assert_false(again->terminal);
+    
+    desktop_entry_free(again);
+    desktop_document_free(generated);
+    g_free(content);
+    desktop_entry_free(entry);
+    desktop_document_free(doc);
+}
+
+// Whatever the path, the generated Exec line is valid and reads back as it
+static void test_exec_round_trip(void) {
+    static const FileType types[] = { FILE_TYPE_OTHER, FILE_TYPE_SHELL, FILE_TYPE_PYTHON, FILE_TYPE_PERL };
+    const gchar *path = "/opt/$HOME/\"it's\" `x`/C:\\tmp/100% done\tnow";
+    for (guint i = 0; i < G_N_ELEMENTS(types) * 2; i++) {
+        DesktopEntry *entry = desktop_entry_new();
+        entry->name = g_strdup("Tool");
+        entry->exec_path = g_strdup(path);
+        entry->exec_type = types[i / 2];
+        entry->terminal = i % 2;
+        gchar *content = desktop_entry_generate_content(entry);
+        g_assert_cmpuint(desktop_validate(content, strlen(content), NULL), ==, 0);
+        
+        DesktopDocument *doc = desktop_document_new_from_data(content, strlen(content));
+        DesktopEntry *again = desktop_entry_new();
+        gchar *error_msg = NULL;
+        g_assert_true(desktop_document_to_entry(doc, again, &error_msg));
+        g_assert_cmpstr(again->exec_path, ==, path);
+        g_assert_cmpint(again->terminal, ==, entry->terminal);
+        
+        desktop_entry_free(again);
+        desktop_document_free(doc);
+        g_free(content);
+        desktop_entry_free(entry);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/desktop_entry/string-escape", test_string_escape);
+    g_test_add_func("/desktop_entry/exec-escape", test_exec_escape);
+    g_test_add_func("/desktop_entry/round-trip", test_round_trip);
+    g_test_add_func("/desktop_entry/exec-round-trip", test_exec_round_trip);
+    return g_test_run();
+}
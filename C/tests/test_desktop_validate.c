@@ -0,0 +1,127 @@
+// The validator reports each problem once, at its line, and a validator
+// reused across documents carries nothing from one to the next
+
+#include "../desktop_validate.h"
+#include "tests.h"
+#include <glib/gstdio.h>
+#include <string.h>
+
+// "line level message" per issue, one per line
+static gchar* check(DesktopValidator *validator, const gchar *data, guint *n_errors) {
+    GArray *issues = desktop_issues_new();
+    *n_errors = desktop_validator_check(validator, data, strlen(data), issues);
+    GString *out = g_string_new(NULL);
+    for (guint i = 0; i < issues->len; i++) {
+        const DesktopIssue *issue = &g_array_index(issues, DesktopIssue, i);
+        g_string_append_printf(out, "%u %s %s\n", issue->line,
+                               desktop_issue_level_to_string(issue->level), issue->message);
+    }
+    g_array_unref(issues);
+    return g_string_free(out, FALSE);
+}
+
+static void test_issues(void) {
+    static const struct {
+        const gchar *data;
+        const gchar *issues;
+        guint n_errors;
+    } cases[] = {
+        { "[Desktop Entry]\nType=Application\nName=Tool\n",
+          "1 error Exec is required for Type=Application unless DBusActivatable=true\n", 1 },
+        { "[Desktop Entry]\nType=Application\nName=Tool\nExec=tool\nTerminal=yes\nName=Again\n",
+          "5 error Terminal: value \"yes\" is not a boolean (true or false)\n"
+          "6 error Key \"Name\" appears more than once in this group\n", 2 },
+        { "[Desktop Entry]\nType=Application\nName=Tool\nExec=tool %f %U\n",
+          "4 error Exec: only one of %f, %F, %u and %U may be used\n", 1 },
+        // Quoting stops the Exec check at the first mistake
+        { "[Desktop Entry]\nType=Application\nName=Tool\nExec=tool \"a$b\" %f %U\n",
+          "4 error Exec: '$' must be escaped inside quotes\n", 1 },
+        { "[Desktop Entry]\nType=Application\nName=Tool\nExec=tool %d\nCategories=IDE;Tool;\n",
+          "4 warning Exec: field code %d is deprecated\n"
+          "5 error Categories: unknown category \"Tool\"; extensions start with X-\n"
+          "5 warning Categories: IDE should come with one of its related categories\n"
+          "5 hint Categories: no Main category is listed\n", 1 },
+        { "[Desktop Entry]\nType=Application\nName=Tool\nComment=Tool\nExec=tool\nActions=new;\n",
+          "4 hint Comment repeats Name\n"
+          "6 error Actions: \"new\" has no [Desktop Action new] group\n", 1 },
+        { "Name=Tool\n[Desktop Entry]\nType=Application\nName=Tool\nExec=tool\nFoo=bar\n",
+          "1 error Key outside of any group\n"
+          "6 error Unknown key \"Foo\"; extension keys start with X-\n", 2 },
+        { "", "0 error No [Desktop Entry] group\n", 1 },
+        // Nothing is left over from the documents before
+        { "[Desktop Entry]\nType=Application\nName=Tool\nExec=tool %f\nCategories=Development;IDE;\n",
+          "", 0 }
+    };
+    DesktopValidator *validator = desktop_validator_new();
+    for (guint i = 0; i < G_N_ELEMENTS(cases); i++) {
+        guint n_errors;
+        gchar *issues = check(validator, cases[i].data, &n_errors);
+        g_assert_cmpstr(issues, ==, cases[i].issues);
+        g_assert_cmpuint(n_errors, ==, cases[i].n_errors);
+        g_free(issues);
+        
+        // The count doesn't depend on the issues being collected
+        g_assert_cmpuint(desktop_validator_check(validator, cases[i].data, strlen(cases[i].data), NULL), ==,
+                         cases[i].n_errors);
+        g_assert_cmpuint(desktop_validate(cases[i].data, strlen(cases[i].data), NULL), ==, cases[i].n_errors);
+    }
+    desktop_validator_free(validator);
+}
+
+static void write_file(const gchar *dir, const gchar *name, const gchar *contents) {
+    gchar *path = g_build_filename(dir, name, NULL);
+    g_assert_true(g_file_set_contents(path, contents, -1, NULL));
+    g_free(path);
+}
+
+static void test_paths(void) {
+    gchar *sandbox = test_sandbox_new();
+    gchar *tree = g_build_filename(sandbox, "tree", NULL);
+    gchar *nested = g_build_filename(tree, "nested", NULL);
+    g_assert_cmpint(g_mkdir_with_parents(nested, 0755), ==, 0);
+    write_file(tree, "b.desktop", "[Desktop Entry]\nType=Application\nName=B\nExec=b\nTerminal=1\n");
+    write_file(tree, "a.desktop", "[Desktop Entry]\nType=Application\nName=A\nExec=a\n");
+    write_file(nested, "c.directory", "[Desktop Entry]\nType=Directory\nName=C\n");
+    write_file(tree, "notes.txt", "not checked");
+    gchar *missing = g_build_filename(sandbox, "missing.desktop", NULL);
+    
+    const gchar *paths[] = { missing, tree, NULL };
+    DesktopValidateStats stats;
+    GPtrArray *results = desktop_validate_paths(paths, 2, &stats);
+    g_assert_cmpuint(results->len, ==, 4);
+    DesktopValidateResult *result = g_ptr_array_index(results, 0);
+    g_assert_cmpstr(result->path, ==, missing);
+    g_assert_nonnull(result->read_error);
+    
+    // Sorted within the tree, each with its own issues
+    static const gchar *names[] = { "a.desktop", "b.desktop", "nested/c.directory" };
+    for (guint i = 0; i < G_N_ELEMENTS(names); i++) {
+        result = g_ptr_array_index(results, i + 1);
+        gchar *expected = g_build_filename(tree, names[i], NULL);
+        g_assert_cmpstr(result->path, ==, expected);
+        g_assert_null(result->read_error);
+        g_free(expected);
+    }
+    result = g_ptr_array_index(results, 2);
+    g_assert_cmpuint(result->n_errors, ==, 1);
+    g_assert_cmpuint(result->issues->len, ==, 1);
+    g_assert_cmpuint(g_array_index(result->issues, DesktopIssue, 0).line, ==, 5);
+    g_assert_null(((DesktopValidateResult*)g_ptr_array_index(results, 1))->issues);
+    g_assert_null(((DesktopValidateResult*)g_ptr_array_index(results, 3))->issues);
+    g_assert_cmpuint(stats.files, ==, 4);
+    // The unreadable file counts as one with errors
+    g_assert_cmpuint(stats.files_with_errors, ==, 2);
+    
+    g_ptr_array_unref(results);
+    g_free(missing);
+    g_free(nested);
+    g_free(tree);
+    test_sandbox_free(sandbox);
+}
+
+int main(int argc, char *argv[]) {
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/desktop_validate/issues", test_issues);
+    g_test_add_func("/desktop_validate/paths", test_paths);
+    return g_test_run();
+}
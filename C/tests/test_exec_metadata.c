@@ -0,0 +1,363 @@
+// An AppImage's name, icon and categories come out of its squashfs image
+// without reading the rest of it, and broken images fail with a message
+
+#include "../exec_metadata.h"
+#include "tests.h"
+#include <glib/gstdio.h>
+#include <string.h>
+
+#define BLOCK_SIZE 4096
+#define PAYLOAD_SIZE (64 * BLOCK_SIZE)
+
+static gchar *sandbox;
+
+static const gchar desktop_file[] =
+    "[Desktop Entry]\n"
+    "Type=Application\n"
+    "Name=Sketch Pad\n"
+    "Comment=Draw\\nquickly\n"
+    "Icon=sketch-pad\n"
+    "Categories=Graphics;2DGraphics;\n"
+    "Exec=AppRun %F\n";
+
+// The first bytes of a 32x32 PNG
+static const guchar png_icon[33] = {
+    0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n', 0, 0, 0, 13, 'I', 'H', 'D', 'R',
+    0, 0, 0, 32, 0, 0, 0, 32, 8, 6, 0, 0, 0
+};
+
+typedef struct {
+    guint16 compressor;
+    gboolean compress_directory;  // Store the directory table zlib-compressed
+    gboolean truncate;            // Cut the file off before its tables
+    guint8 appimage_type;
+} ImageOptions;
+
+static void put_u16(GByteArray *out, guint16 value) {
+    guint8 bytes[2] = { value, value >> 8 };
+    g_byte_array_append(out, bytes, 2);
+}
+
+static void put_u32(GByteArray *out, guint32 value) {
+    put_u16(out, value);
+    put_u16(out, value >> 16);
+}
+
+static void put_u64(GByteArray *out, guint64 value) {
+    put_u32(out, value);
+    put_u32(out, value >> 32);
+}
+
+static void set_u64(GByteArray *out, guint offset, guint64 value) {
+    for (guint i = 0; i < 8; i++) {
+        out->data[offset + i] = value >> (8 * i);
+    }
+}
+
+static void put_inode_header(GByteArray *out, guint16 type, guint16 mode, guint32 number) {
+    put_u16(out, type);
+    put_u16(out, mode);
+    put_u16(out, 0);
+    put_u16(out, 0);
+    put_u32(out, 0);
+    put_u32(out, number);
+}
+
+static gsize zlib_compress(const guint8 *data, gsize length, guint8 *out, gsize capacity) {
+    GConverter *zlib = G_CONVERTER(g_zlib_compressor_new(G_ZLIB_COMPRESSOR_FORMAT_ZLIB, 9));
+    gsize read = 0;
+    gsize written = 0;
+    g_assert_cmpint(g_converter_convert(zlib, data, length, out, capacity, G_CONVERTER_INPUT_AT_END,
+                                        &read, &written, NULL), ==, G_CONVERTER_FINISHED);
+    g_assert_cmpuint(read, ==, length);
+    g_object_unref(zlib);
+    return written;
+}
+
+// Appends a metadata block and returns its position in the image
+static guint64 put_metadata(GByteArray *image, GByteArray *block, gboolean compress) {
+    guint64 pos = image->len;
+    if (compress) {
+        guint8 compressed[8192];
+        gsize length = zlib_compress(block->data, block->len, compressed, sizeof(compressed));
+        put_u16(image, length);
+        g_byte_array_append(image, compressed, length);
+    } else {
+        put_u16(image, block->len | 0x8000);
+        g_byte_array_append(image, block->data, block->len);
+    }
+    return pos;
+}
+
+// An ELF runtime followed by a squashfs image with tool.desktop in a data
+// block, sketch-pad.png in a fragment and .DirIcon linking to it, plus a
+// payload nothing should read
+static gchar* write_appimage(const gchar *name, const ImageOptions *options) {
+    GByteArray *image = g_byte_array_new();
+    guint8 superblock[96] = { 0 };
+    g_byte_array_append(image, superblock, sizeof(superblock));
+    
+    guint32 desktop_start = image->len;
+    g_byte_array_append(image, (const guint8*)desktop_file, strlen(desktop_file));
+    // The icon shares its fragment with the tail of some other file
+    static const guint8 other_tail[7] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
+    guint32 fragment_start = image->len;
+    g_byte_array_append(image, other_tail, sizeof(other_tail));
+    g_byte_array_append(image, png_icon, sizeof(png_icon));
+    guint8 *payload = g_malloc0(PAYLOAD_SIZE);
+    g_byte_array_append(image, payload, PAYLOAD_SIZE);
+    g_free(payload);
+    
+    GByteArray *inodes = g_byte_array_new();
+    GByteArray *dir = g_byte_array_new();
+    
+    // Directory entries, sorted by name
+    static const struct {
+        const gchar *name;
+        guint16 type;
+        guint16 inode_offset;
+    } entries[] = {
+        { ".DirIcon", 3, 100 },
+        { "sketch-pad.png", 2, 68 },
+        { "tool.desktop", 2, 32 }
+    };
+    put_u32(dir, G_N_ELEMENTS(entries) - 1);
+    put_u32(dir, 0);
+    put_u32(dir, 1);
+    for (guint i = 0; i < G_N_ELEMENTS(entries); i++) {
+        put_u16(dir, entries[i].inode_offset);
+        put_u16(dir, i + 1);
+        put_u16(dir, entries[i].type);
+        put_u16(dir, strlen(entries[i].name) - 1);
+        g_byte_array_append(dir, (const guint8*)entries[i].name, strlen(entries[i].name));
+    }
+    
+    // Root directory at 0
+    put_inode_header(inodes, 1, 040755, 1);
+    put_u32(inodes, 0);
+    put_u32(inodes, 2);
+    put_u16(inodes, dir->len + 3);
+    put_u16(inodes, 0);
+    put_u32(inodes, 0);
+    // tool.desktop at 32: one stored block
+    put_inode_header(inodes, 2, 0100644, 2);
+    put_u32(inodes, desktop_start);
+    put_u32(inodes, 0xffffffff);
+    put_u32(inodes, 0);
+    put_u32(inodes, strlen(desktop_file));
+    put_u32(inodes, strlen(desktop_file) | (1u << 24));
+    // sketch-pad.png at 68: all in fragment 0, after the other tail
+    put_inode_header(inodes, 2, 0100644, 3);
+    put_u32(inodes, 0);
+    put_u32(inodes, 0);
+    put_u32(inodes, sizeof(other_tail));
+    put_u32(inodes, sizeof(png_icon));
+    // .DirIcon at 100
+    put_inode_header(inodes, 3, 0120777, 4);
+    put_u32(inodes, 1);
+    put_u32(inodes, strlen("sketch-pad.png"));
+    g_byte_array_append(inodes, (const guint8*)"sketch-pad.png", strlen("sketch-pad.png"));
+    
+    GByteArray *fragments = g_byte_array_new();
+    put_u64(fragments, fragment_start);
+    put_u32(fragments, (sizeof(other_tail) + sizeof(png_icon)) | (1u << 24));
+    put_u32(fragments, 0);
+    
+    guint64 inode_table = put_metadata(image, inodes, FALSE);
+    guint64 directory_table = put_metadata(image, dir, options->compress_directory);
+    guint64 fragment_block = put_metadata(image, fragments, FALSE);
+    guint64 fragment_table = image->len;
+    put_u64(image, fragment_block);
+    
+    GByteArray *header = g_byte_array_new();
+    put_u32(header, 0x73717368);
+    put_u32(header, 4);
+    put_u32(header, 0);
+    put_u32(header, BLOCK_SIZE);
+    put_u32(header, 1);
+    put_u16(header, options->compressor);
+    put_u16(header, 12);
+    put_u16(header, 0);
+    put_u16(header, 1);
+    put_u16(header, 4);
+    put_u16(header, 0);
+    memcpy(image->data, header->data, header->len);
+    set_u64(image, 32, 0);
+    set_u64(image, 40, image->len);
+    set_u64(image, 64, inode_table);
+    set_u64(image, 72, directory_table);
+    set_u64(image, 80, fragment_table);
+    
+    // 64-bit ELF header whose one section header ends where the image starts
+    guint8 elf[128] = { 0x7f, 'E', 'L', 'F', 2, 1, 1 };
+    if (options->appimage_type) {
+        elf[8] = 'A';
+        elf[9] = 'I';
+        elf[10] = options->appimage_type;
+    }
+    elf[0x28] = 64;
+    elf[0x3a] = 64;
+    elf[0x3c] = 1;
+    
+    gchar *path = g_build_filename(sandbox, name, NULL);
+    GByteArray *file = g_byte_array_new();
+    g_byte_array_append(file, elf, sizeof(elf));
+    g_byte_array_append(file, image->data, options->truncate ? inode_table : image->len);
+    g_assert_true(g_file_set_contents(path, (const gchar*)file->data, file->len, NULL));
+    
+    g_byte_array_unref(file);
+    g_byte_array_unref(header);
+    g_byte_array_unref(fragments);
+    g_byte_array_unref(dir);
+    g_byte_array_unref(inodes);
+    g_byte_array_unref(image);
+    return path;
+}
+
+static const ImageOptions default_image = { 1, FALSE, FALSE, 2 };
+
+static void test_read(void) {
+    gchar *path = write_appimage("SketchPad.AppImage", &default_image);
+    gchar *error_msg = NULL;
+    ExecMetadata *meta = exec_metadata_read(path, 0, &error_msg);
+    g_assert_null(error_msg);
+    g_assert_nonnull(meta);
+    g_assert_cmpuint(meta->appimage_type, ==, 2);
+    g_assert_cmpuint(meta->squashfs_offset, ==, 128);
+    g_assert_cmpstr(meta->desktop_file, ==, "tool.desktop");
+    g_assert_cmpstr(meta->name, ==, "Sketch Pad");
+    g_assert_cmpstr(meta->comment, ==, "Draw\nquickly");
+    g_assert_cmpstr(meta->icon, ==, "sketch-pad");
+    g_assert_cmpstr(meta->categories, ==, "Graphics;2DGraphics;");
+    g_assert_null(meta->icon_data);
+    // The payload is never touched
+    g_assert_cmpuint(meta->bytes_read, <, BLOCK_SIZE);
+    exec_metadata_free(meta);
+    
+    // The icon through .DirIcon, which links to a file kept in a fragment
+    meta = exec_metadata_read(path, EXEC_METADATA_ICON, &error_msg);
+    g_assert_nonnull(meta);
+    gsize length = 0;
+    const guchar *data = g_bytes_get_data(meta->icon_data, &length);
+    g_assert_cmpuint(length, ==, sizeof(png_icon));
+    g_assert_cmpint(memcmp(data, png_icon, length), ==, 0);
+    g_assert_cmpstr(meta->icon_extension, ==, "png");
+    g_assert_cmpuint(meta->icon_size, ==, 32);
+    g_assert_null(meta->icon_path);
+    exec_metadata_free(meta);
+    
+    // A gzip-compressed table reads the same
+    ImageOptions compressed = default_image;
+    compressed.compress_directory = TRUE;
+    gchar *compressed_path = write_appimage("Compressed.AppImage", &compressed);
+    meta = exec_metadata_read(compressed_path, 0, &error_msg);
+    g_assert_null(error_msg);
+    g_assert_cmpstr(meta->name, ==, "Sketch Pad");
+    exec_metadata_free(meta);
+    
+    g_free(compressed_path);
+    g_free(path);
+}
+
+static void test_install_icon(void) {
+    gchar *path = write_appimage("Install.AppImage", &default_image);
+    gchar *error_msg = NULL;
+    ExecMetadata *meta = exec_metadata_read(path, EXEC_METADATA_INSTALL_ICON, &error_msg);
+    g_assert_nonnull(meta);
+    g_assert_null(meta->icon_error);
+    gchar *expected = g_build_filename(g_get_user_data_dir(), "icons", "hicolor", "32x32", "apps",
+                                       "sketch-pad.png", NULL);
+    g_assert_cmpstr(meta->icon_path, ==, expected);
+    gchar *contents = NULL;
+    gsize length = 0;
+    g_assert_true(g_file_get_contents(expected, &contents, &length, NULL));
+    g_assert_cmpuint(length, ==, sizeof(png_icon));
+    g_free(contents);
+    
+    // Only what the entry lacks is filled in, the installed icon first
+    DesktopEntry *entry = desktop_entry_new();
+    entry->comment = g_strdup("Mine");
+    exec_metadata_apply(meta, entry);
+    g_assert_cmpstr(entry->name, ==, "Sketch Pad");
+    g_assert_cmpstr(entry->comment, ==, "Mine");
+    g_assert_cmpstr(entry->icon_path, ==, expected);
+    g_assert_true(desktop_categories_has(&entry->categories, DESKTOP_CATEGORY_2D_GRAPHICS));
+    desktop_entry_free(entry);
+    
+    g_free(expected);
+    exec_metadata_free(meta);
+    g_free(path);
+}
+
+static void test_errors(void) {
+    static const struct {
+        const gchar *name;
+        ImageOptions options;
+        const gchar *error;
+    } cases[] = {
+        { "plain", { 1, FALSE, FALSE, 0 }, NULL },
+        { "type1.AppImage", { 1, FALSE, FALSE, 1 }, "Type 1 (ISO 9660) AppImages are not supported" },
+        { "xz.AppImage", { 4, FALSE, FALSE, 2 }, "squashfs images compressed with xz are not supported" },
+        { "truncated.AppImage", { 1, FALSE, TRUE, 2 }, "beyond the end of the file" }
+    };
+    for (guint i = 0; i < G_N_ELEMENTS(cases); i++) {
+        gchar *path = write_appimage(cases[i].name, &cases[i].options);
+        gchar *error_msg = NULL;
+        ExecMetadata *meta = exec_metadata_read(path, EXEC_METADATA_ICON, &error_msg);
+        if (cases[i].error) {
+            g_assert_null(meta);
+            g_assert_nonnull(strstr(error_msg, cases[i].error));
+        } else {
+            // Without the AppImage magic the image is found all the same
+            g_assert_nonnull(meta);
+            g_assert_cmpuint(meta->appimage_type, ==, 2);
+            exec_metadata_free(meta);
+        }
+        g_free(error_msg);
+        g_free(path);
+    }
+    
+    gchar *error_msg = NULL;
+    gchar *script = g_build_filename(sandbox, "script", NULL);
+    g_assert_true(g_file_set_contents(script, "#!/bin/sh\n", -1, NULL));
+    g_assert_null(exec_metadata_read(script, 0, &error_msg));
+    g_assert_cmpstr(error_msg, ==, "Not an ELF executable");
+    g_free(error_msg);
+    g_assert_null(exec_metadata_read(sandbox, 0, &error_msg));
+    g_assert_nonnull(error_msg);
+    g_free(error_msg);
+    g_free(script);
+}
+
+static void read_done(GObject *source, GAsyncResult *result, gpointer user_data) {
+    (void)source;  // Suppress unused parameter warning
+    ExecMetadata **meta = user_data;
+    *meta = exec_metadata_read_finish(result, NULL);
+}
+
+static void test_async(void) {
+    gchar *path = write_appimage("Async.AppImage", &default_image);
+    ExecMetadata *meta = NULL;
+    exec_metadata_read_async(path, 0, NULL, read_done, &meta);
+    while (!meta) {
+        g_main_context_iteration(NULL, TRUE);
+    }
+    g_assert_cmpstr(meta->name, ==, "Sketch Pad");
+    exec_metadata_free(meta);
+    g_free(path);
+}
+
+int main(int argc, char *argv[]) {
+    sandbox = test_sandbox_new();
+    test_sandbox_set_home(sandbox);
+    
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/exec_metadata/read", test_read);
+    g_test_add_func("/exec_metadata/install-icon", test_install_icon);
+    g_test_add_func("/exec_metadata/errors", test_errors);
+    g_test_add_func("/exec_metadata/async", test_async);
+    int status = g_test_run();
+    
+    test_sandbox_free(sandbox);
+    return status;
+}
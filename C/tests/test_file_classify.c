@@ -0,0 +1,164 @@
+// Files are told apart by their leading bytes, and scripts by the
+// interpreter their shebang line names
+
+#include "../file_classify.h"
+#include "tests.h"
+#include <glib/gstdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+static void classify(const void *header, gsize length, const gchar *name, FileClassification *result) {
+    file_classify_buffer(header, length, name, S_IRUSR | S_IXUSR, result);
+    g_assert_true(result->flags & FILE_CLASSIFY_EXECUTABLE);
+}
+
+static void test_magic(void) {
+    FileClassification result;
+    guchar elf[64] = { 0x7f, 'E', 'L', 'F', 2, 1, 1 };
+    elf[18] = 62;
+    classify(elf, sizeof(elf), "tool", &result);
+    g_assert_cmpint(result.type, ==, FILE_TYPE_ELF);
+    g_assert_cmpuint(result.elf_class, ==, 2);
+    g_assert_cmpuint(result.elf_machine, ==, 62);
+    g_assert_false(result.flags & FILE_CLASSIFY_ELF_BIG_ENDIAN);
+    
+    // Big-endian machines keep e_machine in the other byte order
+    guchar elf_be[64] = { 0x7f, 'E', 'L', 'F', 1, 2, 1 };
+    elf_be[19] = 21;
+    classify(elf_be, sizeof(elf_be), "tool", &result);
+    g_assert_cmpint(result.type, ==, FILE_TYPE_ELF);
+    g_assert_cmpuint(result.elf_class, ==, 1);
+    g_assert_cmpuint(result.elf_machine, ==, 21);
+    g_assert_true(result.flags & FILE_CLASSIFY_ELF_BIG_ENDIAN);
+    
+    // A truncated header still counts as ELF
+    classify(elf, 8, "tool", &result);
+    g_assert_cmpint(result.type, ==, FILE_TYPE_ELF);
+    g_assert_cmpuint(result.elf_machine, ==, 0);
+    
+    elf[8] = 'A';
+    elf[9] = 'I';
+    elf[10] = 2;
+    classify(elf, sizeof(elf), "Tool-x86_64", &result);
+    g_assert_cmpint(result.type, ==, FILE_TYPE_APPIMAGE);
+    g_assert_cmpuint(result.appimage_type, ==, 2);
+    elf[10] = 3;
+    classify(elf, sizeof(elf), "Tool-x86_64", &result);
+    g_assert_cmpint(result.type, ==, FILE_TYPE_ELF);
+    
+    // A zip is a JAR when it starts with META-INF/ or is named like one
+    guchar zip[64] = { 'P', 'K', 3, 4 };
+    zip[26] = 9;
+    memcpy(zip + 30, "META-INF/", 9);
+    classify(zip, sizeof(zip), "tool", &result);
+    g_assert_cmpint(result.type, ==, FILE_TYPE_JAVA_JAR);
+    memcpy(zip + 30, "classes/X", 9);
+    classify(zip, sizeof(zip), "tool", &result);
+    g_assert_cmpint(result.type, ==, FILE_TYPE_OTHER);
+    classify(zip, sizeof(zip), "tool.JAR", &result);
+    g_assert_cmpint(result.type, ==, FILE_TYPE_JAVA_JAR);
+    
+    const gchar text[] = "plain text";
+    classify(text, sizeof(text) - 1, "notes", &result);
+    g_assert_cmpint(result.type, ==, FILE_TYPE_OTHER);
+    classify(text, 2, "notes", &result);
+    g_assert_cmpint(result.type, ==, FILE_TYPE_UNKNOWN);
+}
+
+static void test_shebang(void) {
+    static const struct {
+        const gchar *header;
+        FileType type;
+        const gchar *interpreter;
+        guint flags;
+    } cases[] = {
+        { "#!/bin/sh\necho", FILE_TYPE_SHELL, "sh", 0 },
+        { "#! /bin/bash -e\n", FILE_TYPE_SHELL, "bash", 0 },
+        { "#!/usr/bin/python3.11\n", FILE_TYPE_PYTHON, "python3.11", 0 },
+        { "#!/usr/bin/perl5", FILE_TYPE_PERL, "perl5", 0 },
+        { "#!/usr/bin/ruby\r\nputs 1\r\n", FILE_TYPE_RUBY, "ruby", FILE_CLASSIFY_CRLF },
+        { "#!/usr/bin/env node\n", FILE_TYPE_NODE, "node", FILE_CLASSIFY_ENV },
+        { "#!/usr/bin/env FOO=1 BAR=2 perl -w\n", FILE_TYPE_PERL, "perl", FILE_CLASSIFY_ENV },
+        { "#!/usr/bin/env -i -u LANG python3\n", FILE_TYPE_PYTHON, "python3", FILE_CLASSIFY_ENV },
+        { "#!/usr/bin/env --chdir /tmp sh\n", FILE_TYPE_SHELL, "sh", FILE_CLASSIFY_ENV },
+        { "#!/usr/bin/env -S python3 -u\n", FILE_TYPE_PYTHON, "python3",
+          FILE_CLASSIFY_ENV | FILE_CLASSIFY_ENV_SPLIT },
+        { "#!/usr/bin/env -Sruby -w\n", FILE_TYPE_RUBY, "ruby",
+          FILE_CLASSIFY_ENV | FILE_CLASSIFY_ENV_SPLIT },
+        { "#!/usr/bin/env -S /usr/local/bin/node\n", FILE_TYPE_NODE, "node",
+          FILE_CLASSIFY_ENV | FILE_CLASSIFY_ENV_SPLIT },
+        // Names only match whole, or followed by a version
+        { "#!/usr/bin/shellcheck\n", FILE_TYPE_OTHER, "shellcheck", 0 },
+        { "#!/usr/bin/pythonic\n", FILE_TYPE_OTHER, "pythonic", 0 },
+        { "#!/usr/bin/env FOO=1\n", FILE_TYPE_OTHER, "", FILE_CLASSIFY_ENV },
+        { "#!   \n", FILE_TYPE_OTHER, "", 0 }
+    };
+    for (guint i = 0; i < G_N_ELEMENTS(cases); i++) {
+        FileClassification result;
+        classify(cases[i].header, strlen(cases[i].header), "script", &result);
+        g_assert_cmpint(result.type, ==, cases[i].type);
+        g_assert_cmpstr(result.interpreter, ==, cases[i].interpreter);
+        g_assert_cmpuint(result.flags & ~(FILE_CLASSIFY_EXECUTABLE | FILE_CLASSIFY_SHEBANG), ==, cases[i].flags);
+        g_assert_true(result.flags & FILE_CLASSIFY_SHEBANG);
+    }
+    
+    // Long names are cut to fit, and still matched on the full name
+    FileClassification result;
+    const gchar *long_name = "#!/usr/bin/python3.11-with-a-rather-long-suffix\n";
+    classify(long_name, strlen(long_name), "script", &result);
+    g_assert_cmpint(result.type, ==, FILE_TYPE_OTHER);
+    g_assert_cmpuint(strlen(result.interpreter), ==, sizeof(result.interpreter) - 1);
+}
+
+static void test_extension(void) {
+    // The name decides before the contents are looked at
+    FileClassification result;
+    const gchar header[] = "#!/bin/sh\n";
+    file_classify_buffer((const guchar*)header, sizeof(header) - 1, "tool.py", 0, &result);
+    g_assert_cmpint(result.type, ==, FILE_TYPE_PYTHON);
+    g_assert_cmpuint(result.flags, ==, FILE_CLASSIFY_BY_EXTENSION);
+    file_classify_buffer(NULL, 0, "/opt/Tool.RB", 0, &result);
+    g_assert_cmpint(result.type, ==, FILE_TYPE_RUBY);
+    
+    // Except for .jar, which has to be a zip to count
+    file_classify_buffer((const guchar*)header, sizeof(header) - 1, "tool.jar", 0, &result);
+    g_assert_cmpint(result.type, ==, FILE_TYPE_SHELL);
+    
+    g_assert_cmpint(file_classify_by_extension("archive.tar.gz"), ==, FILE_TYPE_UNKNOWN);
+    g_assert_cmpint(file_classify_by_extension(".js"), ==, FILE_TYPE_NODE);
+    g_assert_cmpint(file_classify_by_extension(NULL), ==, FILE_TYPE_UNKNOWN);
+}
+
+static void test_path(void) {
+    gchar *sandbox = test_sandbox_new();
+    gchar *path = g_build_filename(sandbox, "run", NULL);
+    g_assert_true(g_file_set_contents(path, "#!/usr/bin/env bash\nexit 0\n", -1, NULL));
+    g_assert_cmpint(g_chmod(path, 0755), ==, 0);
+    
+    FileClassification result;
+    g_assert_true(file_classify_path(path, &result));
+    g_assert_cmpint(result.type, ==, FILE_TYPE_SHELL);
+    g_assert_true(result.flags & FILE_CLASSIFY_EXECUTABLE);
+    g_assert_true(result.flags & FILE_CLASSIFY_ENV);
+    
+    g_assert_cmpint(g_chmod(path, 0644), ==, 0);
+    g_assert_true(file_classify_path(path, &result));
+    g_assert_false(result.flags & FILE_CLASSIFY_EXECUTABLE);
+    
+    gchar *missing = g_build_filename(sandbox, "missing", NULL);
+    g_assert_false(file_classify_path(missing, &result));
+    g_assert_cmpint(result.type, ==, FILE_TYPE_UNKNOWN);
+    
+    g_free(missing);
+    g_free(path);
+    test_sandbox_free(sandbox);
+}
+
+int main(int argc, char *argv[]) {
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/file_classify/magic", test_magic);
+    g_test_add_func("/file_classify/shebang", test_shebang);
+    g_test_add_func("/file_classify/extension", test_extension);
+    g_test_add_func("/file_classify/path", test_path);
+    return g_test_run();
+}
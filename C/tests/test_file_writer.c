@@ -0,0 +1,211 @@
+// A written file appears complete or not at all, both through O_TMPFILE and
+// through a temporary name where the file system has no O_TMPFILE
+
+#define _GNU_SOURCE
+#include "../file_writer.h"
+#include "tests.h"
+#include <glib/gstdio.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+
+static gchar *sandbox;
+
+// Set to make O_TMPFILE fail the way it does where the file system lacks it
+static gboolean reject_tmpfile;
+static guint tmpfile_attempts;
+
+// Replaces the C library's openat() for the whole program
+int openat(int dir_fd, const char *path, int flags, ...) {
+    mode_t mode = 0;
+    if (flags & (O_CREAT | __O_TMPFILE)) {
+        va_list args;
+        va_start(args, flags);
+        mode = va_arg(args, mode_t);
+        va_end(args);
+    }
+    if ((flags & O_TMPFILE) == O_TMPFILE) {
+        tmpfile_attempts++;
+        if (reject_tmpfile) {
+            errno = EOPNOTSUPP;
+            return -1;
+        }
+    }
+    return syscall(SYS_openat, dir_fd, path, flags, mode);
+}
+
+static gchar* make_dir(const gchar *name) {
+    gchar *dir = g_build_filename(sandbox, name, NULL);
+    g_assert_cmpint(g_mkdir(dir, 0755), ==, 0);
+    return dir;
+}
+
+static guint count_entries(const gchar *dir_path) {
+    GDir *dir = g_dir_open(dir_path, 0, NULL);
+    g_assert_nonnull(dir);
+    guint count = 0;
+    while (g_dir_read_name(dir)) {
+        count++;
+    }
+    g_dir_close(dir);
+    return count;
+}
+
+static void assert_file(const gchar *path, const gchar *contents, mode_t mode) {
+    gchar *actual = NULL;
+    g_assert_true(g_file_get_contents(path, &actual, NULL, NULL));
+    g_assert_cmpstr(actual, ==, contents);
+    g_free(actual);
+    struct stat st;
+    g_assert_cmpint(stat(path, &st), ==, 0);
+    g_assert_cmpuint(st.st_mode & 07777, ==, mode);
+}
+
+static void write_and_replace(const gchar *dir_name) {
+    gchar *dir = make_dir(dir_name);
+    gchar *path = g_build_filename(dir, "tool.desktop", NULL);
+    FileWriter *writer = file_writer_new(FILE_DURABILITY_NONE);
+    gchar *error_msg = NULL;
+    
+    g_assert_true(file_writer_write(writer, path, "first\n", -1, 0755, &error_msg));
+    g_assert_null(error_msg);
+    assert_file(path, "first\n", 0755);
+    
+    // Someone reading the old file keeps reading it whole
+    int old_fd = open(path, O_RDONLY | O_CLOEXEC);
+    g_assert_cmpint(old_fd, >=, 0);
+    const gchar replacement[] = "second, longer\0and binary";
+    g_assert_true(file_writer_write(writer, path, replacement, sizeof(replacement), 0600, &error_msg));
+    g_assert_null(error_msg);
+    gchar old[16];
+    g_assert_cmpint(read(old_fd, old, sizeof(old)), ==, 6);
+    g_assert_cmpint(memcmp(old, "first\n", 6), ==, 0);
+    close(old_fd);
+    
+    gchar *contents = NULL;
+    gsize length;
+    g_assert_true(g_file_get_contents(path, &contents, &length, NULL));
+    g_assert_cmpuint(length, ==, sizeof(replacement));
+    g_assert_cmpint(memcmp(contents, replacement, length), ==, 0);
+    g_free(contents);
+    struct stat st;
+    g_assert_cmpint(stat(path, &st), ==, 0);
+    g_assert_cmpuint(st.st_mode & 07777, ==, 0600);
+    
+    // No temporary name is left behind
+    g_assert_cmpuint(count_entries(dir), ==, 1);
+    
+    FileWriterStats stats;
+    file_writer_get_stats(writer, &stats);
+    g_assert_cmpuint(stats.files, ==, 2);
+    g_assert_cmpuint(stats.bytes, ==, 6 + sizeof(replacement));
+    file_writer_free(writer);
+    g_free(path);
+    g_free(dir);
+}
+
+static void test_replace(void) {
+    tmpfile_attempts = 0;
+    write_and_replace("tmpfile");
+    g_assert_cmpuint(tmpfile_attempts, ==, 2);
+}
+
+static void test_no_tmpfile(void) {
+    reject_tmpfile = TRUE;
+    tmpfile_attempts = 0;
+    write_and_replace("no-tmpfile");
+    // Asked once per directory, then the temporary name is used directly
+    g_assert_cmpuint(tmpfile_attempts, ==, 1);
+    reject_tmpfile = FALSE;
+}
+
+static void test_failure(void) {
+    reject_tmpfile = TRUE;
+    gchar *dir = make_dir("failure");
+    FileWriter *writer = file_writer_new(FILE_DURABILITY_NONE);
+    gchar *error_msg = NULL;
+    
+    gchar *missing = g_build_filename(dir, "missing", "tool.desktop", NULL);
+    g_assert_false(file_writer_write(writer, missing, "x", -1, 0644, &error_msg));
+    g_assert_nonnull(error_msg);
+    g_clear_pointer(&error_msg, g_free);
+    
+    // A directory in the way: the rename fails and the temporary file goes
+    gchar *blocked = g_build_filename(dir, "blocked", NULL);
+    gchar *inside = g_build_filename(blocked, "keep", NULL);
+    g_assert_cmpint(g_mkdir(blocked, 0755), ==, 0);
+    g_assert_true(g_file_set_contents(inside, "", -1, NULL));
+    g_assert_false(file_writer_write(writer, blocked, "x", -1, 0644, &error_msg));
+    g_assert_nonnull(strstr(error_msg, blocked));
+    g_clear_pointer(&error_msg, g_free);
+    g_assert_cmpuint(count_entries(dir), ==, 1);
+    
+    FileWriterStats stats;
+    file_writer_get_stats(writer, &stats);
+    g_assert_cmpuint(stats.files, ==, 0);
+    file_writer_free(writer);
+    g_free(inside);
+    g_free(blocked);
+    g_free(missing);
+    g_free(dir);
+    reject_tmpfile = FALSE;
+}
+
+static void test_durability(void) {
+    gchar *first = make_dir("full-1");
+    gchar *second = make_dir("full-2");
+    FileWriter *writer = file_writer_new(FILE_DURABILITY_FULL);
+    gchar *error_msg = NULL;
+    
+    for (guint i = 0; i < 3; i++) {
+        gchar *name = g_strdup_printf("%u.desktop", i);
+        gchar *path = g_build_filename(i < 2 ? first : second, name, NULL);
+        g_assert_true(file_writer_write(writer, path, "x", -1, 0644, &error_msg));
+        g_free(path);
+        g_free(name);
+    }
+    g_assert_true(file_writer_commit(writer, &error_msg));
+    g_assert_null(error_msg);
+    
+    // Each file synced, each directory once
+    FileWriterStats stats;
+    file_writer_get_stats(writer, &stats);
+    g_assert_cmpuint(stats.files, ==, 3);
+    g_assert_cmpuint(stats.file_syncs, ==, 3);
+    g_assert_cmpuint(stats.dir_syncs, ==, 2);
+    
+    // Nothing new, nothing to sync
+    g_assert_true(file_writer_commit(writer, &error_msg));
+    file_writer_get_stats(writer, &stats);
+    g_assert_cmpuint(stats.dir_syncs, ==, 2);
+    file_writer_free(writer);
+    
+    for (FileDurability durability = FILE_DURABILITY_NONE; durability <= FILE_DURABILITY_FULL; durability++) {
+        FileDurability parsed;
+        g_assert_true(file_durability_from_string(file_durability_to_string(durability), &parsed));
+        g_assert_cmpint(parsed, ==, durability);
+    }
+    FileDurability parsed;
+    g_assert_false(file_durability_from_string("fsync", &parsed));
+    
+    g_free(second);
+    g_free(first);
+}
+
+int main(int argc, char *argv[]) {
+    sandbox = test_sandbox_new();
+    
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/file_writer/replace", test_replace);
+    g_test_add_func("/file_writer/no-tmpfile", test_no_tmpfile);
+    g_test_add_func("/file_writer/failure", test_failure);
+    g_test_add_func("/file_writer/durability", test_durability);
+    int status = g_test_run();
+    
+    test_sandbox_free(sandbox);
+    return status;
+}
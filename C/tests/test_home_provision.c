@@ -0,0 +1,196 @@
+// Provisioning another user's home, or any home in a staging root, never
+// leaves it through a symbolic link and hands over what it creates there,
+// mimeinfo.cache included
+
+#define _GNU_SOURCE
+#include "../home_provision.h"
+#include "tests.h"
+#include <glib/gstdio.h>
+#include <sys/stat.h>
+#include <string.h>
+#include <unistd.h>
+
+#define FOREIGN_UID 4242
+#define FOREIGN_GID 4242
+#define OUTSIDE_CACHE "[MIME Cache]\ntext/plain=outside.desktop;\n"
+
+static gchar *sandbox;
+
+static const HomeProvisionItem items[] = {
+    { "Tool.desktop", "[Desktop Entry]\nType=Application\nName=Tool\nExec=/usr/bin/tool\n"
+                      "MimeType=text/x-cre8or-test;\n" }
+};
+
+// A home owned by someone else, with its data directory in place
+static gchar* make_foreign_home(const gchar *name) {
+    gchar *home = g_build_filename(sandbox, name, NULL);
+    gchar *share = g_build_filename(home, ".local", "share", NULL);
+    g_assert_cmpint(g_mkdir_with_parents(share, 0755), ==, 0);
+    gchar *local = g_build_filename(home, ".local", NULL);
+    g_assert_cmpint(chown(home, FOREIGN_UID, FOREIGN_GID), ==, 0);
+    g_assert_cmpint(chown(local, FOREIGN_UID, FOREIGN_GID), ==, 0);
+    g_assert_cmpint(chown(share, FOREIGN_UID, FOREIGN_GID), ==, 0);
+    g_free(local);
+    g_free(share);
+    return home;
+}
+
+// A directory outside every home, with a cache of its own
+static gchar* make_outside(const gchar *name) {
+    gchar *outside = g_build_filename(sandbox, name, NULL);
+    g_assert_cmpint(g_mkdir(outside, 0755), ==, 0);
+    gchar *cache = g_build_filename(outside, "mimeinfo.cache", NULL);
+    g_assert_true(g_file_set_contents(cache, OUTSIDE_CACHE, -1, NULL));
+    g_free(cache);
+    return outside;
+}
+
+static HomeProvisionResult* provision_in(const gchar *root, const gchar *home, gboolean to_desktop) {
+    HomeProvisionOptions options;
+    home_provision_options_init(&options);
+    options.root = root;
+    options.to_desktop = to_desktop;
+    options.to_local_apps = !to_desktop;
+    options.durability = FILE_DURABILITY_NONE;
+    options.n_threads = 1;
+    
+    const gchar *homes[] = { home, NULL };
+    GPtrArray *results = home_provision_run(homes, items, G_N_ELEMENTS(items), &options, NULL);
+    g_assert_cmpuint(results->len, ==, 1);
+    HomeProvisionResult *result = g_ptr_array_steal_index(results, 0);
+    g_ptr_array_free(results, TRUE);
+    return result;
+}
+
+static HomeProvisionResult* provision(const gchar *home) {
+    return provision_in(NULL, home, FALSE);
+}
+
+static void assert_outside_untouched(const gchar *outside) {
+    gchar *entry = g_build_filename(outside, "Tool.desktop", NULL);
+    gchar *cache = g_build_filename(outside, "mimeinfo.cache", NULL);
+    gchar *contents = NULL;
+    g_assert_false(g_file_test(entry, G_FILE_TEST_EXISTS));
+    g_assert_true(g_file_get_contents(cache, &contents, NULL, NULL));
+    g_assert_cmpstr(contents, ==, OUTSIDE_CACHE);
+    g_free(contents);
+    g_free(cache);
+    g_free(entry);
+}
+
+static void test_symlinked_applications(void) {
+    if (geteuid() != 0) {
+        g_test_skip("needs root to create another user's home");
+        return;
+    }
+    gchar *home = make_foreign_home("linked");
+    gchar *outside = make_outside("linked-outside");
+    gchar *apps = g_build_filename(home, ".local", "share", "applications", NULL);
+    g_assert_cmpint(symlink(outside, apps), ==, 0);
+    
+    HomeProvisionResult *result = provision(home);
+    g_assert_nonnull(result->error);
+    g_assert_cmpuint(result->written, ==, 0);
+    assert_outside_untouched(outside);
+    
+    home_provision_result_free(result);
+    g_free(apps);
+    g_free(outside);
+    g_free(home);
+}
+
+static void test_symlinked_cache(void) {
+    if (geteuid() != 0) {
+        g_test_skip("needs root to create another user's home");
+        return;
+    }
+    gchar *home = make_foreign_home("cache-linked");
+    gchar *outside = make_outside("cache-outside");
+    gchar *apps = g_build_filename(home, ".local", "share", "applications", NULL);
+    gchar *cache = g_build_filename(apps, "mimeinfo.cache", NULL);
+    gchar *outside_cache = g_build_filename(outside, "mimeinfo.cache", NULL);
+    g_assert_cmpint(g_mkdir(apps, 0755), ==, 0);
+    g_assert_cmpint(chown(apps, FOREIGN_UID, FOREIGN_GID), ==, 0);
+    g_assert_cmpint(symlink(outside_cache, cache), ==, 0);
+    
+    // The entry goes in; the link is neither followed nor replaced
+    HomeProvisionResult *result = provision(home);
+    g_assert_null(result->error);
+    g_assert_cmpuint(result->written, ==, 1);
+    assert_outside_untouched(outside);
+    g_assert_true(g_file_test(cache, G_FILE_TEST_IS_SYMLINK));
+    
+    home_provision_result_free(result);
+    g_free(outside_cache);
+    g_free(cache);
+    g_free(apps);
+    g_free(outside);
+    g_free(home);
+}
+
+// A home of the caller's own in a staging root: its links don't lead
+// back to the host either
+static void test_staging_root_symlinked_desktop(void) {
+    gchar *root = g_build_filename(sandbox, "staging", NULL);
+    gchar *home = g_build_filename(root, "home", "me", NULL);
+    gchar *outside = make_outside("staging-outside");
+    gchar *desktop = g_build_filename(home, "Desktop", NULL);
+    g_assert_cmpint(g_mkdir_with_parents(home, 0755), ==, 0);
+    g_assert_cmpint(symlink(outside, desktop), ==, 0);
+    
+    HomeProvisionResult *result = provision_in(root, "/home/me", TRUE);
+    g_assert_nonnull(result->error);
+    g_assert_cmpuint(result->written, ==, 0);
+    assert_outside_untouched(outside);
+    
+    home_provision_result_free(result);
+    g_free(desktop);
+    g_free(outside);
+    g_free(home);
+    g_free(root);
+}
+
+static void test_cache_owner(void) {
+    if (geteuid() != 0) {
+        g_test_skip("needs root to create another user's home");
+        return;
+    }
+    gchar *home = make_foreign_home("owned");
+    gchar *apps = g_build_filename(home, ".local", "share", "applications", NULL);
+    gchar *cache = g_build_filename(apps, "mimeinfo.cache", NULL);
+    g_assert_cmpint(g_mkdir(apps, 0755), ==, 0);
+    g_assert_cmpint(chown(apps, FOREIGN_UID, FOREIGN_GID), ==, 0);
+    g_assert_true(g_file_set_contents(cache, "[MIME Cache]\n", -1, NULL));
+    g_assert_cmpint(chown(cache, FOREIGN_UID, FOREIGN_GID), ==, 0);
+    
+    HomeProvisionResult *result = provision(home);
+    g_assert_null(result->error);
+    
+    gchar *contents = NULL;
+    struct stat st;
+    g_assert_true(g_file_get_contents(cache, &contents, NULL, NULL));
+    g_assert_nonnull(strstr(contents, "text/x-cre8or-test=Tool.desktop;"));
+    g_assert_cmpint(lstat(cache, &st), ==, 0);
+    g_assert_cmpuint(st.st_uid, ==, FOREIGN_UID);
+    g_assert_cmpuint(st.st_gid, ==, FOREIGN_GID);
+    
+    g_free(contents);
+    home_provision_result_free(result);
+    g_free(cache);
+    g_free(apps);
+    g_free(home);
+}
+
+int main(int argc, char *argv[]) {
+    sandbox = test_sandbox_new();
+    
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/home_provision/symlinked-applications", test_symlinked_applications);
+    g_test_add_func("/home_provision/symlinked-cache", test_symlinked_cache);
+    g_test_add_func("/home_provision/staging-root-symlinked-desktop", test_staging_root_symlinked_desktop);
+    g_test_add_func("/home_provision/cache-owner", test_cache_owner);
+    int status = g_test_run();
+    
+    test_sandbox_free(sandbox);
+    return status;
+}
@@ -0,0 +1,152 @@
+// mimeinfo.cache is brought up to date from the entries that changed, with
+// one rewrite per directory and batch
+
+#include "../mime_cache.h"
+#include "../file_utils.h"
+#include "tests.h"
+#include <glib/gstdio.h>
+#include <string.h>
+
+static gchar *sandbox;
+static gchar *apps;
+
+static gchar* write_entry(const gchar *filename, const gchar *mime_types) {
+    gchar *path = g_build_filename(apps, filename, NULL);
+    gchar *content = g_strdup_printf("[Desktop Entry]\nType=Application\nName=%s\nExec=/usr/bin/true\n"
+                                     "MimeType=%s\n", filename, mime_types);
+    g_assert_true(g_file_set_contents(path, content, -1, NULL));
+    g_free(content);
+    return path;
+}
+
+static gchar* read_cache(void) {
+    gchar *path = g_build_filename(apps, "mimeinfo.cache", NULL);
+    gchar *contents = NULL;
+    g_assert_true(g_file_get_contents(path, &contents, NULL, NULL));
+    g_free(path);
+    return contents;
+}
+
+static void update(const gchar *path) {
+    gchar *error_msg = NULL;
+    const gchar *paths[] = { path };
+    g_assert_true(mime_cache_update_paths(paths, 1, &error_msg));
+    g_assert_null(error_msg);
+}
+
+static void test_incremental_update(void) {
+    gchar *first = write_entry("first.desktop", "text/x-first;");
+    
+    // No cache yet: the directory is scanned once
+    MimeCache *cache = mime_cache_load(apps);
+    gchar *error_msg = NULL;
+    g_assert_true(mime_cache_write(cache, &error_msg));
+    mime_cache_free(cache);
+    MimeCacheStats before;
+    mime_cache_get_stats(&before);
+    g_assert_cmpuint(before.scans, ==, 1);
+    
+    // Only the entry named is read again; one that nobody reported stays out
+    gchar *second = write_entry("second.desktop", "text/x-first;text/x-second;");
+    gchar *unreported = write_entry("unreported.desktop", "text/x-unreported;");
+    update(second);
+    gchar *contents = read_cache();
+    g_assert_nonnull(strstr(contents, "text/x-first=first.desktop;second.desktop;\n"));
+    g_assert_nonnull(strstr(contents, "text/x-second=second.desktop;\n"));
+    g_assert_null(strstr(contents, "unreported"));
+    g_free(contents);
+    
+    // A removed entry is dropped, keeping the order of the others
+    g_assert_cmpint(g_unlink(first), ==, 0);
+    update(first);
+    contents = read_cache();
+    g_assert_nonnull(strstr(contents, "text/x-first=second.desktop;\n"));
+    g_free(contents);
+    
+    MimeCacheStats after;
+    mime_cache_get_stats(&after);
+    g_assert_cmpuint(after.scans, ==, before.scans);
+    g_assert_cmpuint(after.updated - before.updated, ==, 1);
+    g_assert_cmpuint(after.removed - before.removed, ==, 1);
+    
+    g_free(unreported);
+    g_free(second);
+    g_free(first);
+}
+
+static void test_batch(void) {
+    MimeCacheStats before;
+    mime_cache_get_stats(&before);
+    
+    gchar *third = write_entry("third.desktop", "text/x-third;");
+    gchar *fourth = write_entry("fourth.desktop", "text/x-third;");
+    mime_cache_begin_batch();
+    update(third);
+    update(fourth);
+    gchar *contents = read_cache();
+    g_assert_null(strstr(contents, "text/x-third"));
+    g_free(contents);
+    
+    // Both land with a single rewrite when the batch ends
+    gchar *error_msg = NULL;
+    g_assert_true(mime_cache_end_batch(&error_msg));
+    contents = read_cache();
+    g_assert_nonnull(strstr(contents, "text/x-third=third.desktop;fourth.desktop;\n"));
+    g_free(contents);
+    
+    MimeCacheStats after;
+    mime_cache_get_stats(&after);
+    g_assert_cmpuint(after.writes - before.writes, ==, 1);
+    
+    g_free(fourth);
+    g_free(third);
+}
+
+// After a failed rewrite the file on disk lacks that update, so the next
+// one scans the directory instead of building on it
+static void test_failed_rewrite_rescans(void) {
+    gchar *cache = g_build_filename(apps, "mimeinfo.cache", NULL);
+    gchar *stale = read_cache();
+    
+    // A directory in its place makes the rename fail
+    gchar *fifth = write_entry("fifth.desktop", "text/x-fifth;");
+    g_assert_cmpint(g_unlink(cache), ==, 0);
+    g_assert_cmpint(g_mkdir(cache, 0755), ==, 0);
+    gchar *error_msg = NULL;
+    const gchar *paths[] = { fifth };
+    g_assert_false(mime_cache_update_paths(paths, 1, &error_msg));
+    g_assert_nonnull(error_msg);
+    g_free(error_msg);
+    g_assert_cmpint(g_rmdir(cache), ==, 0);
+    g_assert_true(g_file_set_contents(cache, stale, -1, NULL));
+    
+    gchar *sixth = write_entry("sixth.desktop", "text/x-sixth;");
+    update(sixth);
+    gchar *contents = read_cache();
+    g_assert_nonnull(strstr(contents, "text/x-fifth=fifth.desktop;\n"));
+    g_assert_nonnull(strstr(contents, "text/x-sixth=sixth.desktop;\n"));
+    g_free(contents);
+    
+    g_free(sixth);
+    g_free(fifth);
+    g_free(stale);
+    g_free(cache);
+}
+
+int main(int argc, char *argv[]) {
+    sandbox = test_sandbox_new();
+    test_sandbox_set_home(sandbox);
+    // The user's own directory is kept up to date even without a cache
+    apps = file_utils_get_local_applications_directory();
+    g_assert_cmpint(g_mkdir_with_parents(apps, 0755), ==, 0);
+    
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/mime_cache/incremental-update", test_incremental_update);
+    g_test_add_func("/mime_cache/batch", test_batch);
+    g_test_add_func("/mime_cache/failed-rewrite-rescans", test_failed_rewrite_rescans);
+    int status = g_test_run();
+    
+    g_free(apps);
+    test_sandbox_free(sandbox);
+    return status;
+}
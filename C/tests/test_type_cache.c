@@ -0,0 +1,140 @@
+// A cached classification is only reused while the file keeps its device,
+// inode, size and mtime
+
+#define _GNU_SOURCE
+#include "../type_cache.h"
+#include "tests.h"
+#include <glib/gstdio.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+static gchar *sandbox;
+static gchar *cache_path;
+
+// Writes in place, so an existing file keeps its inode
+static void write_script(const gchar *path, const gchar *contents, time_t mtime) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0755);
+    g_assert_cmpint(fd, >=, 0);
+    g_assert_cmpint(write(fd, contents, strlen(contents)), ==, (gssize)strlen(contents));
+    close(fd);
+    struct timespec times[2] = { { mtime, 0 }, { mtime, 0 } };
+    g_assert_cmpint(utimensat(AT_FDCWD, path, times, 0), ==, 0);
+}
+
+// Classifies path and returns whether it came from the cache
+static gboolean classify(const gchar *path, FileType expected) {
+    TypeCacheStats before, after;
+    type_cache_get_stats(&before);
+    FileClassification result;
+    g_assert_true(type_cache_classify(path, &result));
+    g_assert_cmpint(result.type, ==, expected);
+    type_cache_get_stats(&after);
+    g_assert_cmpuint((after.hits - before.hits) + (after.misses - before.misses), ==, 1);
+    return after.hits > before.hits;
+}
+
+static void test_unchanged(void) {
+    gchar *path = g_build_filename(sandbox, "unchanged", NULL);
+    write_script(path, "#!/bin/sh\n", 1000000000);
+    g_assert_false(classify(path, FILE_TYPE_SHELL));
+    g_assert_true(classify(path, FILE_TYPE_SHELL));
+    
+    // The execute bit is read from the file, not the record
+    g_assert_cmpint(g_chmod(path, 0644), ==, 0);
+    FileClassification result;
+    g_assert_true(type_cache_classify(path, &result));
+    g_assert_false(result.flags & FILE_CLASSIFY_EXECUTABLE);
+    g_assert_cmpint(g_chmod(path, 0755), ==, 0);
+    g_assert_true(type_cache_classify(path, &result));
+    g_assert_true(result.flags & FILE_CLASSIFY_EXECUTABLE);
+    
+    // Records outlive the process
+    type_cache_close();
+    type_cache_open(cache_path);
+    g_assert_true(classify(path, FILE_TYPE_SHELL));
+    g_free(path);
+}
+
+static void test_mtime_changed(void) {
+    gchar *path = g_build_filename(sandbox, "mtime", NULL);
+    write_script(path, "#!/bin/sh\n", 1000000000);
+    g_assert_false(classify(path, FILE_TYPE_SHELL));
+    
+    // Rewritten in place: same inode and size, only the mtime tells
+    struct stat st;
+    g_assert_cmpint(stat(path, &st), ==, 0);
+    write_script(path, "#!/bin/rb\n", 1000000001);
+    struct stat rewritten;
+    g_assert_cmpint(stat(path, &rewritten), ==, 0);
+    g_assert_cmpuint(rewritten.st_ino, ==, st.st_ino);
+    g_assert_cmpint(rewritten.st_size, ==, st.st_size);
+    g_assert_false(classify(path, FILE_TYPE_OTHER));
+    g_assert_true(classify(path, FILE_TYPE_OTHER));
+    
+    write_script(path, "#!/bin/ksh\n", 1000000001);
+    g_assert_false(classify(path, FILE_TYPE_SHELL));
+    g_assert_true(classify(path, FILE_TYPE_SHELL));
+    
+    // A nanosecond is enough
+    struct timespec times[2] = { { 1000000001, 1 }, { 1000000001, 1 } };
+    g_assert_cmpint(utimensat(AT_FDCWD, path, times, 0), ==, 0);
+    g_assert_false(classify(path, FILE_TYPE_SHELL));
+    g_free(path);
+}
+
+static void test_inode_changed(void) {
+    gchar *path = g_build_filename(sandbox, "inode", NULL);
+    gchar *other = g_build_filename(sandbox, "inode.new", NULL);
+    write_script(path, "#!/usr/bin/perl\n", 1000000000);
+    g_assert_false(classify(path, FILE_TYPE_PERL));
+    
+    // Replaced by rename with the same size and mtime
+    write_script(other, "#!/usr/bin/node\n", 1000000000);
+    g_assert_cmpint(g_rename(other, path), ==, 0);
+    g_assert_false(classify(path, FILE_TYPE_NODE));
+    g_assert_true(classify(path, FILE_TYPE_NODE));
+    
+    g_free(other);
+    g_free(path);
+}
+
+static void test_corrupt_record(void) {
+    gchar *path = g_build_filename(sandbox, "corrupt", NULL);
+    write_script(path, "#!/usr/bin/python3\n", 1000000000);
+    g_assert_false(classify(path, FILE_TYPE_PYTHON));
+    g_assert_true(classify(path, FILE_TYPE_PYTHON));
+    
+    // A record changed behind the checksum's back is not trusted
+    type_cache_close();
+    gchar *contents;
+    gsize length;
+    g_assert_true(g_file_get_contents(cache_path, &contents, &length, NULL));
+    gchar *interpreter = memmem(contents, length, "python3", 7);
+    g_assert_nonnull(interpreter);
+    interpreter[6] = '2';
+    g_assert_true(g_file_set_contents(cache_path, contents, length, NULL));
+    g_free(contents);
+    type_cache_open(cache_path);
+    g_assert_false(classify(path, FILE_TYPE_PYTHON));
+    g_free(path);
+}
+
+int main(int argc, char *argv[]) {
+    sandbox = test_sandbox_new();
+    cache_path = g_build_filename(sandbox, "cache", "filetypes.cache", NULL);
+    type_cache_open(cache_path);
+    
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/type_cache/unchanged", test_unchanged);
+    g_test_add_func("/type_cache/mtime-changed", test_mtime_changed);
+    g_test_add_func("/type_cache/inode-changed", test_inode_changed);
+    g_test_add_func("/type_cache/corrupt-record", test_corrupt_record);
+    int status = g_test_run();
+    
+    type_cache_close();
+    g_free(cache_path);
+    test_sandbox_free(sandbox);
+    return status;
+}
@@ -0,0 +1,118 @@
+// The save locations follow user-dirs.dirs as it changes, and a kept
+// descriptor is only used while it is still the directory at its path
+
+#define _GNU_SOURCE
+#include "../user_dirs.h"
+#include "tests.h"
+#include <glib/gstdio.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+static gchar *sandbox;
+static gchar *home;
+
+static void write_user_dirs(const gchar *config_dir, const gchar *desktop) {
+    gchar *path = g_build_filename(config_dir, "user-dirs.dirs", NULL);
+    gchar *contents = g_strdup_printf("# Written by the test\nXDG_DESKTOP_DIR=\"%s\"\n", desktop);
+    g_assert_true(g_file_set_contents(path, contents, -1, NULL));
+    g_free(contents);
+    g_free(path);
+}
+
+static void assert_desktop(const gchar *subdir) {
+    gchar *expected = g_build_filename(home, subdir, NULL);
+    gchar *desktop = user_dirs_dup_path(USER_DIR_DESKTOP);
+    g_assert_cmpstr(desktop, ==, expected);
+    g_free(desktop);
+    g_free(expected);
+}
+
+static ino_t open_desktop_ino(void) {
+    gchar *error_msg = NULL;
+    int fd = user_dirs_open(USER_DIR_DESKTOP, TRUE, &error_msg);
+    g_assert_null(error_msg);
+    g_assert_cmpint(fd, >=, 0);
+    struct stat st;
+    g_assert_cmpint(fstat(fd, &st), ==, 0);
+    close(fd);
+    return st.st_ino;
+}
+
+static void test_follows_user_dirs(void) {
+    assert_desktop(USER_DIRS_DESKTOP_SUBDIR);
+    
+    // Changed while running: picked up without a restart
+    write_user_dirs(g_get_user_config_dir(), "$HOME/Schreibtisch");
+    assert_desktop("Schreibtisch");
+    write_user_dirs(g_get_user_config_dir(), "$HOME/Bureau");
+    assert_desktop("Bureau");
+    gchar *desktop = g_build_filename(home, "Bureau", NULL);
+    UserDir dir;
+    g_assert_true(user_dirs_find(desktop, &dir));
+    g_assert_cmpint(dir, ==, USER_DIR_DESKTOP);
+    g_free(desktop);
+}
+
+static void test_replaced_directory(void) {
+    gchar *desktop = user_dirs_dup_path(USER_DIR_DESKTOP);
+    ino_t first = open_desktop_ino();
+    
+    // Moved away and created again: the kept descriptor is not reused
+    gchar *moved = g_strconcat(desktop, ".old", NULL);
+    g_assert_cmpint(g_rename(desktop, moved), ==, 0);
+    g_assert_cmpint(g_mkdir(desktop, 0755), ==, 0);
+    struct stat st;
+    g_assert_cmpint(stat(desktop, &st), ==, 0);
+    g_assert_cmpuint(st.st_ino, !=, first);
+    g_assert_cmpuint(open_desktop_ino(), ==, st.st_ino);
+    
+    g_free(moved);
+    g_free(desktop);
+}
+
+static void test_other_home(void) {
+    gchar *other = g_build_filename(sandbox, "other", NULL);
+    gchar *config = g_build_filename(other, ".config", NULL);
+    g_assert_cmpint(g_mkdir_with_parents(config, 0755), ==, 0);
+    int home_fd = open(other, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    g_assert_cmpint(home_fd, >=, 0);
+    
+    static const struct {
+        const gchar *value;
+        const gchar *subdir;
+    } cases[] = {
+        { "$HOME/Escritorio", "Escritorio" },
+        { "$HOME/./Work//Desk", "Work/Desk" },
+        // Nothing outside their home is trusted
+        { "$HOME/../victim", USER_DIRS_DESKTOP_SUBDIR },
+        { "/etc", USER_DIRS_DESKTOP_SUBDIR },
+        { "$HOME/", USER_DIRS_DESKTOP_SUBDIR }
+    };
+    for (guint i = 0; i < G_N_ELEMENTS(cases); i++) {
+        write_user_dirs(config, cases[i].value);
+        gchar *subdir = user_dirs_get_desktop_subdir_at(home_fd);
+        g_assert_cmpstr(subdir, ==, cases[i].subdir);
+        g_free(subdir);
+    }
+    
+    close(home_fd);
+    g_free(config);
+    g_free(other);
+}
+
+int main(int argc, char *argv[]) {
+    sandbox = test_sandbox_new();
+    test_sandbox_set_home(sandbox);
+    home = g_build_filename(sandbox, "home", NULL);
+    
+    g_test_init(&argc, &argv, NULL);
+    g_test_add_func("/user_dirs/follows-user-dirs", test_follows_user_dirs);
+    g_test_add_func("/user_dirs/replaced-directory", test_replaced_directory);
+    g_test_add_func("/user_dirs/other-home", test_other_home);
+    int status = g_test_run();
+    
+    g_free(home);
+    test_sandbox_free(sandbox);
+    return status;
+}
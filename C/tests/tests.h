@@ -0,0 +1,83 @@
+#ifndef TESTS_H
+#define TESTS_H
+
+// Small helpers shared by the tests in this directory
+
+#include <glib.h>
+#include <gio/gio.h>
+
+// A fresh directory under the temporary directory for one test program
+static inline gchar* test_sandbox_new(void) {
+    GError *error = NULL;
+    gchar *sandbox = g_dir_make_tmp("cre8or-test-XXXXXX", &error);
+    g_assert_no_error(error);
+    return sandbox;
+}
+
+// Points HOME and the XDG base directories into sandbox, and the system
+// data directories at sandbox/system. Has to run before GLib caches the
+// user directories, so before anything else touches them.
+static inline void test_sandbox_set_home(const gchar *sandbox) {
+    gchar *home = g_build_filename(sandbox, "home", NULL);
+    gchar *data_home = g_build_filename(home, ".local", "share", NULL);
+    gchar *cache_home = g_build_filename(home, ".cache", NULL);
+    gchar *config_home = g_build_filename(home, ".config", NULL);
+    gchar *system_data = g_build_filename(sandbox, "system", NULL);
+    g_assert_cmpint(g_mkdir_with_parents(data_home, 0755), ==, 0);
+    g_assert_cmpint(g_mkdir_with_parents(cache_home, 0755), ==, 0);
+    g_assert_cmpint(g_mkdir_with_parents(config_home, 0755), ==, 0);
+    g_assert_cmpint(g_mkdir_with_parents(system_data, 0755), ==, 0);
+    g_setenv("HOME", home, TRUE);
+    g_setenv("XDG_DATA_HOME", data_home, TRUE);
+    g_setenv("XDG_CACHE_HOME", cache_home, TRUE);
+    g_setenv("XDG_CONFIG_HOME", config_home, TRUE);
+    g_setenv("XDG_DATA_DIRS", system_data, TRUE);
+    g_free(system_data);
+    g_free(config_home);
+    g_free(cache_home);
+    g_free(data_home);
+    g_free(home);
+}
+
+// Deletes the directory dir and everything below it. Links are removed,
+// never followed.
+static inline gboolean test_delete_tree(GFile *dir, GError **error) {
+    GFileEnumerator *children = g_file_enumerate_children(dir, G_FILE_ATTRIBUTE_STANDARD_NAME ","
+                                                          G_FILE_ATTRIBUTE_STANDARD_TYPE,
+                                                          G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS, NULL, error);
+    if (!children) {
+        return FALSE;
+    }
+    
+    gboolean success = TRUE;
+    for (;;) {
+        GFileInfo *info = NULL;
+        GFile *child = NULL;
+        if (!g_file_enumerator_iterate(children, &info, &child, NULL, error)) {
+            success = FALSE;
+            break;
+        }
+        if (!info) {
+            break;
+        }
+        success = g_file_info_get_file_type(info) == G_FILE_TYPE_DIRECTORY ?
+                  test_delete_tree(child, error) : g_file_delete(child, NULL, error);
+        if (!success) {
+            break;
+        }
+    }
+    g_object_unref(children);
+    return success && g_file_delete(dir, NULL, error);
+}
+
+// Removes the sandbox and frees its path
+static inline void test_sandbox_free(gchar *sandbox) {
+    GFile *dir = g_file_new_for_path(sandbox);
+    GError *error = NULL;
+    test_delete_tree(dir, &error);
+    g_assert_no_error(error);
+    g_object_unref(dir);
+    g_free(sandbox);
+}
+
+#endif // TESTS_H
@@ -0,0 +1,258 @@
+#define _GNU_SOURCE
+#include "type_cache.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+
+#define TYPE_CACHE_MAGIC 0x54463843u  // "C8FT"
+#define TYPE_CACHE_VERSION 1
+#define TYPE_CACHE_SLOTS 16384         // Power of two
+#define TYPE_CACHE_PROBE 8             // Slots searched per lookup
+
+typedef struct {
+    guint32 magic;
+    guint32 version;
+    guint32 n_slots;
+    guint32 record_size;
+} TypeCacheHeader;
+
+// One cached classification; check == 0 marks an empty slot
+typedef struct {
+    guint64 dev;
+    guint64 ino;
+    gint64 size;
+    gint64 mtime_sec;
+    guint32 mtime_nsec;
+    guint32 check;
+    guint8 type;
+    guint8 elf_class;
+    guint8 appimage_type;
+    guint8 reserved;
+    guint16 elf_machine;
+    guint16 flags;
+    gchar interpreter[32];
+} TypeCacheRecord;
+
+G_STATIC_ASSERT(sizeof(TypeCacheRecord) == 80);
+
+typedef struct {
+    gpointer map;
+    gsize map_size;
+    TypeCacheRecord *records;
+    gboolean opened;
+    TypeCacheStats stats;
+} TypeCache;
+
+static TypeCache cache;
+G_LOCK_DEFINE_STATIC(cache);
+
+static gsize type_cache_map_size(void) {
+    return sizeof(TypeCacheHeader) + (gsize)TYPE_CACHE_SLOTS * sizeof(TypeCacheRecord);
+}
+
+static void type_cache_map_anonymous(void) {
+    cache.map_size = type_cache_map_size();
+    cache.map = mmap(NULL, cache.map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (cache.map == MAP_FAILED) {
+        cache.map = NULL;
+    }
+}
+
+static gboolean type_cache_map_file(const gchar *cache_path) {
+    gchar *dir = g_path_get_dirname(cache_path);
+    g_mkdir_with_parents(dir, 0700);
+    g_free(dir);
+    
+    int fd = open(cache_path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        return FALSE;
+    }
+    
+    gsize map_size = type_cache_map_size();
+    struct stat st;
+    if (fstat(fd, &st) != 0 || ((gsize)st.st_size != map_size && ftruncate(fd, map_size) != 0)) {
+        close(fd);
+        return FALSE;
+    }
+    
+    gpointer map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return FALSE;
+    }
+    
+    cache.map = map;
+    cache.map_size = map_size;
+    return TRUE;
+}
+
+// Called with the lock held
+static void type_cache_open_locked(const gchar *cache_path, gboolean persistent) {
+    cache.opened = TRUE;
+    
+    if (!persistent || !cache_path || !type_cache_map_file(cache_path)) {
+        type_cache_map_anonymous();
+    }
+    if (!cache.map) {
+        return;
+    }
+    
+    // A foreign or outdated layout is simply reset
+    TypeCacheHeader *header = cache.map;
+    if (header->magic != TYPE_CACHE_MAGIC || header->version != TYPE_CACHE_VERSION ||
+        header->n_slots != TYPE_CACHE_SLOTS || header->record_size != sizeof(TypeCacheRecord)) {
+        memset(cache.map, 0, cache.map_size);
+        header->magic = TYPE_CACHE_MAGIC;
+        header->version = TYPE_CACHE_VERSION;
+        header->n_slots = TYPE_CACHE_SLOTS;
+        header->record_size = sizeof(TypeCacheRecord);
+    }
+    cache.records = (TypeCacheRecord*)((guchar*)cache.map + sizeof(TypeCacheHeader));
+}
+
+static void type_cache_ensure_open(void) {
+    if (cache.opened) {
+        return;
+    }
+    
+    gboolean persistent = g_getenv("CRE8OR_NO_TYPE_CACHE") == NULL;
+    gchar *cache_path = g_build_filename(g_get_user_cache_dir(), "cre8or", "filetypes.cache", NULL);
+    type_cache_open_locked(cache_path, persistent);
+    g_free(cache_path);
+}
+
+void type_cache_open(const gchar *cache_path) {
+    G_LOCK(cache);
+    if (!cache.opened) {
+        type_cache_open_locked(cache_path, cache_path != NULL);
+    }
+    G_UNLOCK(cache);
+}
+
+void type_cache_close(void) {
+    G_LOCK(cache);
+    if (cache.map) {
+        munmap(cache.map, cache.map_size);
+    }
+    memset(&cache, 0, sizeof(cache));
+    G_UNLOCK(cache);
+}
+
+void type_cache_get_stats(TypeCacheStats *stats) {
+    G_LOCK(cache);
+    *stats = cache.stats;
+    G_UNLOCK(cache);
+}
+
+static guint64 mix64(guint64 x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+// Checksum over everything but the check field, never 0
+static guint32 record_check(const TypeCacheRecord *record) {
+    TypeCacheRecord copy = *record;
+    copy.check = 0;
+    
+    const guchar *bytes = (const guchar*)&copy;
+    guint32 hash = 2166136261u;
+    for (gsize i = 0; i < sizeof(copy); i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash | 1;
+}
+
+static gboolean record_matches(const TypeCacheRecord *record, const struct stat *st) {
+    return record->check != 0 &&
+           record->dev == (guint64)st->st_dev &&
+           record->ino == (guint64)st->st_ino &&
+           record->size == (gint64)st->st_size &&
+           record->mtime_sec == (gint64)st->st_mtim.tv_sec &&
+           record->mtime_nsec == (guint32)st->st_mtim.tv_nsec;
+}
+
+gboolean type_cache_classify(const gchar *path, FileClassification *result) {
+    struct stat st;
+    if (!path || stat(path, &st) != 0) {
+        memset(result, 0, sizeof(*result));
+        return FALSE;
+    }
+    
+    G_LOCK(cache);
+    type_cache_ensure_open();
+    if (!cache.records) {
+        G_UNLOCK(cache);
+        return file_classify_path(path, result);
+    }
+    
+    guint64 slot = mix64((guint64)st.st_dev * 0x9e3779b97f4a7c15ULL ^ (guint64)st.st_ino);
+    for (guint probe = 0; probe < TYPE_CACHE_PROBE; probe++) {
+        const TypeCacheRecord *record = &cache.records[(slot + probe) & (TYPE_CACHE_SLOTS - 1)];
+        if (record_matches(record, &st) && record->check == record_check(record)) {
+            memset(result, 0, sizeof(*result));
+            result->type = record->type;
+            result->flags = record->flags;
+            result->elf_class = record->elf_class;
+            result->elf_machine = record->elf_machine;
+            result->appimage_type = record->appimage_type;
+            memcpy(result->interpreter, record->interpreter, sizeof(result->interpreter));
+            // The mode is not part of the key (chmod leaves mtime alone)
+            if (st.st_mode & (S_IXUSR | S_IXGRP | S_IXOTH)) {
+                result->flags |= FILE_CLASSIFY_EXECUTABLE;
+            }
+            cache.stats.hits++;
+            G_UNLOCK(cache);
+            return TRUE;
+        }
+    }
+    cache.stats.misses++;
+    G_UNLOCK(cache);
+    
+    if (!file_classify_path(path, result)) {
+        return FALSE;
+    }
+    
+    TypeCacheRecord fresh;
+    memset(&fresh, 0, sizeof(fresh));
+    fresh.dev = st.st_dev;
+    fresh.ino = st.st_ino;
+    fresh.size = st.st_size;
+    fresh.mtime_sec = st.st_mtim.tv_sec;
+    fresh.mtime_nsec = st.st_mtim.tv_nsec;
+    fresh.type = result->type;
+    fresh.elf_class = result->elf_class;
+    fresh.appimage_type = result->appimage_type;
+    fresh.elf_machine = result->elf_machine;
+    fresh.flags = result->flags & ~FILE_CLASSIFY_EXECUTABLE;
+    memcpy(fresh.interpreter, result->interpreter, sizeof(fresh.interpreter));
+    fresh.check = record_check(&fresh);
+    
+    // Reuse a stale slot for the same inode or an empty one, else evict the home slot
+    G_LOCK(cache);
+    TypeCacheRecord *target = &cache.records[slot & (TYPE_CACHE_SLOTS - 1)];
+    for (guint probe = 0; probe < TYPE_CACHE_PROBE; probe++) {
+        TypeCacheRecord *record = &cache.records[(slot + probe) & (TYPE_CACHE_SLOTS - 1)];
+        if (record->check == 0 || (record->dev == fresh.dev && record->ino == fresh.ino)) {
+            target = record;
+            break;
+        }
+    }
+    // Publish the check last so another process never trusts a half-written record
+    guint32 check = fresh.check;
+    fresh.check = 0;
+    target->check = 0;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(target, &fresh, sizeof(fresh));
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    target->check = check;
+    G_UNLOCK(cache);
+    
+    return TRUE;
+}
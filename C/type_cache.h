@@ -0,0 +1,30 @@
+#ifndef TYPE_CACHE_H
+#define TYPE_CACHE_H
+
+#include <glib.h>
+#include "file_classify.h"
+
+// Persistent file type cache.
+// Classification results are stored in a memory-mapped table under
+// $XDG_CACHE_HOME/cre8or, keyed by (dev, inode, size, mtime), so an
+// unchanged executable costs one stat() and no reads.
+
+typedef struct {
+    guint64 hits;
+    guint64 misses;
+} TypeCacheStats;
+
+// Classifies path through the cache. Same contract as file_classify_path().
+gboolean type_cache_classify(const gchar *path, FileClassification *result);
+
+// Uses cache_path instead of the default location (NULL disables the
+// persistent file and keeps an in-process table). Must be called before
+// the first lookup.
+void type_cache_open(const gchar *cache_path);
+
+// Unmaps the cache; the next lookup reopens the default location
+void type_cache_close(void);
+
+void type_cache_get_stats(TypeCacheStats *stats);
+
+#endif // TYPE_CACHE_H
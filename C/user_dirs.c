@@ -0,0 +1,287 @@
+#define _GNU_SOURCE
+#include "user_dirs.h"
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#define USER_DIRS_FILE "user-dirs.dirs"
+#define USER_DIRS_DESKTOP_KEY "XDG_DESKTOP_DIR=\""
+#define USER_DIRS_MAX_SIZE 65536
+
+static gchar *dir_paths[USER_DIR_COUNT];
+static int dir_fds[USER_DIR_COUNT] = { -1, -1 };   // Kept open while they stay at their path
+G_LOCK_DEFINE_STATIC(user_dirs);
+
+// A user-dirs.dirs value: relative to the home for "$HOME/..." values,
+// else absolute. NULL for "$HOME/", which disables the directory, and for
+// values leaving the home.
+static gchar* normalize_dir_value(const gchar *value) {
+    if (value[0] == '/') {
+        return g_canonicalize_filename(value, "/");
+    }
+    if (!g_str_has_prefix(value, "$HOME") || (value[5] != '/' && value[5] != '\0')) {
+        return NULL;
+    }
+    
+    GString *relative = g_string_new(NULL);
+    gchar **components = g_strsplit(value + 5, "/", -1);
+    gboolean valid = TRUE;
+    for (gchar **component = components; *component; component++) {
+        if ((*component)[0] == '\0' || strcmp(*component, ".") == 0) {
+            continue;
+        }
+        if (strcmp(*component, "..") == 0) {
+            valid = FALSE;
+            break;
+        }
+        if (relative->len > 0) {
+            g_string_append_c(relative, '/');
+        }
+        g_string_append(relative, *component);
+    }
+    g_strfreev(components);
+    
+    if (!valid || relative->len == 0) {
+        g_string_free(relative, TRUE);
+        return NULL;
+    }
+    return g_string_free(relative, FALSE);
+}
+
+// XDG_DESKTOP_DIR of another user's user-dirs.dirs file (see
+// normalize_dir_value). The file is sourced by shells, so the last
+// assignment wins.
+static gchar* parse_desktop_dir(const gchar *contents) {
+    gchar *desktop = NULL;
+    gchar **lines = g_strsplit(contents, "\n", -1);
+    for (gchar **line = lines; *line; line++) {
+        const gchar *p = *line;
+        while (*p == ' ' || *p == '\t') {
+            p++;
+        }
+        if (!g_str_has_prefix(p, USER_DIRS_DESKTOP_KEY)) {
+            continue;
+        }
+        
+        GString *value = g_string_new(NULL);
+        for (p += strlen(USER_DIRS_DESKTOP_KEY); *p && *p != '"'; p++) {
+            if (*p == '\\' && p[1]) {
+                p++;
+            }
+            g_string_append_c(value, *p);
+        }
+        g_free(desktop);
+        desktop = *p == '"' ? normalize_dir_value(value->str) : NULL;
+        g_string_free(value, TRUE);
+    }
+    g_strfreev(lines);
+    return desktop;
+}
+
+// Stamp of the calling user's user-dirs.dirs when the paths were resolved
+typedef struct {
+    gboolean resolved;
+    gboolean exists;
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+} ConfigStamp;
+
+static ConfigStamp config_stamp;
+
+static gboolean config_stamp_matches(const ConfigStamp *stamp, gboolean exists, const struct stat *st) {
+    return stamp->resolved && stamp->exists == exists &&
+           (!exists || (stamp->dev == st->st_dev && stamp->ino == st->st_ino && stamp->size == st->st_size &&
+                        stamp->mtime.tv_sec == st->st_mtim.tv_sec &&
+                        stamp->mtime.tv_nsec == st->st_mtim.tv_nsec));
+}
+
+static void set_dir_path(UserDir dir, gchar *path) {
+    if (g_strcmp0(dir_paths[dir], path) == 0) {
+        g_free(path);
+        return;
+    }
+    g_free(dir_paths[dir]);
+    dir_paths[dir] = path;
+    if (dir_fds[dir] >= 0) {
+        close(dir_fds[dir]);
+        dir_fds[dir] = -1;
+    }
+}
+
+// Resolves the paths, again whenever user-dirs.dirs changed, so a
+// long-running process follows a renamed desktop. Called with the lock held.
+static void resolve_paths(void) {
+    gchar *config_path = g_build_filename(g_get_user_config_dir(), USER_DIRS_FILE, NULL);
+    struct stat st;
+    gboolean exists = stat(config_path, &st) == 0;
+    g_free(config_path);
+    if (config_stamp_matches(&config_stamp, exists, &st)) {
+        return;
+    }
+    
+    // GLib parses the file for the calling user; a desktop set to the home
+    // itself is not used for saving
+    if (config_stamp.resolved) {
+        g_reload_user_special_dirs_cache();
+    }
+    const gchar *home = g_get_home_dir();
+    const gchar *desktop = g_get_user_special_dir(G_USER_DIRECTORY_DESKTOP);
+    set_dir_path(USER_DIR_DESKTOP, desktop && strcmp(desktop, home) != 0 ? g_strdup(desktop) :
+                                   g_build_filename(home, USER_DIRS_DESKTOP_SUBDIR, NULL));
+    set_dir_path(USER_DIR_APPLICATIONS, g_build_filename(g_get_user_data_dir(), "applications", NULL));
+    
+    config_stamp.resolved = TRUE;
+    config_stamp.exists = exists;
+    if (exists) {
+        config_stamp.dev = st.st_dev;
+        config_stamp.ino = st.st_ino;
+        config_stamp.size = st.st_size;
+        config_stamp.mtime = st.st_mtim;
+    }
+}
+
+gchar* user_dirs_dup_path(UserDir dir) {
+    g_return_val_if_fail(dir < USER_DIR_COUNT, NULL);
+    G_LOCK(user_dirs);
+    resolve_paths();
+    gchar *path = g_strdup(dir_paths[dir]);
+    G_UNLOCK(user_dirs);
+    return path;
+}
+
+gboolean user_dirs_find(const gchar *dir_path, UserDir *dir) {
+    gboolean found = FALSE;
+    G_LOCK(user_dirs);
+    resolve_paths();
+    for (guint i = 0; i < USER_DIR_COUNT && !found; i++) {
+        if (strcmp(dir_path, dir_paths[i]) == 0) {
+            *dir = (UserDir)i;
+            found = TRUE;
+        }
+    }
+    G_UNLOCK(user_dirs);
+    return found;
+}
+
+// Whether fd is still the directory at path, and not one removed or
+// replaced since it was opened
+static gboolean fd_is_path(int fd, const gchar *path) {
+    struct stat fd_st;
+    struct stat path_st;
+    return fstat(fd, &fd_st) == 0 && fd_st.st_nlink > 0 && stat(path, &path_st) == 0 &&
+           fd_st.st_dev == path_st.st_dev && fd_st.st_ino == path_st.st_ino;
+}
+
+int user_dirs_open(UserDir dir, gboolean create, gchar **error_msg) {
+    g_return_val_if_fail(dir < USER_DIR_COUNT, -1);
+    int fd = -1;
+    
+    G_LOCK(user_dirs);
+    resolve_paths();
+    gchar *path = g_strdup(dir_paths[dir]);
+    // A directory removed or replaced since it was opened is looked up again
+    if (dir_fds[dir] >= 0 && !fd_is_path(dir_fds[dir], path)) {
+        close(dir_fds[dir]);
+        dir_fds[dir] = -1;
+    }
+    if (dir_fds[dir] < 0) {
+        dir_fds[dir] = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (dir_fds[dir] < 0 && errno == ENOENT && create) {
+            dir_fds[dir] = user_dirs_make_at(AT_FDCWD, path, 0, (uid_t)-1, (gid_t)-1);
+        }
+    }
+    if (dir_fds[dir] >= 0) {
+        fd = fcntl(dir_fds[dir], F_DUPFD_CLOEXEC, 0);
+    }
+    int saved_errno = errno;
+    G_UNLOCK(user_dirs);
+    
+    if (fd < 0) {
+        *error_msg = g_strdup_printf("Failed to %s directory %s: %s", create ? "create" : "open", path,
+                                     g_strerror(saved_errno));
+        errno = saved_errno;
+    }
+    g_free(path);
+    return fd;
+}
+
+int user_dirs_make_at(int base_fd, const gchar *path, int open_flags, uid_t uid, gid_t gid) {
+    int flags = O_RDONLY | O_DIRECTORY | O_CLOEXEC | open_flags;
+    gchar **components = g_strsplit(path, "/", -1);
+    int fd;
+    if (g_path_is_absolute(path)) {
+        fd = open("/", flags);
+    } else if (base_fd == AT_FDCWD) {
+        fd = open(".", flags);
+    } else {
+        fd = fcntl(base_fd, F_DUPFD_CLOEXEC, 0);
+    }
+    
+    for (gchar **component = components; fd >= 0 && *component; component++) {
+        if ((*component)[0] == '\0') {
+            continue;
+        }
+        if (mkdirat(fd, *component, 0755) == 0) {
+            if ((uid != (uid_t)-1 || gid != (gid_t)-1) &&
+                fchownat(fd, *component, uid, gid, AT_SYMLINK_NOFOLLOW) != 0) {
+                int saved_errno = errno;
+                close(fd);
+                fd = -1;
+                errno = saved_errno;
+                break;
+            }
+        } else if (errno != EEXIST) {
+            int saved_errno = errno;
+            close(fd);
+            fd = -1;
+            errno = saved_errno;
+            break;
+        }
+        int next = openat(fd, *component, flags);
+        int saved_errno = errno;
+        close(fd);
+        fd = next;
+        errno = saved_errno;
+    }
+    g_strfreev(components);
+    return fd;
+}
+
+gchar* user_dirs_get_desktop_subdir_at(int home_fd) {
+    gchar *desktop = NULL;
+    int config_fd = openat(home_fd, ".config", O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    int fd = config_fd >= 0 ? openat(config_fd, USER_DIRS_FILE,
+                                     O_RDONLY | O_NOFOLLOW | O_NONBLOCK | O_CLOEXEC) : -1;
+    struct stat st;
+    
+    if (fd >= 0 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        gchar *contents = g_malloc(USER_DIRS_MAX_SIZE + 1);
+        gsize length = 0;
+        ssize_t n;
+        while (length < USER_DIRS_MAX_SIZE &&
+               ((n = read(fd, contents + length, USER_DIRS_MAX_SIZE - length)) > 0 ||
+                (n < 0 && errno == EINTR))) {
+            length += MAX(n, 0);
+        }
+        contents[length] = '\0';
+        desktop = parse_desktop_dir(contents);
+        g_free(contents);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    if (config_fd >= 0) {
+        close(config_fd);
+    }
+    
+    // Another user's absolute paths can't be trusted to stay in their home
+    if (!desktop || g_path_is_absolute(desktop)) {
+        g_free(desktop);
+        desktop = g_strdup(USER_DIRS_DESKTOP_SUBDIR);
+    }
+    return desktop;
+}
@@ -0,0 +1,48 @@
+#ifndef USER_DIRS_H
+#define USER_DIRS_H
+
+#include <glib.h>
+#include <sys/types.h>
+
+// The user's save locations.
+// The desktop comes from XDG_DESKTOP_DIR in user-dirs.dirs (through
+// g_get_user_special_dir()), so localized desktops such as ~/Schreibtisch
+// are found, and the applications directory from $XDG_DATA_HOME. Both are
+// resolved again when user-dirs.dirs changes. Each directory is opened
+// once and the descriptor kept while it is still the directory at that
+// path, so checks, creates and permission changes in it are made relative
+// to the descriptor (fstatat, openat, fchmodat).
+
+// Defaults relative to a home directory
+#define USER_DIRS_DESKTOP_SUBDIR "Desktop"
+#define USER_DIRS_APPLICATIONS_SUBDIR ".local/share/applications"
+
+typedef enum {
+    USER_DIR_DESKTOP,
+    USER_DIR_APPLICATIONS,
+    USER_DIR_COUNT
+} UserDir;
+
+// Absolute path of dir, for the caller to free
+gchar* user_dirs_dup_path(UserDir dir);
+
+// Whether dir_path is one of the user directories, and which
+gboolean user_dirs_find(const gchar *dir_path, UserDir *dir);
+
+// A new descriptor (for the caller to close) of dir, creating the
+// directory and its parents when create is set. The directory is opened
+// again if it was removed since. Returns -1 on failure.
+int user_dirs_open(UserDir dir, gboolean create, gchar **error_msg);
+
+// Creates (mode 0755) and opens path, relative to base_fd or absolute, one
+// component at a time with mkdirat and openat. open_flags are added to
+// every openat (O_NOFOLLOW refuses links), and directories it creates are
+// given to uid and gid unless they are -1. Returns -1 with errno set.
+int user_dirs_make_at(int base_fd, const gchar *path, int open_flags, uid_t uid, gid_t gid);
+
+// The desktop of another user's home open at home_fd, relative to it, from
+// that home's .config/user-dirs.dirs (read without following links).
+// Desktops outside the home fall back to USER_DIRS_DESKTOP_SUBDIR.
+gchar* user_dirs_get_desktop_subdir_at(int home_fd);
+
+#endif // USER_DIRS_H
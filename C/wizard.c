@@ -1,142 +1,185 @@
 #include "wizard.h"
 #include <string.h>
 
-// Category names array
-static const gchar *category_names[] = {
-    "Utility", "Graphics", "Network", "Office", "Development",
-    "AudioVideo", "System", "Settings", "Games"
+// Categories offered on the categories step
+static const DesktopCategory wizard_categories[] = {
+    DESKTOP_CATEGORY_UTILITY, DESKTOP_CATEGORY_GRAPHICS, DESKTOP_CATEGORY_NETWORK,
+    DESKTOP_CATEGORY_OFFICE, DESKTOP_CATEGORY_DEVELOPMENT, DESKTOP_CATEGORY_AUDIO_VIDEO,
+    DESKTOP_CATEGORY_SYSTEM, DESKTOP_CATEGORY_SETTINGS, DESKTOP_CATEGORY_GAME
 };
 
 // Global wizard state to prevent corruption
 static WizardState *g_wizard_state = NULL;
 
-WizardState* wizard_new(GtkWidget *parent_window) {
-    WizardState *wizard = g_new0(WizardState, 1);
+static gboolean wizard_confirm_overwrite(GList *existing_files, gpointer user_data) {
+    GtkWidget *parent_window = GTK_WIDGET(user_data);
     
-    wizard->window = parent_window;
-    wizard->entry = desktop_entry_new();
-    wizard->save_options = file_save_options_new();
-    wizard->current_step = WIZARD_STEP_BASIC_INFO;
-    wizard->preview_content = NULL;
+    if (!existing_files) {
+        return TRUE; // No existing files to worry about
+    }
     
-    // Store in global variable
-    g_wizard_state = wizard;
+    // Create confirmation dialog
+    GtkWidget *dialog = gtk_message_dialog_new(GTK_WINDOW(parent_window),
+                                              GTK_DIALOG_MODAL,
+                                              GTK_MESSAGE_QUESTION,
+                                              GTK_BUTTONS_YES_NO,
+                                              "Overwrite Existing Files?");
     
-    // Create main container
-    wizard->main_container = gtk_box_new(GTK_ORIENTATION_VERTICAL, 5);
-    gtk_container_set_border_width(GTK_CONTAINER(wizard->main_container), 5);
+    // Build message text
+    GString *message = g_string_new("The following files already exist:\n\n");
     
-    // Create step container
-    wizard->step_container = gtk_box_new(GTK_ORIENTATION_VERTICAL, 5);
-    gtk_box_pack_start(GTK_BOX(wizard->main_container), wizard->step_container, TRUE, TRUE, 0);
+    for (GList *iter = existing_files; iter != NULL; iter = iter->next) {
+        gchar *filepath = (gchar*)iter->data;
+        g_string_append_printf(message, "• %s\n", filepath);
+    }
     
-    // Create navigation frame
-    wizard->navigation_frame = gtk_button_box_new(GTK_ORIENTATION_HORIZONTAL);
-    gtk_button_box_set_layout(GTK_BUTTON_BOX(wizard->navigation_frame), GTK_BUTTONBOX_END);
-    gtk_box_pack_end(GTK_BOX(wizard->main_container), wizard->navigation_frame, FALSE, FALSE, 0);
+    g_string_append(message, "\nDo you want to overwrite these files?");
     
-    return wizard;
+    gtk_message_dialog_format_secondary_text(GTK_MESSAGE_DIALOG(dialog), "%s", message->str);
+    g_string_free(message, TRUE);
+    
+    // Show dialog and get response
+    gint response = gtk_dialog_run(GTK_DIALOG(dialog));
+    gtk_widget_destroy(dialog);
+    
+    return (response == GTK_RESPONSE_YES);
 }
 
-void wizard_free(WizardState *wizard) {
-    if (wizard) {
-        desktop_entry_free(wizard->entry);
-        file_save_options_free(wizard->save_options);
-        g_free(wizard->preview_content);
-        g_free(wizard);
+// Stack page names, indexed by WizardStep
+static const gchar *wizard_step_names[] = {
+    "basic-info", "executable", "icon", "categories", "preview", "distribution", "complete"
+};
+
+// Cancels pending work; its callbacks see G_IO_ERROR_CANCELLED and leave
+// the wizard alone
+static void wizard_cancel(GCancellable **cancellable) {
+    if (*cancellable) {
+        g_cancellable_cancel(*cancellable);
+        g_clear_object(cancellable);
     }
 }
 
-void wizard_show(WizardState *wizard) {
-    wizard_create_basic_info_step(wizard);
+// Model bindings: widgets write through to the entry and save options as
+// they change, so leaving a step has nothing left to read back
+
+static void wizard_set_string(gchar **field, const gchar *value) {
+    if (g_strcmp0(*field, value) != 0) {
+        g_free(*field);
+        *field = g_strdup(value);
+    }
+}
+
+static void wizard_on_text_changed(GtkEditable *editable, gpointer user_data) {
+    wizard_set_string(user_data, gtk_entry_get_text(GTK_ENTRY(editable)));
 }
 
-static void clear_step_container(WizardState *wizard) {
-    GList *children = gtk_container_get_children(GTK_CONTAINER(wizard->step_container));
-    for (GList *iter = children; iter != NULL; iter = iter->next) {
-        gtk_widget_destroy(GTK_WIDGET(iter->data));
+static void wizard_on_flag_toggled(GtkToggleButton *button, gpointer user_data) {
+    gboolean *field = user_data;
+    *field = gtk_toggle_button_get_active(button);
+}
+
+static void wizard_on_exec_changed(GtkEditable *editable, WizardState *wizard) {
+    const gchar *exec_path = gtk_entry_get_text(GTK_ENTRY(editable));
+    if (g_strcmp0(exec_path, wizard->entry->exec_path) != 0) {
+        wizard_set_string(&wizard->entry->exec_path, exec_path);
+        wizard->entry->exec_type = FILE_TYPE_UNKNOWN;
     }
-    g_list_free(children);
-    
-    children = gtk_container_get_children(GTK_CONTAINER(wizard->navigation_frame));
-    for (GList *iter = children; iter != NULL; iter = iter->next) {
-        gtk_widget_destroy(GTK_WIDGET(iter->data));
+}
+
+static void wizard_on_category_toggled(GtkToggleButton *button, WizardState *wizard) {
+    DesktopCategory category = GPOINTER_TO_INT(g_object_get_data(G_OBJECT(button), "category"));
+    // Only the offered categories are toggled, so ones typed into the
+    // preview are kept
+    if (gtk_toggle_button_get_active(button)) {
+        desktop_categories_add(&wizard->entry->categories, category);
+    } else {
+        desktop_categories_remove(&wizard->entry->categories, category);
     }
-    g_list_free(children);
 }
 
-static void create_navigation_buttons(WizardState *wizard) {
-    GtkWidget *back_button = gtk_button_new_with_label("Back");
-    GtkWidget *next_button = gtk_button_new_with_label("Next");
-    
-    gtk_widget_set_sensitive(back_button, wizard->current_step > WIZARD_STEP_BASIC_INFO);
-    
-    g_signal_connect(back_button, "clicked", G_CALLBACK(wizard_previous_step), wizard);
-    g_signal_connect(next_button, "clicked", G_CALLBACK(wizard_next_step), wizard);
-    
-    gtk_container_add(GTK_CONTAINER(wizard->navigation_frame), back_button);
-    gtk_container_add(GTK_CONTAINER(wizard->navigation_frame), next_button);
-    
-    gtk_widget_show_all(wizard->navigation_frame);
+static void wizard_bind_text(GtkWidget *entry, gchar **field) {
+    g_signal_connect(entry, "changed", G_CALLBACK(wizard_on_text_changed), field);
+}
+
+static void wizard_bind_flag(GtkWidget *button, gboolean *field) {
+    g_signal_connect(button, "toggled", G_CALLBACK(wizard_on_flag_toggled), field);
+}
+
+// Model to widgets, for values that may have changed elsewhere (the preview
+// edits the entry). The bindings then write back the same values.
+static void wizard_entry_set_text(GtkWidget *entry, const gchar *text) {
+    if (g_strcmp0(gtk_entry_get_text(GTK_ENTRY(entry)), text ? text : "") != 0) {
+        gtk_entry_set_text(GTK_ENTRY(entry), text ? text : "");
+    }
 }
 
+// Shows what the Icon value resolves to. Theme names are looked up in the
+// icon theme index once it has been built.
+static void wizard_update_icon_status(WizardState *wizard) {
+    const gchar *icon = wizard->entry->icon_path;
+    
+    if (!icon_index_is_name(icon)) {
+        gtk_label_set_text(GTK_LABEL(wizard->icon_status), "");
+    } else if (!wizard->icon_index) {
+        gtk_label_set_text(GTK_LABEL(wizard->icon_status), "Looking up icon themes...");
+    } else {
+        gchar *icon_file = icon_index_lookup(wizard->icon_index, icon, 48);
+        gchar *status = icon_file ? g_strdup_printf("Theme icon: %s", icon_file) :
+                        g_strdup_printf("Not found in the %s icon theme.", icon_index_get_theme(wizard->icon_index) ?
+                                        icon_index_get_theme(wizard->icon_index) : "hicolor");
+        gtk_label_set_text(GTK_LABEL(wizard->icon_status), status);
+        g_free(status);
+        g_free(icon_file);
+    }
+}
 
+static void wizard_on_icon_changed(GtkEditable *editable, WizardState *wizard) {
+    (void)editable;  // Suppress unused parameter warning
+    wizard_update_icon_status(wizard);
+}
 
-void wizard_create_basic_info_step(WizardState *wizard) {
-    clear_step_container(wizard);
-    wizard->current_step = WIZARD_STEP_BASIC_INFO;
+static GtkWidget* wizard_page_new(WizardState *wizard, WizardStep step, const gchar *title) {
+    GtkWidget *page = gtk_box_new(GTK_ORIENTATION_VERTICAL, 5);
     
     // Create title
     GtkWidget *title_label = gtk_label_new(NULL);
-    gchar *title_markup = g_markup_printf_escaped("<span size='large' weight='bold'>Step 1: Basic Information</span>");
+    gchar *title_markup = g_markup_printf_escaped("<span size='large' weight='bold'>%s</span>", title);
     gtk_label_set_markup(GTK_LABEL(title_label), title_markup);
     g_free(title_markup);
-    gtk_box_pack_start(GTK_BOX(wizard->step_container), title_label, FALSE, FALSE, 10);
+    gtk_box_pack_start(GTK_BOX(page), title_label, FALSE, FALSE, 10);
     
-    // Create form
+    gtk_stack_add_named(GTK_STACK(wizard->stack), page, wizard_step_names[step]);
+    return page;
+}
+
+static GtkWidget* wizard_form_new(GtkWidget *page) {
     GtkWidget *form_grid = gtk_grid_new();
     gtk_grid_set_row_spacing(GTK_GRID(form_grid), 10);
     gtk_grid_set_column_spacing(GTK_GRID(form_grid), 10);
-    gtk_box_pack_start(GTK_BOX(wizard->step_container), form_grid, FALSE, FALSE, 10);
+    gtk_box_pack_start(GTK_BOX(page), form_grid, FALSE, FALSE, 10);
+    return form_grid;
+}
+
+static void wizard_build_basic_info_page(WizardState *wizard) {
+    GtkWidget *page = wizard_page_new(wizard, WIZARD_STEP_BASIC_INFO, "Step 1: Basic Information");
+    GtkWidget *form_grid = wizard_form_new(page);
     
     // Name field
     gtk_grid_attach(GTK_GRID(form_grid), gtk_label_new("Application Name:"), 0, 0, 1, 1);
     wizard->name_entry = gtk_entry_new();
     gtk_grid_attach(GTK_GRID(form_grid), wizard->name_entry, 1, 0, 1, 1);
+    wizard_bind_text(wizard->name_entry, &wizard->entry->name);
     
     // Comment field
     gtk_grid_attach(GTK_GRID(form_grid), gtk_label_new("Short Description:"), 0, 1, 1, 1);
     wizard->comment_entry = gtk_entry_new();
     gtk_grid_attach(GTK_GRID(form_grid), wizard->comment_entry, 1, 1, 1, 1);
-    
-    create_navigation_buttons(wizard);
-    gtk_widget_show_all(wizard->step_container);
-    
-    // Update UI with existing data
-    if (wizard->entry->name) {
-        gtk_entry_set_text(GTK_ENTRY(wizard->name_entry), wizard->entry->name);
-    }
-    if (wizard->entry->comment) {
-        gtk_entry_set_text(GTK_ENTRY(wizard->comment_entry), wizard->entry->comment);
-    }
+    wizard_bind_text(wizard->comment_entry, &wizard->entry->comment);
 }
 
-void wizard_create_executable_step(WizardState *wizard) {
-    clear_step_container(wizard);
-    wizard->current_step = WIZARD_STEP_EXECUTABLE;
-    
-    // Create title
-    GtkWidget *title_label = gtk_label_new(NULL);
-    gchar *title_markup = g_markup_printf_escaped("<span size='large' weight='bold'>Step 2: Executable</span>");
-    gtk_label_set_markup(GTK_LABEL(title_label), title_markup);
-    g_free(title_markup);
-    gtk_box_pack_start(GTK_BOX(wizard->step_container), title_label, FALSE, FALSE, 10);
-    
-    // Create form
-    GtkWidget *form_grid = gtk_grid_new();
-    gtk_grid_set_row_spacing(GTK_GRID(form_grid), 10);
-    gtk_grid_set_column_spacing(GTK_GRID(form_grid), 10);
-    gtk_box_pack_start(GTK_BOX(wizard->step_container), form_grid, FALSE, FALSE, 10);
+static void wizard_build_executable_page(WizardState *wizard) {
+    GtkWidget *page = wizard_page_new(wizard, WIZARD_STEP_EXECUTABLE, "Step 2: Executable");
+    GtkWidget *form_grid = wizard_form_new(page);
     
     // Executable field
     gtk_grid_attach(GTK_GRID(form_grid), gtk_label_new("Location:"), 0, 0, 1, 1);
@@ -158,38 +201,18 @@ void wizard_create_executable_step(WizardState *wizard) {
     gtk_grid_attach(GTK_GRID(form_grid), terminal_desc, 0, 2, 2, 1);
     
     // Connect signals
-    g_signal_connect(wizard->exec_browse_button, "clicked", 
+    g_signal_connect(wizard->exec_browse_button, "clicked",
                     G_CALLBACK(wizard_on_browse_executable), wizard);
-    
-    create_navigation_buttons(wizard);
-    gtk_widget_show_all(wizard->step_container);
-    
-    // Update UI with existing data
-    if (wizard->entry->exec_path) {
-        gtk_entry_set_text(GTK_ENTRY(wizard->exec_entry), wizard->entry->exec_path);
-    }
-    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(wizard->terminal_check), wizard->entry->terminal);
+    g_signal_connect(wizard->exec_entry, "changed", G_CALLBACK(wizard_on_exec_changed), wizard);
+    wizard_bind_flag(wizard->terminal_check, &wizard->entry->terminal);
 }
 
-void wizard_create_icon_step(WizardState *wizard) {
-    clear_step_container(wizard);
-    wizard->current_step = WIZARD_STEP_ICON;
-    
-    // Create title
-    GtkWidget *title_label = gtk_label_new(NULL);
-    gchar *title_markup = g_markup_printf_escaped("<span size='large' weight='bold'>Step 3: Icon (Optional)</span>");
-    gtk_label_set_markup(GTK_LABEL(title_label), title_markup);
-    g_free(title_markup);
-    gtk_box_pack_start(GTK_BOX(wizard->step_container), title_label, FALSE, FALSE, 10);
-    
-    // Create form
-    GtkWidget *form_grid = gtk_grid_new();
-    gtk_grid_set_row_spacing(GTK_GRID(form_grid), 10);
-    gtk_grid_set_column_spacing(GTK_GRID(form_grid), 10);
-    gtk_box_pack_start(GTK_BOX(wizard->step_container), form_grid, FALSE, FALSE, 10);
+static void wizard_build_icon_page(WizardState *wizard) {
+    GtkWidget *page = wizard_page_new(wizard, WIZARD_STEP_ICON, "Step 3: Icon (Optional)");
+    GtkWidget *form_grid = wizard_form_new(page);
     
     // Icon field
-    gtk_grid_attach(GTK_GRID(form_grid), gtk_label_new("Icon File Location:"), 0, 0, 1, 1);
+    gtk_grid_attach(GTK_GRID(form_grid), gtk_label_new("Icon File or Name:"), 0, 0, 1, 1);
     
     GtkWidget *icon_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 5);
     wizard->icon_entry = gtk_entry_new();
@@ -197,112 +220,86 @@ void wizard_create_icon_step(WizardState *wizard) {
     gtk_box_pack_start(GTK_BOX(icon_box), wizard->icon_entry, TRUE, TRUE, 0);
     gtk_box_pack_start(GTK_BOX(icon_box), wizard->icon_browse_button, FALSE, FALSE, 0);
     gtk_grid_attach(GTK_GRID(form_grid), icon_box, 1, 0, 1, 1);
+    gtk_entry_set_placeholder_text(GTK_ENTRY(wizard->icon_entry), "e.g. utilities-terminal");
+    
+    // Where a theme name resolves to
+    wizard->icon_status = gtk_label_new(NULL);
+    gtk_label_set_xalign(GTK_LABEL(wizard->icon_status), 0.0);
+    gtk_label_set_line_wrap(GTK_LABEL(wizard->icon_status), TRUE);
+    gtk_grid_attach(GTK_GRID(form_grid), wizard->icon_status, 1, 1, 1, 1);
     
     // Connect signals
-    g_signal_connect(wizard->icon_browse_button, "clicked", 
+    g_signal_connect(wizard->icon_browse_button, "clicked",
                     G_CALLBACK(wizard_on_browse_icon), wizard);
-    
-    create_navigation_buttons(wizard);
-    gtk_widget_show_all(wizard->step_container);
-    
-    // Update UI with existing data
-    if (wizard->entry->icon_path) {
-        gtk_entry_set_text(GTK_ENTRY(wizard->icon_entry), wizard->entry->icon_path);
-    }
+    wizard_bind_text(wizard->icon_entry, &wizard->entry->icon_path);
+    // After the binding, so the status sees the new value
+    g_signal_connect(wizard->icon_entry, "changed", G_CALLBACK(wizard_on_icon_changed), wizard);
 }
 
-void wizard_create_categories_step(WizardState *wizard) {
-    clear_step_container(wizard);
-    wizard->current_step = WIZARD_STEP_CATEGORIES;
-    
-    // Create title
-    GtkWidget *title_label = gtk_label_new(NULL);
-    gchar *title_markup = g_markup_printf_escaped("<span size='large' weight='bold'>Step 4: Categories (Optional)</span>");
-    gtk_label_set_markup(GTK_LABEL(title_label), title_markup);
-    g_free(title_markup);
-    gtk_box_pack_start(GTK_BOX(wizard->step_container), title_label, FALSE, FALSE, 10);
+static void wizard_build_categories_page(WizardState *wizard) {
+    GtkWidget *page = wizard_page_new(wizard, WIZARD_STEP_CATEGORIES, "Step 4: Categories (Optional)");
     
     // Create description
     GtkWidget *desc_label = gtk_label_new("Select one or more categories for your application:");
-    gtk_box_pack_start(GTK_BOX(wizard->step_container), desc_label, FALSE, FALSE, 10);
+    gtk_box_pack_start(GTK_BOX(page), desc_label, FALSE, FALSE, 10);
     
     // Create checkboxes in a grid
     GtkWidget *cat_grid = gtk_grid_new();
     gtk_grid_set_row_spacing(GTK_GRID(cat_grid), 5);
     gtk_grid_set_column_spacing(GTK_GRID(cat_grid), 20);
-    gtk_box_pack_start(GTK_BOX(wizard->step_container), cat_grid, FALSE, FALSE, 10);
+    gtk_box_pack_start(GTK_BOX(page), cat_grid, FALSE, FALSE, 10);
     
     for (int i = 0; i < 9; i++) {
-        wizard->category_checks[i] = gtk_check_button_new_with_label(category_names[i]);
+        wizard->category_checks[i] = gtk_check_button_new_with_label(desktop_category_get_name(wizard_categories[i]));
+        g_object_set_data(G_OBJECT(wizard->category_checks[i]), "category", GINT_TO_POINTER(wizard_categories[i]));
+        g_signal_connect(wizard->category_checks[i], "toggled", G_CALLBACK(wizard_on_category_toggled), wizard);
         gtk_grid_attach(GTK_GRID(cat_grid), wizard->category_checks[i], i % 3, i / 3, 1, 1);
     }
-    
-    create_navigation_buttons(wizard);
-    gtk_widget_show_all(wizard->step_container);
 }
 
-void wizard_create_preview_step(WizardState *wizard) {
-    clear_step_container(wizard);
-    wizard->current_step = WIZARD_STEP_PREVIEW;
-    
-    // Create title
-    GtkWidget *title_label = gtk_label_new(NULL);
-    gchar *title_markup = g_markup_printf_escaped("<span size='large' weight='bold'>Step 5: Preview and Edit</span>");
-    gtk_label_set_markup(GTK_LABEL(title_label), title_markup);
-    g_free(title_markup);
-    gtk_box_pack_start(GTK_BOX(wizard->step_container), title_label, FALSE, FALSE, 10);
+static void wizard_build_preview_page(WizardState *wizard) {
+    GtkWidget *page = wizard_page_new(wizard, WIZARD_STEP_PREVIEW, "Step 5: Preview and Edit");
     
     // Create description
     GtkWidget *desc_label = gtk_label_new("Review and edit the .desktop file content:");
-    gtk_box_pack_start(GTK_BOX(wizard->step_container), desc_label, FALSE, FALSE, 10);
+    gtk_box_pack_start(GTK_BOX(page), desc_label, FALSE, FALSE, 10);
     
     // Create text view with scrollbar
     GtkWidget *scrolled_window = gtk_scrolled_window_new(NULL, NULL);
     gtk_scrolled_window_set_min_content_height(GTK_SCROLLED_WINDOW(scrolled_window), 150);
-    gtk_box_pack_start(GTK_BOX(wizard->step_container), scrolled_window, TRUE, TRUE, 5);
+    gtk_box_pack_start(GTK_BOX(page), scrolled_window, TRUE, TRUE, 5);
     
     wizard->preview_text = gtk_text_view_new();
     gtk_text_view_set_monospace(GTK_TEXT_VIEW(wizard->preview_text), TRUE);
     gtk_text_view_set_wrap_mode(GTK_TEXT_VIEW(wizard->preview_text), GTK_WRAP_WORD_CHAR);
     gtk_container_add(GTK_CONTAINER(scrolled_window), wizard->preview_text);
     
-    // Generate preview content
-    wizard_generate_preview(wizard);
-    
-    // Connect text buffer signal
-    GtkTextBuffer *buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(wizard->preview_text));
-    g_signal_connect(buffer, "changed", G_CALLBACK(wizard_on_preview_changed), wizard);
-    
-    create_navigation_buttons(wizard);
-    gtk_widget_show_all(wizard->step_container);
+    // Problems found in the edited text are listed here
+    wizard->preview_status = gtk_label_new(NULL);
+    gtk_label_set_xalign(GTK_LABEL(wizard->preview_status), 0.0);
+    gtk_label_set_line_wrap(GTK_LABEL(wizard->preview_status), TRUE);
+    gtk_box_pack_start(GTK_BOX(page), wizard->preview_status, FALSE, FALSE, 5);
 }
 
-void wizard_create_distribution_step(WizardState *wizard) {
-    clear_step_container(wizard);
-    wizard->current_step = WIZARD_STEP_DISTRIBUTION;
-    
-    // Create title
-    GtkWidget *title_label = gtk_label_new(NULL);
-    gchar *title_markup = g_markup_printf_escaped("<span size='large' weight='bold'>Step 6: Distribution</span>");
-    gtk_label_set_markup(GTK_LABEL(title_label), title_markup);
-    g_free(title_markup);
-    gtk_box_pack_start(GTK_BOX(wizard->step_container), title_label, FALSE, FALSE, 10);
+static void wizard_build_distribution_page(WizardState *wizard) {
+    GtkWidget *page = wizard_page_new(wizard, WIZARD_STEP_DISTRIBUTION, "Step 6: Distribution");
+    FileSaveOptions *options = wizard->save_options;
     
     // Create description
     GtkWidget *desc_label = gtk_label_new("Choose where to save the .desktop file:");
-    gtk_box_pack_start(GTK_BOX(wizard->step_container), desc_label, FALSE, FALSE, 10);
+    gtk_box_pack_start(GTK_BOX(page), desc_label, FALSE, FALSE, 10);
     
     // Create checkboxes
     GtkWidget *options_box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 10);
-    gtk_box_pack_start(GTK_BOX(wizard->step_container), options_box, FALSE, FALSE, 10);
+    gtk_box_pack_start(GTK_BOX(page), options_box, FALSE, FALSE, 10);
     
     gchar *desktop_path = file_utils_get_desktop_directory();
     gchar *local_apps_path = file_utils_get_local_applications_directory();
+    gchar *desktop_label = g_strdup_printf("User's Desktop (%s)", desktop_path);
+    gchar *local_apps_label = g_strdup_printf("User's Local Applications (%s)", local_apps_path);
     
-    wizard->save_checkboxes[0] = gtk_check_button_new_with_label(
-        g_strdup_printf("User's Desktop (%s)", desktop_path));
-    wizard->save_checkboxes[1] = gtk_check_button_new_with_label(
-        g_strdup_printf("User's Local Applications (%s)", local_apps_path));
+    wizard->save_checkboxes[0] = gtk_check_button_new_with_label(desktop_label);
+    wizard->save_checkboxes[1] = gtk_check_button_new_with_label(local_apps_label);
     wizard->save_checkboxes[2] = gtk_check_button_new_with_label(
         "Save to custom location");
     
@@ -320,48 +317,311 @@ void wizard_create_distribution_step(WizardState *wizard) {
     gtk_widget_set_sensitive(wizard->custom_path_entry, FALSE);
     
     // Connect signals
+    wizard_bind_flag(wizard->save_checkboxes[0], &options->save_to_desktop);
+    wizard_bind_flag(wizard->save_checkboxes[1], &options->save_to_local_apps);
+    wizard_bind_flag(wizard->save_checkboxes[2], &options->save_to_custom);
     for (int i = 0; i < 3; i++) {
-        g_signal_connect(wizard->save_checkboxes[i], "toggled", 
+        g_signal_connect(wizard->save_checkboxes[i], "toggled",
                         G_CALLBACK(wizard_on_save_option_changed), wizard);
     }
+    wizard_bind_text(wizard->custom_path_entry, &options->custom_path);
     
+    g_free(desktop_label);
+    g_free(local_apps_label);
     g_free(desktop_path);
     g_free(local_apps_path);
-    
-    create_navigation_buttons(wizard);
-    gtk_widget_show_all(wizard->step_container);
 }
 
-void wizard_create_complete_step(WizardState *wizard) {
-    clear_step_container(wizard);
-    wizard->current_step = WIZARD_STEP_COMPLETE;
-    
-    // Create title
-    GtkWidget *title_label = gtk_label_new(NULL);
-    gchar *title_markup = g_markup_printf_escaped("<span size='large' weight='bold'>Complete!</span>");
-    gtk_label_set_markup(GTK_LABEL(title_label), title_markup);
-    g_free(title_markup);
-    gtk_box_pack_start(GTK_BOX(wizard->step_container), title_label, FALSE, FALSE, 10);
+static void wizard_build_complete_page(WizardState *wizard) {
+    GtkWidget *page = wizard_page_new(wizard, WIZARD_STEP_COMPLETE, "Complete!");
     
     // Create message
     GtkWidget *msg_label = gtk_label_new("Your .desktop file has been created successfully!");
-    gtk_box_pack_start(GTK_BOX(wizard->step_container), msg_label, FALSE, FALSE, 10);
+    gtk_box_pack_start(GTK_BOX(page), msg_label, FALSE, FALSE, 10);
     
     // Create buttons
     GtkWidget *button_box = gtk_button_box_new(GTK_ORIENTATION_HORIZONTAL);
     gtk_button_box_set_layout(GTK_BUTTON_BOX(button_box), GTK_BUTTONBOX_CENTER);
-    gtk_box_pack_start(GTK_BOX(wizard->step_container), button_box, FALSE, FALSE, 20);
+    gtk_box_pack_start(GTK_BOX(page), button_box, FALSE, FALSE, 20);
     
     GtkWidget *new_button = gtk_button_new_with_label("Create Another");
     GtkWidget *quit_button = gtk_button_new_with_label("Quit");
     
-    g_signal_connect(new_button, "clicked", G_CALLBACK(wizard_show), wizard);
+    g_signal_connect_swapped(new_button, "clicked", G_CALLBACK(wizard_show), wizard);
     g_signal_connect_swapped(quit_button, "clicked", G_CALLBACK(gtk_widget_destroy), wizard->window);
     
     gtk_container_add(GTK_CONTAINER(button_box), new_button);
     gtk_container_add(GTK_CONTAINER(button_box), quit_button);
+}
+
+static void create_navigation_buttons(WizardState *wizard) {
+    wizard->back_button = gtk_button_new_with_label("Back");
+    wizard->next_button = gtk_button_new_with_label("Next");
+    
+    g_signal_connect_swapped(wizard->back_button, "clicked", G_CALLBACK(wizard_previous_step), wizard);
+    g_signal_connect_swapped(wizard->next_button, "clicked", G_CALLBACK(wizard_next_step), wizard);
+    
+    gtk_container_add(GTK_CONTAINER(wizard->navigation_frame), wizard->back_button);
+    gtk_container_add(GTK_CONTAINER(wizard->navigation_frame), wizard->next_button);
+    
+    // Hidden on the last page; keep gtk_widget_show_all() off it
+    gtk_widget_show_all(wizard->navigation_frame);
+    gtk_widget_set_no_show_all(wizard->navigation_frame, TRUE);
+}
+
+WizardState* wizard_new(GtkWidget *parent_window) {
+    WizardState *wizard = g_new0(WizardState, 1);
+    
+    wizard->window = parent_window;
+    wizard->entry = desktop_entry_new();
+    wizard->save_options = file_save_options_new();
+    wizard->save_options->confirm_overwrite = wizard_confirm_overwrite;
+    wizard->save_options->confirm_data = parent_window;
+    wizard->current_step = WIZARD_STEP_BASIC_INFO;
+    wizard->preview_content = NULL;
+    wizard->timing_enabled = g_getenv("CRE8OR_STEP_TIMING") != NULL;
+    
+    // Store in global variable
+    g_wizard_state = wizard;
+    
+    // Create main container
+    wizard->main_container = gtk_box_new(GTK_ORIENTATION_VERTICAL, 5);
+    gtk_container_set_border_width(GTK_CONTAINER(wizard->main_container), 5);
     
-    gtk_widget_show_all(wizard->step_container);
+    // Every step page is built once here; moving between steps only
+    // switches the visible page
+    wizard->stack = gtk_stack_new();
+    gtk_box_pack_start(GTK_BOX(wizard->main_container), wizard->stack, TRUE, TRUE, 0);
+    wizard_build_basic_info_page(wizard);
+    wizard_build_executable_page(wizard);
+    wizard_build_icon_page(wizard);
+    wizard_build_categories_page(wizard);
+    wizard_build_preview_page(wizard);
+    wizard_build_distribution_page(wizard);
+    wizard_build_complete_page(wizard);
+    gtk_widget_show_all(wizard->stack);
+    
+    // Create navigation frame
+    wizard->navigation_frame = gtk_button_box_new(GTK_ORIENTATION_HORIZONTAL);
+    gtk_button_box_set_layout(GTK_BUTTON_BOX(wizard->navigation_frame), GTK_BUTTONBOX_END);
+    gtk_box_pack_end(GTK_BOX(wizard->main_container), wizard->navigation_frame, FALSE, FALSE, 0);
+    create_navigation_buttons(wizard);
+    
+    return wizard;
+}
+
+void wizard_free(WizardState *wizard) {
+    if (wizard) {
+        wizard_cancel(&wizard->browse_probe);
+        wizard_cancel(&wizard->type_probe);
+        wizard_cancel(&wizard->metadata_read);
+        wizard_cancel(&wizard->save_cancellable);
+        wizard_cancel(&wizard->icon_index_load);
+        icon_index_free(wizard->icon_index);
+        if (wizard->timing_clock) {
+            g_signal_handler_disconnect(wizard->timing_clock, wizard->timing_handler);
+            g_object_unref(wizard->timing_clock);
+        }
+        if (wizard->timing_count > 0) {
+            g_printerr("Step transitions: %u, first frame after %.2f ms on average, %.2f ms at most\n",
+                       wizard->timing_count, wizard->timing_total_us / 1000.0 / wizard->timing_count,
+                       wizard->timing_max_us / 1000.0);
+        }
+        wizard_preview_sync_free(wizard->preview_sync);
+        desktop_entry_free(wizard->entry);
+        file_save_options_free(wizard->save_options);
+        g_free(wizard->preview_content);
+        g_free(wizard);
+    }
+}
+
+// Step transition timing (CRE8OR_STEP_TIMING=1): the time to switch pages,
+// and the time until the window has painted the new one
+
+static void wizard_on_after_paint(GdkFrameClock *clock, WizardState *wizard) {
+    gint64 frame_us = g_get_monotonic_time() - wizard->timing_start_us;
+    g_printerr("Step %s -> %s: switched in %.2f ms, first frame after %.2f ms\n",
+               wizard_step_names[wizard->timing_from], wizard_step_names[wizard->current_step],
+               wizard->timing_switch_us / 1000.0, frame_us / 1000.0);
+    wizard->timing_count++;
+    wizard->timing_total_us += frame_us;
+    wizard->timing_max_us = MAX(wizard->timing_max_us, frame_us);
+    
+    g_signal_handler_disconnect(clock, wizard->timing_handler);
+    g_clear_object(&wizard->timing_clock);
+    wizard->timing_handler = 0;
+}
+
+static void wizard_timing_switched(WizardState *wizard, WizardStep from) {
+    wizard->timing_switch_us = g_get_monotonic_time() - wizard->timing_start_us;
+    wizard->timing_from = from;
+    
+    // Not realized yet on the first page, which main() shows
+    GdkFrameClock *clock = gtk_widget_get_frame_clock(wizard->stack);
+    if (!clock || wizard->timing_clock) {
+        return;
+    }
+    wizard->timing_clock = g_object_ref(clock);
+    wizard->timing_handler = g_signal_connect(clock, "after-paint", G_CALLBACK(wizard_on_after_paint), wizard);
+}
+
+// Generates the preview content, then follows the user's edits of it
+static void wizard_show_preview(WizardState *wizard) {
+    gtk_widget_set_sensitive(wizard->preview_text, TRUE);
+    wizard_generate_preview(wizard);
+    wizard->preview_sync = wizard_preview_sync_new(GTK_TEXT_VIEW(wizard->preview_text),
+                                                   GTK_LABEL(wizard->preview_status), wizard->entry);
+}
+
+static void wizard_on_type_probed(GObject *source, GAsyncResult *result, gpointer user_data) {
+    (void)source;  // Suppress unused parameter warning
+    GError *error = NULL;
+    FileType file_type = FILE_TYPE_UNKNOWN;
+    
+    // Validation errors don't matter here, only the type
+    file_utils_probe_executable_finish(result, &file_type, &error);
+    if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+        g_error_free(error);
+        return;
+    }
+    
+    WizardState *wizard = user_data;
+    g_clear_object(&wizard->type_probe);
+    // Unknown and unreadable files get the same direct Exec line as OTHER
+    wizard->entry->exec_type = file_type != FILE_TYPE_UNKNOWN ? file_type : FILE_TYPE_OTHER;
+    
+    if (wizard->current_step == WIZARD_STEP_PREVIEW && !wizard->preview_sync) {
+        wizard_show_preview(wizard);
+        if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT)) {
+            gchar *status = g_strdup_printf("%s; using a direct Exec line.", error->message);
+            gtk_label_set_text(GTK_LABEL(wizard->preview_status), status);
+            g_free(status);
+        }
+    }
+    g_clear_error(&error);
+}
+
+// Detects the type of entry->exec_path in the background, replacing any
+// detection still running for an older path
+static void wizard_start_type_probe(WizardState *wizard) {
+    wizard_cancel(&wizard->type_probe);
+    if (!wizard->entry->exec_path || wizard->entry->exec_path[0] == '\0') {
+        wizard->entry->exec_type = FILE_TYPE_OTHER;
+        return;
+    }
+    wizard->type_probe = g_cancellable_new();
+    file_utils_probe_executable_async(wizard->entry->exec_path, FILE_UTILS_PROBE_TIMEOUT_MS,
+                                      wizard->type_probe, wizard_on_type_probed, wizard);
+}
+
+static void wizard_on_icon_index_ready(GObject *source, GAsyncResult *result, gpointer user_data) {
+    (void)source;  // Suppress unused parameter warning
+    GError *error = NULL;
+    
+    IconIndex *index = icon_index_new_finish(result, &error);
+    if (!index) {
+        // Only fails when cancelled, and then the wizard may be gone
+        g_error_free(error);
+        return;
+    }
+    
+    WizardState *wizard = user_data;
+    g_clear_object(&wizard->icon_index_load);
+    wizard->icon_index = index;
+    wizard_update_icon_status(wizard);
+}
+
+// Indexes the icon theme GTK uses, the first time the icon step is shown
+static void wizard_start_icon_index(WizardState *wizard) {
+    if (wizard->icon_index || wizard->icon_index_load) {
+        return;
+    }
+    gchar *theme = NULL;
+    g_object_get(gtk_settings_get_default(), "gtk-icon-theme-name", &theme, NULL);
+    wizard->icon_index_load = g_cancellable_new();
+    icon_index_new_async(theme, wizard->icon_index_load, wizard_on_icon_index_ready, wizard);
+    g_free(theme);
+}
+
+static void wizard_enter_preview(WizardState *wizard) {
+    // The Exec line depends on the executable's type, which is detected on
+    // a worker; until then the preview waits
+    if (wizard->entry->exec_type != FILE_TYPE_UNKNOWN) {
+        wizard_show_preview(wizard);
+    } else {
+        GtkTextBuffer *buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(wizard->preview_text));
+        gtk_text_buffer_set_text(buffer, "", -1);
+        gtk_widget_set_sensitive(wizard->preview_text, FALSE);
+        gtk_label_set_text(GTK_LABEL(wizard->preview_status), "Detecting the executable's type...");
+        if (!wizard->type_probe) {
+            wizard_start_type_probe(wizard);
+        }
+    }
+}
+
+// Brings the page of step up to date with the model
+static void wizard_load_step(WizardState *wizard, WizardStep step) {
+    switch (step) {
+        case WIZARD_STEP_BASIC_INFO:
+            wizard_entry_set_text(wizard->name_entry, wizard->entry->name);
+            wizard_entry_set_text(wizard->comment_entry, wizard->entry->comment);
+            break;
+        case WIZARD_STEP_EXECUTABLE:
+            wizard_entry_set_text(wizard->exec_entry, wizard->entry->exec_path);
+            gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(wizard->terminal_check), wizard->entry->terminal);
+            break;
+        case WIZARD_STEP_ICON:
+            wizard_entry_set_text(wizard->icon_entry, wizard->entry->icon_path);
+            wizard_start_icon_index(wizard);
+            wizard_update_icon_status(wizard);
+            break;
+        case WIZARD_STEP_CATEGORIES:
+            for (int i = 0; i < 9; i++) {
+                gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(wizard->category_checks[i]),
+                                             desktop_categories_has(&wizard->entry->categories, wizard_categories[i]));
+            }
+            break;
+        case WIZARD_STEP_PREVIEW:
+            wizard_enter_preview(wizard);
+            break;
+        default:
+            break;
+    }
+}
+
+static void wizard_leave_step(WizardState *wizard) {
+    // Leaving the preview: apply pending edits and keep the edited text
+    if (wizard->preview_sync) {
+        g_free(wizard->preview_content);
+        wizard->preview_content = wizard_preview_sync_get_text(wizard->preview_sync);
+        wizard_preview_sync_free(wizard->preview_sync);
+        wizard->preview_sync = NULL;
+    }
+    if (wizard->browse_probe) {
+        wizard_cancel(&wizard->browse_probe);
+        gtk_widget_set_sensitive(wizard->exec_browse_button, TRUE);
+    }
+}
+
+void wizard_show_step(WizardState *wizard, WizardStep step) {
+    WizardStep from = wizard->current_step;
+    wizard->timing_start_us = g_get_monotonic_time();
+    
+    wizard_leave_step(wizard);
+    wizard->current_step = step;
+    wizard_load_step(wizard, step);
+    gtk_stack_set_visible_child_name(GTK_STACK(wizard->stack), wizard_step_names[step]);
+    
+    gtk_widget_set_sensitive(wizard->back_button, step > WIZARD_STEP_BASIC_INFO);
+    gtk_widget_set_visible(wizard->navigation_frame, step != WIZARD_STEP_COMPLETE);
+    
+    if (wizard->timing_enabled) {
+        wizard_timing_switched(wizard, from);
+    }
+}
+
+void wizard_show(WizardState *wizard) {
+    wizard_show_step(wizard, WIZARD_STEP_BASIC_INFO);
 }
 
 void wizard_next_step(WizardState *wizard) {
@@ -386,43 +646,13 @@ void wizard_next_step(WizardState *wizard) {
         return;
     }
     
-    // Update entry data from current step before moving to next
+    // Finish what the current step started before moving on
     wizard_update_entry_from_current_step(wizard);
     
-    switch (wizard->current_step) {
-
-        case WIZARD_STEP_BASIC_INFO:
-            wizard_create_executable_step(wizard);
-            break;
-        case WIZARD_STEP_EXECUTABLE:
-            wizard_create_icon_step(wizard);
-            break;
-        case WIZARD_STEP_ICON:
-            wizard_create_categories_step(wizard);
-            break;
-        case WIZARD_STEP_CATEGORIES:
-            wizard_create_preview_step(wizard);
-            break;
-        case WIZARD_STEP_PREVIEW:
-            wizard_create_distribution_step(wizard);
-            break;
-        case WIZARD_STEP_DISTRIBUTION:
-            if (wizard_save_files(wizard, &error_msg)) {
-                wizard_create_complete_step(wizard);
-            } else {
-                GtkWidget *dialog = gtk_message_dialog_new(GTK_WINDOW(wizard->window),
-                                                          GTK_DIALOG_MODAL,
-                                                          GTK_MESSAGE_ERROR,
-                                                          GTK_BUTTONS_OK,
-                                                          "Save Error");
-                gtk_message_dialog_format_secondary_text(GTK_MESSAGE_DIALOG(dialog), "%s", error_msg);
-                gtk_dialog_run(GTK_DIALOG(dialog));
-                gtk_widget_destroy(dialog);
-                g_free(error_msg);
-            }
-            break;
-        default:
-            break;
+    if (wizard->current_step == WIZARD_STEP_DISTRIBUTION) {
+        wizard_save_files(wizard);
+    } else if (wizard->current_step < WIZARD_STEP_DISTRIBUTION) {
+        wizard_show_step(wizard, wizard->current_step + 1);
     }
 }
 
@@ -430,70 +660,24 @@ void wizard_previous_step(WizardState *wizard) {
     // Use global wizard state instead of parameter
     wizard = g_wizard_state;
     
-    switch (wizard->current_step) {
-        case WIZARD_STEP_BASIC_INFO:
-            // This is the first step, no previous
-            break;
-        case WIZARD_STEP_EXECUTABLE:
-            wizard_create_basic_info_step(wizard);
-            break;
-        case WIZARD_STEP_ICON:
-            wizard_create_executable_step(wizard);
-            break;
-        case WIZARD_STEP_CATEGORIES:
-            wizard_create_icon_step(wizard);
-            break;
-        case WIZARD_STEP_PREVIEW:
-            wizard_create_categories_step(wizard);
-            break;
-        case WIZARD_STEP_DISTRIBUTION:
-            wizard_create_preview_step(wizard);
-            break;
-        default:
-            break;
+    if (wizard->current_step > WIZARD_STEP_BASIC_INFO && wizard->current_step < WIZARD_STEP_COMPLETE) {
+        wizard_show_step(wizard, wizard->current_step - 1);
     }
 }
 
 void wizard_update_entry_from_current_step(WizardState *wizard) {
+    // The widgets are bound to the model; only work that should not run on
+    // every keystroke is left for leaving the step
     switch (wizard->current_step) {
-
-        case WIZARD_STEP_BASIC_INFO:
-            g_free(wizard->entry->name);
-            wizard->entry->name = g_strdup(gtk_entry_get_text(GTK_ENTRY(wizard->name_entry)));
-            g_free(wizard->entry->comment);
-            wizard->entry->comment = g_strdup(gtk_entry_get_text(GTK_ENTRY(wizard->comment_entry)));
-            break;
         case WIZARD_STEP_EXECUTABLE:
-            g_free(wizard->entry->exec_path);
-            wizard->entry->exec_path = g_strdup(gtk_entry_get_text(GTK_ENTRY(wizard->exec_entry)));
-            wizard->entry->terminal = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(wizard->terminal_check));
-            break;
-        case WIZARD_STEP_ICON:
-            g_free(wizard->entry->icon_path);
-            wizard->entry->icon_path = g_strdup(gtk_entry_get_text(GTK_ENTRY(wizard->icon_entry)));
-            break;
-        case WIZARD_STEP_CATEGORIES:
-            desktop_entry_clear_categories(&wizard->entry->categories);
-            for (int i = 0; i < 9; i++) {
-                if (gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(wizard->category_checks[i]))) {
-                    desktop_entry_set_category(&wizard->entry->categories, category_names[i], TRUE);
-                }
+            // Ready by the time the preview needs it, usually
+            if (wizard->entry->exec_type == FILE_TYPE_UNKNOWN) {
+                wizard_start_type_probe(wizard);
             }
             break;
         case WIZARD_STEP_PREVIEW:
-            // Content is updated by text buffer callback
-            break;
-        case WIZARD_STEP_DISTRIBUTION:
-            wizard->save_options->save_to_desktop = 
-                gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(wizard->save_checkboxes[0]));
-            wizard->save_options->save_to_local_apps = 
-                gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(wizard->save_checkboxes[1]));
-            wizard->save_options->save_to_custom = 
-                gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(wizard->save_checkboxes[2]));
-            if (wizard->save_options->save_to_custom) {
-                g_free(wizard->save_options->custom_path);
-                wizard->save_options->custom_path = 
-                    g_strdup(gtk_entry_get_text(GTK_ENTRY(wizard->custom_path_entry)));
+            if (wizard->preview_sync) {
+                wizard_preview_sync_flush(wizard->preview_sync);
             }
             break;
         default:
@@ -503,7 +687,7 @@ void wizard_update_entry_from_current_step(WizardState *wizard) {
 
 gboolean wizard_validate_current_step(WizardState *wizard, gchar **error_msg) {
     switch (wizard->current_step) {
-
+        
         case WIZARD_STEP_BASIC_INFO:
             if (!gtk_entry_get_text(GTK_ENTRY(wizard->name_entry)) || 
                 strlen(gtk_entry_get_text(GTK_ENTRY(wizard->name_entry))) == 0) {
@@ -525,14 +709,17 @@ gboolean wizard_validate_current_step(WizardState *wizard, gchar **error_msg) {
             // Categories are optional
             return TRUE;
         case WIZARD_STEP_PREVIEW:
-            // Preview is always valid
+            if (!wizard->preview_sync) {
+                *error_msg = g_strdup("The preview is not ready yet.");
+                return FALSE;
+            }
             return TRUE;
         case WIZARD_STEP_DISTRIBUTION:
             gboolean save_to_desktop = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(wizard->save_checkboxes[0]));
             gboolean save_to_local_apps = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(wizard->save_checkboxes[1]));
             gboolean save_to_custom = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(wizard->save_checkboxes[2]));
             
-
+            
             
             if (!save_to_desktop && !save_to_local_apps && !save_to_custom) {
                 *error_msg = g_strdup("Please select at least one save location.");
@@ -560,24 +747,144 @@ void wizard_generate_preview(WizardState *wizard) {
     gtk_text_buffer_set_text(buffer, wizard->preview_content, -1);
 }
 
-gboolean wizard_save_files(WizardState *wizard, gchar **error_msg) {
+static void wizard_on_save_finished(GObject *source, GAsyncResult *result, gpointer user_data) {
+    (void)source;  // Suppress unused parameter warning
+    GError *error = NULL;
+    WizardState *wizard = user_data;
+    
+    // Outputs go to a scratch copy: the wizard may be gone if cancelled
+    FileSaveOptions outputs = { 0 };
+    gboolean success = file_utils_save_desktop_file_finish(result, &outputs, &error);
+    if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+        g_strfreev(outputs.duplicates);
+        g_error_free(error);
+        return;
+    }
+    
+    g_clear_object(&wizard->save_cancellable);
+    gtk_widget_set_sensitive(wizard->navigation_frame, TRUE);
+    wizard->save_options->trust_stats = outputs.trust_stats;
+    g_strfreev(wizard->save_options->duplicates);
+    wizard->save_options->duplicates = outputs.duplicates;
+    
+    if (success) {
+        if (wizard->save_options->duplicates) {
+            gchar *paths = g_strjoinv("\n", wizard->save_options->duplicates);
+            GtkWidget *dialog = gtk_message_dialog_new(GTK_WINDOW(wizard->window),
+                                                      GTK_DIALOG_MODAL,
+                                                      GTK_MESSAGE_WARNING,
+                                                      GTK_BUTTONS_OK,
+                                                      "Similar Application Already Installed");
+            gtk_message_dialog_format_secondary_text(GTK_MESSAGE_DIALOG(dialog),
+                "Entries with the same name or executable already exist:\n\n%s", paths);
+            gtk_dialog_run(GTK_DIALOG(dialog));
+            gtk_widget_destroy(dialog);
+            g_free(paths);
+        }
+        wizard_show_step(wizard, WIZARD_STEP_COMPLETE);
+    } else {
+        GtkWidget *dialog = gtk_message_dialog_new(GTK_WINDOW(wizard->window),
+                                                  GTK_DIALOG_MODAL,
+                                                  GTK_MESSAGE_ERROR,
+                                                  GTK_BUTTONS_OK,
+                                                  "Save Error");
+        gtk_message_dialog_format_secondary_text(GTK_MESSAGE_DIALOG(dialog), "%s", error->message);
+        gtk_dialog_run(GTK_DIALOG(dialog));
+        gtk_widget_destroy(dialog);
+        g_error_free(error);
+    }
+}
+
+void wizard_save_files(WizardState *wizard) {
     // Use stored preview content instead of trying to access text view
     if (!wizard->preview_content) {
         wizard->preview_content = desktop_entry_generate_content(wizard->entry);
     }
     
-    gchar *content = g_strdup(wizard->preview_content);
-    gchar *filename = wizard->entry->name ? g_strdup(wizard->entry->name) : g_strdup("my_application");
+    const gchar *filename = wizard->entry->name ? wizard->entry->name : "my_application";
     
-    gboolean success = file_utils_save_desktop_file(content, filename, wizard->save_options, wizard->window, error_msg);
+    // Existence checks and writes run on a worker; navigation waits for them
+    gtk_widget_set_sensitive(wizard->navigation_frame, FALSE);
+    wizard->save_cancellable = g_cancellable_new();
+    file_utils_save_desktop_file_async(wizard->preview_content, filename, wizard->save_options,
+                                       wizard->save_cancellable, wizard_on_save_finished, wizard);
+}
+
+// Callback functions
+
+typedef struct {
+    WizardState *wizard;
+    gchar *path;
+} BrowseProbe;
+
+static void wizard_on_metadata_read(GObject *source, GAsyncResult *result, gpointer user_data) {
+    (void)source;  // Suppress unused parameter warning
+    GError *error = NULL;
     
-    g_free(content);
-    g_free(filename);
+    ExecMetadata *meta = exec_metadata_read_finish(result, &error);
+    if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+        g_error_free(error);
+        return;
+    }
     
-    return success;
+    WizardState *wizard = user_data;
+    g_clear_object(&wizard->metadata_read);
+    if (meta) {
+        // Only fills what the user has not entered; the pages reload from
+        // the entry when they are shown
+        exec_metadata_apply(meta, wizard->entry);
+        exec_metadata_free(meta);
+    }
+    g_clear_error(&error);
 }
 
-// Callback functions
+static void wizard_on_browse_probed(GObject *source, GAsyncResult *result, gpointer user_data) {
+    (void)source;  // Suppress unused parameter warning
+    BrowseProbe *probe = user_data;
+    WizardState *wizard = probe->wizard;
+    GError *error = NULL;
+    FileType file_type = FILE_TYPE_UNKNOWN;
+    
+    gboolean valid = file_utils_probe_executable_finish(result, &file_type, &error);
+    if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+        // Step left or wizard gone
+        g_error_free(error);
+        g_free(probe->path);
+        g_free(probe);
+        return;
+    }
+    
+    g_clear_object(&wizard->browse_probe);
+    gtk_widget_set_sensitive(wizard->exec_browse_button, TRUE);
+    if (!valid) {
+        GtkWidget *error_dialog = gtk_message_dialog_new(GTK_WINDOW(wizard->window),
+                                                       GTK_DIALOG_MODAL,
+                                                       GTK_MESSAGE_ERROR,
+                                                       GTK_BUTTONS_OK,
+                                                       "Invalid Executable");
+        gtk_message_dialog_format_secondary_text(GTK_MESSAGE_DIALOG(error_dialog), 
+                                               "The selected file is not a valid executable: %s", 
+                                               error->message);
+        gtk_dialog_run(GTK_DIALOG(error_dialog));
+        gtk_widget_destroy(error_dialog);
+        g_error_free(error);
+    } else {
+        // The binding stores the path; the type is known now, so the
+        // preview needs no second look
+        gtk_entry_set_text(GTK_ENTRY(wizard->exec_entry), probe->path);
+        wizard->entry->exec_type = file_type != FILE_TYPE_UNKNOWN ? file_type : FILE_TYPE_OTHER;
+        
+        // An AppImage brings its own name, icon and categories
+        if (file_type == FILE_TYPE_APPIMAGE) {
+            wizard_cancel(&wizard->metadata_read);
+            wizard->metadata_read = g_cancellable_new();
+            exec_metadata_read_async(probe->path, EXEC_METADATA_INSTALL_ICON, wizard->metadata_read,
+                                     wizard_on_metadata_read, wizard);
+        }
+    }
+    g_free(probe->path);
+    g_free(probe);
+}
 
 void wizard_on_browse_executable(GtkButton *button, WizardState *wizard) {
     (void)button;  // Suppress unused parameter warning
@@ -594,23 +901,15 @@ void wizard_on_browse_executable(GtkButton *button, WizardState *wizard) {
     if (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT) {
         filename = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(dialog));
         if (filename) {
-            // Validate the selected file
-            gchar *exec_error = NULL;
-            if (!file_utils_validate_executable(filename, &exec_error)) {
-                GtkWidget *error_dialog = gtk_message_dialog_new(GTK_WINDOW(wizard->window),
-                                                               GTK_DIALOG_MODAL,
-                                                               GTK_MESSAGE_ERROR,
-                                                               GTK_BUTTONS_OK,
-                                                               "Invalid Executable");
-                gtk_message_dialog_format_secondary_text(GTK_MESSAGE_DIALOG(error_dialog), 
-                                                       "The selected file is not a valid executable: %s", 
-                                                       exec_error ? exec_error : "Unknown error");
-                gtk_dialog_run(GTK_DIALOG(error_dialog));
-                gtk_widget_destroy(error_dialog);
-                if (exec_error) g_free(exec_error);
-            } else {
-                gtk_entry_set_text(GTK_ENTRY(wizard->exec_entry), filename);
-            }
+            // Validate the selected file without blocking on slow mounts
+            wizard_cancel(&wizard->browse_probe);
+            wizard->browse_probe = g_cancellable_new();
+            gtk_widget_set_sensitive(wizard->exec_browse_button, FALSE);
+            BrowseProbe *probe = g_new0(BrowseProbe, 1);
+            probe->wizard = wizard;
+            probe->path = g_strdup(filename);
+            file_utils_probe_executable_async(filename, FILE_UTILS_PROBE_TIMEOUT_MS, wizard->browse_probe,
+                                              wizard_on_browse_probed, probe);
             g_free(filename);
         }
     }
@@ -637,21 +936,17 @@ void wizard_on_browse_icon(GtkButton *button, WizardState *wizard) {
     
     if (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT) {
         gchar *filename = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(dialog));
-        gtk_entry_set_text(GTK_ENTRY(wizard->icon_entry), filename);
+        // A file of an installed icon theme is stored by name, so the entry
+        // follows the user's theme
+        gchar *icon_name = wizard->icon_index ? icon_index_name_for_path(wizard->icon_index, filename) : NULL;
+        gtk_entry_set_text(GTK_ENTRY(wizard->icon_entry), icon_name ? icon_name : filename);
+        g_free(icon_name);
         g_free(filename);
     }
     
     gtk_widget_destroy(dialog);
 }
 
-void wizard_on_preview_changed(GtkTextBuffer *buffer, WizardState *wizard) {
-    // Update the preview content when user edits the text
-    GtkTextIter start, end;
-    gtk_text_buffer_get_bounds(buffer, &start, &end);
-    g_free(wizard->preview_content);
-    wizard->preview_content = gtk_text_buffer_get_text(buffer, &start, &end, FALSE);
-}
-
 void wizard_on_save_option_changed(GtkToggleButton *button, WizardState *wizard) {
     if (button == GTK_TOGGLE_BUTTON(wizard->save_checkboxes[2])) { // Custom path checkbox
         gboolean active = gtk_toggle_button_get_active(button);
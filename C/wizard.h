@@ -4,6 +4,9 @@
 #include <gtk/gtk.h>
 #include "desktop_entry.h"
 #include "file_utils.h"
+#include "icon_index.h"
+#include "exec_metadata.h"
+#include "wizard_preview.h"
 
 // Wizard step enumeration
 typedef enum {
@@ -20,8 +23,10 @@ typedef enum {
 typedef struct {
     GtkWidget *window;
     GtkWidget *main_container;
-    GtkWidget *step_container;
+    GtkWidget *stack;               // One page per step, built once
     GtkWidget *navigation_frame;
+    GtkWidget *back_button;
+    GtkWidget *next_button;
     
     DesktopEntry *entry;
     FileSaveOptions *save_options;
@@ -36,11 +41,33 @@ typedef struct {
     GtkWidget *exec_browse_button;
     GtkWidget *icon_entry;
     GtkWidget *icon_browse_button;
+    GtkWidget *icon_status;
     GtkWidget *terminal_check;
     GtkWidget *category_checks[9];
     GtkWidget *preview_text;
+    GtkWidget *preview_status;
+    WizardPreviewSync *preview_sync;  // Applies preview edits to entry while the step is shown
     GtkWidget *save_checkboxes[3];
     GtkWidget *custom_path_entry;
+    
+    // Filesystem work runs on GTask workers; these cancel it
+    GCancellable *browse_probe;     // Check of a file picked with Browse
+    GCancellable *type_probe;       // Type detection of entry->exec_path
+    GCancellable *metadata_read;    // Name and icon of a picked AppImage
+    GCancellable *save_cancellable;
+    GCancellable *icon_index_load;
+    IconIndex *icon_index;          // Resolves Icon theme names, built on first use
+    
+    // Step transition timing, enabled with CRE8OR_STEP_TIMING
+    gboolean timing_enabled;
+    WizardStep timing_from;
+    gint64 timing_start_us;
+    gint64 timing_switch_us;
+    GdkFrameClock *timing_clock;
+    gulong timing_handler;
+    guint timing_count;
+    gint64 timing_total_us;
+    gint64 timing_max_us;
 } WizardState;
 
 // Function prototypes
@@ -53,21 +80,14 @@ void wizard_previous_step(WizardState *wizard);
 gboolean wizard_validate_current_step(WizardState *wizard, gchar **error_msg);
 void wizard_generate_preview(WizardState *wizard);
 void wizard_update_entry_from_current_step(WizardState *wizard);
-gboolean wizard_save_files(WizardState *wizard, gchar **error_msg);
+void wizard_save_files(WizardState *wizard);
 
-// Step-specific functions
-void wizard_create_basic_info_step(WizardState *wizard);
-void wizard_create_executable_step(WizardState *wizard);
-void wizard_create_icon_step(WizardState *wizard);
-void wizard_create_categories_step(WizardState *wizard);
-void wizard_create_preview_step(WizardState *wizard);
-void wizard_create_distribution_step(WizardState *wizard);
-void wizard_create_complete_step(WizardState *wizard);
+// Switches to the page of step, loading it from the model
+void wizard_show_step(WizardState *wizard, WizardStep step);
 
 // Callback functions
 void wizard_on_browse_executable(GtkButton *button, WizardState *wizard);
 void wizard_on_browse_icon(GtkButton *button, WizardState *wizard);
-void wizard_on_preview_changed(GtkTextBuffer *buffer, WizardState *wizard);
 void wizard_on_save_option_changed(GtkToggleButton *button, WizardState *wizard);
 
 #endif // WIZARD_H 
\ No newline at end of file
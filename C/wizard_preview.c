@@ -0,0 +1,413 @@
+#include "wizard_preview.h"
+#include "desktop_parser.h"
+#include <string.h>
+
+// Quiet time after the last edit before it is applied
+#define PREVIEW_SYNC_DELAY_MS 300
+// Problems listed in the status label; the rest are only underlined
+#define PREVIEW_MAX_MESSAGES 3
+// Underline for problems, created once per buffer however often the
+// preview is entered
+#define PREVIEW_ERROR_TAG "preview-error"
+
+// [Desktop Entry] keys that map onto the model
+typedef enum {
+    PREVIEW_KEY_NAME = 1 << 0,
+    PREVIEW_KEY_COMMENT = 1 << 1,
+    PREVIEW_KEY_EXEC = 1 << 2,
+    PREVIEW_KEY_ICON = 1 << 3,
+    PREVIEW_KEY_TERMINAL = 1 << 4,
+    PREVIEW_KEY_CATEGORIES = 1 << 5,
+    PREVIEW_KEY_GROUP = 1 << 6        // Not a key: a group header
+} PreviewKey;
+
+#define PREVIEW_N_KEYS 6
+#define PREVIEW_KEYS_ALL ((1 << PREVIEW_N_KEYS) - 1)
+
+static const gchar *preview_key_names[PREVIEW_N_KEYS] = {
+    "Name", "Comment", "Exec", "Icon", "Terminal", "Categories"
+};
+
+struct _WizardPreviewSync {
+    GtkTextBuffer *buffer;
+    GtkLabel *status;
+    DesktopEntry *entry;
+    GtkTextTag *error_tag;
+    GtkTextMark *dirty_start;   // Left gravity: stays before text inserted at it
+    GtkTextMark *dirty_end;     // Right gravity: moves past text inserted at it
+    gboolean dirty;
+    guint touched;              // PreviewKey bits of the edited lines as they were
+    gint64 last_edit_us;
+    guint timeout_id;
+    gulong insert_handler;
+    gulong delete_handler;
+};
+
+// Result of parsing a range of lines
+typedef struct {
+    guint found;                      // PreviewKey bits seen in [Desktop Entry]
+    gchar *values[PREVIEW_N_KEYS];    // Unescaped values of the keys found
+    GString *messages;
+    guint n_problems;
+} PreviewScan;
+
+static guint preview_line_key(const DesktopLine *line) {
+    if (line->kind == DESKTOP_LINE_GROUP) {
+        return PREVIEW_KEY_GROUP;
+    }
+    if (line->kind != DESKTOP_LINE_KEY || line->locale.length > 0) {
+        return 0;
+    }
+    for (guint i = 0; i < PREVIEW_N_KEYS; i++) {
+        if (desktop_span_equal(line->name, preview_key_names[i])) {
+            return 1u << i;
+        }
+    }
+    return 0;
+}
+
+static void preview_line_bounds(const GtkTextIter *first, const GtkTextIter *last,
+                                GtkTextIter *start, GtkTextIter *end) {
+    *start = *first;
+    *end = *last;
+    gtk_text_iter_set_line_offset(start, 0);
+    if (!gtk_text_iter_ends_line(end)) {
+        gtk_text_iter_forward_to_line_end(end);
+    }
+}
+
+// Records which keys the lines first..last hold before an edit changes them,
+// so a key that disappears is noticed. Costs the length of those lines only.
+static void preview_note_lines(WizardPreviewSync *sync, const GtkTextIter *first, const GtkTextIter *last) {
+    GtkTextIter start, end;
+    preview_line_bounds(first, last, &start, &end);
+    gchar *text = gtk_text_buffer_get_slice(sync->buffer, &start, &end, TRUE);
+    
+    for (const gchar *p = text; ; ) {
+        const gchar *newline = strchr(p, '\n');
+        DesktopLine line;
+        desktop_parse_line(p, newline ? (gsize)(newline - p) : strlen(p), &line);
+        sync->touched |= preview_line_key(&line);
+        if (!newline) {
+            break;
+        }
+        p = newline + 1;
+    }
+    g_free(text);
+}
+
+static gboolean preview_on_timeout(gpointer user_data);
+
+static void preview_mark_dirty(WizardPreviewSync *sync, const GtkTextIter *start, const GtkTextIter *end) {
+    if (!sync->dirty) {
+        gtk_text_buffer_move_mark(sync->buffer, sync->dirty_start, start);
+        gtk_text_buffer_move_mark(sync->buffer, sync->dirty_end, end);
+        sync->dirty = TRUE;
+    } else {
+        GtkTextIter current;
+        gtk_text_buffer_get_iter_at_mark(sync->buffer, &current, sync->dirty_start);
+        if (gtk_text_iter_compare(start, &current) < 0) {
+            gtk_text_buffer_move_mark(sync->buffer, sync->dirty_start, start);
+        }
+        gtk_text_buffer_get_iter_at_mark(sync->buffer, &current, sync->dirty_end);
+        if (gtk_text_iter_compare(end, &current) > 0) {
+            gtk_text_buffer_move_mark(sync->buffer, sync->dirty_end, end);
+        }
+    }
+    
+    // Debounce without touching the timer on every keystroke: the timeout
+    // checks the time of the last edit and reschedules itself if needed
+    sync->last_edit_us = g_get_monotonic_time();
+    if (!sync->timeout_id) {
+        sync->timeout_id = g_timeout_add(PREVIEW_SYNC_DELAY_MS, preview_on_timeout, sync);
+    }
+}
+
+// Both handlers run before the default handler, while the old text is
+// still there
+
+static void preview_on_insert_text(GtkTextBuffer *buffer, GtkTextIter *location,
+                                   gchar *text, gint length, gpointer user_data) {
+    (void)buffer;  // Suppress unused parameter warning
+    (void)text;
+    (void)length;
+    WizardPreviewSync *sync = user_data;
+    preview_note_lines(sync, location, location);
+    preview_mark_dirty(sync, location, location);
+}
+
+static void preview_on_delete_range(GtkTextBuffer *buffer, GtkTextIter *start,
+                                    GtkTextIter *end, gpointer user_data) {
+    (void)buffer;  // Suppress unused parameter warning
+    WizardPreviewSync *sync = user_data;
+    preview_note_lines(sync, start, end);
+    preview_mark_dirty(sync, start, end);
+}
+
+static void preview_problem(WizardPreviewSync *sync, PreviewScan *scan, gint line_number,
+                            const gchar *message) {
+    GtkTextIter start, end;
+    gtk_text_buffer_get_iter_at_line(sync->buffer, &start, line_number);
+    preview_line_bounds(&start, &start, &start, &end);
+    gtk_text_buffer_apply_tag(sync->buffer, sync->error_tag, &start, &end);
+    
+    if (scan->n_problems < PREVIEW_MAX_MESSAGES) {
+        g_string_append_printf(scan->messages, "%sLine %d: %s",
+                               scan->messages->len > 0 ? "\n" : "", line_number + 1, message);
+    }
+    scan->n_problems++;
+}
+
+// Whether the lines from start on are in [Desktop Entry], from the nearest
+// group header above
+static gboolean preview_in_entry_group(WizardPreviewSync *sync, const GtkTextIter *start) {
+    GtkTextIter line_start = *start;
+    while (gtk_text_iter_backward_line(&line_start)) {
+        GtkTextIter line_end;
+        preview_line_bounds(&line_start, &line_start, &line_start, &line_end);
+        gchar *text = gtk_text_buffer_get_slice(sync->buffer, &line_start, &line_end, TRUE);
+        DesktopLine line;
+        desktop_parse_line(text, strlen(text), &line);
+        gboolean is_group = line.kind == DESKTOP_LINE_GROUP;
+        gboolean in_entry = is_group && desktop_span_equal(line.name, "Desktop Entry");
+        g_free(text);
+        if (is_group) {
+            return in_entry;
+        }
+    }
+    return FALSE;
+}
+
+// Parses the whole lines between first and last, checking them as it goes
+static void preview_scan(WizardPreviewSync *sync, const GtkTextIter *first, const GtkTextIter *last,
+                         PreviewScan *scan) {
+    GtkTextIter start, end;
+    preview_line_bounds(first, last, &start, &end);
+    gtk_text_buffer_remove_tag(sync->buffer, sync->error_tag, &start, &end);
+    
+    gboolean in_entry = preview_in_entry_group(sync, &start);
+    gint line_number = gtk_text_iter_get_line(&start);
+    gchar *text = gtk_text_buffer_get_slice(sync->buffer, &start, &end, TRUE);
+    
+    for (const gchar *p = text; ; line_number++) {
+        const gchar *newline = strchr(p, '\n');
+        DesktopLine line;
+        desktop_parse_line(p, newline ? (gsize)(newline - p) : strlen(p), &line);
+        
+        if (line.kind == DESKTOP_LINE_INVALID) {
+            preview_problem(sync, scan, line_number, "expected a [Group], a # comment or Key=Value");
+        } else if (line.kind == DESKTOP_LINE_GROUP) {
+            scan->found |= PREVIEW_KEY_GROUP;
+            in_entry = desktop_span_equal(line.name, "Desktop Entry");
+        } else if (line.kind == DESKTOP_LINE_KEY && in_entry) {
+            guint key = preview_line_key(&line);
+            if (key) {
+                guint index = g_bit_nth_lsf(key, -1);
+                scan->found |= key;
+                g_free(scan->values[index]);
+                scan->values[index] = desktop_span_unescape(line.value, key == PREVIEW_KEY_CATEGORIES);
+            }
+            if (key == PREVIEW_KEY_TERMINAL && !desktop_span_equal(line.value, "true") &&
+                !desktop_span_equal(line.value, "false")) {
+                preview_problem(sync, scan, line_number, "Terminal must be true or false");
+            } else if (key == PREVIEW_KEY_CATEGORIES) {
+                DesktopCategories categories;
+                DesktopCategory unmet;
+                desktop_categories_clear(&categories);
+                if (desktop_categories_parse(&categories, line.value.data, line.value.length) > 0) {
+                    preview_problem(sync, scan, line_number, "unknown category (it will be dropped)");
+                } else if ((unmet = desktop_categories_check(&categories)) != DESKTOP_CATEGORY_INVALID) {
+                    gchar *message = g_strdup_printf("%s needs a related main category",
+                                                     desktop_category_get_name(unmet));
+                    preview_problem(sync, scan, line_number, message);
+                    g_free(message);
+                }
+            }
+        }
+        
+        if (!newline) {
+            break;
+        }
+        p = newline + 1;
+    }
+    g_free(text);
+}
+
+static void preview_set_string(gchar **field, gchar **value) {
+    g_free(*field);
+    *field = *value;
+    *value = NULL;
+}
+
+// Writes the keys found into the entry; with clear_missing, model fields
+// whose key is gone from the document are reset
+static void preview_apply_scan(WizardPreviewSync *sync, PreviewScan *scan, gboolean clear_missing) {
+    DesktopEntry *entry = sync->entry;
+    
+    for (guint i = 0; i < PREVIEW_N_KEYS; i++) {
+        guint key = 1u << i;
+        if (!(scan->found & key) && !clear_missing) {
+            continue;
+        }
+        gchar *value = scan->values[i];
+        switch (key) {
+            case PREVIEW_KEY_NAME:
+                preview_set_string(&entry->name, &scan->values[i]);
+                break;
+            case PREVIEW_KEY_COMMENT:
+                preview_set_string(&entry->comment, &scan->values[i]);
+                break;
+            case PREVIEW_KEY_ICON:
+                preview_set_string(&entry->icon_path, &scan->values[i]);
+                break;
+            case PREVIEW_KEY_EXEC:
+                // Undo the interpreter and terminal wrappers the generator adds
+                g_free(entry->exec_path);
+                entry->exec_path = value ? desktop_exec_get_path(value, NULL) : NULL;
+                entry->exec_type = FILE_TYPE_UNKNOWN;
+                break;
+            case PREVIEW_KEY_TERMINAL:
+                entry->terminal = g_strcmp0(value, "true") == 0;
+                break;
+            case PREVIEW_KEY_CATEGORIES:
+                desktop_categories_clear(&entry->categories);
+                if (value) {
+                    desktop_categories_parse(&entry->categories, value, -1);
+                }
+                break;
+        }
+    }
+}
+
+static void preview_update_status(WizardPreviewSync *sync, PreviewScan *scan) {
+    if (!sync->status) {
+        return;
+    }
+    
+    GString *status = g_string_new(scan->messages->str);
+    if (scan->n_problems > PREVIEW_MAX_MESSAGES) {
+        g_string_append_printf(status, "\n(%u more underlined)", scan->n_problems - PREVIEW_MAX_MESSAGES);
+    }
+    gchar *error_msg = NULL;
+    if (!desktop_entry_validate(sync->entry, &error_msg)) {
+        g_string_append_printf(status, "%s%s", status->len > 0 ? "\n" : "", error_msg);
+        g_free(error_msg);
+    }
+    if (status->len == 0) {
+        g_string_append(status, "Edits are applied to the entry as you type.");
+    }
+    gtk_label_set_text(sync->status, status->str);
+    g_string_free(status, TRUE);
+}
+
+static void preview_scan_clear(PreviewScan *scan) {
+    for (guint i = 0; i < PREVIEW_N_KEYS; i++) {
+        g_free(scan->values[i]);
+        scan->values[i] = NULL;
+    }
+    g_string_truncate(scan->messages, 0);
+    scan->found = 0;
+    scan->n_problems = 0;
+}
+
+static void preview_apply(WizardPreviewSync *sync) {
+    if (!sync->dirty) {
+        return;
+    }
+    GtkTextIter start, end;
+    gtk_text_buffer_get_iter_at_mark(sync->buffer, &start, sync->dirty_start);
+    gtk_text_buffer_get_iter_at_mark(sync->buffer, &end, sync->dirty_end);
+    guint touched = sync->touched;
+    sync->dirty = FALSE;
+    sync->touched = 0;
+    
+    PreviewScan scan = { 0 };
+    scan.messages = g_string_new(NULL);
+    
+    // Usually only the edited lines need parsing. A group header changing,
+    // or a key no longer being where it was, takes the whole document.
+    gboolean whole = (touched & PREVIEW_KEY_GROUP) != 0;
+    if (!whole) {
+        preview_scan(sync, &start, &end, &scan);
+        whole = (scan.found & PREVIEW_KEY_GROUP) || (touched & PREVIEW_KEYS_ALL & ~scan.found);
+    }
+    if (whole) {
+        preview_scan_clear(&scan);
+        gtk_text_buffer_get_bounds(sync->buffer, &start, &end);
+        preview_scan(sync, &start, &end, &scan);
+    }
+    preview_apply_scan(sync, &scan, whole);
+    preview_update_status(sync, &scan);
+    
+    preview_scan_clear(&scan);
+    g_string_free(scan.messages, TRUE);
+}
+
+static gboolean preview_on_timeout(gpointer user_data) {
+    WizardPreviewSync *sync = user_data;
+    gint64 idle_ms = (g_get_monotonic_time() - sync->last_edit_us) / 1000;
+    if (idle_ms < PREVIEW_SYNC_DELAY_MS) {
+        sync->timeout_id = g_timeout_add(PREVIEW_SYNC_DELAY_MS - idle_ms, preview_on_timeout, sync);
+        return G_SOURCE_REMOVE;
+    }
+    sync->timeout_id = 0;
+    preview_apply(sync);
+    return G_SOURCE_REMOVE;
+}
+
+WizardPreviewSync* wizard_preview_sync_new(GtkTextView *view, GtkLabel *status, DesktopEntry *entry) {
+    WizardPreviewSync *sync = g_new0(WizardPreviewSync, 1);
+    sync->buffer = g_object_ref(gtk_text_view_get_buffer(view));
+    sync->status = status ? g_object_ref(status) : NULL;
+    sync->entry = entry;
+    
+    GtkTextIter start;
+    gtk_text_buffer_get_start_iter(sync->buffer, &start);
+    sync->dirty_start = gtk_text_buffer_create_mark(sync->buffer, NULL, &start, TRUE);
+    sync->dirty_end = gtk_text_buffer_create_mark(sync->buffer, NULL, &start, FALSE);
+    sync->error_tag = gtk_text_tag_table_lookup(gtk_text_buffer_get_tag_table(sync->buffer),
+                                                PREVIEW_ERROR_TAG);
+    if (!sync->error_tag) {
+        sync->error_tag = gtk_text_buffer_create_tag(sync->buffer, PREVIEW_ERROR_TAG,
+                                                     "underline", PANGO_UNDERLINE_ERROR, NULL);
+    }
+    
+    sync->insert_handler = g_signal_connect(sync->buffer, "insert-text",
+                                            G_CALLBACK(preview_on_insert_text), sync);
+    sync->delete_handler = g_signal_connect(sync->buffer, "delete-range",
+                                            G_CALLBACK(preview_on_delete_range), sync);
+    
+    if (sync->status) {
+        gtk_label_set_text(sync->status, "Edits are applied to the entry as you type.");
+    }
+    return sync;
+}
+
+void wizard_preview_sync_flush(WizardPreviewSync *sync) {
+    if (sync->timeout_id) {
+        g_source_remove(sync->timeout_id);
+        sync->timeout_id = 0;
+    }
+    preview_apply(sync);
+}
+
+gchar* wizard_preview_sync_get_text(WizardPreviewSync *sync) {
+    GtkTextIter start, end;
+    gtk_text_buffer_get_bounds(sync->buffer, &start, &end);
+    return gtk_text_buffer_get_text(sync->buffer, &start, &end, FALSE);
+}
+
+void wizard_preview_sync_free(WizardPreviewSync *sync) {
+    if (sync) {
+        wizard_preview_sync_flush(sync);
+        g_signal_handler_disconnect(sync->buffer, sync->insert_handler);
+        g_signal_handler_disconnect(sync->buffer, sync->delete_handler);
+        gtk_text_buffer_delete_mark(sync->buffer, sync->dirty_start);
+        gtk_text_buffer_delete_mark(sync->buffer, sync->dirty_end);
+        g_object_unref(sync->buffer);
+        if (sync->status) {
+            g_object_unref(sync->status);
+        }
+        g_free(sync);
+    }
+}
@@ -0,0 +1,27 @@
+#ifndef WIZARD_PREVIEW_H
+#define WIZARD_PREVIEW_H
+
+#include <gtk/gtk.h>
+#include "desktop_entry.h"
+
+// Two-way sync between the preview text view and the entry model.
+// Each edit only records which lines it touched; once typing pauses, just
+// those lines are parsed again, the entry is updated and problems are
+// underlined in place and listed in the status label.
+
+typedef struct _WizardPreviewSync WizardPreviewSync;
+
+// Starts tracking edits to view's buffer, which should already hold the
+// generated content. entry is updated in place; status may be NULL.
+WizardPreviewSync* wizard_preview_sync_new(GtkTextView *view, GtkLabel *status, DesktopEntry *entry);
+
+// Applies pending edits immediately
+void wizard_preview_sync_flush(WizardPreviewSync *sync);
+
+// Returns the full text of the preview
+gchar* wizard_preview_sync_get_text(WizardPreviewSync *sync);
+
+// Stops tracking; pending edits are applied first
+void wizard_preview_sync_free(WizardPreviewSync *sync);
+
+#endif // WIZARD_PREVIEW_H